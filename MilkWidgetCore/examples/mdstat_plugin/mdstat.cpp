@@ -0,0 +1,104 @@
+/**
+ * MilkWidgetCore - Example Collector Plugin
+ *
+ * Software RAID health from /proc/mdstat as mdstat.arrays,
+ * mdstat.degraded and mdstat.rebuilding. init() allocates the read
+ * buffer once; sample() only reads into it and counts.
+ *
+ *   MILK_PLUGINS=./libmilk_mdstat.so milkwidget raid.xml
+ */
+
+#include <milk/MetricPlugin.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t BufferSize = 64 * 1024;
+
+const MilkMetric Metrics[] = {
+    {"arrays", nullptr},
+    {"degraded", nullptr},    // Arrays with a missing member ("[U_]")
+    {"rebuilding", nullptr},  // Arrays in resync or recovery
+};
+
+struct State {
+    char* buffer;
+};
+
+void* init(const char** error) {
+    State* state = static_cast<State*>(malloc(sizeof(State)));
+    if (state) state->buffer = static_cast<char*>(malloc(BufferSize));
+    if (!state || !state->buffer) {
+        free(state);
+        *error = "out of memory";
+        return nullptr;
+    }
+    return state;
+}
+
+const MilkMetric* describe(void*, uint32_t* count) {
+    *count = sizeof(Metrics) / sizeof(Metrics[0]);
+    return Metrics;
+}
+
+int sample(void* opaque, double* values, uint32_t count) {
+    State* state = static_cast<State*>(opaque);
+    if (count < 3) return -1;
+
+    // No md driver simply means no arrays
+    values[0] = values[1] = values[2] = 0;
+    int fd = open("/proc/mdstat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t length = read(fd, state->buffer, BufferSize - 1);
+    close(fd);
+    if (length <= 0) return 0;
+    state->buffer[length] = '\0';
+
+    // An array is a line "mdN : ..." followed by its status lines
+    bool degraded = false;
+    bool rebuilding = false;
+    for (char* line = state->buffer; line && *line;) {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        if (strncmp(line, "md", 2) == 0 && strstr(line, " : ")) {
+            values[1] += degraded;
+            values[2] += rebuilding;
+            degraded = rebuilding = false;
+            values[0] += 1;
+        } else if (line[0] == ' ') {
+            const char* members = strrchr(line, '[');
+            if (members && strchr(members, '_')) degraded = true;
+            if (strstr(line, "resync") || strstr(line, "recovery")) rebuilding = true;
+        }
+        line = next;
+    }
+    values[1] += degraded;
+    values[2] += rebuilding;
+    return 0;
+}
+
+void shutdown(void* opaque) {
+    State* state = static_cast<State*>(opaque);
+    free(state->buffer);
+    free(state);
+}
+
+const MilkPlugin Plugin = {
+    MILK_PLUGIN_ABI_VERSION,
+    "mdstat",
+    init,
+    describe,
+    sample,
+    shutdown,
+};
+
+} // namespace
+
+extern "C" MILK_PLUGIN_EXPORT const MilkPlugin* milk_plugin_entry(void) {
+    return &Plugin;
+}
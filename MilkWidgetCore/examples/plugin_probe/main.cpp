@@ -0,0 +1,61 @@
+/**
+ * MilkWidgetCore - Example Plugin Probe
+ *
+ * Loads one collector plugin, runs it for a number of rounds the way the
+ * sampler would, and prints its values and timings. Exits non-zero when
+ * the plugin fails to load or gets disabled for overrunning its budget,
+ * so a plugin's own build can run it as a check.
+ *
+ *   milk_plugin_probe ./libmilk_mdstat.so [rounds] [budget-us]
+ */
+
+#include <milk/MilkWidget.h>
+
+#include <QCoreApplication>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Milk;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <plugin> [rounds] [budget-us]\n", argv[0]);
+        return 2;
+    }
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+    
+    // A host of its own: the sampler never runs, so every round below is ours
+    PluginHost probe;
+    PluginHost* host = &probe;
+    if (argc > 3) host->setBudget(std::atoi(argv[3]));
+    
+    QString error;
+    if (!host->load(QString::fromLocal8Bit(argv[1]), &error)) {
+        std::fprintf(stderr, "load failed: %s\n", qPrintable(error));
+        return 1;
+    }
+    
+    qint64 slowest = 0;
+    for (int i = 0; i < rounds; ++i) {
+        host->sample();
+        slowest = qMax(slowest, host->plugins().first().lastRunNs);
+    }
+    QCoreApplication::processEvents();  // Deliveries and the disabled signal are queued
+    
+    PluginHost::PluginInfo info = host->plugins().first();
+    for (int i = 0; i < info.metrics.size(); ++i) {
+        std::printf("%-40s %g\n", qPrintable(info.metrics[i]), info.values[i]);
+    }
+    std::printf("\n%d rounds, slowest %.1f us, budget %d us, %d overruns\n",
+                rounds, slowest / 1000.0, host->budget(), info.overruns);
+    
+    int status = 0;
+    if (info.disabled) {
+        std::printf("DISABLED: %s\n", qPrintable(info.reason));
+        status = 1;
+    }
+    cleanupAPIs();
+    return status;
+}
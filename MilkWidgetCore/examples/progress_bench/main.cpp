@@ -0,0 +1,95 @@
+/**
+ * MilkWidgetCore - ProgressBar Paint Benchmark
+ *
+ * Renders 100 animating bars offscreen and compares the old per-frame
+ * path/gradient paint against the cached layer blit ProgressBar uses now.
+ *
+ *   milk_progress_bench [frames]
+ */
+
+#include <milk/MilkWidget.h>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPainterPath>
+#include <QVBoxLayout>
+#include <QtMath>
+#include <iostream>
+
+using namespace Milk;
+
+static const int BarCount = 100;
+
+/** Reproduces the previous ProgressBar::paintEvent for comparison */
+class LegacyBar : public QWidget {
+public:
+    explicit LegacyBar(QWidget* parent) : QWidget(parent) { setFixedHeight(12); }
+    void setValue(double v) { m_value = v; }
+
+protected:
+    void paintEvent(QPaintEvent*) override {
+        QPainter p(this); p.setRenderHint(QPainter::Antialiasing);
+        QRectF r = rect();
+        QPainterPath bgPath; bgPath.addRoundedRect(r, 6, 6); p.fillPath(bgPath, QColor(60, 60, 70, 150));
+        QRectF fillRect = r; fillRect.setWidth(r.width() * m_value / 100.0);
+        QPainterPath fillPath; fillPath.addRoundedRect(fillRect, 6, 6);
+        QLinearGradient grad(fillRect.topLeft(), fillRect.topRight());
+        grad.setColorAt(0, QColor(0, 150, 255)); grad.setColorAt(1, QColor(180, 80, 255));
+        p.fillPath(fillPath, grad);
+    }
+
+private:
+    double m_value = 0;
+};
+
+template <typename Bar>
+static double run(QWidget& host, const QList<Bar*>& bars, int frames) {
+    QImage target(host.size(), QImage::Format_ARGB32_Premultiplied);
+    QElapsedTimer timer; timer.start();
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < bars.size(); i++) {
+            bars[i]->setValue(50 + 50 * qSin((f + i * 7) * 0.05));
+        }
+        target.fill(Qt::transparent);
+        host.render(&target);
+    }
+    return timer.nsecsElapsed() / 1e6 / frames;
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    int frames = argc > 1 ? QString(argv[1]).toInt() : 600;
+    if (frames <= 0) frames = 600;
+
+    QWidget legacyHost; legacyHost.resize(320, BarCount * 14);
+    auto* legacyLayout = new QVBoxLayout(&legacyHost); legacyLayout->setSpacing(2);
+    QList<LegacyBar*> legacy;
+    for (int i = 0; i < BarCount; i++) { legacy << new LegacyBar(&legacyHost); legacyLayout->addWidget(legacy.last()); }
+
+    QWidget cachedHost; cachedHost.resize(320, BarCount * 14);
+    auto* cachedLayout = new QVBoxLayout(&cachedHost); cachedLayout->setSpacing(2);
+    QList<ProgressBar*> cached;
+    for (int i = 0; i < BarCount; i++) {
+        auto* bar = new ProgressBar(&cachedHost);
+        bar->setHeight(12); bar->setRounded(6); bar->setAnimated(false);
+        bar->setGradient(QColor(0, 150, 255), QColor(180, 80, 255));
+        cached << bar; cachedLayout->addWidget(bar);
+    }
+
+    legacyHost.ensurePolished(); legacyLayout->activate();
+    cachedHost.ensurePolished(); cachedLayout->activate();
+
+    // Warm up both paths once so the cache fill is not part of the measurement
+    run(legacyHost, legacy, 1);
+    run(cachedHost, cached, 1);
+
+    double legacyMs = run(legacyHost, legacy, frames);
+    double cachedMs = run(cachedHost, cached, frames);
+
+    std::cout << BarCount << " bars, " << frames << " frames\n"
+              << "  legacy (path + gradient per frame): " << legacyMs << " ms/frame\n"
+              << "  cached (clipped layer blit):        " << cachedMs << " ms/frame\n"
+              << "  speedup: " << (cachedMs > 0 ? legacyMs / cachedMs : 0) << "x\n";
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * MilkWidgetCore - Example Audio Spectrum
+ *
+ * Bar visualizer for whatever is playing. Pass a WAV file or FIFO path to
+ * analyze that instead of the default audio monitor.
+ */
+
+#include <milk/MilkWidget.h>
+
+using namespace Milk;
+
+int main(int argc, char *argv[])
+{
+    Application app(argc, argv);
+    
+    Widget* panel = Widget::create(420, 160);
+    panel->setBackground(15, 15, 25, 220);
+    panel->setRounded(10);
+    panel->setPosition(Position::BottomRight);
+    panel->setDraggable(true);
+    
+    Graph* bars = graph(panel);
+    bars->setGraphType(GraphType::Bar);
+    bars->setLineColor(QColor("#4ECDC4"));
+    bars->setMinValue(0.0);
+    bars->setMaxValue(1.0);
+    bars->setShowGrid(false);
+    
+    Text* level = label("", panel);
+    level->setMonospace();
+    level->setColor("#A8A8A8");
+    level->setFontSize(9);
+    
+    AudioSpectrum* spectrum = audio();
+    spectrum->setBands(48);
+    spectrum->setFrameRate(60);
+    if (argc > 1) spectrum->setSource(QString::fromLocal8Bit(argv[1]));
+    bars->setMaxPoints(spectrum->bands());
+    
+    // All the math happened on the audio thread; this only copies 48 floats
+    SpectrumFrame frame;
+    QList<double> values;
+    QObject::connect(spectrum, &AudioSpectrum::frameReady, bars, [=]() mutable {
+        if (!spectrum->takeFrame(frame)) return;
+        values.clear();
+        for (float band : frame.bands) values.append(band);
+        bars->setValues(values);
+        level->setText(QString("rms %1  peak %2").arg(frame.rms, 0, 'f', 3).arg(frame.peak, 0, 'f', 3));
+    });
+    QObject::connect(spectrum, &AudioSpectrum::error, level, &Text::setText);
+    
+    spectrum->start();
+    panel->show();
+    
+    return app.exec();
+}
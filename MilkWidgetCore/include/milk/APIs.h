@@ -7,32 +7,189 @@
 #pragma once
 
 #include <QObject>
+#include <QThread>
 #include <QTimer>
 #include <QMutex>
 #include <QNetworkAccessManager>
+#include <QNetworkReply>
 #include <QJsonObject>
+#include <QPointer>
+#include <QUrl>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QCache>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QVariant>
+#include <QVector>
+#include <QStringList>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "Types.h"
 
+class QLocalServer;
+class QTcpServer;
+
 namespace Milk {
 
+class AlertRules;
+class PluginHost;
+class GpuCollector;
+class CpuTopology;
+class MemInfoReader;
+
 // ============================================================================
 // SYSTEM MONITOR
 // ============================================================================
+
+/**
+ * Samples /proc and sysfs on the "milk-sampler" thread and publishes each
+ * round as an immutable Snapshot; updated() is delivered to the GUI thread
+ * afterwards. Alert rules run on the sampler right after publishing.
+ */
 class SystemMonitor : public QObject {
     Q_OBJECT
     
 public:
+    /**
+     * Everything one update collected, published as a whole. Readers hold
+     * a shared pointer to an immutable copy and never take the monitor's lock.
+     */
+    struct Snapshot {
+        struct Filesystem {
+            QString mountPoint;
+            QString device;
+            QString type;
+            qint64 total = 0;
+            qint64 free = 0;
+        };
+        struct Interface {
+            QString name;
+            quint64 rxBytes = 0;
+            quint64 txBytes = 0;
+        };
+        struct Gpu {
+            QString card;          // "card0"
+            QString model;
+            QString driver;
+            double busy = -1;      // Percent; -1: unknown
+            qint64 vramUsed = -1;  // Bytes; -1: unknown
+            qint64 vramTotal = -1;
+            double temperature = 0;
+        };
+        struct Memory {
+            // Bytes, from the meminfo field of the same name; HugePages_* are counts
+            qint64 total = 0;
+            qint64 free = 0;
+            qint64 available = 0;  // Estimated for NUMA nodes, which don't report it
+            qint64 used = 0;       // NUMA nodes only
+            qint64 buffers = 0;
+            qint64 cached = 0;
+            qint64 swapCached = 0;
+            qint64 active = 0;
+            qint64 inactive = 0;
+            qint64 unevictable = 0;
+            qint64 mlocked = 0;
+            qint64 swapTotal = 0;
+            qint64 swapFree = 0;
+            qint64 dirty = 0;
+            qint64 writeback = 0;
+            qint64 anonPages = 0;
+            qint64 mapped = 0;
+            qint64 filePages = 0;  // NUMA nodes only
+            qint64 shmem = 0;
+            qint64 kReclaimable = 0;
+            qint64 slab = 0;
+            qint64 sReclaimable = 0;
+            qint64 sUnreclaim = 0;
+            qint64 kernelStack = 0;
+            qint64 pageTables = 0;
+            qint64 commitLimit = 0;
+            qint64 committedAs = 0;
+            qint64 vmallocUsed = 0;
+            qint64 anonHugePages = 0;
+            qint64 hugePagesTotal = 0;
+            qint64 hugePagesFree = 0;
+            qint64 hugePagesReserved = 0;
+            qint64 hugePagesSurplus = 0;
+            qint64 hugePageSize = 0;
+        };
+        struct CpuGroup {
+            QString name;          // "package0", "node1", "performance", "efficiency"
+            int cpus = 0;
+            double usage = 0;      // Percent, mean over the group
+            double frequency = 0;  // MHz, mean; 0: unknown
+        };
+        struct GpuProcess {
+            int pid = 0;
+            QString name;
+            QString card;
+            double busy = 0;       // Busiest engine, percent
+        };
+        
+        qint64 timestamp = 0;  // ms since epoch
+        double cpuUsage = 0;   // Percent
+        QVector<double> coreUsage;      // Percent by logical CPU id
+        QVector<double> coreFrequency;  // MHz by logical CPU id
+        QVector<CpuGroup> cpuGroups;    // Packages; nodes and core types where there are several
+        qint64 memoryTotal = 0;
+        qint64 memoryAvailable = 0;
+        qint64 swapTotal = 0;
+        qint64 swapFree = 0;
+        Memory memory;                  // All of /proc/meminfo
+        QVector<Memory> memoryNodes;    // By NUMA node id; empty without NUMA
+        QVector<Filesystem> filesystems;
+        QVector<Interface> interfaces;
+        QMap<QString, double> temperatures;  // Celsius by sensor
+        double uptime = 0;
+        int processes = 0;
+        double load[3] = {0, 0, 0};
+        int batteryPercent = -1;  // -1: no battery
+        bool batteryCharging = false;
+        QVector<Gpu> gpus;
+        QVector<GpuProcess> gpuProcesses;
+    };
+    
+    /** Values with a change signal; see setDeadband */
+    enum Metric { Cpu, Memory, Temperature, Gpu, MetricCount };
+    
+    /**
+     * When a change signal fires. A new value is reported once it moved by
+     * the larger of absolute and relative * |last reported value| (any
+     * change if both are 0), or when maxStaleMs passed since the last
+     * report (never if 0).
+     */
+    struct Deadband {
+        double absolute = 0;  // In the metric's unit: percent, or °C
+        double relative = 0;
+        int maxStaleMs = 0;
+        
+        /** Whether value is due, given the last report and when it was made (0: never) */
+        bool due(double value, double last, qint64 nowMs, qint64 lastAtMs) const;
+    };
+    
     static SystemMonitor* instance();
     static void cleanup();
     
+    /** Latest published snapshot; lock-free, callable from any thread */
+    std::shared_ptr<const Snapshot> snapshot() const;
+    
     // CPU
     double cpu();
     double cpuCore(int core);
     int cpuCores();
+    int cpuPhysicalCores();  // SMT siblings count once
+    int cpuPackages();
+    int cpuNodes();
+    double cpuPackage(int package);
+    double cpuNode(int node);
     QString cpuModel();
-    double cpuFrequency();
+    double cpuFrequency();  // MHz, mean over all CPUs
+    double cpuCoreFrequency(int core);
     
     // Memory
     double memory();
@@ -70,49 +227,91 @@ public:
     QString osVersion();
     QString kernelVersion();
     
-    // GPU
+    // GPU (first card)
     double gpuUsage();
-    double gpuMemory();
+    double gpuMemory();  // Percent of VRAM in use
     QString gpuModel();
     
     // Update interval
     void setUpdateInterval(int ms);
     int updateInterval() const { return m_updateInterval; }
     
+    // Change signals; defaults suit whole-number displays
+    void setDeadband(Metric metric, const Deadband& deadband);
+    Deadband deadband(Metric metric);
+    
+    // History: record sys.cpu, sys.memory and sys.temperature into TimeSeries each update
+    void setHistoryEnabled(bool enabled);
+    bool historyEnabled() const { return m_historyEnabled; }
+    
     // Get all info at once
     SystemInfo info();
     
 signals:
     void updated();
+    
+    // At most once per snapshot each, subject to the metric's Deadband.
+    // The same values reach MetricRegistry as sys.cpu, sys.memory,
+    // sys.temperature and sys.gpu. Network rates have no signal; they are
+    // published as net.<interface>.rx/tx and net.rx/tx in bytes per second.
     void cpuChanged(double usage);
     void memoryChanged(double usage);
     void temperatureChanged(double temp);
+    void gpuChanged(double usage);
     
 private:
     explicit SystemMonitor(QObject* parent = nullptr);
     ~SystemMonitor();
     
     void updateSystemInfo();
-    void readCpuInfo();
-    void readMemInfo();
-    void readDiskInfo();
-    void readTempInfo();
-    void readProcessInfo();
+    void readCpuInfo(Snapshot& snapshot);
+    void readMemInfo(Snapshot& snapshot);
+    void readDiskInfo(Snapshot& snapshot);
+    void readTempInfo(Snapshot& snapshot);
+    void readProcessInfo(Snapshot& snapshot);
+    void readNetInfo(Snapshot& snapshot);
+    void readBatteryInfo(Snapshot& snapshot);
+    void readGpuInfo(Snapshot& snapshot);
+    void reportChanges(const Snapshot& snapshot);
+    void reportNetRates(const Snapshot& snapshot);
     
 private:
+    friend class AlertRules;
+    friend class PluginHost;
     static SystemMonitor* s_instance;
     
-    QTimer* m_timer;
-    QMutex m_mutex;
+    QThread* m_thread = nullptr;
+    QTimer* m_timer = nullptr;  // Lives on m_thread
+    QMutex m_mutex;      // m_info and m_deadbands; never held while sampling
+    QMutex m_hookMutex;  // m_alerts and m_plugins; held while they run
     int m_updateInterval = 1000;
+    std::atomic<bool> m_historyEnabled{false};
+    AlertRules* m_alerts = nullptr;
+    PluginHost* m_plugins = nullptr;
+    
+    // Change signals: deadbands guarded by m_mutex, last reports sampler only
+    Deadband m_deadbands[MetricCount];
+    double m_reported[MetricCount] = {};
+    qint64 m_reportedAt[MetricCount] = {};  // m_clock ms; 0: never reported
+    
+    // Network rates: sampler only
+    QHash<QString, QPair<quint64, quint64>> m_netBytes;  // rx, tx at m_netAt
+    QHash<QString, double> m_netReported;
+    qint64 m_netAt = 0;  // m_clock ms; 0: no round yet
     
     // Cached data
     SystemInfo m_info;
+    SystemInfo m_sampled;  // Sampler only; copied to m_info after each round
+    std::shared_ptr<const Snapshot> m_snapshot;  // Only touched through std::atomic_load/store
+    QString m_batteryPath;
+    std::unique_ptr<CpuTopology> m_topology;  // Only used by updateSystemInfo
+    std::unique_ptr<MemInfoReader> m_memInfo;
+    std::unique_ptr<GpuCollector> m_gpu;
+    QElapsedTimer m_clock;
     
     // CPU calculation state
     quint64 m_lastCpuIdle = 0;
     quint64 m_lastCpuTotal = 0;
-    QList<QPair<quint64, quint64>> m_lastCoreStats;
     
     // Static info
     QString m_cpuModel;
@@ -262,6 +461,8 @@ private:
     QString m_status;
     int m_lowThreshold = 20;
     int m_criticalThreshold = 10;
+    bool m_lowRaised = false;       // Warned during this discharge
+    bool m_criticalRaised = false;
 };
 
 // ============================================================================
@@ -281,6 +482,12 @@ public:
     void setUnits(const QString& units);  // "metric", "imperial"
     void setUpdateInterval(int minutes);
     
+    // Caching
+    void setEndpoint(const QUrl& url);  // OpenWeatherMap-compatible "weather" URL
+    void setCacheTtl(int seconds);      // refresh() is a no-op while data is this fresh
+    void setMaxStale(int seconds);      // Older cached data is not shown on cold start
+    bool isStale();
+    
     // Current weather
     QString temperature();
     int temperatureInt();
@@ -331,6 +538,10 @@ private:
     
     void fetchWeather();
     void parseWeatherData(const QJsonObject& data);
+    void locationChanged();
+    QString cacheFile() const;
+    void loadCache();
+    void storeCache();
     
 private slots:
     void onWeatherReply();
@@ -340,19 +551,182 @@ private:
     
     QNetworkAccessManager* m_network;
     QTimer* m_timer;
+    QTimer* m_retryTimer;
+    QPointer<QNetworkReply> m_reply;  // In-flight request shared by all callers
     
     QString m_apiKey;
     QString m_city;
     double m_lat = 0;
     double m_lon = 0;
+    bool m_useCoords = false;
     QString m_units = "metric";
+    QUrl m_endpoint;
+    
+    // Cache validators and freshness of m_rawData
+    int m_cacheTtl = 600;
+    int m_maxStale = 24 * 3600;
+    int m_backoff = 0;  // Seconds; doubles per failure, 0 when healthy
+    QByteArray m_etag;
+    QByteArray m_lastModified;
     
     WeatherInfo m_info;
     QJsonObject m_rawData;
-    QDateTime m_lastUpdate;
+    QDateTime m_lastUpdate;  // Last time the server confirmed the data
     bool m_valid = false;
 };
 
+// ============================================================================
+// DATA SOURCE
+// ============================================================================
+class JsonPathSet;
+
+/**
+ * Binds widgets to fields of a JSON HTTP endpoint.
+ *
+ * Paths ("cpu.load", "$.hosts[2].name") are compiled once; each response
+ * is scanned in a single pass that skips every subtree no path asks for,
+ * so no QJsonDocument is built for the body.
+ */
+class DataSource : public QObject {
+    Q_OBJECT
+    
+public:
+    enum Mode {
+        Poll,        // GET every interval
+        LongPoll,    // Re-issue the GET as soon as the previous one answers
+        EventStream  // Server-Sent Events; each "data:" payload is one document
+    };
+    
+    explicit DataSource(const QUrl& url, QObject* parent = nullptr);
+    ~DataSource();
+    
+    /** One instance per URL, shared by every widget that binds to it */
+    static DataSource* shared(const QUrl& url);
+    static void cleanup();
+    
+    /** Shared manager: one connection pool, HTTP/2 where the server allows */
+    static QNetworkAccessManager* network();
+    
+    // Setup
+    void setMode(Mode mode);
+    void setInterval(int ms);
+    void setHeader(const QByteArray& name, const QByteArray& value);
+    
+    // Binding. JSON null is a value of its own, a valid QVariant holding
+    // nullptr (isNull() is true); a path missing from a response keeps
+    // its last value, and value() is invalid until one arrives.
+    bool bind(const QString& path);
+    void bind(const QString& path, std::function<void(const QVariant&)> callback);
+    QVariant value(const QString& path) const;
+    
+    // Control
+    void start();
+    void stop();
+    bool isRunning() const { return m_running; }
+    QUrl url() const { return m_url; }
+    
+signals:
+    void valueChanged(const QString& path, const QVariant& value);
+    void updated();
+    void error(const QString& message);
+    
+private:
+    void request();
+    void onReadyRead();
+    void onFinished();
+    void process(const char* data, int size);
+    void scheduleNext();
+    void reset(const QString& message);  // Drop the connection and reconnect with backoff
+    
+private:
+    static QHash<QString, DataSource*> s_shared;
+    
+    QUrl m_url;
+    Mode m_mode = Poll;
+    int m_interval = 1000;
+    bool m_running = false;
+    QList<QPair<QByteArray, QByteArray>> m_headers;
+    
+    QTimer* m_timer;
+    QPointer<QNetworkReply> m_reply;
+    QByteArray m_buffer;  // Reused body / event-stream line buffer
+    QByteArray m_event;   // SSE data lines of the pending event
+    int m_failures = 0;
+    
+    std::unique_ptr<JsonPathSet> m_paths;
+    QHash<QString, int> m_slotByPath;
+    QStringList m_pathNames;  // First path bound to each slot
+    QVector<QVariant> m_values;
+    QVector<QVariant> m_scratch;
+    QMultiHash<int, std::function<void(const QVariant&)>> m_callbacks;
+};
+
+// ============================================================================
+// COMMAND SOURCE
+// ============================================================================
+class CommandWorker;
+
+/**
+ * Managed subprocess output for widgets.
+ *
+ * Persistent commands stay running and report each line they print;
+ * interval commands rerun on a timer, never overlap themselves, and share
+ * a global concurrency cap. Processes and parsing live on one runner
+ * thread. Identical commands are deduplicated across widgets.
+ */
+class CommandSource : public QObject {
+    Q_OBJECT
+    
+public:
+    enum Mode {
+        Persistent,  // Long-running, line-delimited output; restarted with backoff
+        Interval     // Rerun every interval; stdout is the result
+    };
+    
+    /**
+     * Shared, refcounted instance per command/mode/interval/pattern; pair
+     * with release(). pattern is a regex whose first capture group (or
+     * whole match) becomes value(); empty means the first number.
+     */
+    static CommandSource* acquire(const QString& command, Mode mode = Interval, int intervalMs = 1000,
+                                  const QString& pattern = QString());
+    static void release(CommandSource* source);
+    static void setMaxConcurrent(int count);
+    static void cleanup();
+    
+    QString command() const { return m_command; }
+    QString output() const { return m_output; }
+    QString lastLine() const { return m_lastLine; }
+    double value() const { return m_value; }
+    
+signals:
+    void lineReceived(const QString& line);
+    void outputChanged(const QString& output);
+    void valueChanged(double value);
+    void error(const QString& message);
+    
+private:
+    CommandSource(const QString& command, Mode mode, int intervalMs, const QString& pattern);
+    ~CommandSource();
+    
+    void onResult(const QStringList& lines, const QString& output, double value, bool hasValue);
+    
+private:
+    static QHash<QString, CommandSource*> s_sources;
+    static QThread* s_thread;
+    
+    QString m_key;
+    QString m_command;
+    Mode m_mode;
+    int m_refs = 0;
+    CommandWorker* m_worker;
+    
+    QString m_output;
+    QString m_lastLine;
+    double m_value = 0;
+    bool m_hasValue = false;
+};
+
 // ============================================================================
 // MEDIA PLAYER
 // ============================================================================
@@ -415,13 +789,113 @@ private:
     
     void updateMediaInfo();
     void connectToPlayer();
+    void disconnectFromPlayer();
+    void pickPlayer();
+    void applyProperties(const QVariantMap& properties);
+    void applyMetadata(const QVariantMap& metadata);
+    void setPlaybackStatus(const QString& status);
+    void callPlayer(const QString& method, const QVariantList& args = {});
+    void fetchArt(const QString& url);
+    qint64 positionUs() const;
+    
+private slots:
+    void onNameOwnerChanged(const QString& name, const QString& oldOwner, const QString& newOwner);
+    void onPropertiesChanged(const QString& interface, const QVariantMap& changed, const QStringList& invalidated);
+    void onSeeked(qlonglong position);
     
 private:
     static MediaPlayer* s_instance;
     
-    QTimer* m_timer;
+    QTimer* m_timer;  // Emits locally extrapolated positionChanged while playing
     QString m_playerName;
+    QStringList m_players;
+    bool m_pinned = false;  // setPlayer() was called; don't switch on our own
     MediaInfo m_info;
+    QString m_status = "Stopped";
+    QString m_trackId;
+    
+    // Position is only sent on seeks; between them it advances at m_rate
+    qint64 m_positionUs = 0;
+    qint64 m_lengthUs = 0;
+    double m_rate = 1.0;
+    QElapsedTimer m_positionClock;
+    double m_unmutedVolume = 1.0;
+    
+    QString m_artSource;
+    QImage m_art;
+    QCache<QString, QImage> m_artCache;
+};
+
+// ============================================================================
+// AUDIO SPECTRUM
+// ============================================================================
+class AudioWorker;
+class SpectrumBuffer;
+
+/**
+ * Log-spaced spectrum and levels of what is playing.
+ *
+ * PCM comes from the default PulseAudio/PipeWire monitor, a WAV file, or
+ * a FIFO of raw float32 mono. Windowing, the FFT and band binning run on
+ * the "milk-audio" thread; frames are handed over through a triple
+ * buffer, so reading one from a paint or frameReady handler never blocks.
+ */
+class AudioSpectrum : public QObject {
+    Q_OBJECT
+    
+public:
+    static AudioSpectrum* instance();
+    static void cleanup();
+    
+    // Setup (restarts the pipeline when running)
+    void setSource(const QString& source);  // "monitor" or a file/FIFO path
+    QString source() const { return m_source; }
+    void setSampleRate(int hz);             // Monitor and raw input; WAV files carry their own
+    void setFftSize(int size);              // Rounded up to a power of two, 256 - 16384
+    void setBands(int count);
+    int bands() const { return m_bands; }
+    void setFrequencyRange(double minHz, double maxHz);
+    void setFrameRate(int fps);
+    void setSmoothing(double factor);       // Fall-off per frame, 0 - 0.99
+    
+    // Control
+    void start();
+    void stop();
+    bool isRunning() const { return m_thread != nullptr; }
+    
+    /** Copies the newest frame into @p frame; false if there is none newer. GUI thread only. */
+    bool takeFrame(SpectrumFrame& frame);
+    /** Newest frame, or the last one taken */
+    SpectrumFrame frame();
+    
+signals:
+    /** A frame is waiting; not emitted again until it has been taken */
+    void frameReady();
+    void finished();  // File or FIFO source ran out
+    void error(const QString& message);
+    
+private:
+    explicit AudioSpectrum(QObject* parent = nullptr);
+    ~AudioSpectrum();
+    
+    void restart();
+    
+private:
+    static AudioSpectrum* s_instance;
+    
+    QString m_source = "monitor";
+    int m_sampleRate = 48000;
+    int m_fftSize = 2048;
+    int m_bands = 32;
+    int m_fps = 60;
+    double m_minHz = 40;
+    double m_maxHz = 16000;
+    double m_smoothing = 0.6;
+    
+    QThread* m_thread = nullptr;
+    AudioWorker* m_worker = nullptr;
+    std::shared_ptr<SpectrumBuffer> m_frames;
+    SpectrumFrame m_front;
 };
 
 // ============================================================================
@@ -439,10 +913,22 @@ public:
     void notify(const QString& title, const QString& message, const QString& icon);
     void notify(const QString& title, const QString& message, int timeout);
     
+    /**
+     * Notifications sharing a tag update one bubble in place (replaces_id).
+     * Identical notifications, or ones with the same tag, arriving less
+     * than the coalesce window apart are delivered once with a repeat
+     * count. A burst that keeps going is still sent four windows after
+     * it began.
+     */
+    void notify(const QString& title, const QString& message, const QString& icon,
+                int timeout, const QString& tag);
+    void close(const QString& tag);
+    
     // Options
     void setDefaultTimeout(int ms);
     void setDefaultIcon(const QString& icon);
     void setAppName(const QString& name);
+    void setCoalesceWindow(int ms);
     
     // Notification history
     struct Notification {
@@ -463,6 +949,23 @@ private:
     explicit NotificationAPI(QObject* parent = nullptr);
     ~NotificationAPI();
     
+    struct Pending {
+        QString title;
+        QString message;
+        QString icon;
+        int timeout = 0;
+        int count = 0;
+    };
+    
+    void flush();
+    void deliver(const QString& key, const Pending& pending);
+    void probeServer();
+    void setServerState(int state);
+    
+private slots:
+    void onNotificationClosed(uint id, uint reason);
+    void onActionInvoked(uint id, const QString& action);
+    
 private:
     static NotificationAPI* s_instance;
     
@@ -470,6 +973,351 @@ private:
     QString m_defaultIcon;
     int m_defaultTimeout = 5000;
     QList<Notification> m_history;
+    
+    // Bursts are collected per key and sent once the window passes quietly
+    QTimer* m_flushTimer;
+    int m_coalesceWindow = 250;
+    QElapsedTimer m_burst;  // Since the first pending notification
+    QHash<QString, Pending> m_pending;
+    QStringList m_pendingOrder;
+    QHash<QString, uint> m_serverIds;  // Key -> id of the bubble currently showing it
+    QSet<uint> m_ownIds;
+    int m_serverState = -1;            // -1 unknown, 0 no D-Bus server, 1 available
+    bool m_probing = false;            // Asynchronous probe for a server in flight
+};
+
+// ============================================================================
+// METRICS EXPORTER
+// ============================================================================
+
+/**
+ * Serves the latest SystemMonitor snapshot in OpenMetrics text format.
+ *
+ * Opt-in and local only: HTTP on 127.0.0.1, or the same HTTP over a Unix
+ * socket (curl --unix-socket). Each scrape formats the published snapshot
+ * into a reused buffer; the monitor's lock is never taken.
+ */
+class MetricsExporter : public QObject {
+    Q_OBJECT
+    
+public:
+    static MetricsExporter* instance();
+    static void cleanup();
+    
+    bool listen(quint16 port = 9273);
+    bool listenLocal(const QString& path);
+    void close();
+    bool isListening() const;
+    quint16 port() const;  // TCP port in use, e.g. after listen(0); 0 when not listening
+    
+    /** The document a scrape of /metrics returns */
+    QByteArray render();
+    
+signals:
+    void error(const QString& message);
+    
+private:
+    explicit MetricsExporter(QObject* parent = nullptr);
+    ~MetricsExporter();
+    
+    void accept(QIODevice* socket);
+    void respond(QIODevice* socket);
+    
+private:
+    static MetricsExporter* s_instance;
+    
+    QTcpServer* m_tcp = nullptr;
+    QLocalServer* m_local = nullptr;
+    QByteArray m_buffer;  // Capacity kept across scrapes
+};
+
+// ============================================================================
+// METRIC REGISTRY
+// ============================================================================
+
+/**
+ * Named numbers that widgets bind to, whoever produces them: the StatsD
+ * ingest, the control socket or application code. Every name keeps a short
+ * in-memory history for graphs that bind late. GUI thread only.
+ */
+class MetricRegistry : public QObject {
+    Q_OBJECT
+    
+public:
+    static MetricRegistry* instance();
+    static void cleanup();
+    
+    void set(const QString& name, double value);
+    double value(const QString& name, double fallback = 0) const;
+    bool contains(const QString& name) const;
+    QStringList names() const;
+    
+    /** Most recent values of @p name, oldest first */
+    QVector<double> history(const QString& name) const;
+    void setHistorySize(int samples);  // Per name, default 300; applies to new names
+    
+    /**
+     * Call @p callback with every new value of @p name, and right away if
+     * it already has one. The binding goes away with @p context.
+     */
+    void bind(const QString& name, QObject* context, std::function<void(double)> callback);
+    
+signals:
+    void metricAdded(const QString& name);
+    void valueChanged(const QString& name, double value);
+    
+private:
+    explicit MetricRegistry(QObject* parent = nullptr);
+    ~MetricRegistry();
+    
+    struct Binding {
+        QPointer<QObject> context;
+        std::function<void(double)> callback;
+    };
+    
+    struct Metric {
+        double value = 0;
+        bool hasValue = false;  // Bindings can create a name before its first value
+        QVector<double> ring;
+        int head = 0;   // Next slot to write
+        int count = 0;
+        QVector<Binding> bindings;
+    };
+    
+private:
+    static MetricRegistry* s_instance;
+    
+    QHash<QString, Metric> m_metrics;
+    int m_historySize = 300;
+};
+
+// ============================================================================
+// STATSD INGEST
+// ============================================================================
+class StatsdTable;
+
+/**
+ * Push endpoint for other local daemons: StatsD lines ("name:value|type")
+ * on a Unix datagram socket, by default
+ * $XDG_RUNTIME_DIR/milkwidget-statsd.sock.
+ *
+ * The "milk-statsd" thread receives in batches, parses without allocating
+ * and aggregates into a fixed-size lock-free table. The GUI thread drains
+ * names that changed into MetricRegistry once per display frame:
+ *   g      latest value; "+n" / "-n" adjust it
+ *   c      per-second rate over the last second, honouring "|@rate"
+ *   ms, h  mean of the samples received during the frame
+ *
+ * Linux only: elsewhere listen() logs a warning, emits error() and
+ * returns false.
+ */
+class StatsdIngest : public QObject {
+    Q_OBJECT
+    
+public:
+    struct Stats {
+        quint64 datagrams = 0;
+        quint64 lines = 0;
+        quint64 malformed = 0;
+        quint64 dropped = 0;  // Lines for new names once the table was full
+        int names = 0;
+    };
+    
+    static StatsdIngest* instance();
+    static void cleanup();
+    
+    static QString defaultPath();
+    
+    bool listen(const QString& path = QString());
+    void close();
+    bool isListening() const { return m_thread != nullptr; }
+    QString path() const { return m_path; }
+    
+    /** Prepended to every name on its way into the registry, e.g. "statsd." */
+    void setPrefix(const QString& prefix);
+    /** Deliveries per second; defaults to the primary screen's refresh rate, or 60 */
+    void setDeliveryRate(int hz);
+    
+    Stats stats() const;
+    
+signals:
+    void error(const QString& message);
+    
+private:
+    explicit StatsdIngest(QObject* parent = nullptr);
+    ~StatsdIngest();
+    
+    void receive();  // Receiver thread
+    void deliver();  // GUI thread
+    
+private:
+    static StatsdIngest* s_instance;
+    
+    QString m_path;
+    QString m_prefix;
+    int m_socket = -1;
+    int m_wake[2] = {-1, -1};  // Pipe that stops the receiver
+    QThread* m_thread = nullptr;
+    QTimer* m_timer;
+    std::unique_ptr<StatsdTable> m_table;
+    
+    // GUI-side state, indexed like the table's insertion order
+    QVector<QString> m_names;
+    QVector<quint32> m_delivered;  // Sequence last delivered
+    QVector<double> m_counts;      // Counter increments in the current window
+    QVector<double> m_timerSums;   // Timer totals at the last delivery
+    QVector<quint32> m_timerCounts;
+    QElapsedTimer m_window;
+};
+
+// ============================================================================
+// ALERT RULES
+// ============================================================================
+
+/**
+ * Threshold rules over SystemMonitor snapshots, e.g. raise "hot" once
+ * `sys.temperature > 85` has held for 10 s and clear it when
+ * `sys.temperature < 80` has. Conditions are expressions over snapshot
+ * values: cpu, memory, swap, disk, load, load5, load15, temperature,
+ * temperature.<sensor>, battery, charging, processes, uptime.
+ *
+ * All rules run in one batch on the sampler thread after every snapshot.
+ * Only raise and clear transitions reach the GUI thread, where each rule's
+ * state is also published to MetricRegistry as "alert.<name>" (0 or 1).
+ */
+class AlertRules : public QObject {
+    Q_OBJECT
+    
+public:
+    struct Rule {
+        QString name;
+        QString condition;       // Raises the alert
+        QString clear;           // Ends it; empty means "condition no longer holds"
+        int holdMs = 0;          // Condition must hold this long before raising
+        int clearHoldMs = 0;     // Clear must hold this long before clearing
+        int minIntervalMs = 0;   // Never raise again sooner than this after a raise
+        QString message;         // Desktop notification on raise, if set
+        QString source;          // File the rule was loaded from; empty when added in code
+    };
+    
+    static AlertRules* instance();
+    static void cleanup();
+    
+    /** Adds or replaces the rule with this name; false if an expression does not compile */
+    bool addRule(const Rule& rule, QString* error = nullptr);
+    void removeRule(const QString& name);
+    void clearRules();
+    
+    /**
+     * Makes rules the complete set loaded from source: rules that source
+     * defined before and no longer does are removed, the rest are added or
+     * replaced as by addRule(). Used when a widget file is (re)loaded.
+     */
+    void replaceRules(const QString& source, const QList<Rule>& rules);
+    
+    QStringList rules() const;
+    bool isActive(const QString& name) const;
+    
+signals:
+    void raised(const QString& name);
+    void cleared(const QString& name);
+    void changed(const QString& name, bool active);
+    
+private:
+    explicit AlertRules(QObject* parent = nullptr);
+    ~AlertRules();
+    
+    friend class SystemMonitor;
+    struct RuleState;
+    
+    void evaluate(const SystemMonitor::Snapshot& snapshot);  // Sampler thread
+    void deliver(const QString& name, bool active, const QString& message);  // GUI thread
+    
+private:
+    static AlertRules* s_instance;
+    
+    mutable QMutex m_mutex;  // Rules are edited on the GUI thread, run on the sampler
+    std::vector<std::unique_ptr<RuleState>> m_rules;
+};
+
+// ============================================================================
+// PLUGIN HOST
+// ============================================================================
+
+/**
+ * Loads metric collector plugins (see MetricPlugin.h) and runs them on the
+ * sampler thread after every SystemMonitor round. Plugins write into one
+ * preallocated slab; the GUI thread copies it into MetricRegistry at most
+ * once per round. Overrunning the time budget gets a plugin disabled.
+ */
+class PluginHost : public QObject {
+    Q_OBJECT
+    
+public:
+    struct PluginInfo {
+        QString name;
+        QString path;
+        QStringList metrics;     // Full registry names
+        QVector<double> values;  // Latest round; NaN where there was none
+        qint64 lastRunNs = 0;
+        int overruns = 0;
+        bool disabled = false;
+        QString reason;          // Why it was disabled
+    };
+    
+    /** The host the sampler runs after every SystemMonitor round */
+    static PluginHost* instance();
+    static void cleanup();
+    
+    /** A host of your own runs its plugins only when sample() is called */
+    explicit PluginHost(QObject* parent = nullptr);
+    ~PluginHost();
+    
+    /** File::dataDir()/plugins */
+    static QString defaultDirectory();
+    
+    bool load(const QString& path, QString* error = nullptr);
+    int loadDirectory(const QString& directory = QString());  // Returns how many loaded
+    
+    void setBudget(int microseconds);
+    int budget() const { return int(m_budgetNs / 1000); }
+    
+    QVector<PluginInfo> plugins() const;
+    
+    /** One round of every enabled plugin; the sampler calls this, tools may too */
+    void sample();
+    
+signals:
+    void pluginDisabled(const QString& name, const QString& reason);
+    
+private:
+    struct Loaded;
+    
+    void attach();   // Hooks into SystemMonitor's rounds
+    void deliver();  // GUI thread
+    
+private:
+    static PluginHost* s_instance;
+    
+    mutable QMutex m_mutex;  // Plugin list, their stats and m_slab; never held while a plugin runs
+    std::vector<std::unique_ptr<Loaded>> m_plugins;
+    std::vector<double> m_slab;
+    bool m_attached = false;
+    
+    // One round at a time, under m_roundMutex
+    QMutex m_roundMutex;
+    std::vector<Loaded*> m_running;
+    std::vector<qint64> m_runNs;
+    std::vector<double> m_round;
+    
+    QMutex m_publishMutex;
+    std::vector<double> m_published;  // Last finished round
+    std::atomic<bool> m_deliveryPending{false};
+    std::atomic<qint64> m_budgetNs{2000000};
+    
+    // GUI thread only
+    QStringList m_names;  // Registry name per slab slot
+    std::vector<double> m_delivering;
 };
 
 // ============================================================================
@@ -481,7 +1329,16 @@ NetworkMonitor* net();
 BatteryMonitor* battery();
 WeatherAPI* weather();
 MediaPlayer* media();
+AudioSpectrum* audio();
 NotificationAPI* notify();
+DataSource* dataSource(const QString& url);
+/** An interval CommandSource, released when the last copy of the handle goes */
+std::shared_ptr<CommandSource> commandSource(const QString& command, int intervalMs = 1000);
+MetricsExporter* metrics();
+MetricRegistry* metricRegistry();
+StatsdIngest* statsd();
+AlertRules* alerts();
+PluginHost* plugins();
 
 // Global cleanup
 void cleanupAPIs();
@@ -10,15 +10,21 @@
 #include <QSystemTrayIcon>
 #include <QMenu>
 #include <QList>
+#include <QHash>
+#include <QPointer>
 #include <memory>
 
 #include "Types.h"
 
+class QLocalServer;
+class QLocalSocket;
+
 namespace Milk {
 
 class Widget;
 class ThemeManager;
 class ConfigWatcher;
+class ControlServer;
 
 class Application : public QApplication {
     Q_OBJECT
@@ -40,6 +46,17 @@ public:
      */
     QList<Widget*> loadWidgets(const QString& xmlPath);
     
+    /**
+     * Replace the widgets loaded from an XML file with a fresh parse of it.
+     * The old widgets are kept if the file no longer parses.
+     */
+    QList<Widget*> reloadWidgets(const QString& xmlPath);
+    
+    /**
+     * XML files widgets have been loaded from, as absolute paths
+     */
+    QStringList loadedFiles() const { return m_loadedFiles; }
+    
     /**
      * Load a theme directory
      * Theme directories contain widget XML files and resources
@@ -66,6 +83,11 @@ public:
      */
     QList<Widget*> widgets() const { return m_widgets; }
     
+    /**
+     * Find a widget, or an element inside one, by its XML id
+     */
+    QWidget* findWidget(const QString& id) const;
+    
     /**
      * Show all widgets
      */
@@ -139,6 +161,24 @@ public:
     void setGlobalUpdateInterval(int ms);
     int globalUpdateInterval() const { return m_globalUpdateInterval; }
     
+    /**
+     * Set the global memory budget (bytes) shared by decoded images, scaled
+     * variants and render layers. Defaults to $MILK_MEMORY_BUDGET_MB or 32 MB.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+    
+    // ========================================================================
+    // Control Socket
+    // ========================================================================
+    
+    /**
+     * Accept commands from other processes on a Unix socket, by default
+     * $XDG_RUNTIME_DIR/milkwidget.sock. See ControlServer.
+     */
+    bool startControlServer(const QString& path = QString());
+    ControlServer* controlServer() { return m_controlServer.get(); }
+    
     // ========================================================================
     // Desktop Integration
     // ========================================================================
@@ -214,9 +254,105 @@ private:
     // Managers
     std::unique_ptr<ThemeManager> m_themeManager;
     std::unique_ptr<ConfigWatcher> m_configWatcher;
+    std::unique_ptr<ControlServer> m_controlServer;
+    QStringList m_loadedFiles;
     
     // Singleton
     static Application* s_instance;
 };
 
+// ============================================================================
+// CONTROL SOCKET
+// ============================================================================
+
+/**
+ * Control channel for a running instance. A frame is a 32-bit big-endian
+ * length followed by that many bytes of UTF-8 commands, one per line, so a
+ * script can push hundreds of values in a single write. Every frame gets
+ * exactly one reply frame holding one line per command: "ok", "ok <result>"
+ * or "err <message>".
+ *
+ *   show|hide|toggle [id]       Whole widgets or elements; all when no id
+ *   reload [file]               Re-read one XML file, or all of them
+ *   set <id> <property> <value> Text, color, value, min, max, ... or any
+ *                               Qt property of the element
+ *   push <id> <value>           Graph sample, bar/gauge value or label text
+ *   graph|bar|gauge|text <id> <value>
+ *                               push that also checks the element type
+ *   metric <name> <value>       Set a MetricRegistry value
+ *   list                        Ids of the loaded widgets
+ *   stats                       Counters as key=value pairs
+ *
+ * Ids are the id attributes from the XML.
+ */
+class ControlServer : public QObject {
+    Q_OBJECT
+    
+public:
+    struct Stats {
+        quint64 frames = 0;
+        quint64 commands = 0;
+        quint64 errors = 0;
+        int clients = 0;
+    };
+    
+    /** Frames larger than this are refused and the client dropped */
+    static const int MaxFrameBytes = 1024 * 1024;
+    
+    explicit ControlServer(Application* app);
+    ~ControlServer();
+    
+    static QString defaultPath();
+    
+    /**
+     * Fails rather than stealing the socket when another instance is
+     * already answering on it
+     */
+    bool listen(const QString& path = QString());
+    void close();
+    bool isListening() const;
+    QString path() const;
+    
+    /** Run a batch in-process; returns the reply payload */
+    QByteArray execute(const QByteArray& batch);
+    
+    Stats stats() const { return m_stats; }
+    
+signals:
+    void error(const QString& message);
+    
+private:
+    void accept(QLocalSocket* socket);
+    void readFrames(QLocalSocket* socket);
+    void run(const QByteArray& line, QByteArray& reply);
+    QWidget* lookup(const QString& id);
+    
+    Application* m_app;
+    QLocalServer* m_server = nullptr;
+    QHash<QLocalSocket*, QByteArray> m_pending;  // Partial frames per client
+    QHash<QString, QPointer<QWidget>> m_lookup;  // Id -> element, for hot push loops
+    Stats m_stats;
+};
+
+/**
+ * Blocking client for ControlServer, for command-line tools and scripts
+ */
+class ControlClient {
+public:
+    ControlClient();
+    ~ControlClient();
+    
+    bool connectToServer(const QString& path = QString(), int timeoutMs = 3000);
+    bool isConnected() const;
+    
+    /** Send one frame and wait for its reply frame */
+    bool request(const QByteArray& batch, QByteArray* reply, int timeoutMs = 3000);
+    
+    QString errorString() const { return m_error; }
+    
+private:
+    std::unique_ptr<QLocalSocket> m_socket;
+    QString m_error;
+};
+
 } // namespace Milk
@@ -0,0 +1,66 @@
+/**
+ * MilkWidgetCore - Metric Collector Plugin ABI
+ *
+ * A plugin is a shared object exporting milk_plugin_entry(). The host
+ * loads it, calls init() and describe() once on the GUI thread, then
+ * sample() on the sampler thread after every SystemMonitor round. Values
+ * reach MetricRegistry as "<plugin name>.<metric name>".
+ *
+ * sample() fills a slab the host allocated up front, one double per
+ * metric, preset to NaN meaning "no value this round". It must not
+ * allocate, block, or call into Qt or the host, and has to return within
+ * the host's time budget (PluginHost::setBudget, 2 ms by default). A
+ * plugin that overruns three rounds in a row, or any round by ten times
+ * the budget, is skipped from then on.
+ *
+ * Plain C so any compiler can produce a plugin. The struct only ever
+ * grows at the end, with MILK_PLUGIN_ABI_VERSION bumped.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define MILK_PLUGIN_ABI_VERSION 1
+#define MILK_PLUGIN_ENTRY "milk_plugin_entry"
+
+#ifdef _WIN32
+#define MILK_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define MILK_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MilkMetric {
+    const char* name;  /* Below the plugin's name, e.g. "degraded" */
+    const char* unit;  /* Informational; may be NULL */
+} MilkMetric;
+
+typedef struct MilkPlugin {
+    uint32_t abi_version;  /* MILK_PLUGIN_ABI_VERSION */
+    const char* name;      /* Prefix of every metric, e.g. "mdstat" */
+
+    /* GUI thread, once; may be NULL. Returns the plugin's state. Setting
+       *error fails the load; shutdown() is not called then. */
+    void* (*init)(const char** error);
+
+    /* GUI thread, once after init. The array stays valid until shutdown. */
+    const MilkMetric* (*describe)(void* state, uint32_t* count);
+
+    /* Sampler thread. Writes values[0 .. count - 1]; nonzero discards the round. */
+    int (*sample)(void* state, double* values, uint32_t count);
+
+    /* GUI thread, once before unloading; may be NULL. */
+    void (*shutdown)(void* state);
+} MilkPlugin;
+
+/* The one symbol a plugin exports:
+   MILK_PLUGIN_EXPORT const MilkPlugin* milk_plugin_entry(void); */
+typedef const MilkPlugin* (*MilkPluginEntry)(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -39,6 +39,11 @@ public:
      */
     QList<Widget*> parseString(const QString& xml);
     
+    /**
+     * Build one child element (text, graph, container, ...) for @p parent
+     */
+    QWidget* parseElement(const QDomElement& elem, Widget* parent);
+    
     /**
      * Convert widget to XML string
      */
@@ -74,6 +79,7 @@ private:
     Position parsePosition(const QString& value);
     Shape parseShape(const QString& value);
     Alignment parseAlignment(const QString& value);
+    RenderBackend parseRenderBackend(const QString& value);
     
 private:
     QString m_lastError;
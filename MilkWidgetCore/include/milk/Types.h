@@ -10,6 +10,7 @@
 #include <QSize>
 #include <QRect>
 #include <QFont>
+#include <QVector>
 #include <functional>
 #include <memory>
 
@@ -111,6 +112,12 @@ enum class BlurMode {
     Frosted      // Frosted glass
 };
 
+enum class RenderBackend {
+    Auto,        // OpenGL when a context can be created, raster otherwise
+    Raster,
+    OpenGL
+};
+
 enum class BorderStyle {
     None,
     Solid,
@@ -241,6 +248,13 @@ struct MediaInfo {
     double volume = 1.0;
 };
 
+struct SpectrumFrame {
+    QVector<float> bands;  // 0.0 - 1.0 per band, lowest frequency first
+    float rms = 0;         // Linear, full scale = 1.0
+    float peak = 0;
+    quint64 sequence = 0;
+};
+
 // ============================================================================
 // Helper Functions
 // ============================================================================
@@ -13,11 +13,22 @@
 #include <QPropertyAnimation>
 #include <QParallelAnimationGroup>
 #include <QSequentialAnimationGroup>
+#include <QPixmap>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <cstring>
 #include <functional>
+#include <list>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "Types.h"
 
+class QPainter;
+class QScreen;
+
 namespace Milk {
 
 // ============================================================================
@@ -377,6 +388,315 @@ void debounce(QObject* context, int ms, std::function<void()> callback);
  */
 void throttle(QObject* context, int ms, std::function<void()> callback);
 
+// ============================================================================
+// RENDER CACHE
+// ============================================================================
+
+/**
+ * Incremental 64-bit hash used to describe what a cached layer contains.
+ * Feed it every input that affects the rendered pixels (colors, radii,
+ * source paths...), then pass value() to RenderCache.
+ */
+class ContentHash {
+public:
+    explicit ContentHash(quint64 seed = 0xcbf29ce484222325ULL) : m_hash(seed) {}
+
+    ContentHash& operator<<(quint64 v) {
+        // splitmix64 finalizer folded into the running hash
+        v += 0x9e3779b97f4a7c15ULL + m_hash;
+        v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+        m_hash = v ^ (v >> 31);
+        return *this;
+    }
+    ContentHash& operator<<(int v) { return *this << quint64(qint64(v)); }
+    ContentHash& operator<<(bool v) { return *this << quint64(v ? 1 : 0); }
+    ContentHash& operator<<(double v) { quint64 bits; memcpy(&bits, &v, sizeof bits); return *this << bits; }
+    ContentHash& operator<<(const QColor& c) { return *this << quint64(c.isValid() ? c.rgba64() : 0); }
+    ContentHash& operator<<(const QString& s) { return *this << quint64(qHash(s)) << quint64(s.size()); }
+
+    quint64 value() const { return m_hash; }
+
+private:
+    quint64 m_hash;
+};
+
+/**
+ * Process-wide LRU cache for pre-rendered pixmap layers.
+ *
+ * Entries are keyed by content hash + logical size + device pixel ratio, so a
+ * window that moves to a monitor with a different scale factor simply looks up
+ * a different key instead of drawing a blurry upscaled copy. Total pixel bytes
+ * are bounded by a budget; least recently used entries are evicted first.
+ */
+class RenderCache : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * What an entry holds; all categories share one memory budget
+     */
+    enum Category {
+        Layer,     // Pre-rendered widget chrome, tracks, dials
+        Scaled,    // Source images scaled/clipped to widget size
+        Decoded,   // Image files decoded at the size they are displayed at
+        CategoryCount
+    };
+
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 evictions = 0;
+        qint64 bytes = 0;
+        qint64 budget = 0;
+        qint64 categoryBytes[CategoryCount] = {};
+        qint64 pixmapCacheLimit = 0;  // QPixmapCache share of the budget
+        int entries = 0;
+    };
+
+    using Painter = std::function<void(QPainter& painter, const QSize& size)>;
+
+    static RenderCache* instance();
+    static void cleanup();
+
+    /**
+     * Look up a layer; returns a null pixmap on miss
+     */
+    QPixmap find(quint64 contentHash, const QSize& size, qreal dpr);
+
+    /**
+     * Store a layer. The pixmap should already carry its device pixel ratio.
+     */
+    void insert(quint64 contentHash, const QSize& size, qreal dpr, const QPixmap& pixmap,
+                Category category = Layer);
+
+    /**
+     * Return the cached layer, rendering it with `paint` on a miss. `paint`
+     * draws in logical coordinates onto a transparent pixmap of size * dpr.
+     */
+    QPixmap fetch(quint64 contentHash, const QSize& size, qreal dpr, const Painter& paint,
+                  Category category = Layer);
+
+    /**
+     * Decode an image file straight to `pixelSize` (device pixels). Nothing
+     * keeps the full-resolution image alive; if the entry is evicted it is
+     * decoded again from disk on the next request.
+     */
+    QPixmap decode(const QString& path, const QSize& pixelSize);
+
+    /**
+     * Global memory budget in bytes (default 32 MB). One eighth goes to
+     * QPixmapCache, which Qt styles use internally; the rest bounds this cache.
+     */
+    void setBudget(qint64 bytes);
+    qint64 budget() const { return m_budget; }
+
+    /**
+     * Eviction
+     */
+    void evictRatio(qreal dpr);
+    void clear();
+
+    Stats stats() const;
+    void resetStats();
+
+signals:
+    void evicted(qreal dpr);
+
+private:
+    RenderCache();
+
+    struct Key {
+        quint64 content;
+        int width;
+        int height;
+        int dprMilli;  // DPR in thousandths, avoids float compares
+
+        bool operator==(const Key& o) const {
+            return content == o.content && width == o.width &&
+                   height == o.height && dprMilli == o.dprMilli;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const noexcept {
+            return size_t((ContentHash(k.content) << k.width << k.height << k.dprMilli).value());
+        }
+    };
+
+    struct Entry {
+        Key key;
+        QPixmap pixmap;
+        qint64 bytes;
+        Category category;
+    };
+
+    static Key makeKey(quint64 contentHash, const QSize& size, qreal dpr);
+    static qint64 pixmapBytes(const QPixmap& pixmap);
+    void trim();
+    void erase(std::list<Entry>::iterator it);
+    void watchScreen(QScreen* screen);
+    void onScreenRatioChanged(QScreen* screen);
+
+private:
+    static RenderCache* s_instance;
+
+    std::list<Entry> m_lru;  // front = most recently used
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+    QHash<QScreen*, int> m_screenRatios;  // last seen DPR (milli) per screen
+
+    qint64 m_budget = 32 * 1024 * 1024;
+    qint64 m_pixmapCacheLimit = 4 * 1024 * 1024;
+    qint64 m_bytes = 0;
+    qint64 m_categoryBytes[CategoryCount] = {};
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+    quint64 m_evictions = 0;
+};
+
+// Global render cache accessor
+RenderCache* renderCache();
+
+// ============================================================================
+// TIME SERIES
+// ============================================================================
+
+/**
+ * Persistent history of one metric, kept under File::dataDir()/history.
+ *
+ * Each tier (1 s, 1 min, 1 h) is a memory-mapped ring of fixed 4 KiB
+ * blocks holding delta-of-delta timestamps and XOR-compressed values, so
+ * disk use is bounded and reopening is a single mmap. Minute and hour
+ * points are means rolled up from the tier below as samples arrive.
+ * Thread-safe.
+ */
+class TimeSeries {
+public:
+    enum Tier { Seconds, Minutes, Hours, TierCount };
+
+    struct Point {
+        qint64 time;  // ms since epoch
+        double value;
+    };
+
+    /** Shared series for `metric`, opened on first use; creates its files */
+    static TimeSeries* open(const QString& metric);
+    /** Like open(), but nullptr instead of new files if nothing was recorded */
+    static TimeSeries* find(const QString& metric);
+    static void closeAll();
+
+    /** Points at or before the last one kept are dropped */
+    void append(double value);
+    void append(qint64 timeMs, double value);
+
+    /** Points of one tier within [fromMs, toMs], oldest first */
+    QVector<Point> read(Tier tier, qint64 fromMs, qint64 toMs) const;
+
+    /**
+     * At most `maxPoints` points over [fromMs, toMs], each part of the range
+     * taken from the finest tier that has it, averaged down to fit
+     */
+    QVector<Point> history(qint64 fromMs, qint64 toMs, int maxPoints) const;
+
+    QString metric() const { return m_metric; }
+
+private:
+    explicit TimeSeries(const QString& metric);
+    ~TimeSeries();
+
+    struct TierFile;
+    struct Rollup {
+        qint64 bucket = -1;
+        double sum = 0;
+        int count = 0;
+    };
+
+    QVector<Point> readLocked(int tier, qint64 fromMs, qint64 toMs) const;
+    void rollUp(int tier, qint64 timeMs, double value);
+    void recoverRollups();
+
+    static QHash<QString, TimeSeries*> s_series;
+    static QMutex s_seriesMutex;
+
+    QString m_metric;
+    mutable QMutex m_mutex;
+    std::unique_ptr<TierFile> m_tiers[TierCount];
+    Rollup m_rollups[TierCount];  // Mean being built for tier i from tier i - 1
+};
+
+// ============================================================================
+// EXPRESSIONS
+// ============================================================================
+
+class ExpressionCompiler;
+
+/**
+ * Attribute expression such as `cpu > 90 ? '#f44' : '#4f4'`, compiled once
+ * into typed bytecode with constant parts folded away. Identifiers are
+ * numeric inputs (metric names, dots allowed) fed through setInput();
+ * the result is a number or a string. Evaluation uses no QVariant and
+ * allocates nothing unless a string function such as fmtBytes() runs.
+ *
+ * Not thread-safe; one instance per binding.
+ */
+class Expression {
+public:
+    enum Type { Number, String };
+    
+    /** A single expression, e.g. `min(cpu, 100) / 2` */
+    static std::shared_ptr<Expression> compile(const QString& source, QString* error = nullptr);
+    
+    /** Text with embedded {expressions}, e.g. `{fmtBytes(net.rx)}/s`; `${` is literal */
+    static std::shared_ptr<Expression> compileTemplate(const QString& text, QString* error = nullptr);
+    
+    /** Whether `text` holds a {expression} compileTemplate() would pick up */
+    static bool isTemplate(const QString& text);
+    
+    Type type() const { return m_type; }
+    const QStringList& inputs() const { return m_inputs; }
+    bool isConstant() const { return m_inputs.isEmpty(); }
+    
+    /** Returns false when the input already had this value */
+    bool setInput(int slot, double value);
+    
+    /** Runs the program; returns whether the result differs from the last run */
+    bool evaluate();
+    
+    double number() const { return m_number; }
+    QString toString() const;
+    
+private:
+    friend class ExpressionCompiler;
+    
+    enum Op : quint8 {
+        PushNumber, PushInput, PushString, ToString,
+        Negate, Not, Add, Subtract, Multiply, Divide, Modulo,
+        Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or,
+        Concat, StringEqual, StringNotEqual,
+        Jump, JumpIfFalse, CallNumber, CallString
+    };
+    
+    struct Instruction {
+        Op op;
+        quint8 argc;
+        qint32 operand;
+    };
+    
+    Expression() = default;
+    
+    Type m_type = Number;
+    QVector<Instruction> m_code;
+    QVector<double> m_constants;
+    QStringList m_strings;
+    QStringList m_inputs;
+    QVector<double> m_slots;
+    std::vector<double> m_numberStack;
+    std::vector<QString> m_stringStack;
+    
+    double m_number = 0;
+    QString m_text;
+    bool m_evaluated = false;
+};
+
 // ============================================================================
 // SCREEN UTILITIES
 // ============================================================================
@@ -11,6 +11,7 @@
 #include <QPropertyAnimation>
 #include <QGraphicsEffect>
 #include <QPointer>
+#include <QPainterPath>
 #include <QMap>
 #include <memory>
 
@@ -172,6 +173,18 @@ public:
     void hide();
     void toggle();
     
+    // ========================================================================
+    // Diagnostics
+    // ========================================================================
+    /** Device pixels of chrome repainted: last paint, running total, paint count */
+    struct RepaintStats {
+        qint64 lastFramePixels = 0;
+        qint64 totalPixels = 0;
+        qint64 frames = 0;
+    };
+    RepaintStats repaintStats() const { return m_repaintStats; }
+    void resetRepaintStats() { m_repaintStats = RepaintStats(); }
+    
 signals:
     void clicked();
     void hovered(bool enter);
@@ -197,6 +210,9 @@ private:
     void applyX11Properties();
     void updateMask();
     void updatePosition();
+    QPainterPath shapePath(const QRectF& rect) const;
+    quint64 chromeHash() const;
+    void paintChrome(QPainter& painter, const QRectF& rect);
     QEasingCurve::Type toQtEasing(Easing e);
     
     void cleanupAnimations();
@@ -230,6 +246,8 @@ private:
     // Behavior
     bool m_draggable = true;
     bool m_initialized = false;
+    bool m_screenTracked = false;
+    RepaintStats m_repaintStats;
     QPoint m_dragPos;
     WindowType m_windowType = WindowType::Normal;
     
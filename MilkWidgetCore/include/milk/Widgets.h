@@ -11,14 +11,21 @@
 #include <QDateTime>
 #include <QImage>
 #include <QPushButton>
+#include <QVector>
+#include <QHash>
+#include <functional>
 
 #include "Types.h"
 #include "Widget.h"
 
+class QPainterPath;
+
 namespace Milk {
 
 // Forward declarations
 class Widget;
+class GLGraphSurface;
+class GLGaugeSurface;
 
 // ============================================================================
 // TEXT WIDGET
@@ -78,8 +85,12 @@ public:
     void setMaxLines(int lines);
     void setEllipsis(bool enabled);
     
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    
 private:
     QString m_styleClass;
+    QColor m_backdrop = Qt::transparent;  // Rounded panel behind code text
     int m_maxLines = 0;
     bool m_ellipsis = false;
 };
@@ -137,6 +148,11 @@ protected:
     void paintEvent(QPaintEvent* event) override;
     void timerEvent(QTimerEvent* event) override;
     
+private:
+    QString formattedText() const;
+    QRect fillDamage(double from, double to) const;
+    QRect textDamage(const QString& text) const;
+    
 private:
     double m_value = 0;
     double m_minValue = 0;
@@ -176,6 +192,9 @@ public:
     void setValues(const QList<double>& values);
     void clear();
     
+    /** Fill with the last `seconds` of a recorded metric (see TimeSeries) */
+    void loadHistory(const QString& metric, int seconds = 24 * 60 * 60);
+    
     // Range
     void setMinValue(double min);
     void setMaxValue(double max);
@@ -198,14 +217,25 @@ public:
     void setSmooth(bool enabled);
     void setAntialiased(bool enabled);
     
+    // Rendering (OpenGL needs a build with MILK_HAS_OPENGL; falls back to
+    // raster, and labels, smoothing and bars are drawn on the raster path)
+    void setRenderBackend(RenderBackend backend);
+    RenderBackend renderBackend() const;
+    
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
     
 private:
+    void syncSurface();
+    void dropSurface();
+    bool onSurface() const;
+    QPainterPath seriesPath() const;
     void drawLine(QPainter& p);
     void drawArea(QPainter& p);
     void drawBar(QPainter& p);
     void drawGrid(QPainter& p);
+    void drawLabels(QPainter& p);
     
 private:
     QList<double> m_values;
@@ -221,8 +251,11 @@ private:
     int m_lineWidth = 2;
     bool m_showGrid = true;
     bool m_showLabels = false;
-    bool m_smooth = true;
+    bool m_smooth = false;
     bool m_antialiased = true;
+    
+    RenderBackend m_backend = RenderBackend::Raster;
+    GLGraphSurface* m_surface = nullptr;
 };
 
 // ============================================================================
@@ -263,11 +296,27 @@ public:
     void setAnimated(bool enabled);
     void animateTo(double value, int duration = 300);
     
+    // Rendering (OpenGL needs a build with MILK_HAS_OPENGL; falls back to
+    // raster, and a gradient fill is drawn on the raster path)
+    void setRenderBackend(RenderBackend backend);
+    RenderBackend renderBackend() const;
+    
 signals:
     void valueChanged(double value);
     
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    
+private:
+    void syncSurface();
+    void dropSurface();
+    bool onSurface() const;
+    QString valueText() const;
+    QRectF arcRect() const;
+    double fraction(double value) const;
+    QRect arcDamage(double from, double to) const;
+    QRect textDamage(const QString& text) const;
     
 private:
     double m_value = 0;
@@ -289,6 +338,9 @@ private:
     QString m_label;
     QString m_unit;
     bool m_animated = true;
+    
+    RenderBackend m_backend = RenderBackend::Raster;
+    GLGaugeSurface* m_surface = nullptr;
 };
 
 // ============================================================================
@@ -332,8 +384,11 @@ protected:
     void paintEvent(QPaintEvent* event) override;
     
 private:
-    QPixmap m_pixmap;
+    QPixmap m_pixmap;     // In-memory sources only; files are decoded on demand
     QString m_source;
+    QSize m_sourceSize;   // Full-resolution size read from the file header
+    qint64 m_sourceModified = 0;  // With the byte size, tells a rewritten file apart
+    qint64 m_sourceBytes = 0;
     Qt::AspectRatioMode m_fillMode = Qt::KeepAspectRatio;
     int m_radius = 0;
     bool m_circular = false;
@@ -370,14 +425,14 @@ public:
     // Callback
     void onClick(ClickCallback callback);
     
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+    
 protected:
     void enterEvent(QEnterEvent* event) override;
     void leaveEvent(QEvent* event) override;
     void paintEvent(QPaintEvent* event) override;
     
-private:
-    void updateStyle();
-    
 private:
     QColor m_bgColor = QColor(60, 60, 80, 200);
     QColor m_hoverColor = QColor(80, 80, 100, 200);
@@ -444,6 +499,163 @@ private:
     QColor m_bgColor = Qt::transparent;
 };
 
+// ============================================================================
+// REPEATER
+// ============================================================================
+
+/**
+ * Container holding one copy of a template per entry of a list: a fixed
+ * count, or a collection such as network interfaces. refresh() re-reads
+ * the list and rebuilds the copies only when it changed. The XML parser
+ * supplies a factory built from a prototype it resolved once.
+ */
+class Repeater : public Container {
+    Q_OBJECT
+    
+public:
+    using Source = std::function<QStringList()>;
+    using Factory = std::function<QList<QWidget*>(int index, const QString& entry)>;
+    
+    explicit Repeater(Layout layout = Vertical, QWidget* parent = nullptr);
+    virtual ~Repeater() = default;
+    
+    static Repeater* create(Layout layout, Widget* parent = nullptr);
+    
+    void setFactory(Factory factory);
+    void setSource(Source source);
+    void setCount(int count);      // Entries "0" .. "count - 1"
+    void setColumns(int columns);  // Grid layout only
+    
+    QStringList entries() const { return m_entries; }
+    int count() const { return m_entries.size(); }
+    
+public slots:
+    void refresh();
+    
+signals:
+    void expanded(int count);
+    
+private:
+    void rebuild();
+    
+private:
+    Factory m_factory;
+    Source m_source;
+    QStringList m_entries;
+    QList<QWidget*> m_copies;
+    int m_columns = 1;
+};
+
+// ============================================================================
+// ITEM VIEW
+// ============================================================================
+
+/** Look shared by any number of items; items refer to it by index */
+struct ItemStyle {
+    QColor color = Qt::white;               // Text, bar fill
+    QColor background = Qt::transparent;    // Boxes
+    QColor track = QColor(255, 255, 255, 40);  // Bar background
+    QFont font;
+    int radius = 0;
+    int barHeight = 8;
+    Qt::Alignment align = Qt::AlignLeft | Qt::AlignVCenter;
+};
+
+/**
+ * Retained tree of lightweight items painted in one pass: labels, bars,
+ * spacers, custom painters, and boxes that lay their children out in a
+ * column, a row or a stack. An item is a small struct, not a QWidget, so
+ * a dashboard can hold thousands of cells.
+ *
+ * Along a box's direction children get their fixed size or their natural
+ * one, and the remaining space is shared out by grow factor. Across it
+ * they fill the box. Value and text updates repaint just that item.
+ */
+class ItemView : public QWidget {
+    Q_OBJECT
+    
+public:
+    enum Direction { Column, Row, Stack };
+    using Painter = std::function<void(QPainter& painter, const QRect& rect)>;
+    
+    explicit ItemView(Direction direction = Column, QWidget* parent = nullptr);
+    virtual ~ItemView() = default;
+    
+    static ItemView* create(Direction direction = Column, Widget* parent = nullptr);
+    
+    // Styles; 0 is the default and always exists
+    int addStyle(const ItemStyle& style);
+    const ItemStyle& style(int index) const { return m_styles[index]; }
+    void setStyle(int index, const ItemStyle& style);
+    
+    // Building; every add returns the new item's id. The root is a box.
+    int root() const { return 0; }
+    int addBox(int parent, Direction direction, int gap = 0, int padding = 0, int style = 0);
+    int addLabel(int parent, const QString& text, int style = 0);
+    int addBar(int parent, double value, double max = 1.0, int style = 0);
+    int addSpace(int parent, int size = -1);  // -1: a spring that takes spare room
+    int addCustom(int parent, Painter painter, int style = 0);
+    
+    // Per item
+    void setText(int item, const QString& text);
+    void setValue(int item, double value);
+    void setGrow(int item, double grow);
+    void setSize(int item, int size);  // Extent along the parent's direction, -1 natural
+    void setGap(int box, int gap);
+    void setPadding(int box, int padding);
+    void setItemStyle(int item, int style);
+    void setName(int item, const QString& name);
+    
+    int find(const QString& name) const { return m_names.value(name, -1); }
+    int itemCount() const { return m_items.size(); }
+    QRect itemRect(int item);
+    int itemAt(const QPoint& pos);  // Deepest item under pos, or -1
+    
+    QSize sizeHint() const override;
+    
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    
+private:
+    enum Kind : quint8 { Box, Label, Bar, Space, Custom };
+    
+    // Children are linked, not stored, so an item is fixed-size and the
+    // whole tree is one allocation. Parents precede their children.
+    struct Item {
+        QRect rect;
+        qint32 parent = -1;
+        qint32 firstChild = -1;
+        qint32 lastChild = -1;
+        qint32 next = -1;
+        qint32 data = -1;    // Label: string index; Custom: painter index
+        float value = 0;
+        float max = 1;
+        float grow = 0;
+        qint16 size = -1;
+        qint16 gap = 0;
+        qint16 padding = 0;
+        quint16 style = 0;
+        Kind kind = Box;
+        quint8 direction = Column;
+    };
+    
+    int append(int parent, Kind kind, int style);
+    void invalidate(int item);
+    void ensureLayout();
+    void measure() const;
+    void layout(int item, const QRect& rect);
+    
+private:
+    QVector<Item> m_items;
+    mutable QVector<QSize> m_natural;  // Scratch for the layout pass
+    QVector<ItemStyle> m_styles;
+    QVector<QString> m_strings;
+    QVector<Painter> m_painters;
+    QHash<QString, int> m_names;
+    bool m_layoutDirty = true;
+};
+
 // ============================================================================
 // CLOCK WIDGET
 // ============================================================================
@@ -1,6 +1,6 @@
 /**
  * MilkWidgetCore - Additional API Implementations
- * NetworkMonitor, BatteryMonitor, WeatherAPI, MediaPlayer, NotificationAPI
+ * NetworkMonitor, BatteryMonitor
  */
 
 #include "milk/APIs.h"
@@ -160,240 +160,156 @@ void NetworkMonitor::setUpdateInterval(int ms) { m_updateTimer->setInterval(ms);
 
 BatteryMonitor* BatteryMonitor::s_instance = nullptr;
 
+// Points a level must climb back above a threshold before it warns again
+static const int WarningHysteresis = 3;
+
 BatteryMonitor* BatteryMonitor::instance() {
     if (!s_instance) s_instance = new BatteryMonitor();
     return s_instance;
 }
 
-BatteryMonitor::BatteryMonitor() : QObject() {
-    m_updateTimer = new QTimer(this);
-    connect(m_updateTimer, &QTimer::timeout, this, &BatteryMonitor::update);
-    m_updateTimer->start(5000);
+void BatteryMonitor::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+BatteryMonitor::BatteryMonitor(QObject* parent) : QObject(parent) {
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &BatteryMonitor::updateBatteryInfo);
+    m_timer->start(5000);
     findBattery();
-    update();
+    updateBatteryInfo();
+}
+
+BatteryMonitor::~BatteryMonitor() = default;
+
+static QByteArray readSupply(const QString& path, const char* field) {
+    QFile file(path + '/' + QLatin1String(field));
+    return file.open(QIODevice::ReadOnly) ? file.readAll().trimmed() : QByteArray();
 }
 
 void BatteryMonitor::findBattery() {
     QDir powerSupply("/sys/class/power_supply");
     for (const QString& name : powerSupply.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
-        QString typePath = powerSupply.filePath(name + "/type");
-        QFile typeFile(typePath);
-        if (typeFile.open(QIODevice::ReadOnly)) {
-            QString type = QString::fromUtf8(typeFile.readAll()).trimmed();
-            if (type == "Battery") {
-                m_batteryPath = powerSupply.filePath(name);
-                m_hasBattery = true;
-                return;
-            }
+        if (readSupply(powerSupply.filePath(name), "type") == "Battery") {
+            m_batteryPath = powerSupply.filePath(name);
+            m_hasBattery = true;
+            return;
         }
     }
     m_hasBattery = false;
 }
 
-void BatteryMonitor::update() {
+void BatteryMonitor::updateBatteryInfo() {
     if (!m_hasBattery || m_batteryPath.isEmpty()) return;
     
-    // Read capacity
-    QFile capFile(m_batteryPath + "/capacity");
-    if (capFile.open(QIODevice::ReadOnly)) {
-        m_level = QString::fromUtf8(capFile.readAll()).trimmed().toInt();
-    }
+    int percent = readSupply(m_batteryPath, "capacity").toInt();
+    m_status = QString::fromUtf8(readSupply(m_batteryPath, "status"));
+    bool charging = m_status == "Charging";
+    m_pluggedIn = charging || m_status == "Full" || m_status == "Not charging";
     
-    // Read status
-    QFile statusFile(m_batteryPath + "/status");
-    if (statusFile.open(QIODevice::ReadOnly)) {
-        QString status = QString::fromUtf8(statusFile.readAll()).trimmed();
-        m_charging = (status == "Charging");
-        m_pluggedIn = (status == "Charging" || status == "Full" || status == "Not charging");
-    }
+    bool levelMoved = percent != m_percent;
+    bool chargingFlipped = charging != m_charging;
+    m_percent = percent;
+    m_charging = charging;
     
     emit updated();
-    emit levelChanged(m_level);
-    if (m_level <= 10 && !m_charging) {
-        emit lowBattery();
+    if (levelMoved) emit percentChanged(m_percent);
+    if (chargingFlipped) emit chargingChanged(m_charging);
+    
+    // Each warning fires once per discharge, not on every poll below the
+    // threshold; it re-arms on power or once the level is clearly back up
+    bool discharging = !m_pluggedIn;
+    if (!discharging || m_percent > m_criticalThreshold + WarningHysteresis) m_criticalRaised = false;
+    if (!discharging || m_percent > m_lowThreshold + WarningHysteresis) m_lowRaised = false;
+    
+    if (discharging && m_percent <= m_criticalThreshold && !m_criticalRaised) {
+        m_criticalRaised = true;
+        m_lowRaised = true;  // Critical implies low; don't follow up with the milder one
+        emit criticalBattery(m_percent);
+    } else if (discharging && m_percent <= m_lowThreshold && !m_lowRaised) {
+        m_lowRaised = true;
+        emit lowBattery(m_percent);
     }
 }
 
-int BatteryMonitor::level() const { return m_level; }
-bool BatteryMonitor::isCharging() const { return m_charging; }
-bool BatteryMonitor::isPluggedIn() const { return m_pluggedIn; }
-bool BatteryMonitor::hasBattery() const { return m_hasBattery; }
-QString BatteryMonitor::status() const {
-    if (!m_hasBattery) return "No Battery";
-    if (m_charging) return "Charging";
-    if (m_pluggedIn) return "Plugged In";
-    return "Discharging";
-}
-int BatteryMonitor::timeRemaining() const { return -1; } // Would need ACPI
-QString BatteryMonitor::timeRemainingStr() const { return "Unknown"; }
-void BatteryMonitor::setUpdateInterval(int ms) { m_updateTimer->setInterval(ms); }
-
-// ============================================================================
-// WEATHER API
-// ============================================================================
-
-WeatherAPI* WeatherAPI::s_instance = nullptr;
-
-WeatherAPI* WeatherAPI::instance() {
-    if (!s_instance) s_instance = new WeatherAPI();
-    return s_instance;
-}
-
-WeatherAPI::WeatherAPI() : QObject(), m_networkMgr(new QNetworkAccessManager(this)) {
-    m_updateTimer = new QTimer(this);
-    connect(m_updateTimer, &QTimer::timeout, this, &WeatherAPI::refresh);
-}
-
-void WeatherAPI::setApiKey(const QString& key) { m_apiKey = key; }
-void WeatherAPI::setLocation(const QString& location) { m_location = location; }
-void WeatherAPI::setCoordinates(double lat, double lon) { m_lat = lat; m_lon = lon; m_useCoords = true; }
-void WeatherAPI::setUnits(const QString& units) { m_units = units; }
-void WeatherAPI::setUpdateInterval(int ms) { m_updateTimer->setInterval(ms); if (ms > 0) m_updateTimer->start(); }
+int BatteryMonitor::percent() { return m_percent; }
+bool BatteryMonitor::isCharging() { return m_charging; }
+bool BatteryMonitor::isPluggedIn() { return m_pluggedIn; }
+bool BatteryMonitor::hasBattery() { return m_hasBattery; }
 
-void WeatherAPI::refresh() {
-    if (m_apiKey.isEmpty()) {
-        emit error("API key not set");
-        return;
-    }
-    
-    QString url = QString("https://api.openweathermap.org/data/2.5/weather?appid=%1&units=%2")
-        .arg(m_apiKey).arg(m_units);
-    
-    if (m_useCoords) {
-        url += QString("&lat=%1&lon=%2").arg(m_lat).arg(m_lon);
-    } else if (!m_location.isEmpty()) {
-        url += "&q=" + m_location;
-    } else {
-        emit error("Location not set");
-        return;
-    }
-    
-    QNetworkReply* reply = m_networkMgr->get(QNetworkRequest(QUrl(url)));
-    connect(reply, &QNetworkReply::finished, [this, reply]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            parseResponse(reply->readAll());
-        } else {
-            emit error(reply->errorString());
-        }
-        reply->deleteLater();
-    });
+QString BatteryMonitor::status() {
+    if (!m_hasBattery) return "No Battery";
+    return m_status.isEmpty() ? QString("Unknown") : m_status;
 }
 
-void WeatherAPI::parseResponse(const QByteArray& data) {
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    QJsonObject obj = doc.object();
-    
-    m_info.location = obj["name"].toString();
-    
-    QJsonObject main = obj["main"].toObject();
-    m_info.temperature = main["temp"].toDouble();
-    m_info.feelsLike = main["feels_like"].toDouble();
-    m_info.humidity = main["humidity"].toInt();
-    m_info.pressure = main["pressure"].toInt();
-    
-    QJsonArray weather = obj["weather"].toArray();
-    if (!weather.isEmpty()) {
-        QJsonObject w = weather[0].toObject();
-        m_info.condition = w["main"].toString();
-        m_info.description = w["description"].toString();
-        m_info.icon = w["icon"].toString();
+int BatteryMonitor::timeRemainingMinutes() {
+    if (!m_hasBattery) return -1;
+    // Energy (µWh over µW) where the driver has it, charge (µAh over µA) otherwise
+    double now = readSupply(m_batteryPath, "energy_now").toDouble();
+    double full = readSupply(m_batteryPath, "energy_full").toDouble();
+    double rate = readSupply(m_batteryPath, "power_now").toDouble();
+    if (now <= 0 || rate <= 0) {
+        now = readSupply(m_batteryPath, "charge_now").toDouble();
+        full = readSupply(m_batteryPath, "charge_full").toDouble();
+        rate = readSupply(m_batteryPath, "current_now").toDouble();
     }
-    
-    QJsonObject wind = obj["wind"].toObject();
-    m_info.windSpeed = wind["speed"].toDouble();
-    m_info.windDirection = wind["deg"].toInt();
-    
-    emit updated();
+    if (now <= 0 || rate <= 0) return -1;
+    double hours = m_charging ? (full - now) / rate : now / rate;
+    return qMax(0, int(hours * 60));
 }
 
-WeatherInfo WeatherAPI::current() const { return m_info; }
-double WeatherAPI::temperature() const { return m_info.temperature; }
-double WeatherAPI::feelsLike() const { return m_info.feelsLike; }
-int WeatherAPI::humidity() const { return m_info.humidity; }
-QString WeatherAPI::condition() const { return m_info.condition; }
-QString WeatherAPI::description() const { return m_info.description; }
-QString WeatherAPI::icon() const { return m_info.icon; }
-double WeatherAPI::windSpeed() const { return m_info.windSpeed; }
-int WeatherAPI::windDirection() const { return m_info.windDirection; }
-QString WeatherAPI::locationName() const { return m_info.location; }
-
-// ============================================================================
-// MEDIA PLAYER (MPRIS)
-// ============================================================================
-
-MediaPlayer* MediaPlayer::s_instance = nullptr;
-
-MediaPlayer* MediaPlayer::instance() {
-    if (!s_instance) s_instance = new MediaPlayer();
-    return s_instance;
+QString BatteryMonitor::timeRemaining() {
+    int minutes = timeRemainingMinutes();
+    if (minutes < 0) return "Unknown";
+    return QString("%1h %2m").arg(minutes / 60).arg(minutes % 60, 2, 10, QChar('0'));
 }
 
-MediaPlayer::MediaPlayer() : QObject() {
-    // MPRIS D-Bus integration would go here
-    // For now, stub implementation
+double BatteryMonitor::health() {
+    double full = readSupply(m_batteryPath, "energy_full").toDouble();
+    double design = readSupply(m_batteryPath, "energy_full_design").toDouble();
+    if (full <= 0 || design <= 0) {
+        full = readSupply(m_batteryPath, "charge_full").toDouble();
+        design = readSupply(m_batteryPath, "charge_full_design").toDouble();
+    }
+    return design > 0 ? 100.0 * full / design : 0;
 }
 
-void MediaPlayer::play() { emit playbackChanged(); }
-void MediaPlayer::pause() { emit playbackChanged(); }
-void MediaPlayer::playPause() { emit playbackChanged(); }
-void MediaPlayer::stop() { emit playbackChanged(); }
-void MediaPlayer::next() { emit trackChanged(); }
-void MediaPlayer::previous() { emit trackChanged(); }
-void MediaPlayer::setVolume(int) {}
-void MediaPlayer::seek(int) {}
-
-bool MediaPlayer::isPlaying() const { return m_playing; }
-bool MediaPlayer::hasPlayer() const { return m_hasPlayer; }
-QString MediaPlayer::playerName() const { return m_playerName; }
-MediaInfo MediaPlayer::currentTrack() const { return m_info; }
-QString MediaPlayer::title() const { return m_info.title; }
-QString MediaPlayer::artist() const { return m_info.artist; }
-QString MediaPlayer::album() const { return m_info.album; }
-QString MediaPlayer::artUrl() const { return m_info.artUrl; }
-int MediaPlayer::duration() const { return m_info.duration; }
-int MediaPlayer::position() const { return m_info.position; }
-int MediaPlayer::volume() const { return m_volume; }
-QStringList MediaPlayer::availablePlayers() const { return {}; }
-void MediaPlayer::setActivePlayer(const QString&) {}
-
-// ============================================================================
-// NOTIFICATION API
-// ============================================================================
+int BatteryMonitor::cycleCount() { return readSupply(m_batteryPath, "cycle_count").toInt(); }
+double BatteryMonitor::voltage() { return readSupply(m_batteryPath, "voltage_now").toDouble() / 1e6; }
+double BatteryMonitor::current() { return readSupply(m_batteryPath, "current_now").toDouble() / 1e6; }
 
-NotificationAPI* NotificationAPI::s_instance = nullptr;
-
-NotificationAPI* NotificationAPI::instance() {
-    if (!s_instance) s_instance = new NotificationAPI();
-    return s_instance;
+double BatteryMonitor::power() {
+    double watts = readSupply(m_batteryPath, "power_now").toDouble() / 1e6;
+    return watts > 0 ? watts : voltage() * current();
 }
 
-NotificationAPI::NotificationAPI() : QObject() {}
+QString BatteryMonitor::technology() { return QString::fromUtf8(readSupply(m_batteryPath, "technology")); }
 
-void NotificationAPI::send(const QString& title, const QString& body, const QString& icon, int timeout) {
-    // Use notify-send or D-Bus
-    QProcess::startDetached("notify-send", {
-        "-t", QString::number(timeout),
-        "-i", icon,
-        title, body
-    });
-    emit notificationSent(title, body);
-}
+void BatteryMonitor::setLowThreshold(int percent) { m_lowThreshold = percent; }
+void BatteryMonitor::setCriticalThreshold(int percent) { m_criticalThreshold = percent; }
 
-void NotificationAPI::send(const QString& title, const QString& body) {
-    send(title, body, "dialog-information", 5000);
-}
+BatteryMonitor* battery() { return BatteryMonitor::instance(); }
 
 // ============================================================================
 // CLEANUP
 // ============================================================================
 
 void cleanupAPIs() {
-    if (SystemMonitor::s_instance) { delete SystemMonitor::s_instance; SystemMonitor::s_instance = nullptr; }
+    MetricsExporter::cleanup();  // Reads SystemMonitor snapshots; goes first
+    StatsdIngest::cleanup();     // Feeds the registry from its own thread
+    AlertRules::cleanup();       // Both run on the sampler; detach before it stops
+    PluginHost::cleanup();
+    SystemMonitor::cleanup();
     if (NetworkMonitor::s_instance) { delete NetworkMonitor::s_instance; NetworkMonitor::s_instance = nullptr; }
-    if (BatteryMonitor::s_instance) { delete BatteryMonitor::s_instance; BatteryMonitor::s_instance = nullptr; }
-    if (WeatherAPI::s_instance) { delete WeatherAPI::s_instance; WeatherAPI::s_instance = nullptr; }
-    if (MediaPlayer::s_instance) { delete MediaPlayer::s_instance; MediaPlayer::s_instance = nullptr; }
-    if (NotificationAPI::s_instance) { delete NotificationAPI::s_instance; NotificationAPI::s_instance = nullptr; }
+    BatteryMonitor::cleanup();
+    WeatherAPI::cleanup();
+    DataSource::cleanup();
+    CommandSource::cleanup();
+    MediaPlayer::cleanup();
+    AudioSpectrum::cleanup();
+    NotificationAPI::cleanup();
+    MetricRegistry::cleanup();
 }
 
 } // namespace Milk
@@ -0,0 +1,310 @@
+/**
+ * MilkWidgetCore - Alert Rules Implementation
+ *
+ * Rules are compiled once into Expressions whose inputs are read straight
+ * out of each snapshot. The sampler runs the whole batch under one lock
+ * and queues only the transitions to the GUI thread.
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QMutexLocker>
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Milk {
+
+using Snapshot = SystemMonitor::Snapshot;
+using SnapshotValue = std::function<double(const Snapshot&)>;
+
+/** What a reader returns when this machine has no such value right now */
+static const double Unavailable = std::numeric_limits<double>::quiet_NaN();
+
+/** Reader for one value a rule may name; null if there is no such value */
+static SnapshotValue snapshotValue(QString name) {
+    if (name.startsWith("sys.")) name = name.mid(4);
+
+    if (name == "cpu") return [](const Snapshot& s) { return s.cpuUsage; };
+    if (name.startsWith("cpu.")) {
+        QString group = name.mid(4);  // cpu.package1, cpu.node0, cpu.efficiency
+        return [group](const Snapshot& s) {
+            for (const auto& g : s.cpuGroups) {
+                if (g.name == group) return g.usage;
+            }
+            return Unavailable;
+        };
+    }
+    if (name == "memory") {
+        return [](const Snapshot& s) {
+            return s.memoryTotal > 0 ? 100.0 * (s.memoryTotal - s.memoryAvailable) / s.memoryTotal : Unavailable;
+        };
+    }
+    if (name == "swap") {
+        return [](const Snapshot& s) {
+            return s.swapTotal > 0 ? 100.0 * (s.swapTotal - s.swapFree) / s.swapTotal : 0.0;
+        };
+    }
+    if (name == "disk") {
+        return [](const Snapshot& s) {
+            for (const auto& fs : s.filesystems) {
+                if (fs.mountPoint == "/" && fs.total > 0) return 100.0 * (fs.total - fs.free) / fs.total;
+            }
+            return Unavailable;
+        };
+    }
+    if (name == "load" || name == "load1") return [](const Snapshot& s) { return s.load[0]; };
+    if (name == "load5") return [](const Snapshot& s) { return s.load[1]; };
+    if (name == "load15") return [](const Snapshot& s) { return s.load[2]; };
+    if (name == "temperature") {
+        return [](const Snapshot& s) {
+            if (s.temperatures.isEmpty()) return Unavailable;
+            double hottest = 0;
+            for (double celsius : s.temperatures) hottest = qMax(hottest, celsius);
+            return hottest;
+        };
+    }
+    if (name.startsWith("temperature.")) {
+        QString sensor = name.mid(12);
+        return [sensor](const Snapshot& s) { return s.temperatures.value(sensor, Unavailable); };
+    }
+    if (name == "gpu") {
+        return [](const Snapshot& s) {
+            return s.gpus.isEmpty() || s.gpus.first().busy < 0 ? Unavailable : s.gpus.first().busy;
+        };
+    }
+    if (name == "battery") {
+        return [](const Snapshot& s) { return s.batteryPercent < 0 ? Unavailable : double(s.batteryPercent); };
+    }
+    if (name == "charging") {
+        return [](const Snapshot& s) { return s.batteryPercent < 0 ? Unavailable : s.batteryCharging ? 1.0 : 0.0; };
+    }
+    if (name == "processes") return [](const Snapshot& s) { return double(s.processes); };
+    if (name == "uptime") return [](const Snapshot& s) { return s.uptime; };
+    return SnapshotValue();
+}
+
+struct AlertRules::RuleState {
+    Rule rule;
+    std::shared_ptr<Expression> condition;
+    std::shared_ptr<Expression> clear;  // Null: clears when condition stops holding
+    QVector<SnapshotValue> conditionInputs;
+    QVector<SnapshotValue> clearInputs;
+
+    bool active = false;
+    qint64 since = -1;       // When the expression for the next transition started holding
+    qint64 lastRaised = -1;
+};
+
+static bool compileCondition(const QString& source, std::shared_ptr<Expression>* expression,
+                             QVector<SnapshotValue>* inputs, QString* error) {
+    QString message;
+    *expression = Expression::compile(source, &message);
+    if (!*expression) {
+        *error = QString("\"%1\": %2").arg(source, message);
+        return false;
+    }
+    if ((*expression)->type() != Expression::Number) {
+        *error = QString("\"%1\": a condition must be a comparison, not text").arg(source);
+        return false;
+    }
+    for (const QString& name : (*expression)->inputs()) {
+        SnapshotValue value = snapshotValue(name);
+        if (!value) {
+            *error = QString("\"%1\": unknown value %2").arg(source, name);
+            return false;
+        }
+        inputs->append(value);
+    }
+    return true;
+}
+
+static bool holds(Expression& expression, const QVector<SnapshotValue>& inputs, const Snapshot& snapshot) {
+    for (int slot = 0; slot < inputs.size(); ++slot) {
+        double value = inputs[slot](snapshot);
+        // "battery < 20" on a desktop, or "!(battery > 20)": never met
+        if (std::isnan(value)) return false;
+        expression.setInput(slot, value);
+    }
+    expression.evaluate();
+    return expression.number() != 0;
+}
+
+// ============================================================================
+// ALERT RULES
+// ============================================================================
+
+AlertRules* AlertRules::s_instance = nullptr;
+
+AlertRules* AlertRules::instance() {
+    if (!s_instance) {
+        s_instance = new AlertRules();
+    }
+    return s_instance;
+}
+
+void AlertRules::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+AlertRules::AlertRules(QObject* parent)
+    : QObject(parent)
+{
+    SystemMonitor* monitor = SystemMonitor::instance();
+    QMutexLocker locker(&monitor->m_hookMutex);
+    monitor->m_alerts = this;
+}
+
+AlertRules::~AlertRules() {
+    // Waits out a batch the sampler may be running right now
+    if (SystemMonitor* monitor = SystemMonitor::s_instance) {
+        QMutexLocker locker(&monitor->m_hookMutex);
+        monitor->m_alerts = nullptr;
+    }
+}
+
+bool AlertRules::addRule(const Rule& rule, QString* error) {
+    std::unique_ptr<RuleState> state(new RuleState);
+    state->rule = rule;
+
+    QString message;
+    bool ok = true;
+    if (rule.name.isEmpty()) {
+        message = "alert rules need a name";
+        ok = false;
+    } else {
+        ok = compileCondition(rule.condition, &state->condition, &state->conditionInputs, &message) &&
+             (rule.clear.isEmpty() || compileCondition(rule.clear, &state->clear, &state->clearInputs, &message));
+    }
+    if (!ok) {
+        log()->warning(QString("Alert %1: %2").arg(rule.name, message));
+        if (error) *error = message;
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    auto it = std::find_if(m_rules.begin(), m_rules.end(),
+                           [&rule](const std::unique_ptr<RuleState>& s) { return s->rule.name == rule.name; });
+    if (it != m_rules.end()) {
+        // Reloading a file must not raise everything that is already raised again
+        state->active = (*it)->active;
+        state->lastRaised = (*it)->lastRaised;
+        *it = std::move(state);
+    } else {
+        m_rules.push_back(std::move(state));
+    }
+    return true;
+}
+
+void AlertRules::removeRule(const QString& name) {
+    bool wasActive = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = std::find_if(m_rules.begin(), m_rules.end(),
+                               [&name](const std::unique_ptr<RuleState>& s) { return s->rule.name == name; });
+        if (it == m_rules.end()) return;
+        wasActive = (*it)->active;
+        m_rules.erase(it);
+    }
+    if (wasActive) {
+        deliver(name, false, QString());
+    }
+}
+
+void AlertRules::replaceRules(const QString& source, const QList<Rule>& rules) {
+    QSet<QString> kept;
+    for (Rule rule : rules) {
+        rule.source = source;
+        if (addRule(rule)) kept.insert(rule.name);
+    }
+
+    QStringList stale;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const auto& state : m_rules) {
+            if (state->rule.source == source && !kept.contains(state->rule.name)) stale << state->rule.name;
+        }
+    }
+    for (const QString& name : stale) {
+        removeRule(name);
+    }
+}
+
+void AlertRules::clearRules() {
+    for (const QString& name : rules()) {
+        removeRule(name);
+    }
+}
+
+QStringList AlertRules::rules() const {
+    QMutexLocker locker(&m_mutex);
+    QStringList names;
+    for (const auto& state : m_rules) names << state->rule.name;
+    return names;
+}
+
+bool AlertRules::isActive(const QString& name) const {
+    QMutexLocker locker(&m_mutex);
+    for (const auto& state : m_rules) {
+        if (state->rule.name == name) return state->active;
+    }
+    return false;
+}
+
+void AlertRules::evaluate(const SystemMonitor::Snapshot& snapshot) {
+    struct Transition {
+        QString name;
+        bool active;
+        QString message;
+    };
+    QVector<Transition> transitions;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        const qint64 now = snapshot.timestamp;
+        for (const auto& state : m_rules) {
+            const Rule& rule = state->rule;
+            bool raising = !state->active;
+            bool met;
+            if (raising) met = holds(*state->condition, state->conditionInputs, snapshot);
+            else if (state->clear) met = holds(*state->clear, state->clearInputs, snapshot);
+            else met = !holds(*state->condition, state->conditionInputs, snapshot);
+
+            if (!met) {
+                state->since = -1;
+                continue;
+            }
+            if (state->since < 0) state->since = now;
+            if (now - state->since < (raising ? rule.holdMs : rule.clearHoldMs)) continue;
+            if (raising && state->lastRaised >= 0 && now - state->lastRaised < rule.minIntervalMs) continue;
+
+            state->active = raising;
+            state->since = -1;
+            if (raising) state->lastRaised = now;
+            transitions.append({rule.name, raising, raising ? rule.message : QString()});
+        }
+    }
+
+    for (const Transition& t : transitions) {
+        QMetaObject::invokeMethod(this, [this, t]() { deliver(t.name, t.active, t.message); }, Qt::QueuedConnection);
+    }
+}
+
+void AlertRules::deliver(const QString& name, bool active, const QString& message) {
+    MetricRegistry::instance()->set("alert." + name, active ? 1 : 0);
+    if (active && !message.isEmpty()) {
+        NotificationAPI::instance()->notify(name, message);
+    }
+    emit changed(name, active);
+    if (active) emit raised(name);
+    else emit cleared(name);
+}
+
+AlertRules* alerts() {
+    return AlertRules::instance();
+}
+
+} // namespace Milk
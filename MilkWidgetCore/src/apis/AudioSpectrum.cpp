@@ -0,0 +1,595 @@
+/**
+ * MilkWidgetCore - Audio Spectrum Implementation
+ */
+
+#include "apis/AudioWorker.h"
+#include "milk/Utils.h"
+
+#include <QFileInfo>
+#include <QProcess>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtEndian>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Milk {
+
+static const float FloorDb = -70.0f;
+
+// ============================================================================
+// TRIPLE BUFFER
+// ============================================================================
+
+SpectrumBuffer::SpectrumBuffer(int bands) {
+    for (SpectrumFrame& frame : m_slots) frame.bands.fill(0.0f, bands);
+}
+
+void SpectrumBuffer::publish() {
+    int previous = m_middle.exchange(m_back | Dirty, std::memory_order_acq_rel);
+    m_back = previous & ~Dirty;
+}
+
+bool SpectrumBuffer::acquire() {
+    if (!(m_middle.load(std::memory_order_acquire) & Dirty)) return false;
+    int previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+    m_front = previous & ~Dirty;
+    return true;
+}
+
+// ============================================================================
+// FFT PLAN
+// ============================================================================
+
+void FftPlan::prepare(int size) {
+    if (size == m_size) return;
+    m_size = size;
+
+    // A real transform of size N is a complex transform of N/2 plus a split step
+    const int half = size / 2;
+    int bits = 0;
+    while ((1 << bits) < half) bits++;
+
+    m_bitReverse.resize(half);
+    for (int i = 0; i < half; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    m_twiddles.resize(half / 2);
+    for (int k = 0; k < half / 2; ++k) {
+        m_twiddles[k] = std::polar(1.0f, float(-2.0 * M_PI * k / half));
+    }
+    m_split.resize(half + 1);
+    for (int k = 0; k <= half; ++k) {
+        m_split[k] = std::polar(1.0f, float(-2.0 * M_PI * k / size));
+    }
+    m_work.assign(half, std::complex<float>());
+}
+
+void FftPlan::powerSpectrum(const float* input, float* power) {
+    const int half = m_size / 2;
+    std::complex<float>* a = m_work.data();
+
+    // Even samples as real parts, odd samples as imaginary parts
+    for (int i = 0; i < half; ++i) a[m_bitReverse[i]] = std::complex<float>(input[2 * i], input[2 * i + 1]);
+
+    // Butterflies spelled out: std::complex multiply carries NaN checks
+    for (int len = 2; len <= half; len <<= 1) {
+        const int span = len >> 1;
+        const int step = half / len;
+        for (int i = 0; i < half; i += len) {
+            for (int j = 0; j < span; ++j) {
+                const std::complex<float> w = m_twiddles[j * step];
+                std::complex<float>& lo = a[i + j];
+                std::complex<float>& hi = a[i + j + span];
+                float vr = hi.real() * w.real() - hi.imag() * w.imag();
+                float vi = hi.real() * w.imag() + hi.imag() * w.real();
+                hi = std::complex<float>(lo.real() - vr, lo.imag() - vi);
+                lo = std::complex<float>(lo.real() + vr, lo.imag() + vi);
+            }
+        }
+    }
+
+    for (int k = 0; k <= half; ++k) {
+        const std::complex<float> z = a[k % half];
+        const std::complex<float> zc = std::conj(a[(half - k) % half]);
+        // even = (z + zc) / 2, odd = (z - zc) / 2i
+        float er = 0.5f * (z.real() + zc.real()), ei = 0.5f * (z.imag() + zc.imag());
+        float or_ = 0.5f * (z.imag() - zc.imag()), oi = -0.5f * (z.real() - zc.real());
+        const std::complex<float> w = m_split[k];
+        float xr = er + or_ * w.real() - oi * w.imag();
+        float xi = ei + or_ * w.imag() + oi * w.real();
+        power[k] = xr * xr + xi * xi;
+    }
+}
+
+// ============================================================================
+// WORKER (audio thread)
+// ============================================================================
+
+AudioWorker::AudioWorker(const Config& config, std::shared_ptr<SpectrumBuffer> frames)
+    : QObject(nullptr)
+    , m_config(config)
+    , m_frames(std::move(frames))
+{
+}
+
+AudioWorker::~AudioWorker() {
+    stop();
+}
+
+void AudioWorker::start() {
+    QString error;
+    bool monitor = m_config.source.isEmpty() || m_config.source == "monitor";
+    if (!(monitor ? openMonitor(&error) : openFile(&error))) {
+        stop();
+        emit failed(error);
+        return;
+    }
+
+    const int n = m_config.fftSize;
+    m_plan.prepare(n);
+
+    // Periodic Hann window; its mean is the amplitude lost to windowing
+    m_window.resize(n);
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * M_PI * i / n));
+        sum += m_window[i];
+    }
+    m_windowGain = float(sum / n);
+
+    m_ring.assign(n, 0.0f);
+    m_input.assign(n, 0.0f);
+    m_power.assign(n / 2 + 1, 0.0f);
+    m_levels.assign(m_config.bands, 0.0f);
+    m_ringPos = 0;
+    m_sinceHop = 0;
+    m_hop = qMax(1, m_sampleRate / qMax(1, m_config.fps));
+    prepareBands();
+}
+
+void AudioWorker::stop() {
+    if (m_pacer) m_pacer->stop();
+    if (m_notifier) {
+        delete m_notifier;
+        m_notifier = nullptr;
+    }
+    if (m_process) {
+        m_process->disconnect(this);
+        m_process->kill();
+        m_process->waitForFinished(1000);
+        delete m_process;
+        m_process = nullptr;
+    }
+    if (m_file) {
+        delete m_file;
+        m_file = nullptr;
+    }
+    m_partial.clear();
+}
+
+bool AudioWorker::openMonitor(QString* error) {
+    m_type = Float32;
+    m_channels = 1;
+    m_sampleRate = m_config.sampleRate;
+    QString rate = QString::number(m_sampleRate);
+
+    // parec covers PulseAudio and pipewire-pulse; pw-record covers bare PipeWire
+    QString parec = QStandardPaths::findExecutable("parec");
+    QString pwRecord = QStandardPaths::findExecutable("pw-record");
+    QString program;
+    QStringList args;
+    if (!parec.isEmpty()) {
+        program = parec;
+        args = {"--device=@DEFAULT_MONITOR@", "--raw", "--format=float32le", "--channels=1",
+                "--rate=" + rate, "--latency-msec=20"};
+    } else if (!pwRecord.isEmpty()) {
+        program = pwRecord;
+        args = {"-P", "{ stream.capture.sink=true }", "--format", "f32", "--channels", "1",
+                "--rate", rate, "-"};
+    } else {
+        *error = "No audio monitor: neither parec nor pw-record is installed";
+        return false;
+    }
+
+    m_process = new QProcess(this);
+    m_process->setStandardInputFile(QProcess::nullDevice());
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &AudioWorker::onProcessData);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this]() {
+        QString message = QString::fromUtf8(m_process->readAllStandardError()).trimmed();
+        emit failed(message.isEmpty() ? QString("Audio monitor exited") : message);
+    });
+    m_process->start(program, args);
+    if (!m_process->waitForStarted(3000)) {
+        *error = QString("Failed to start %1").arg(program);
+        return false;
+    }
+    return true;
+}
+
+bool AudioWorker::openFile(QString* error) {
+    QString path = m_config.source;
+    if (path.startsWith("file:")) path = QUrl(path).toLocalFile();
+    QFileInfo info(path);
+    if (!info.exists()) {
+        *error = QString("Audio source not found: %1").arg(path);
+        return false;
+    }
+
+    m_file = new QFile(path, this);
+
+    if (!info.isFile()) {
+#ifdef Q_OS_UNIX
+        // FIFOs carry raw float32 mono; non-blocking so an absent writer can't stall the thread
+        int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0 || !m_file->open(fd, QIODevice::ReadOnly, QFileDevice::AutoCloseHandle)) {
+            if (fd >= 0) ::close(fd);
+            *error = QString("Cannot open %1").arg(path);
+            return false;
+        }
+        m_type = Float32;
+        m_channels = 1;
+        m_sampleRate = m_config.sampleRate;
+        m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &AudioWorker::onFifoData);
+        return true;
+#else
+        *error = QString("Unsupported audio source: %1").arg(path);
+        return false;
+#endif
+    }
+
+    if (!m_file->open(QIODevice::ReadOnly)) {
+        *error = QString("Cannot open %1: %2").arg(path, m_file->errorString());
+        return false;
+    }
+    if (!readWavHeader(error)) return false;
+
+    if (!m_pacer) {
+        m_pacer = new QTimer(this);
+        m_pacer->setTimerType(Qt::PreciseTimer);
+        connect(m_pacer, &QTimer::timeout, this, &AudioWorker::readPaced);
+    }
+    // The interval only sets the cadence; readPaced() works out how much to read
+    m_playClock.start();
+    m_framesRead = 0;
+    m_pacer->start(qMax(1, 1000 / qMax(1, m_config.fps)));
+    return true;
+}
+
+bool AudioWorker::readWavHeader(QString* error) {
+    m_type = Float32;
+    m_channels = 1;
+    m_sampleRate = m_config.sampleRate;
+
+    QByteArray riff = m_file->read(12);
+    if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") {
+        m_file->seek(0);  // Headerless: raw float32 mono
+        return true;
+    }
+
+    bool haveFormat = false;
+    while (!m_file->atEnd()) {
+        QByteArray chunk = m_file->read(8);
+        if (chunk.size() < 8) break;
+        quint32 size = qFromLittleEndian<quint32>(chunk.constData() + 4);
+
+        if (chunk.startsWith("fmt ")) {
+            QByteArray fmt = m_file->read(size + (size & 1));
+            if (fmt.size() < 16) break;
+            quint16 tag = qFromLittleEndian<quint16>(fmt.constData());
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of the subformat GUID
+            if (tag == 0xFFFE && fmt.size() >= 26) tag = qFromLittleEndian<quint16>(fmt.constData() + 24);
+            quint16 bits = qFromLittleEndian<quint16>(fmt.constData() + 14);
+            m_channels = qFromLittleEndian<quint16>(fmt.constData() + 2);
+            m_sampleRate = int(qFromLittleEndian<quint32>(fmt.constData() + 4));
+            if (tag == 1 && bits == 16) m_type = Int16;
+            else if (tag == 3 && bits == 32) m_type = Float32;
+            else {
+                *error = QString("Unsupported WAV format %1 (%2-bit); use 16-bit PCM or 32-bit float")
+                             .arg(tag).arg(bits);
+                return false;
+            }
+            haveFormat = m_channels > 0 && m_sampleRate > 0;
+        } else if (chunk.startsWith("data")) {
+            if (haveFormat) return true;
+            break;
+        } else {
+            m_file->seek(m_file->pos() + size + (size & 1));
+        }
+    }
+
+    *error = QString("Malformed WAV file: %1").arg(m_file->fileName());
+    return false;
+}
+
+void AudioWorker::prepareBands() {
+    const int n = m_plan.size();
+    const int lastBin = n / 2;
+    const double binHz = double(m_sampleRate) / n;
+    const double nyquist = m_sampleRate / 2.0;
+    const double low = qBound(binHz, m_config.minHz, nyquist);
+    const double high = qBound(low, m_config.maxHz, nyquist);
+    const int bands = m_config.bands;
+
+    m_bandStart.resize(bands);
+    m_bandEnd.resize(bands);
+    for (int b = 0; b < bands; ++b) {
+        double from = low * std::pow(high / low, double(b) / bands);
+        double to = low * std::pow(high / low, double(b + 1) / bands);
+        // Low bands can be narrower than a bin; they still get one
+        int start = qBound(1, int(from / binHz), lastBin);
+        int end = qBound(start + 1, int(std::ceil(to / binHz)), lastBin + 1);
+        m_bandStart[b] = start;
+        m_bandEnd[b] = end;
+    }
+}
+
+// ============================================================================
+// INPUT
+// ============================================================================
+
+void AudioWorker::onProcessData() {
+    QByteArray data = m_process->readAllStandardOutput();
+    feed(data.constData(), data.size());
+}
+
+void AudioWorker::onFifoData() {
+#ifdef Q_OS_UNIX
+    char buffer[16384];
+    for (;;) {
+        ssize_t count = ::read(m_file->handle(), buffer, sizeof(buffer));
+        if (count > 0) {
+            feed(buffer, count);
+            continue;
+        }
+        if (count == 0) {
+            // Writer closed its end; a closed FIFO would otherwise stay readable forever
+            stop();
+            emit finished();
+        }
+        return;
+    }
+#endif
+}
+
+void AudioWorker::readPaced() {
+    // Read what the clock says is due: a fixed amount per tick drifts with
+    // the rounded interval and with late timers. After a stall of over a
+    // second the backlog is forgiven; playback resumes late, not racing.
+    qint64 due = m_playClock.nsecsElapsed() / 1000 * m_sampleRate / 1000000 - m_framesRead;
+    if (due <= 0) return;
+    qint64 frames = qMin<qint64>(due, m_sampleRate);
+    m_framesRead += due;
+
+    int frameBytes = (m_type == Float32 ? 4 : 2) * m_channels;
+    QByteArray data = m_file->read(frames * frameBytes);
+    if (!data.isEmpty()) feed(data.constData(), data.size());
+    if (m_file->atEnd()) {
+        stop();
+        emit finished();
+    }
+}
+
+void AudioWorker::feed(const char* data, qint64 bytes) {
+    const int sampleBytes = m_type == Float32 ? 4 : 2;
+    const int frameBytes = sampleBytes * m_channels;
+
+    // Reads don't respect frame boundaries; carry the remainder over
+    if (!m_partial.isEmpty()) {
+        m_partial.append(data, int(bytes));
+        QByteArray joined;
+        joined.swap(m_partial);
+        qint64 whole = joined.size() - joined.size() % frameBytes;
+        m_partial = joined.mid(int(whole));
+        joined.truncate(int(whole));
+        feed(joined.constData(), joined.size());
+        return;
+    }
+    qint64 whole = bytes - bytes % frameBytes;
+    if (whole < bytes) m_partial = QByteArray(data + whole, int(bytes - whole));
+
+    const int mask = m_plan.size() - 1;
+    const float scale = 1.0f / m_channels;
+    for (const char* frame = data; frame < data + whole; frame += frameBytes) {
+        float sample = 0;
+        for (int c = 0; c < m_channels; ++c) {
+            const char* p = frame + c * sampleBytes;
+            if (m_type == Float32) {
+                quint32 bits = qFromLittleEndian<quint32>(p);
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                sample += value;
+            } else {
+                sample += qFromLittleEndian<qint16>(p) / 32768.0f;
+            }
+        }
+        sample *= scale;
+
+        m_ring[m_ringPos] = sample;
+        m_ringPos = (m_ringPos + 1) & mask;
+        m_peak = qMax(m_peak, std::fabs(sample));
+        m_sumSquares += double(sample) * sample;
+        if (++m_sinceHop >= m_hop) {
+            analyze();
+            m_sinceHop = 0;
+        }
+    }
+}
+
+// ============================================================================
+// ANALYSIS
+// ============================================================================
+
+void AudioWorker::analyze() {
+    const int n = m_plan.size();
+    const float* ring = m_ring.data();
+    const float* window = m_window.data();
+    float* input = m_input.data();
+
+    // Oldest sample first; both loops are plain multiplies the compiler vectorizes
+    const int head = n - m_ringPos;
+    for (int i = 0; i < head; ++i) input[i] = ring[m_ringPos + i] * window[i];
+    for (int i = head; i < n; ++i) input[i] = ring[i - head] * window[i];
+
+    m_plan.powerSpectrum(input, m_power.data());
+
+    // A full-scale sine peaks at (N * gain / 2)^2 in the power spectrum
+    const float fullScale = 0.5f * n * m_windowGain;
+    const float norm = 1.0f / (fullScale * fullScale);
+    const float decay = float(qBound(0.0, m_config.smoothing, 0.99));
+    const float* power = m_power.data();
+    float* levels = m_levels.data();
+
+    for (int b = 0, bands = int(m_levels.size()); b < bands; ++b) {
+        // Branch-free max reduction over the band's bins
+        float strongest = 0;
+        for (int k = m_bandStart[b], end = m_bandEnd[b]; k < end; ++k) {
+            strongest = std::fmax(strongest, power[k]);
+        }
+        float db = 10.0f * std::log10(std::fmax(strongest * norm, 1e-12f));
+        float level = qBound(0.0f, (db - FloorDb) / -FloorDb, 1.0f);
+        // Rise immediately, fall at the smoothing rate
+        levels[b] = std::fmax(level, levels[b] * decay);
+    }
+
+    SpectrumFrame& frame = m_frames->back();
+    std::memcpy(frame.bands.data(), levels, m_levels.size() * sizeof(float));
+    frame.rms = float(std::sqrt(m_sumSquares / m_hop));
+    frame.peak = m_peak;
+    frame.sequence = ++m_sequence;
+    m_frames->publish();
+    m_peak = 0;
+    m_sumSquares = 0;
+
+    // One queued signal at a time; a busy GUI thread just sees the newest frame
+    if (!m_frames->notified.exchange(true)) emit frameReady();
+}
+
+// ============================================================================
+// AUDIO SPECTRUM (GUI thread)
+// ============================================================================
+
+AudioSpectrum* AudioSpectrum::s_instance = nullptr;
+
+AudioSpectrum* AudioSpectrum::instance() {
+    if (!s_instance) {
+        s_instance = new AudioSpectrum();
+    }
+    return s_instance;
+}
+
+void AudioSpectrum::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+AudioSpectrum::AudioSpectrum(QObject* parent)
+    : QObject(parent)
+    , m_frames(std::make_shared<SpectrumBuffer>(m_bands))
+{
+}
+
+AudioSpectrum::~AudioSpectrum() {
+    stop();
+}
+
+void AudioSpectrum::setSource(const QString& source) { m_source = source; restart(); }
+void AudioSpectrum::setSampleRate(int hz) { m_sampleRate = qBound(8000, hz, 192000); restart(); }
+void AudioSpectrum::setBands(int count) { m_bands = qBound(1, count, 256); restart(); }
+void AudioSpectrum::setFrequencyRange(double minHz, double maxHz) { m_minHz = minHz; m_maxHz = maxHz; restart(); }
+void AudioSpectrum::setFrameRate(int fps) { m_fps = qBound(1, fps, 240); restart(); }
+void AudioSpectrum::setSmoothing(double factor) { m_smoothing = qBound(0.0, factor, 0.99); restart(); }
+
+void AudioSpectrum::setFftSize(int size) {
+    int rounded = 256;
+    while (rounded < size && rounded < 16384) rounded <<= 1;
+    m_fftSize = rounded;
+    restart();
+}
+
+void AudioSpectrum::start() {
+    if (m_thread) return;
+
+    m_frames = std::make_shared<SpectrumBuffer>(m_bands);
+    m_front = SpectrumFrame();
+    m_front.bands.fill(0.0f, m_bands);
+
+    AudioWorker::Config config;
+    config.source = m_source;
+    config.sampleRate = m_sampleRate;
+    config.fftSize = m_fftSize;
+    config.bands = m_bands;
+    config.fps = m_fps;
+    config.minHz = m_minHz;
+    config.maxHz = m_maxHz;
+    config.smoothing = m_smoothing;
+
+    m_thread = new QThread();
+    m_thread->setObjectName("milk-audio");
+    m_worker = new AudioWorker(config, m_frames);
+    m_worker->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &AudioWorker::frameReady, this, &AudioSpectrum::frameReady);
+    connect(m_worker, &AudioWorker::failed, this, [this](const QString& message) {
+        log()->warning(QString("AudioSpectrum: %1").arg(message));
+        emit error(message);
+    });
+    connect(m_worker, &AudioWorker::finished, this, &AudioSpectrum::finished);
+    m_thread->start();
+    QMetaObject::invokeMethod(m_worker, "start", Qt::QueuedConnection);
+}
+
+void AudioSpectrum::stop() {
+    if (!m_thread) return;
+    m_worker->disconnect(this);
+    // The worker stops its source in its destructor, on its own thread
+    m_thread->quit();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+    m_worker = nullptr;
+}
+
+void AudioSpectrum::restart() {
+    if (!m_thread) return;
+    stop();
+    start();
+}
+
+bool AudioSpectrum::takeFrame(SpectrumFrame& frame) {
+    m_frames->notified.store(false);
+    if (!m_frames->acquire()) return false;
+
+    // Element copy: sharing the slot's vector would make the worker detach it
+    const SpectrumFrame& latest = m_frames->front();
+    frame.bands.resize(latest.bands.size());
+    std::memcpy(frame.bands.data(), latest.bands.constData(), latest.bands.size() * sizeof(float));
+    frame.rms = latest.rms;
+    frame.peak = latest.peak;
+    frame.sequence = latest.sequence;
+    return true;
+}
+
+SpectrumFrame AudioSpectrum::frame() {
+    takeFrame(m_front);
+    return m_front;
+}
+
+AudioSpectrum* audio() {
+    return AudioSpectrum::instance();
+}
+
+} // namespace Milk
@@ -0,0 +1,160 @@
+/**
+ * MilkWidgetCore - Audio Spectrum Worker (private)
+ *
+ * PCM decoding, the FFT plan and band binning for AudioSpectrum. All of it
+ * runs on the "milk-audio" thread; the only thing shared with the GUI
+ * thread is the SpectrumBuffer.
+ */
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include "milk/APIs.h"
+
+class QProcess;
+class QSocketNotifier;
+
+namespace Milk {
+
+// ============================================================================
+// TRIPLE BUFFER
+// ============================================================================
+
+/**
+ * Single-producer, single-consumer triple buffer of spectrum frames. The
+ * worker fills back() and publishes it; the GUI thread acquires the newest
+ * published slot. Neither side ever waits on the other.
+ */
+class SpectrumBuffer {
+public:
+    explicit SpectrumBuffer(int bands);
+
+    // Producer
+    SpectrumFrame& back() { return m_slots[m_back]; }
+    void publish();
+
+    // Consumer: true if a newer frame than front() was published
+    bool acquire();
+    const SpectrumFrame& front() const { return m_slots[m_front]; }
+
+    /** Set by the worker when it signals, cleared by the reader on acquire */
+    std::atomic<bool> notified{false};
+
+private:
+    static const int Dirty = 4;
+
+    SpectrumFrame m_slots[3];
+    int m_back = 0;
+    std::atomic<int> m_middle{1};
+    int m_front = 2;
+};
+
+// ============================================================================
+// FFT PLAN
+// ============================================================================
+
+/**
+ * Radix-2 real FFT. Twiddles and the bit-reversal table are built once by
+ * prepare(); transforms reuse them and allocate nothing.
+ */
+class FftPlan {
+public:
+    void prepare(int size);
+    int size() const { return m_size; }
+
+    /** size() real samples in, size()/2 + 1 bins of power (re² + im²) out */
+    void powerSpectrum(const float* input, float* power);
+
+private:
+    int m_size = 0;
+    std::vector<int> m_bitReverse;
+    std::vector<std::complex<float>> m_twiddles;  // Complex FFT of size/2
+    std::vector<std::complex<float>> m_split;     // Real-input post-processing
+    std::vector<std::complex<float>> m_work;
+};
+
+// ============================================================================
+// WORKER
+// ============================================================================
+
+class AudioWorker : public QObject {
+    Q_OBJECT
+
+public:
+    struct Config {
+        QString source;
+        int sampleRate = 48000;
+        int fftSize = 2048;
+        int bands = 32;
+        int fps = 60;
+        double minHz = 40;
+        double maxHz = 16000;
+        double smoothing = 0.6;
+    };
+
+    AudioWorker(const Config& config, std::shared_ptr<SpectrumBuffer> frames);
+    ~AudioWorker();
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameReady();
+    void failed(const QString& message);
+    void finished();
+
+private:
+    enum SampleType { Float32, Int16 };
+
+    bool openMonitor(QString* error);
+    bool openFile(QString* error);
+    bool readWavHeader(QString* error);
+    void prepareBands();
+    void onProcessData();
+    void onFifoData();
+    void readPaced();
+    void feed(const char* data, qint64 bytes);
+    void analyze();
+
+    Config m_config;
+    std::shared_ptr<SpectrumBuffer> m_frames;
+
+    QFile* m_file = nullptr;
+    QProcess* m_process = nullptr;
+    QSocketNotifier* m_notifier = nullptr;
+    QTimer* m_pacer = nullptr;  // Regular files are read at playback speed
+    QElapsedTimer m_playClock;  // Since playback of the file began
+    qint64 m_framesRead = 0;    // Sample frames read from the file so far
+
+    SampleType m_type = Float32;
+    int m_channels = 1;
+    int m_sampleRate = 48000;
+    QByteArray m_partial;  // Bytes of an incomplete sample frame
+
+    FftPlan m_plan;
+    std::vector<float> m_window;
+    std::vector<float> m_ring;
+    std::vector<float> m_input;
+    std::vector<float> m_power;
+    std::vector<int> m_bandStart;  // Bin range [start, end) of each band
+    std::vector<int> m_bandEnd;
+    std::vector<float> m_levels;
+    int m_ringPos = 0;
+    int m_hop = 800;
+    int m_sinceHop = 0;
+    float m_peak = 0;
+    double m_sumSquares = 0;
+    float m_windowGain = 1;
+    quint64 m_sequence = 0;
+};
+
+} // namespace Milk
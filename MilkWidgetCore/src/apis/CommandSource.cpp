@@ -0,0 +1,252 @@
+/**
+ * MilkWidgetCore - Command Source Implementation
+ */
+
+#include "apis/CommandWorker.h"
+#include "milk/Utils.h"
+
+#include <QThread>
+#include <QCoreApplication>
+#include <utility>
+
+namespace Milk {
+
+static const int MaxRestartDelay = 30000;
+static const char* DefaultPattern = "[-+]?\\d*\\.?\\d+";
+
+// ============================================================================
+// WORKER (runner thread)
+// ============================================================================
+
+std::atomic<int> CommandWorker::s_maxConcurrent{qMax(2, QThread::idealThreadCount())};
+int CommandWorker::s_running = 0;
+QList<CommandWorker*> CommandWorker::s_waiting;
+
+CommandWorker::CommandWorker(const QString& command, CommandSource::Mode mode, int intervalMs,
+                             const QString& pattern)
+    : QObject(nullptr)
+    , m_command(command)
+    , m_mode(mode)
+    , m_interval(qMax(50, intervalMs))
+    , m_pattern(pattern)
+{
+}
+
+CommandWorker::~CommandWorker() {
+    stop();
+}
+
+void CommandWorker::start() {
+    m_stopped = false;
+    if (!m_pattern.isValid()) emit failed(QString("Invalid pattern: %1").arg(m_pattern.errorString()));
+    if (!m_timer) {
+        m_timer = new QTimer(this);
+        m_timer->setTimerType(Qt::CoarseTimer);
+        connect(m_timer, &QTimer::timeout, this, &CommandWorker::tick);
+        m_killTimer = new QTimer(this);
+        m_killTimer->setSingleShot(true);
+        connect(m_killTimer, &QTimer::timeout, this, [this]() {
+            if (m_process) m_process->kill();
+        });
+    }
+    if (m_mode == CommandSource::Interval) m_timer->start(m_interval);
+    tick();
+}
+
+void CommandWorker::stop() {
+    m_stopped = true;
+    s_waiting.removeAll(this);
+    if (m_timer) m_timer->stop();
+    if (m_killTimer) m_killTimer->stop();
+    if (m_process) {
+        m_process->disconnect(this);
+        m_process->kill();
+        m_process->waitForFinished(1000);
+        delete m_process;
+        m_process = nullptr;
+    }
+    if (m_counted) {
+        m_counted = false;
+        s_running--;
+        startWaiting();
+    }
+}
+
+void CommandWorker::tick() {
+    if (m_stopped || m_process) return;  // Previous run still going: skip, never stack
+    if (m_mode == CommandSource::Interval && s_running >= s_maxConcurrent.load()) {
+        if (!s_waiting.contains(this)) s_waiting.append(this);
+        return;
+    }
+    launch();
+}
+
+void CommandWorker::startWaiting() {
+    while (!s_waiting.isEmpty() && s_running < s_maxConcurrent.load()) {
+        s_waiting.takeFirst()->launch();
+    }
+}
+
+void CommandWorker::launch() {
+    if (m_stopped || m_process) return;
+
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::SeparateChannels);
+    m_process->setStandardInputFile(QProcess::nullDevice());
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &CommandWorker::onReadyRead);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &CommandWorker::onFinished);
+
+    m_buffer.clear();
+    // Only interval runs count against the cap; a persistent child would hold its slot forever
+    m_counted = m_mode == CommandSource::Interval;
+    if (m_counted) s_running++;
+    m_process->start("/bin/sh", {"-c", m_command});
+
+    // A hung interval command must not hold a concurrency slot forever
+    if (m_mode == CommandSource::Interval) m_killTimer->start(qMax(m_interval * 4, 5000));
+}
+
+void CommandWorker::onReadyRead() {
+    m_buffer += m_process->readAllStandardOutput();
+    if (m_mode != CommandSource::Persistent) return;
+
+    int end = m_buffer.lastIndexOf('\n');
+    if (end < 0) return;
+    QStringList lines = QString::fromUtf8(m_buffer.constData(), end).split('\n', Qt::SkipEmptyParts);
+    m_buffer.remove(0, end + 1);
+    if (lines.isEmpty()) return;
+
+    m_restartDelay = 1000;  // Output means the process is healthy again
+    publish(lines, lines.last());
+}
+
+void CommandWorker::onFinished(int exitCode, QProcess::ExitStatus status) {
+    m_killTimer->stop();
+    m_buffer += m_process->readAllStandardOutput();
+    QByteArray stderrText = m_process->readAllStandardError().trimmed();
+    m_process->deleteLater();
+    m_process = nullptr;
+    if (m_counted) { m_counted = false; s_running--; }
+
+    QString text = QString::fromUtf8(m_buffer).trimmed();
+    m_buffer.clear();
+
+    if (status != QProcess::NormalExit || exitCode != 0) {
+        emit failed(QString("'%1' exited with %2%3").arg(m_command).arg(exitCode)
+                    .arg(stderrText.isEmpty() ? QString() : ": " + QString::fromUtf8(stderrText)));
+    } else if (!text.isEmpty()) {
+        publish(text.split('\n', Qt::SkipEmptyParts), text);
+    }
+
+    startWaiting();
+
+    if (m_mode == CommandSource::Persistent && !m_stopped) {
+        QTimer::singleShot(m_restartDelay, this, [this]() { tick(); });
+        m_restartDelay = qMin(m_restartDelay * 2, MaxRestartDelay);
+    }
+}
+
+void CommandWorker::publish(const QStringList& lines, const QString& output) {
+    // Parsed here so the GUI thread only receives finished values
+    QRegularExpressionMatch match = m_pattern.match(output);
+    bool hasValue = false;
+    double value = 0;
+    if (match.hasMatch()) {
+        value = match.captured(m_pattern.captureCount() > 0 ? 1 : 0).toDouble(&hasValue);
+    }
+    emit result(lines, output, value, hasValue);
+}
+
+// ============================================================================
+// COMMAND SOURCE (GUI thread)
+// ============================================================================
+
+QHash<QString, CommandSource*> CommandSource::s_sources;
+QThread* CommandSource::s_thread = nullptr;
+
+CommandSource* CommandSource::acquire(const QString& command, Mode mode, int intervalMs, const QString& pattern) {
+    // Identical commands share one process no matter how many widgets use
+    // them. The pattern is part of the key because the worker parses the
+    // value before it reaches any subscriber.
+    const QString regex = pattern.isEmpty() ? QString(DefaultPattern) : pattern;
+    QString key = QString("%1|%2|%3|%4").arg(int(mode)).arg(mode == Interval ? intervalMs : 0)
+                                        .arg(regex.size()).arg(regex + command);
+    CommandSource* source = s_sources.value(key);
+    if (!source) {
+        if (!s_thread) {
+            s_thread = new QThread();
+            s_thread->setObjectName("milk-commands");
+            s_thread->start();
+        }
+        source = new CommandSource(command, mode, intervalMs, regex);
+        source->m_key = key;
+        s_sources.insert(key, source);
+    }
+    source->m_refs++;
+    return source;
+}
+
+void CommandSource::release(CommandSource* source) {
+    // A handle may outlive cleanup(), which already deleted every source
+    if (!source || s_sources.key(source).isEmpty()) return;
+    if (--source->m_refs > 0) return;
+    s_sources.remove(source->m_key);
+    delete source;
+}
+
+void CommandSource::setMaxConcurrent(int count) {
+    CommandWorker::s_maxConcurrent.store(qMax(1, count));
+}
+
+void CommandSource::cleanup() {
+    for (CommandSource* source : std::as_const(s_sources)) delete source;
+    s_sources.clear();
+    if (s_thread) {
+        s_thread->quit();
+        s_thread->wait();
+        delete s_thread;
+        s_thread = nullptr;
+    }
+}
+
+CommandSource::CommandSource(const QString& command, Mode mode, int intervalMs, const QString& pattern)
+    : QObject(nullptr)
+    , m_command(command)
+    , m_mode(mode)
+    , m_worker(new CommandWorker(command, mode, intervalMs, pattern))
+{
+    m_worker->moveToThread(s_thread);
+    connect(m_worker, &CommandWorker::result, this, &CommandSource::onResult);
+    connect(m_worker, &CommandWorker::failed, this, &CommandSource::error);
+    QMetaObject::invokeMethod(m_worker, "start", Qt::QueuedConnection);
+}
+
+CommandSource::~CommandSource() {
+    // The worker stops its process in its own destructor, on its own thread
+    m_worker->disconnect(this);
+    m_worker->deleteLater();
+}
+
+void CommandSource::onResult(const QStringList& lines, const QString& output, double value, bool hasValue) {
+    m_lastLine = lines.isEmpty() ? QString() : lines.last();
+    if (m_mode == Persistent) {
+        for (const QString& line : lines) emit lineReceived(line);
+    }
+    if (output != m_output) {
+        m_output = output;
+        emit outputChanged(m_output);
+    }
+    if (hasValue && (!m_hasValue || value != m_value)) {
+        m_value = value;
+        m_hasValue = true;
+        emit valueChanged(m_value);
+    }
+}
+
+std::shared_ptr<CommandSource> commandSource(const QString& command, int intervalMs) {
+    return std::shared_ptr<CommandSource>(CommandSource::acquire(command, CommandSource::Interval, intervalMs),
+                                          &CommandSource::release);
+}
+
+} // namespace Milk
@@ -0,0 +1,64 @@
+/**
+ * MilkWidgetCore - Command Source Worker (private)
+ *
+ * Owns the child process of one CommandSource. All workers live on a single
+ * runner thread, so the concurrency bookkeeping below needs no locking.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTimer>
+#include <atomic>
+
+#include "milk/APIs.h"
+
+namespace Milk {
+
+class CommandWorker : public QObject {
+    Q_OBJECT
+
+public:
+    CommandWorker(const QString& command, CommandSource::Mode mode, int intervalMs, const QString& pattern);
+    ~CommandWorker();
+
+    static std::atomic<int> s_maxConcurrent;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    /** Complete lines since the last result, the text they form, and the parsed value */
+    void result(const QStringList& lines, const QString& output, double value, bool hasValue);
+    void failed(const QString& message);
+
+private:
+    void tick();
+    void launch();
+    void onReadyRead();
+    void onFinished(int exitCode, QProcess::ExitStatus status);
+    void publish(const QStringList& lines, const QString& output);
+    static void startWaiting();
+
+    static int s_running;
+    static QList<CommandWorker*> s_waiting;
+
+    QString m_command;
+    CommandSource::Mode m_mode;
+    int m_interval;
+
+    QProcess* m_process = nullptr;
+    QTimer* m_timer = nullptr;
+    QTimer* m_killTimer = nullptr;
+    QByteArray m_buffer;
+    QRegularExpression m_pattern;
+    int m_restartDelay = 1000;
+    bool m_counted = false;
+    bool m_stopped = true;
+};
+
+} // namespace Milk
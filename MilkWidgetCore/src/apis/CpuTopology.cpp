@@ -0,0 +1,254 @@
+/**
+ * MilkWidgetCore - CPU Topology Implementation
+ *
+ * Discovery reads a few small sysfs files per CPU once. A round then
+ * parses the cpuN lines in place, pread()s one frequency file per CPU and
+ * folds both columns into the group sums; only the snapshot's own vectors
+ * are allocated.
+ */
+
+#include "apis/CpuTopology.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Milk {
+
+static QByteArray readSmallFile(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    return file.readAll().trimmed();
+}
+
+/** "0-3,8-11" as used by cpulist, online and the cpu_core/cpu_atom PMUs */
+static QVector<int> parseCpuList(const QByteArray& list) {
+    QVector<int> cpus;
+    for (const QByteArray& range : list.split(',')) {
+        int dash = range.indexOf('-');
+        bool ok1, ok2 = true;
+        int first = range.left(dash < 0 ? range.size() : dash).toInt(&ok1);
+        int last = dash < 0 ? first : range.mid(dash + 1).toInt(&ok2);
+        if (!ok1 || !ok2) continue;
+        for (int cpu = first; cpu <= last; ++cpu) cpus.append(cpu);
+    }
+    return cpus;
+}
+
+// ============================================================================
+// CPU TOPOLOGY
+// ============================================================================
+
+CpuTopology::CpuTopology(const QString& sysRoot)
+    : m_sysRoot(sysRoot)
+{
+    discover();
+}
+
+CpuTopology::~CpuTopology() {
+#ifdef Q_OS_LINUX
+    for (int fd : m_freqFd) {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+}
+
+void CpuTopology::discover() {
+    const QString cpuRoot = m_sysRoot + "/devices/system/cpu";
+
+    m_cpu = parseCpuList(readSmallFile(cpuRoot + "/online"));
+    if (m_cpu.isEmpty()) {
+        for (const QString& name : QDir(cpuRoot).entryList({"cpu[0-9]*"}, QDir::Dirs)) {
+            m_cpu.append(name.mid(3).toInt());
+        }
+    }
+    std::sort(m_cpu.begin(), m_cpu.end());
+    const int rows = m_cpu.size();
+    if (rows == 0) return;
+
+    m_rowOfCpu.fill(-1, m_cpu.last() + 1);
+    for (int row = 0; row < rows; ++row) m_rowOfCpu[m_cpu[row]] = row;
+
+    // Intel hybrid parts expose one PMU per core type; others may only
+    // differ in cpu_capacity (arm big.LITTLE)
+    m_type.fill(Unknown, rows);
+    QVector<int> performance = parseCpuList(readSmallFile(m_sysRoot + "/devices/cpu_core/cpus"));
+    QVector<int> efficiency = parseCpuList(readSmallFile(m_sysRoot + "/devices/cpu_atom/cpus"));
+    if (performance.isEmpty() || efficiency.isEmpty()) {
+        performance.clear();
+        efficiency.clear();
+        QVector<int> capacity(rows, 0);
+        int highest = 0;
+        for (int row = 0; row < rows; ++row) {
+            capacity[row] = readSmallFile(QString("%1/cpu%2/cpu_capacity").arg(cpuRoot).arg(m_cpu[row])).toInt();
+            highest = qMax(highest, capacity[row]);
+        }
+        for (int row = 0; row < rows; ++row) {
+            if (capacity[row] <= 0) continue;
+            (capacity[row] == highest ? performance : efficiency).append(m_cpu[row]);
+        }
+    }
+    m_hybrid = !performance.isEmpty() && !efficiency.isEmpty();
+    auto rowOf = [this](int cpu) { return cpu < m_rowOfCpu.size() ? m_rowOfCpu[cpu] : -1; };
+    if (m_hybrid) {
+        for (int cpu : performance) {
+            if (rowOf(cpu) >= 0) m_type[rowOf(cpu)] = Performance;
+        }
+        for (int cpu : efficiency) {
+            if (rowOf(cpu) >= 0) m_type[rowOf(cpu)] = Efficiency;
+        }
+    }
+
+    // NUMA nodes list their CPUs; machines without NUMA have no node directory
+    QVector<int> nodeOf(rows, 0);
+    QDir nodeRoot(m_sysRoot + "/devices/system/node");
+    QStringList nodeNames = nodeRoot.entryList({"node[0-9]*"}, QDir::Dirs);
+    for (const QString& name : nodeNames) {
+        int node = name.mid(4).toInt();
+        for (int cpu : parseCpuList(readSmallFile(nodeRoot.filePath(name + "/cpulist")))) {
+            if (rowOf(cpu) >= 0) nodeOf[rowOf(cpu)] = node;
+        }
+    }
+    m_nodeCount = qMax(1, nodeNames.size());
+
+    auto group = [this](const QString& name) {
+        int index = m_groups.indexOf(name);
+        if (index < 0) {
+            index = m_groups.size();
+            m_groups.append(name);
+        }
+        return index;
+    };
+
+    QSet<QPair<int, int>> physical;
+    QSet<int> packages;
+    m_core.resize(rows);
+    m_packageGroup.resize(rows);
+    m_nodeGroup.fill(-1, rows);
+    m_typeGroup.fill(-1, rows);
+    m_freqFd.fill(-1, rows);
+    for (int row = 0; row < rows; ++row) {
+        QString dir = QString("%1/cpu%2").arg(cpuRoot).arg(m_cpu[row]);
+        int package = readSmallFile(dir + "/topology/physical_package_id").toInt();
+        m_core[row] = readSmallFile(dir + "/topology/core_id").toInt();
+        physical.insert(qMakePair(package, m_core[row]));
+        packages.insert(package);
+
+        m_packageGroup[row] = group(QString("package%1").arg(package));
+        if (m_nodeCount > 1) m_nodeGroup[row] = group(QString("node%1").arg(nodeOf[row]));
+        if (m_type[row] == Performance) m_typeGroup[row] = group("performance");
+        else if (m_type[row] == Efficiency) m_typeGroup[row] = group("efficiency");
+
+#ifdef Q_OS_LINUX
+        m_freqFd[row] = ::open(QFile::encodeName(dir + "/cpufreq/scaling_cur_freq").constData(), O_RDONLY | O_CLOEXEC);
+#endif
+    }
+    m_physicalCount = physical.size();
+    m_packageCount = packages.size();
+
+    m_lastTotal.fill(0, rows);
+    m_lastIdle.fill(0, rows);
+    m_usage.fill(0, rows);
+    m_frequency.fill(0, rows);
+    m_groupCpus.fill(0, m_groups.size());
+    m_groupUsage.fill(0, m_groups.size());
+    m_groupFrequency.fill(0, m_groups.size());
+    m_groupFrequencyCpus.fill(0, m_groups.size());
+    for (int row = 0; row < rows; ++row) {
+        for (int g : {m_packageGroup[row], m_nodeGroup[row], m_typeGroup[row]}) {
+            if (g >= 0) ++m_groupCpus[g];
+        }
+    }
+}
+
+void CpuTopology::sample(const QByteArray& stat, SystemMonitor::Snapshot& snapshot) {
+    const int rows = m_cpu.size();
+    if (rows == 0) return;
+
+    // "cpuN user nice system idle iowait irq softirq ..."; the aggregate
+    // "cpu " line is the caller's
+    const char* p = stat.constData();
+    const char* end = p + stat.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+        if (!eol) eol = end;
+        if (eol - p > 3 && strncmp(p, "cpu", 3) == 0 && p[3] >= '0' && p[3] <= '9') {
+            char* field;
+            long cpu = strtol(p + 3, &field, 10);
+            int row = cpu < m_rowOfCpu.size() ? m_rowOfCpu[int(cpu)] : -1;
+            if (row >= 0) {
+                quint64 total = 0;
+                quint64 idle = 0;
+                for (int i = 0; i < 7; ++i) {
+                    quint64 value = strtoull(field, &field, 10);
+                    total += value;
+                    if (i == 3) idle = value;
+                }
+                // Idle time can step back (NO_HZ accounting, a CPU going
+                // offline); such a round keeps the previous usage
+                if (m_lastTotal[row] > 0 && total > m_lastTotal[row] && idle >= m_lastIdle[row] &&
+                    idle - m_lastIdle[row] <= total - m_lastTotal[row]) {
+                    quint64 totalDiff = total - m_lastTotal[row];
+                    quint64 idleDiff = idle - m_lastIdle[row];
+                    m_usage[row] = 100.0 * (totalDiff - idleDiff) / totalDiff;
+                }
+                m_lastTotal[row] = total;
+                m_lastIdle[row] = idle;
+            }
+        } else if (strncmp(p, "cpu", 3) != 0) {
+            break;  // The cpu lines come first
+        }
+        p = eol + 1;
+    }
+
+#ifdef Q_OS_LINUX
+    for (int row = 0; row < rows; ++row) {
+        int fd = m_freqFd[row];
+        if (fd < 0) continue;
+        ssize_t length = ::pread(fd, m_buffer, sizeof(m_buffer) - 1, 0);
+        if (length <= 0) continue;
+        m_buffer[length] = '\0';
+        m_frequency[row] = strtoull(m_buffer, nullptr, 10) / 1000.0;  // kHz to MHz
+    }
+#endif
+
+    std::fill(m_groupUsage.begin(), m_groupUsage.end(), 0.0);
+    std::fill(m_groupFrequency.begin(), m_groupFrequency.end(), 0.0);
+    std::fill(m_groupFrequencyCpus.begin(), m_groupFrequencyCpus.end(), 0);
+    for (int row = 0; row < rows; ++row) {
+        for (int g : {m_packageGroup[row], m_nodeGroup[row], m_typeGroup[row]}) {
+            if (g < 0) continue;
+            m_groupUsage[g] += m_usage[row];
+            if (m_frequency[row] > 0) {
+                m_groupFrequency[g] += m_frequency[row];
+                ++m_groupFrequencyCpus[g];
+            }
+        }
+    }
+
+    // Indexed by logical CPU id, which is what cpuCore(n) callers mean
+    snapshot.coreUsage.fill(0, m_rowOfCpu.size());
+    snapshot.coreFrequency.fill(0, m_rowOfCpu.size());
+    for (int row = 0; row < rows; ++row) {
+        snapshot.coreUsage[m_cpu[row]] = m_usage[row];
+        snapshot.coreFrequency[m_cpu[row]] = m_frequency[row];
+    }
+    snapshot.cpuGroups.resize(m_groups.size());
+    for (int g = 0; g < m_groups.size(); ++g) {
+        SystemMonitor::Snapshot::CpuGroup& out = snapshot.cpuGroups[g];
+        out.name = m_groups[g];
+        out.cpus = m_groupCpus[g];
+        out.usage = m_groupCpus[g] > 0 ? m_groupUsage[g] / m_groupCpus[g] : 0;
+        out.frequency = m_groupFrequencyCpus[g] > 0 ? m_groupFrequency[g] / m_groupFrequencyCpus[g] : 0;
+    }
+}
+
+} // namespace Milk
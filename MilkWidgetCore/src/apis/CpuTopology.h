@@ -0,0 +1,75 @@
+/**
+ * MilkWidgetCore - CPU Topology (private)
+ *
+ * Which package, NUMA node and core type every logical CPU belongs to,
+ * read once from sysfs, plus the per-CPU state sampling needs. Columns
+ * are kept as parallel arrays indexed by row so a round walks each one
+ * linearly; rows are in logical CPU order.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "milk/APIs.h"
+
+namespace Milk {
+
+class CpuTopology {
+public:
+    enum CoreType { Unknown = 0, Performance, Efficiency };
+
+    explicit CpuTopology(const QString& sysRoot = "/sys");
+    ~CpuTopology();
+
+    CpuTopology(const CpuTopology&) = delete;
+    CpuTopology& operator=(const CpuTopology&) = delete;
+
+    int size() const { return m_cpu.size(); }
+    int physicalCores() const { return m_physicalCount; }
+    int packages() const { return m_packageCount; }
+    int nodes() const { return m_nodeCount; }
+    bool hybrid() const { return m_hybrid; }
+
+    /**
+     * Per-CPU usage from the cpuN lines of /proc/stat (the whole file, as
+     * read for the aggregate line), current frequencies, and the package,
+     * node and core type groups, into snapshot.
+     */
+    void sample(const QByteArray& stat, SystemMonitor::Snapshot& snapshot);
+
+private:
+    void discover();
+
+    QString m_sysRoot;
+
+    // One entry per online logical CPU
+    QVector<int> m_cpu;
+    QVector<int> m_core;          // Core id within the package; SMT siblings share it
+    QVector<int> m_type;          // CoreType
+    QVector<int> m_packageGroup;  // Index into m_groups
+    QVector<int> m_nodeGroup;     // Index into m_groups, -1 on single-node hosts
+    QVector<int> m_typeGroup;     // Index into m_groups, -1 unless hybrid
+    QVector<int> m_freqFd;        // scaling_cur_freq, -1 without cpufreq
+    QVector<quint64> m_lastTotal;
+    QVector<quint64> m_lastIdle;
+    QVector<double> m_usage;
+    QVector<double> m_frequency;  // MHz
+
+    QVector<int> m_rowOfCpu;      // Logical CPU id to row, -1 when offline
+    QStringList m_groups;         // "package0", "node1", "performance", ...
+    QVector<int> m_groupCpus;
+    QVector<double> m_groupUsage;      // Scratch for one round
+    QVector<double> m_groupFrequency;
+    QVector<int> m_groupFrequencyCpus;
+    int m_physicalCount = 0;
+    int m_packageCount = 0;
+    int m_nodeCount = 0;
+    bool m_hybrid = false;
+    char m_buffer[64];
+};
+
+} // namespace Milk
@@ -0,0 +1,491 @@
+/**
+ * MilkWidgetCore - JSON/HTTP Data Source Implementation
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QCoreApplication>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <cstring>
+
+namespace Milk {
+
+// ============================================================================
+// JSON PATH SET
+// ============================================================================
+
+/**
+ * Compiled set of paths, stored as a trie of object keys and array indices.
+ * extract() walks the document once: subtrees with no trie node below them
+ * are skipped by bracket counting, scalars at path ends are decoded in place.
+ */
+class JsonPathSet {
+public:
+    /** Compile a path and return its slot, or -1 on a syntax error */
+    int add(const QString& path);
+    int slotCount() const { return m_slots; }
+
+    /** Fill out[slot] for every path present in the document */
+    bool extract(const char* begin, const char* end, QVector<QVariant>& out) const;
+
+private:
+    struct Node {
+        QHash<QByteArray, int> keys;
+        QHash<int, int> indices;
+        int slot = -1;
+    };
+    struct Cursor {
+        const char* p;
+        const char* end;
+        int depth = 0;
+    };
+
+    static const int MaxDepth = 256;
+
+    int keyChild(int node, const QByteArray& key);
+    int indexChild(int node, int index);
+    bool value(Cursor& c, int node, QVector<QVariant>& out) const;
+    static bool readString(Cursor& c, QByteArray* decoded);
+    static bool skipContainer(Cursor& c);
+    static QVariant decode(const char* begin, const char* end);
+
+    QVector<Node> m_nodes{Node()};
+    int m_slots = 0;
+};
+
+int JsonPathSet::keyChild(int node, const QByteArray& key) {
+    int child = m_nodes[node].keys.value(key, -1);
+    if (child < 0) {
+        child = m_nodes.size();
+        m_nodes.append(Node());
+        m_nodes[node].keys.insert(key, child);
+    }
+    return child;
+}
+
+int JsonPathSet::indexChild(int node, int index) {
+    int child = m_nodes[node].indices.value(index, -1);
+    if (child < 0) {
+        child = m_nodes.size();
+        m_nodes.append(Node());
+        m_nodes[node].indices.insert(index, child);
+    }
+    return child;
+}
+
+int JsonPathSet::add(const QString& path) {
+    // Grammar: [$] segment* where segment is  .key | key | [n] | ["key"]
+    QByteArray p = path.trimmed().toUtf8();
+    int i = p.startsWith('$') ? 1 : 0;
+    int node = 0;
+
+    while (i < p.size()) {
+        char ch = p[i];
+        if (ch == '.') {
+            i++;
+        } else if (ch == '[') {
+            int close = p.indexOf(']', i);
+            if (close < 0) return -1;
+            QByteArray inner = p.mid(i + 1, close - i - 1).trimmed();
+            if (inner.size() >= 2 && (inner[0] == '"' || inner[0] == '\'') && inner.endsWith(inner[0])) {
+                node = keyChild(node, inner.mid(1, inner.size() - 2));
+            } else {
+                bool ok = false;
+                int index = inner.toInt(&ok);
+                if (!ok || index < 0) return -1;
+                node = indexChild(node, index);
+            }
+            i = close + 1;
+        } else {
+            int j = i;
+            while (j < p.size() && p[j] != '.' && p[j] != '[') j++;
+            node = keyChild(node, p.mid(i, j - i));
+            i = j;
+        }
+    }
+
+    if (m_nodes[node].slot < 0) m_nodes[node].slot = m_slots++;
+    return m_nodes[node].slot;
+}
+
+static inline void skipWhitespace(const char*& p, const char* end) {
+    while (p < end && uchar(*p) <= ' ') p++;
+}
+
+bool JsonPathSet::readString(Cursor& c, QByteArray* decoded) {
+    if (c.p >= c.end || *c.p != '"') return false;
+    const char* start = ++c.p;
+    bool escaped = false;
+    while (c.p < c.end && *c.p != '"') {
+        if (*c.p == '\\') { escaped = true; c.p++; }
+        c.p++;
+    }
+    if (c.p >= c.end) return false;
+    if (decoded) {
+        if (!escaped) *decoded = QByteArray(start, int(c.p - start));
+        else *decoded = decode(start - 1, c.p + 1).toString().toUtf8();
+    }
+    c.p++;
+    return true;
+}
+
+bool JsonPathSet::skipContainer(Cursor& c) {
+    int depth = 0;
+    while (c.p < c.end) {
+        char ch = *c.p;
+        if (ch == '"') {
+            if (!readString(c, nullptr)) return false;
+            continue;
+        }
+        c.p++;
+        if (ch == '{' || ch == '[') depth++;
+        else if ((ch == '}' || ch == ']') && --depth == 0) return true;
+    }
+    return false;
+}
+
+QVariant JsonPathSet::decode(const char* begin, const char* end) {
+    int size = int(end - begin);
+    switch (*begin) {
+        case '"':
+            if (!memchr(begin, '\\', size_t(size))) return QString::fromUtf8(begin + 1, size - 2);
+            return QJsonDocument::fromJson("[" + QByteArray(begin, size) + "]").array().at(0).toString();
+        case 't': return true;
+        case 'f': return false;
+        case 'n': return QVariant::fromValue(nullptr);  // Present but empty; invalid means absent
+        case '{': case '[': return QJsonDocument::fromJson(QByteArray::fromRawData(begin, size)).toVariant();
+        default: {
+            bool ok = false;
+            double d = QByteArray(begin, size).toDouble(&ok);
+            return ok ? QVariant(d) : QVariant();
+        }
+    }
+}
+
+bool JsonPathSet::value(Cursor& c, int node, QVector<QVariant>& out) const {
+    skipWhitespace(c.p, c.end);
+    if (c.p >= c.end || ++c.depth > MaxDepth) return false;
+
+    const char* start = c.p;
+    const Node* n = node >= 0 ? &m_nodes[node] : nullptr;
+
+    if (*c.p == '{' || *c.p == '[') {
+        if (!n) {
+            if (!skipContainer(c)) return false;
+        } else if (*c.p == '{') {
+            c.p++; skipWhitespace(c.p, c.end);
+            if (c.p < c.end && *c.p == '}') {
+                c.p++;
+            } else {
+                QByteArray key;
+                for (;;) {
+                    skipWhitespace(c.p, c.end);
+                    if (!readString(c, n->keys.isEmpty() ? nullptr : &key)) return false;
+                    int child = n->keys.isEmpty() ? -1 : n->keys.value(key, -1);
+                    skipWhitespace(c.p, c.end);
+                    if (c.p >= c.end || *c.p != ':') return false;
+                    c.p++;
+                    if (!value(c, child, out)) return false;
+                    skipWhitespace(c.p, c.end);
+                    if (c.p >= c.end) return false;
+                    if (*c.p == ',') { c.p++; continue; }
+                    if (*c.p == '}') { c.p++; break; }
+                    return false;
+                }
+            }
+        } else {
+            c.p++; skipWhitespace(c.p, c.end);
+            if (c.p < c.end && *c.p == ']') {
+                c.p++;
+            } else {
+                for (int index = 0;; index++) {
+                    if (!value(c, n->indices.value(index, -1), out)) return false;
+                    skipWhitespace(c.p, c.end);
+                    if (c.p >= c.end) return false;
+                    if (*c.p == ',') { c.p++; continue; }
+                    if (*c.p == ']') { c.p++; break; }
+                    return false;
+                }
+            }
+        }
+    } else if (*c.p == '"') {
+        if (!readString(c, nullptr)) return false;
+    } else {
+        while (c.p < c.end && *c.p != ',' && *c.p != '}' && *c.p != ']' && uchar(*c.p) > ' ') c.p++;
+        if (c.p == start) return false;
+    }
+
+    c.depth--;
+    if (n && n->slot >= 0) out[n->slot] = decode(start, c.p);
+    return true;
+}
+
+bool JsonPathSet::extract(const char* begin, const char* end, QVector<QVariant>& out) const {
+    if (out.size() < m_slots) out.resize(m_slots);
+    Cursor c{begin, end};
+    return value(c, 0, out);
+}
+
+// ============================================================================
+// DATA SOURCE
+// ============================================================================
+
+QHash<QString, DataSource*> DataSource::s_shared;
+
+/** Largest response body, SSE line or SSE event kept in memory */
+static const int MaxDocumentBytes = 8 * 1024 * 1024;
+
+QNetworkAccessManager* DataSource::network() {
+    static QPointer<QNetworkAccessManager> manager;
+    if (!manager) {
+        manager = new QNetworkAccessManager(QCoreApplication::instance());
+    }
+    return manager;
+}
+
+DataSource* DataSource::shared(const QUrl& url) {
+    QString key = url.toString();
+    DataSource* source = s_shared.value(key);
+    if (!source) {
+        source = new DataSource(url);
+        s_shared.insert(key, source);
+    }
+    return source;
+}
+
+void DataSource::cleanup() {
+    // Taken out first: each destructor would otherwise edit the hash being walked
+    QHash<QString, DataSource*> sources;
+    sources.swap(s_shared);
+    qDeleteAll(sources);
+}
+
+DataSource::DataSource(const QUrl& url, QObject* parent)
+    : QObject(parent)
+    , m_url(url)
+    , m_timer(new QTimer(this))
+    , m_paths(new JsonPathSet)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::CoarseTimer);
+    connect(m_timer, &QTimer::timeout, this, &DataSource::request);
+}
+
+DataSource::~DataSource() {
+    stop();
+    // A shared source deleted by its owner must not be handed out again
+    auto it = s_shared.find(m_url.toString());
+    if (it != s_shared.end() && it.value() == this) s_shared.erase(it);
+}
+
+void DataSource::setMode(Mode mode) {
+    if (mode == m_mode) return;
+    m_mode = mode;
+    if (m_running) { stop(); start(); }
+}
+
+void DataSource::setInterval(int ms) { m_interval = qMax(10, ms); }
+
+void DataSource::setHeader(const QByteArray& name, const QByteArray& value) {
+    m_headers.append(qMakePair(name, value));
+}
+
+// ============================================================================
+// BINDING
+// ============================================================================
+
+bool DataSource::bind(const QString& path) {
+    if (m_slotByPath.contains(path)) return true;
+
+    int slot = m_paths->add(path);
+    if (slot < 0) {
+        emit error(QString("Invalid path: %1").arg(path));
+        return false;
+    }
+    m_slotByPath.insert(path, slot);
+    if (slot >= m_pathNames.size()) m_pathNames.append(path);
+    m_values.resize(m_paths->slotCount());
+    m_scratch.resize(m_paths->slotCount());
+    return true;
+}
+
+void DataSource::bind(const QString& path, std::function<void(const QVariant&)> callback) {
+    if (!bind(path) || !callback) return;
+    int slot = m_slotByPath.value(path);
+    if (m_values[slot].isValid()) callback(m_values[slot]);
+    m_callbacks.insert(slot, std::move(callback));
+    start();
+}
+
+QVariant DataSource::value(const QString& path) const {
+    int slot = m_slotByPath.value(path, -1);
+    return slot >= 0 ? m_values.value(slot) : QVariant();
+}
+
+// ============================================================================
+// TRANSPORT
+// ============================================================================
+
+void DataSource::start() {
+    if (m_running) return;
+    m_running = true;
+    m_failures = 0;
+    request();
+}
+
+void DataSource::stop() {
+    m_running = false;
+    m_timer->stop();
+    if (m_reply) {
+        m_reply->disconnect(this);
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+}
+
+void DataSource::request() {
+    if (!m_running || m_reply) return;  // A slow poll is never stacked
+
+    QNetworkRequest req(m_url);
+    req.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    for (const auto& header : m_headers) req.setRawHeader(header.first, header.second);
+
+    if (m_mode == EventStream) {
+        req.setRawHeader("Accept", "text/event-stream");
+        req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    } else {
+        req.setRawHeader("Accept", "application/json");
+        req.setTransferTimeout(m_mode == LongPoll ? 120000 : qMax(5000, m_interval * 2));
+    }
+
+    m_buffer.clear();
+    m_event.clear();
+    m_reply = network()->get(req);
+    if (m_mode == EventStream) {
+        connect(m_reply, &QNetworkReply::readyRead, this, &DataSource::onReadyRead);
+    } else {
+        // QNetworkReply buffers the whole body; refuse one nobody could render
+        connect(m_reply, &QNetworkReply::downloadProgress, this, [this](qint64 received, qint64 total) {
+            if (received > MaxDocumentBytes || total > MaxDocumentBytes) {
+                reset(QString("%1: response larger than %2 bytes").arg(m_url.toString()).arg(MaxDocumentBytes));
+            }
+        });
+    }
+    connect(m_reply, &QNetworkReply::finished, this, &DataSource::onFinished);
+}
+
+void DataSource::reset(const QString& message) {
+    QNetworkReply* reply = m_reply;
+    m_reply = nullptr;
+    if (reply) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+    // Give the memory back; a normal request reuses the capacity
+    m_buffer = QByteArray();
+    m_event = QByteArray();
+    m_failures++;
+    emit error(message);
+    scheduleNext();
+}
+
+void DataSource::onReadyRead() {
+    if (!m_reply) return;
+    m_buffer += m_reply->readAll();
+
+    // One event per blank line; consecutive "data:" lines are joined by '\n'
+    int pos = 0;
+    for (int nl; (nl = m_buffer.indexOf('\n', pos)) >= 0; pos = nl + 1) {
+        int len = nl - pos;
+        if (len > 0 && m_buffer[nl - 1] == '\r') len--;
+        const char* line = m_buffer.constData() + pos;
+
+        if (len == 0) {
+            if (!m_event.isEmpty()) process(m_event.constData(), m_event.size());
+            m_event.clear();
+        } else if (len >= 5 && memcmp(line, "data:", 5) == 0) {
+            int skip = (len > 5 && line[5] == ' ') ? 6 : 5;
+            if (!m_event.isEmpty()) m_event += '\n';
+            m_event.append(line + skip, len - skip);
+        }
+    }
+    m_buffer.remove(0, pos);
+
+    // A line or event that never ends would grow without bound: reconnect instead
+    if (m_buffer.size() > MaxDocumentBytes || m_event.size() > MaxDocumentBytes) {
+        reset(QString("%1: event larger than %2 bytes").arg(m_url.toString()).arg(MaxDocumentBytes));
+    }
+}
+
+void DataSource::onFinished() {
+    QNetworkReply* reply = m_reply;
+    if (!reply) return;
+    m_reply = nullptr;
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError) {
+        m_failures++;
+        emit error(QString("%1: %2").arg(m_url.toString(), reply->errorString()));
+    } else {
+        m_failures = 0;
+        if (m_mode != EventStream) {
+            m_buffer = reply->readAll();
+            process(m_buffer.constData(), m_buffer.size());
+        }
+    }
+    scheduleNext();
+}
+
+void DataSource::scheduleNext() {
+    if (!m_running) return;
+
+    // Long-poll and SSE reconnect at once; failures back off exponentially
+    int delay = m_mode == Poll ? m_interval : 0;
+    if (m_failures > 0) {
+        qint64 backoff = qint64(qMax(m_interval, 1000)) << qMin(m_failures - 1, 6);
+        delay = int(qMin<qint64>(backoff, qMax(60000, m_interval)));
+    }
+    m_timer->start(delay);
+}
+
+/** QVariant equality of nullptr differs between Qt versions; two nulls are always the same */
+static bool sameValue(const QVariant& a, const QVariant& b) {
+    const int nullType = qMetaTypeId<std::nullptr_t>();
+    if (a.userType() == nullType || b.userType() == nullType) return a.userType() == b.userType();
+    return a == b;
+}
+
+void DataSource::process(const char* data, int size) {
+    if (m_paths->slotCount() == 0) return;
+
+    for (QVariant& v : m_scratch) v = QVariant();
+    if (!m_paths->extract(data, data + size, m_scratch)) {
+        emit error(QString("Malformed JSON from %1").arg(m_url.toString()));
+        return;
+    }
+
+    bool changed = false;
+    for (int slot = 0; slot < m_scratch.size(); slot++) {
+        const QVariant& v = m_scratch[slot];
+        if (!v.isValid() || sameValue(v, m_values[slot])) continue;  // Invalid: not in this response
+        m_values[slot] = v;
+        changed = true;
+        emit valueChanged(m_pathNames[slot], v);
+        for (auto it = m_callbacks.constFind(slot); it != m_callbacks.constEnd() && it.key() == slot; ++it) {
+            it.value()(v);
+        }
+    }
+    if (changed) emit updated();
+}
+
+DataSource* dataSource(const QString& url) {
+    return DataSource::shared(QUrl(url));
+}
+
+} // namespace Milk
@@ -0,0 +1,359 @@
+/**
+ * MilkWidgetCore - GPU Collector Implementation
+ *
+ * A round is a handful of pread() calls on descriptors opened at
+ * discovery. Walking /proc for new DRM clients is the expensive part and
+ * only happens every DiscoveryRounds rounds.
+ */
+
+#include "apis/GpuCollector.h"
+
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Milk {
+
+namespace {
+
+struct Engine {
+    QByteArray name;   // "gfx", "render", "video", ...
+    quint64 ns = 0;    // Cumulative busy time; on a Card, this round's total
+    quint64 last = 0;  // ns of the previous round
+    int capacity = 1;  // Instances of the engine; busy time adds up across them
+};
+
+Engine& engine(QVector<Engine>& engines, const char* name, int length) {
+    for (Engine& e : engines) {
+        if (e.name.size() == length && memcmp(e.name.constData(), name, size_t(length)) == 0) return e;
+    }
+    engines.append(Engine());
+    engines.last().name = QByteArray(name, length);
+    return engines.last();
+}
+
+int openFile(const QString& path) {
+#ifdef Q_OS_LINUX
+    return ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+#else
+    Q_UNUSED(path)
+    return -1;
+#endif
+}
+
+void closeFile(int& fd) {
+#ifdef Q_OS_LINUX
+    if (fd >= 0) ::close(fd);
+#endif
+    fd = -1;
+}
+
+/** Whole file from offset 0, NUL-terminated; -1 when it is gone */
+int readFile(int fd, char* buffer, int size) {
+#ifdef Q_OS_LINUX
+    if (fd < 0) return -1;
+    ssize_t length = ::pread(fd, buffer, size_t(size - 1), 0);
+    if (length < 0) return -1;
+    buffer[length] = '\0';
+    return int(length);
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(buffer);
+    Q_UNUSED(size);
+    return -1;
+#endif
+}
+
+qint64 readNumber(int fd, char* buffer, int size) {
+    if (readFile(fd, buffer, size) <= 0) return -1;
+    return strtoll(buffer, nullptr, 10);
+}
+
+QByteArray readSmallFile(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    return file.readAll().trimmed();
+}
+
+QString vendorName(const QByteArray& pciId) {
+    QByteArray vendor = pciId.left(4).toUpper();
+    if (vendor == "1002" || vendor == "1022") return "AMD";
+    if (vendor == "10DE") return "NVIDIA";
+    if (vendor == "8086") return "Intel";
+    return QString();
+}
+
+} // namespace
+
+struct GpuCollector::Card {
+    QString name;
+    QString model;
+    QString driver;
+    QByteArray slot;  // PCI address, matches drm-pdev in fdinfo
+
+    int busyFd = -1;
+    int vramUsedFd = -1;
+    int vramTotalFd = -1;
+    int tempFd = -1;
+
+    QVector<Engine> round;  // Engine time of all clients this round
+    bool sawClients = false;
+
+    ~Card() {
+        closeFile(busyFd);
+        closeFile(vramUsedFd);
+        closeFile(vramTotalFd);
+        closeFile(tempFd);
+    }
+};
+
+struct GpuCollector::Client {
+    int fd = -1;       // /proc/<pid>/fdinfo/<fdNumber>
+    int pid = 0;
+    int fdNumber = 0;
+    QString name;
+    QByteArray id;     // drm-client-id
+    QByteArray slot;   // drm-pdev
+    int card = -1;
+
+    QVector<Engine> engines;
+    bool baseline = true;  // No previous round to difference against yet
+    double busy = 0;
+
+    ~Client() { closeFile(fd); }
+};
+
+// ============================================================================
+// GPU COLLECTOR
+// ============================================================================
+
+GpuCollector::GpuCollector(const QString& sysRoot, const QString& procRoot)
+    : m_sysRoot(sysRoot)
+    , m_procRoot(procRoot)
+{
+}
+
+GpuCollector::~GpuCollector() = default;
+
+void GpuCollector::discoverCards() {
+    // card0, card1, ...; connectors like card0-DP-1 live next to them
+    static const QRegularExpression cardName("^card\\d+$");
+    QDir drm(m_sysRoot + "/class/drm");
+    QStringList names = drm.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::System);
+    std::sort(names.begin(), names.end(), [](const QString& a, const QString& b) {
+        return a.size() != b.size() ? a.size() < b.size() : a < b;
+    });
+
+    for (const QString& name : names) {
+        if (!cardName.match(name).hasMatch()) continue;
+        QString device = drm.filePath(name + "/device");
+
+        std::unique_ptr<Card> card(new Card);
+        card->name = name;
+        QByteArray pciId;
+        for (const QByteArray& line : readSmallFile(device + "/uevent").split('\n')) {
+            if (line.startsWith("DRIVER=")) card->driver = QString::fromLatin1(line.mid(7));
+            else if (line.startsWith("PCI_ID=")) pciId = line.mid(7);
+            else if (line.startsWith("PCI_SLOT_NAME=")) card->slot = line.mid(14);
+        }
+
+        card->model = QString::fromUtf8(readSmallFile(device + "/product_name"));
+        if (card->model.isEmpty()) {
+            QString vendor = vendorName(pciId);
+            card->model = vendor.isEmpty() ? card->driver
+                                           : QString("%1 GPU [%2]").arg(vendor, QString::fromLatin1(pciId));
+        }
+
+        // amdgpu has all of these; other drivers only some, or none
+        card->busyFd = openFile(device + "/gpu_busy_percent");
+        card->vramUsedFd = openFile(device + "/mem_info_vram_used");
+        card->vramTotalFd = openFile(device + "/mem_info_vram_total");
+        QDir hwmon(device + "/hwmon");
+        QStringList monitors = hwmon.entryList({"hwmon*"}, QDir::Dirs | QDir::System, QDir::Name);
+        if (!monitors.isEmpty()) {
+            card->tempFd = openFile(hwmon.filePath(monitors.first() + "/temp1_input"));
+        }
+        m_cards.push_back(std::move(card));
+    }
+}
+
+bool GpuCollector::readClient(Client& client) {
+    int length = readFile(client.fd, m_buffer, int(sizeof(m_buffer)));
+    if (length <= 0) return false;  // Process exited or closed the descriptor
+
+    for (Engine& e : client.engines) {
+        e.last = e.ns;
+        e.ns = 0;
+        e.capacity = 1;
+    }
+
+    const char* id = nullptr;
+    for (char* line = m_buffer; *line;) {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        char* colon = strchr(line, ':');
+        if (colon && strncmp(line, "drm-", 4) == 0) {
+            const char* value = colon + 1;
+            while (*value == ' ' || *value == '\t') ++value;
+            const char* key = line + 4;
+            int keyLength = int(colon - key);
+
+            if (keyLength == 9 && strncmp(key, "client-id", 9) == 0) {
+                id = value;
+            } else if (keyLength == 4 && strncmp(key, "pdev", 4) == 0) {
+                if (client.slot.isEmpty()) client.slot = QByteArray(value);
+            } else if (strncmp(key, "engine-capacity-", 16) == 0) {
+                engine(client.engines, key + 16, keyLength - 16).capacity = qMax(1, atoi(value));
+            } else if (strncmp(key, "engine-", 7) == 0) {
+                engine(client.engines, key + 7, keyLength - 7).ns = strtoull(value, nullptr, 10);
+            }
+        }
+        line = next ? next : line + strlen(line);
+    }
+
+    if (!id) return false;
+    if (client.id.isEmpty()) {
+        client.id = QByteArray(id);
+    } else if (client.id != id) {
+        return false;  // The descriptor number was reused for another DRM file
+    }
+
+    client.busy = 0;
+    if (!client.baseline && m_elapsedNs > 0) {
+        Card* card = client.card >= 0 ? m_cards[size_t(client.card)].get() : nullptr;
+        for (const Engine& e : client.engines) {
+            quint64 delta = e.ns > e.last ? e.ns - e.last : 0;
+            client.busy = qMax(client.busy, 100.0 * delta / (double(m_elapsedNs) * e.capacity));
+            if (card) {
+                Engine& total = engine(card->round, e.name.constData(), e.name.size());
+                total.ns += delta;
+                total.capacity = e.capacity;
+                card->sawClients = true;
+            }
+        }
+    }
+    client.baseline = false;
+    return true;
+}
+
+void GpuCollector::discoverClients() {
+#ifdef Q_OS_LINUX
+    QDir proc(m_procRoot);
+    char target[256];
+    for (const QString& entry : proc.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        bool ok;
+        int pid = entry.toInt(&ok);
+        if (!ok) continue;
+
+        // Other users' descriptors are not readable; that is expected
+        QDir fds(proc.filePath(entry + "/fd"));
+        for (const QString& fdName : fds.entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot)) {
+            ssize_t length = ::readlink(QFile::encodeName(fds.filePath(fdName)).constData(), target, sizeof(target) - 1);
+            if (length <= 0) continue;
+            target[length] = '\0';
+            if (strncmp(target, "/dev/dri/", 9) != 0) continue;
+
+            int fdNumber = fdName.toInt();
+            bool known = std::any_of(m_clients.begin(), m_clients.end(), [&](const std::unique_ptr<Client>& c) {
+                return c->pid == pid && c->fdNumber == fdNumber;
+            });
+            if (known) continue;
+
+            std::unique_ptr<Client> client(new Client);
+            client->pid = pid;
+            client->fdNumber = fdNumber;
+            client->fd = openFile(proc.filePath(entry + "/fdinfo/" + fdName));
+            if (!readClient(*client)) continue;  // Kernels before 5.19 have no drm-client-id
+
+            // dup() and fork() share one DRM file; count it once
+            bool shared = std::any_of(m_clients.begin(), m_clients.end(), [&](const std::unique_ptr<Client>& c) {
+                return c->id == client->id && c->slot == client->slot;
+            });
+            if (shared) continue;
+
+            client->name = QString::fromLocal8Bit(readSmallFile(proc.filePath(entry + "/comm")));
+            for (size_t i = 0; i < m_cards.size(); ++i) {
+                if (m_cards[i]->slot == client->slot || (m_cards.size() == 1 && client->slot.isEmpty())) {
+                    client->card = int(i);
+                }
+            }
+            m_clients.push_back(std::move(client));
+        }
+    }
+#endif
+}
+
+void GpuCollector::sample(SystemMonitor::Snapshot& snapshot, qint64 nowNs) {
+    if (m_round == 0) {
+        discoverCards();
+    }
+    m_elapsedNs = m_lastNs > 0 ? nowNs - m_lastNs : 0;
+    m_lastNs = nowNs;
+
+    for (const auto& card : m_cards) {
+        for (Engine& e : card->round) e.ns = 0;
+        card->sawClients = false;
+    }
+
+    // Differencing existing clients first; new ones only get their baseline
+    m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                   [this](const std::unique_ptr<Client>& c) { return !readClient(*c); }),
+                    m_clients.end());
+    if (m_round % DiscoveryRounds == 0) {
+        discoverClients();
+    }
+    ++m_round;
+
+    for (const auto& card : m_cards) {
+        SystemMonitor::Snapshot::Gpu gpu;
+        gpu.card = card->name;
+        gpu.model = card->model;
+        gpu.driver = card->driver;
+
+        qint64 busy = readNumber(card->busyFd, m_buffer, int(sizeof(m_buffer)));
+        if (busy >= 0) {
+            gpu.busy = double(busy);
+        } else if (card->sawClients && m_elapsedNs > 0) {
+            // No busy counter (i915, xe, msm, ...): the busiest engine across all clients
+            gpu.busy = 0;
+            for (const Engine& e : card->round) {
+                gpu.busy = qMax(gpu.busy, 100.0 * e.ns / (double(m_elapsedNs) * e.capacity));
+            }
+            gpu.busy = qMin(gpu.busy, 100.0);
+        }
+        gpu.vramUsed = readNumber(card->vramUsedFd, m_buffer, int(sizeof(m_buffer)));
+        gpu.vramTotal = readNumber(card->vramTotalFd, m_buffer, int(sizeof(m_buffer)));
+        qint64 millidegrees = readNumber(card->tempFd, m_buffer, int(sizeof(m_buffer)));
+        if (millidegrees > 0) gpu.temperature = millidegrees / 1000.0;
+        snapshot.gpus.append(gpu);
+    }
+
+    // Several clients of one process on one card add up
+    for (const auto& client : m_clients) {
+        if (client->baseline || client->busy <= 0) continue;
+        QString card = client->card >= 0 ? m_cards[size_t(client->card)]->name : QString();
+        auto it = std::find_if(snapshot.gpuProcesses.begin(), snapshot.gpuProcesses.end(),
+                               [&](const SystemMonitor::Snapshot::GpuProcess& p) {
+                                   return p.pid == client->pid && p.card == card;
+                               });
+        if (it == snapshot.gpuProcesses.end()) {
+            SystemMonitor::Snapshot::GpuProcess process;
+            process.pid = client->pid;
+            process.name = client->name;
+            process.card = card;
+            snapshot.gpuProcesses.append(process);
+            it = snapshot.gpuProcesses.end() - 1;
+        }
+        it->busy = qMin(100.0, it->busy + client->busy);
+    }
+}
+
+} // namespace Milk
@@ -0,0 +1,55 @@
+/**
+ * MilkWidgetCore - GPU Collector (private)
+ *
+ * Vendor-neutral GPU metrics from the DRM sysfs class and the drm-*
+ * keys in /proc/<pid>/fdinfo. Files are opened once and re-read with
+ * pread(); engine times are turned into utilisation by differencing
+ * against the previous round. Both roots are parameters so the collector
+ * runs unchanged against a fixture tree.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+#include "milk/APIs.h"
+
+namespace Milk {
+
+class GpuCollector {
+public:
+    explicit GpuCollector(const QString& sysRoot = "/sys", const QString& procRoot = "/proc");
+    ~GpuCollector();
+
+    GpuCollector(const GpuCollector&) = delete;
+    GpuCollector& operator=(const GpuCollector&) = delete;
+
+    /** Fill snapshot.gpus and snapshot.gpuProcesses; nowNs is any monotonic clock */
+    void sample(SystemMonitor::Snapshot& snapshot, qint64 nowNs);
+
+    /** Rounds between walks of /proc for new DRM clients */
+    static const int DiscoveryRounds = 5;
+
+private:
+    struct Card;
+    struct Client;
+
+    void discoverCards();
+    void discoverClients();
+    bool readClient(Client& client);
+
+    QString m_sysRoot;
+    QString m_procRoot;
+    std::vector<std::unique_ptr<Card>> m_cards;
+    std::vector<std::unique_ptr<Client>> m_clients;
+    int m_round = 0;
+    qint64 m_lastNs = 0;
+    qint64 m_elapsedNs = 0;
+    char m_buffer[4096];
+};
+
+} // namespace Milk
@@ -0,0 +1,503 @@
+/**
+ * MilkWidgetCore - Media Player (MPRIS) Implementation
+ *
+ * Everything is driven by bus signals: players are discovered through
+ * NameOwnerChanged and tracked through PropertiesChanged/Seeked. MPRIS does
+ * not broadcast position, so it is extrapolated from the last known value
+ * and playback rate instead of being polled.
+ *
+ * The session bus comes from DBUS_SESSION_BUS_ADDRESS, so pointing that at
+ * a private bus with a fake player is enough to exercise this class.
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QThreadPool>
+#include <limits>
+
+#ifdef MILK_HAS_DBUS
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#endif
+
+namespace Milk {
+
+static const char* MprisPrefix = "org.mpris.MediaPlayer2.";
+static const char* MprisPath = "/org/mpris/MediaPlayer2";
+static const char* PlayerInterface = "org.mpris.MediaPlayer2.Player";
+static const char* PropertiesInterface = "org.freedesktop.DBus.Properties";
+
+static const int ArtCacheKb = 16 * 1024;
+static const int ArtMaxBytes = 8 * 1024 * 1024;
+
+#ifdef MILK_HAS_DBUS
+// Properties arrive as plain variants from GetAll but as QDBusArgument
+// wrappers from signals; unwrap both the same way.
+static QVariantMap toVariantMap(const QVariant& value) {
+    if (value.canConvert<QDBusArgument>()) {
+        return qdbus_cast<QVariantMap>(value.value<QDBusArgument>());
+    }
+    return value.toMap();
+}
+#endif
+
+static QString clockString(int seconds) {
+    seconds = qMax(0, seconds);
+    if (seconds >= 3600) {
+        return QString("%1:%2:%3").arg(seconds / 3600)
+            .arg((seconds % 3600) / 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+    }
+    return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+MediaPlayer* MediaPlayer::s_instance = nullptr;
+
+MediaPlayer* MediaPlayer::instance() {
+    if (!s_instance) {
+        s_instance = new MediaPlayer();
+    }
+    return s_instance;
+}
+
+void MediaPlayer::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+MediaPlayer::MediaPlayer(QObject* parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+    , m_artCache(ArtCacheKb)
+{
+    m_timer->setInterval(1000);
+    m_timer->setTimerType(Qt::CoarseTimer);
+    connect(m_timer, &QTimer::timeout, this, [this]() {
+        m_info.position = position();
+        emit positionChanged(m_info.position);
+    });
+
+#ifdef MILK_HAS_DBUS
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.isConnected()) {
+        log()->warning("MediaPlayer: no session bus");
+        return;
+    }
+
+    bus.connect("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus",
+                "NameOwnerChanged", this, SLOT(onNameOwnerChanged(QString,QString,QString)));
+
+    // Players already running before us; later ones arrive via NameOwnerChanged
+    QDBusMessage call = QDBusMessage::createMethodCall("org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                                       "org.freedesktop.DBus", "ListNames");
+    auto* watcher = new QDBusPendingCallWatcher(bus.asyncCall(call), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher* w) {
+        QDBusPendingReply<QStringList> reply = *w;
+        w->deleteLater();
+        if (reply.isError()) return;
+        for (const QString& name : reply.value()) {
+            if (name.startsWith(MprisPrefix) && !m_players.contains(name.mid(int(strlen(MprisPrefix))))) {
+                m_players.append(name.mid(int(strlen(MprisPrefix))));
+            }
+        }
+        if (m_playerName.isEmpty()) pickPlayer();
+    });
+#endif
+}
+
+MediaPlayer::~MediaPlayer() {
+    disconnectFromPlayer();
+}
+
+// ============================================================================
+// PLAYER TRACKING
+// ============================================================================
+
+void MediaPlayer::onNameOwnerChanged(const QString& name, const QString& oldOwner, const QString& newOwner) {
+    Q_UNUSED(oldOwner)
+    if (!name.startsWith(MprisPrefix)) return;
+    QString player = name.mid(int(strlen(MprisPrefix)));
+
+    if (newOwner.isEmpty()) {
+        m_players.removeAll(player);
+        if (player == m_playerName) {
+            disconnectFromPlayer();
+            // A pinned player keeps its name and is picked up again if it returns
+            if (!m_pinned) m_playerName.clear();
+            m_info = MediaInfo();
+            m_status = "Stopped";
+            m_positionUs = m_lengthUs = 0;
+            m_trackId.clear();
+            m_art = QImage();
+            m_artSource.clear();
+            m_timer->stop();
+            emit playbackChanged(false);
+            emit trackChanged(QString(), QString());
+            emit updated();
+            if (!m_pinned) pickPlayer();
+        }
+        return;
+    }
+
+    if (!m_players.contains(player)) m_players.append(player);
+    if (m_pinned && player == m_playerName) connectToPlayer();
+    else if (m_playerName.isEmpty()) pickPlayer();
+}
+
+void MediaPlayer::pickPlayer() {
+    if (m_players.isEmpty()) return;
+    m_playerName = m_players.first();
+    connectToPlayer();
+}
+
+void MediaPlayer::connectToPlayer() {
+#ifdef MILK_HAS_DBUS
+    if (m_playerName.isEmpty()) return;
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QString service = MprisPrefix + m_playerName;
+    bus.connect(service, MprisPath, PropertiesInterface, "PropertiesChanged",
+                this, SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+    bus.connect(service, MprisPath, PlayerInterface, "Seeked", this, SLOT(onSeeked(qlonglong)));
+    updateMediaInfo();
+#endif
+}
+
+void MediaPlayer::disconnectFromPlayer() {
+#ifdef MILK_HAS_DBUS
+    if (m_playerName.isEmpty()) return;
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QString service = MprisPrefix + m_playerName;
+    bus.disconnect(service, MprisPath, PropertiesInterface, "PropertiesChanged",
+                   this, SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+    bus.disconnect(service, MprisPath, PlayerInterface, "Seeked", this, SLOT(onSeeked(qlonglong)));
+#endif
+}
+
+void MediaPlayer::updateMediaInfo() {
+#ifdef MILK_HAS_DBUS
+    // One full snapshot per player switch; signals keep it current afterwards
+    QDBusMessage call = QDBusMessage::createMethodCall(MprisPrefix + m_playerName, MprisPath,
+                                                       PropertiesInterface, "GetAll");
+    call << QString(PlayerInterface);
+    QString player = m_playerName;
+    auto* watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, player](QDBusPendingCallWatcher* w) {
+        QDBusPendingReply<QVariantMap> reply = *w;
+        w->deleteLater();
+        if (player != m_playerName) return;  // Switched away while waiting
+        if (reply.isError()) {
+            log()->warning(QString("MediaPlayer: %1: %2").arg(player, reply.error().message()));
+            return;
+        }
+        applyProperties(reply.value());
+    });
+#endif
+}
+
+void MediaPlayer::onPropertiesChanged(const QString& interface, const QVariantMap& changed,
+                                      const QStringList& invalidated) {
+    if (interface != PlayerInterface) return;
+    // Players may announce a change without its value; fetch the lot once
+    if (!invalidated.isEmpty()) updateMediaInfo();
+    applyProperties(changed);
+}
+
+void MediaPlayer::onSeeked(qlonglong position) {
+    m_positionUs = position;
+    m_positionClock.restart();
+    m_info.position = this->position();
+    emit positionChanged(m_info.position);
+}
+
+void MediaPlayer::applyProperties(const QVariantMap& properties) {
+#ifdef MILK_HAS_DBUS
+    bool changed = false;
+
+    // Fold elapsed time in before rate or status changes alter the slope
+    if (properties.contains("Rate") || properties.contains("PlaybackStatus")) {
+        m_positionUs = positionUs();
+        m_positionClock.restart();
+    }
+    if (properties.contains("Rate")) {
+        m_rate = properties.value("Rate").toDouble();
+    }
+    if (properties.contains("Metadata")) {
+        applyMetadata(toVariantMap(properties.value("Metadata")));
+        changed = true;
+    }
+    if (properties.contains("Position")) {
+        m_positionUs = properties.value("Position").toLongLong();
+        m_positionClock.restart();
+        changed = true;
+    }
+    if (properties.contains("PlaybackStatus")) {
+        setPlaybackStatus(properties.value("PlaybackStatus").toString());
+        changed = true;
+    }
+    if (properties.contains("Volume")) {
+        double volume = properties.value("Volume").toDouble();
+        if (!qFuzzyCompare(volume + 1.0, m_info.volume + 1.0)) {
+            m_info.volume = volume;
+            emit volumeChanged(volume);
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        m_info.position = position();
+        emit updated();
+    }
+#else
+    Q_UNUSED(properties)
+#endif
+}
+
+void MediaPlayer::applyMetadata(const QVariantMap& metadata) {
+#ifdef MILK_HAS_DBUS
+    QString trackId;
+    QVariant id = metadata.value("mpris:trackid");
+    if (id.canConvert<QDBusObjectPath>()) trackId = id.value<QDBusObjectPath>().path();
+    else trackId = id.toString();
+
+    QString title = metadata.value("xesam:title").toString();
+    QString artist = metadata.value("xesam:artist").toStringList().join(", ");
+    bool newTrack = trackId != m_trackId || title != m_info.title || artist != m_info.artist;
+
+    m_trackId = trackId;
+    m_info.title = title;
+    m_info.artist = artist;
+    m_info.album = metadata.value("xesam:album").toString();
+    m_lengthUs = metadata.value("mpris:length").toLongLong();
+    m_info.duration = int(m_lengthUs / 1000000);
+
+    if (newTrack) {
+        // Position is not re-sent with the new track; it starts over
+        m_positionUs = 0;
+        m_positionClock.restart();
+        emit trackChanged(m_info.title, m_info.artist);
+    }
+
+    QString art = metadata.value("mpris:artUrl").toString();
+    if (art != m_info.artUrl) {
+        m_info.artUrl = art;
+        fetchArt(art);
+    }
+#else
+    Q_UNUSED(metadata)
+#endif
+}
+
+void MediaPlayer::setPlaybackStatus(const QString& status) {
+    if (status == m_status) return;
+    m_status = status;
+    m_info.playing = status == "Playing";
+    if (m_info.playing) m_timer->start();
+    else m_timer->stop();
+    emit playbackChanged(m_info.playing);
+}
+
+qint64 MediaPlayer::positionUs() const {
+    qint64 position = m_positionUs;
+    if (m_info.playing && m_positionClock.isValid()) {
+        position += qint64(m_positionClock.elapsed() * 1000.0 * m_rate);
+    }
+    if (m_lengthUs > 0) position = qMin(position, m_lengthUs);
+    return qMax<qint64>(0, position);
+}
+
+// ============================================================================
+// ALBUM ART
+// ============================================================================
+
+void MediaPlayer::fetchArt(const QString& url) {
+    m_artSource = url;
+    if (url.isEmpty()) {
+        m_art = QImage();
+        return;
+    }
+    if (QImage* cached = m_artCache.object(url)) {
+        m_art = *cached;
+        return;
+    }
+    m_art = QImage();
+
+    // Decoded off the GUI thread; only the finished image comes back
+    auto finish = [this, url](const QImage& image) {
+        if (image.isNull()) return;
+        m_artCache.insert(url, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+        if (url != m_artSource) return;  // Track changed while loading
+        m_art = image;
+        emit updated();
+    };
+    auto decode = [this, finish](const QByteArray& data) {
+        QPointer<MediaPlayer> self(this);
+        QThreadPool::globalInstance()->start([self, finish, data]() {
+            QImage image = QImage::fromData(data);
+            if (self) QMetaObject::invokeMethod(self, [finish, image]() { finish(image); }, Qt::QueuedConnection);
+        });
+    };
+
+    QUrl source(url);
+    if (source.isLocalFile()) {
+        QString path = source.toLocalFile();
+        QPointer<MediaPlayer> self(this);
+        QThreadPool::globalInstance()->start([self, finish, path]() {
+            QImage image(path);
+            if (self) QMetaObject::invokeMethod(self, [finish, image]() { finish(image); }, Qt::QueuedConnection);
+        });
+        return;
+    }
+    if (source.scheme() != "http" && source.scheme() != "https") return;
+
+    // Oversized art is abandoned, not truncated: the announced length is
+    // checked first, the bytes actually received cover a missing or wrong one
+    QNetworkReply* reply = DataSource::network()->get(QNetworkRequest(source));
+    auto tooLarge = [reply](qint64 size) {
+        if (size <= ArtMaxBytes) return false;
+        log()->warning(QString("MediaPlayer: album art over %1 bytes: %2").arg(ArtMaxBytes).arg(reply->url().toString()));
+        reply->abort();
+        return true;
+    };
+    connect(reply, &QNetworkReply::metaDataChanged, reply, [reply, tooLarge]() {
+        tooLarge(reply->header(QNetworkRequest::ContentLengthHeader).toLongLong());
+    });
+    connect(reply, &QNetworkReply::downloadProgress, reply, [tooLarge](qint64 received, qint64) {
+        tooLarge(received);
+    });
+    connect(reply, &QNetworkReply::finished, this, [reply, decode, tooLarge]() {
+        reply->deleteLater();
+        if (reply->error() != QNetworkReply::NoError) return;  // Including an abort above
+        if (tooLarge(reply->bytesAvailable())) return;
+        QByteArray data = reply->readAll();
+        if (!data.isEmpty()) decode(data);
+    });
+}
+
+QImage MediaPlayer::artImage() { return m_art; }
+
+// ============================================================================
+// GETTERS
+// ============================================================================
+
+QString MediaPlayer::title() { return m_info.title; }
+QString MediaPlayer::artist() { return m_info.artist; }
+QString MediaPlayer::album() { return m_info.album; }
+QString MediaPlayer::artUrl() { return m_info.artUrl; }
+int MediaPlayer::duration() { return m_info.duration; }
+int MediaPlayer::position() { return int(positionUs() / 1000000); }
+double MediaPlayer::progress() { return m_lengthUs > 0 ? double(positionUs()) / m_lengthUs : 0.0; }
+QString MediaPlayer::durationStr() { return clockString(duration()); }
+QString MediaPlayer::positionStr() { return clockString(position()); }
+bool MediaPlayer::isPlaying() { return m_status == "Playing"; }
+bool MediaPlayer::isPaused() { return m_status == "Paused"; }
+bool MediaPlayer::isStopped() { return m_status == "Stopped"; }
+double MediaPlayer::volume() { return m_info.volume; }
+bool MediaPlayer::isMuted() { return m_info.volume <= 0.0; }
+
+QString MediaPlayer::playerName() { return m_playerName; }
+QStringList MediaPlayer::availablePlayers() { return m_players; }
+
+void MediaPlayer::setPlayer(const QString& player) {
+    QString name = player.startsWith(MprisPrefix) ? player.mid(int(strlen(MprisPrefix))) : player;
+    m_pinned = !name.isEmpty();
+    if (name == m_playerName) return;
+
+    disconnectFromPlayer();
+    m_playerName = name;
+    m_info = MediaInfo();
+    m_status = "Stopped";
+    m_trackId.clear();
+    m_positionUs = m_lengthUs = 0;
+    m_art = QImage();
+    m_artSource.clear();
+    m_timer->stop();
+
+    if (name.isEmpty()) pickPlayer();
+    else if (m_players.contains(name)) connectToPlayer();
+    emit updated();
+}
+
+MediaInfo MediaPlayer::info() {
+    m_info.position = position();
+    return m_info;
+}
+
+// ============================================================================
+// CONTROLS
+// ============================================================================
+
+void MediaPlayer::callPlayer(const QString& method, const QVariantList& args) {
+#ifdef MILK_HAS_DBUS
+    if (m_playerName.isEmpty()) return;
+    QString interface = method == "Set" ? PropertiesInterface : PlayerInterface;
+    QDBusMessage call = QDBusMessage::createMethodCall(MprisPrefix + m_playerName, MprisPath, interface, method);
+    call.setArguments(args);
+    // State changes come back through PropertiesChanged, never from the reply
+    auto* watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [method](QDBusPendingCallWatcher* w) {
+        w->deleteLater();
+        if (w->isError()) log()->warning(QString("MediaPlayer: %1 failed: %2").arg(method, w->error().message()));
+    });
+#else
+    Q_UNUSED(method)
+    Q_UNUSED(args)
+#endif
+}
+
+void MediaPlayer::play() { callPlayer("Play"); }
+void MediaPlayer::pause() { callPlayer("Pause"); }
+void MediaPlayer::playPause() { callPlayer("PlayPause"); }
+void MediaPlayer::stop() { callPlayer("Stop"); }
+void MediaPlayer::next() { callPlayer("Next"); }
+void MediaPlayer::previous() { callPlayer("Previous"); }
+
+void MediaPlayer::seek(int position) {
+#ifdef MILK_HAS_DBUS
+    if (m_trackId.isEmpty()) return;
+    qint64 target = qBound<qint64>(0, qint64(position) * 1000000, m_lengthUs > 0 ? m_lengthUs : std::numeric_limits<qint64>::max());
+    callPlayer("SetPosition", {QVariant::fromValue(QDBusObjectPath(m_trackId)), QVariant::fromValue(qlonglong(target))});
+#else
+    Q_UNUSED(position)
+#endif
+}
+
+void MediaPlayer::seekPercent(double percent) {
+    seek(int(m_info.duration * qBound(0.0, percent, 1.0)));
+}
+
+void MediaPlayer::setVolume(double volume) {
+#ifdef MILK_HAS_DBUS
+    callPlayer("Set", {QString(PlayerInterface), QString("Volume"),
+                       QVariant::fromValue(QDBusVariant(qBound(0.0, volume, 1.0)))});
+#else
+    Q_UNUSED(volume)
+#endif
+}
+
+void MediaPlayer::mute() {
+    if (isMuted()) return;
+    m_unmutedVolume = m_info.volume;
+    setVolume(0.0);
+}
+
+void MediaPlayer::unmute() {
+    if (!isMuted()) return;
+    setVolume(m_unmutedVolume > 0.0 ? m_unmutedVolume : 1.0);
+}
+
+void MediaPlayer::toggleMute() {
+    if (isMuted()) unmute();
+    else mute();
+}
+
+MediaPlayer* media() {
+    return MediaPlayer::instance();
+}
+
+} // namespace Milk
@@ -0,0 +1,205 @@
+/**
+ * MilkWidgetCore - Meminfo Reader Implementation
+ */
+
+#include "apis/MemInfo.h"
+
+#include <QDir>
+#include <QFile>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Milk {
+
+using Memory = SystemMonitor::Snapshot::Memory;
+
+namespace {
+
+struct Key {
+    const char* name;
+    qint64 Memory::*field;
+};
+
+constexpr Key Keys[] = {
+    {"MemTotal", &Memory::total},
+    {"MemFree", &Memory::free},
+    {"MemAvailable", &Memory::available},
+    {"MemUsed", &Memory::used},
+    {"Buffers", &Memory::buffers},
+    {"Cached", &Memory::cached},
+    {"SwapCached", &Memory::swapCached},
+    {"Active", &Memory::active},
+    {"Inactive", &Memory::inactive},
+    {"Unevictable", &Memory::unevictable},
+    {"Mlocked", &Memory::mlocked},
+    {"SwapTotal", &Memory::swapTotal},
+    {"SwapFree", &Memory::swapFree},
+    {"Dirty", &Memory::dirty},
+    {"Writeback", &Memory::writeback},
+    {"AnonPages", &Memory::anonPages},
+    {"Mapped", &Memory::mapped},
+    {"FilePages", &Memory::filePages},
+    {"Shmem", &Memory::shmem},
+    {"KReclaimable", &Memory::kReclaimable},
+    {"Slab", &Memory::slab},
+    {"SReclaimable", &Memory::sReclaimable},
+    {"SUnreclaim", &Memory::sUnreclaim},
+    {"KernelStack", &Memory::kernelStack},
+    {"PageTables", &Memory::pageTables},
+    {"CommitLimit", &Memory::commitLimit},
+    {"Committed_AS", &Memory::committedAs},
+    {"VmallocUsed", &Memory::vmallocUsed},
+    {"AnonHugePages", &Memory::anonHugePages},
+    {"HugePages_Total", &Memory::hugePagesTotal},
+    {"HugePages_Free", &Memory::hugePagesFree},
+    {"HugePages_Rsvd", &Memory::hugePagesReserved},
+    {"HugePages_Surp", &Memory::hugePagesSurplus},
+    {"Hugepagesize", &Memory::hugePageSize},
+};
+constexpr int KeyCount = int(sizeof(Keys) / sizeof(Keys[0]));
+
+// FNV-1a with a seed picked so that the keys above land in distinct
+// slots; adding a key may need a new seed, which the static_assert below
+// insists on
+constexpr uint32_t Seed = 2166147777u;
+constexpr int SlotBits = 6;
+constexpr int SlotCount = 1 << SlotBits;
+
+constexpr int slotOf(const char* key, size_t length) {
+    uint32_t hash = Seed;
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ uint8_t(key[i])) * 16777619u;
+    return int(hash >> (32 - SlotBits));
+}
+
+constexpr size_t length(const char* s) {
+    size_t n = 0;
+    while (s[n]) ++n;
+    return n;
+}
+
+constexpr std::array<int8_t, SlotCount> buildSlots() {
+    std::array<int8_t, SlotCount> table{};
+    for (int i = 0; i < SlotCount; ++i) table[i] = -1;
+    for (int k = 0; k < KeyCount; ++k) {
+        int slot = slotOf(Keys[k].name, length(Keys[k].name));
+        if (table[slot] >= 0) return std::array<int8_t, SlotCount>{};  // Collision: all zero
+        table[slot] = int8_t(k);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, SlotCount> Slots = buildSlots();
+
+constexpr bool perfect() {
+    int used = 0;
+    for (int i = 0; i < SlotCount; ++i) used += Slots[i] >= 0;
+    return used == KeyCount;
+}
+static_assert(KeyCount < SlotCount && perfect(), "meminfo keys collide; pick another Seed");
+
+int readAll(int fd, char* buffer, int size) {
+#ifdef Q_OS_LINUX
+    if (fd < 0) return -1;
+    ssize_t n = ::pread(fd, buffer, size_t(size - 1), 0);
+    if (n < 0) return -1;
+    buffer[n] = '\0';
+    return int(n);
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(buffer);
+    Q_UNUSED(size);
+    return -1;
+#endif
+}
+
+int openFile(const QString& path) {
+#ifdef Q_OS_LINUX
+    return ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+#else
+    Q_UNUSED(path);
+    return -1;
+#endif
+}
+
+} // namespace
+
+int parseMemInfo(const char* text, Memory& memory) {
+    int found = 0;
+    for (const char* line = text; *line;) {
+        const char* eol = strchr(line, '\n');
+        if (!eol) eol = line + strlen(line);
+
+        // "Node 1 MemFree:   123 kB" in the per-node files
+        const char* key = line;
+        if (strncmp(key, "Node ", 5) == 0) {
+            key += 5;
+            while (key < eol && *key != ' ') ++key;
+            while (key < eol && *key == ' ') ++key;
+        }
+        const char* colon = static_cast<const char*>(memchr(key, ':', size_t(eol - key)));
+        if (colon) {
+            size_t keyLength = size_t(colon - key);
+            int index = Slots[size_t(slotOf(key, keyLength))];
+            const Key* match = index >= 0 ? &Keys[index] : nullptr;
+            if (match && length(match->name) == keyLength && memcmp(match->name, key, keyLength) == 0) {
+                char* unit;
+                qint64 value = strtoll(colon + 1, &unit, 10);
+                while (*unit == ' ') ++unit;
+                if (unit[0] == 'k' && unit[1] == 'B') value *= 1024;
+                memory.*(match->field) = value;
+                ++found;
+            }
+        }
+        line = *eol ? eol + 1 : eol;
+    }
+    return found;
+}
+
+// ============================================================================
+// MEMINFO READER
+// ============================================================================
+
+MemInfoReader::MemInfoReader(const QString& sysRoot, const QString& procRoot) {
+    m_fd = openFile(procRoot + "/meminfo");
+
+    QDir nodes(sysRoot + "/devices/system/node");
+    for (const QString& name : nodes.entryList({"node[0-9]*"}, QDir::Dirs)) {
+        int node = name.mid(4).toInt();
+        while (m_nodeFds.size() <= node) m_nodeFds.append(-1);
+        m_nodeFds[node] = openFile(nodes.filePath(name + "/meminfo"));
+    }
+}
+
+MemInfoReader::~MemInfoReader() {
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) ::close(m_fd);
+    for (int fd : m_nodeFds) {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+}
+
+bool MemInfoReader::read(SystemMonitor::Snapshot& snapshot) {
+    if (readAll(m_fd, m_buffer, int(sizeof(m_buffer))) <= 0) return false;
+    parseMemInfo(m_buffer, snapshot.memory);
+
+    snapshot.memoryNodes.resize(m_nodeFds.size());
+    for (int node = 0; node < m_nodeFds.size(); ++node) {
+        if (readAll(m_nodeFds[node], m_buffer, int(sizeof(m_buffer))) <= 0) continue;
+        Memory& memory = snapshot.memoryNodes[node];
+        parseMemInfo(m_buffer, memory);
+
+        // Nodes don't report MemAvailable; free plus what reclaim gets back cheaply
+        qint64 estimate = memory.free + memory.filePages - memory.shmem + memory.sReclaimable;
+        memory.available = qBound<qint64>(memory.free, estimate, memory.total);
+    }
+    return true;
+}
+
+} // namespace Milk
@@ -0,0 +1,42 @@
+/**
+ * MilkWidgetCore - Meminfo Reader (private)
+ *
+ * /proc/meminfo and the per-node meminfo files under sysfs, parsed in one
+ * pass each. Keys are looked up in a perfect hash table built at compile
+ * time, so a line costs one hash and at most one key comparison.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "milk/APIs.h"
+
+namespace Milk {
+
+/**
+ * Parse meminfo text into memory. Node files ("Node 0 MemTotal: ...") are
+ * accepted as well; fields missing from the text are left untouched.
+ * Returns the number of known keys found.
+ */
+int parseMemInfo(const char* text, SystemMonitor::Snapshot::Memory& memory);
+
+class MemInfoReader {
+public:
+    explicit MemInfoReader(const QString& sysRoot = "/sys", const QString& procRoot = "/proc");
+    ~MemInfoReader();
+
+    MemInfoReader(const MemInfoReader&) = delete;
+    MemInfoReader& operator=(const MemInfoReader&) = delete;
+
+    /** Fill snapshot.memory and snapshot.memoryNodes; false if /proc/meminfo is unreadable */
+    bool read(SystemMonitor::Snapshot& snapshot);
+
+private:
+    int m_fd = -1;
+    QVector<int> m_nodeFds;  // By node id; -1 for gaps
+    char m_buffer[8192];
+};
+
+} // namespace Milk
@@ -0,0 +1,123 @@
+/**
+ * MilkWidgetCore - Metric Registry Implementation
+ */
+
+#include "milk/APIs.h"
+
+#include <algorithm>
+
+namespace Milk {
+
+MetricRegistry* MetricRegistry::s_instance = nullptr;
+
+MetricRegistry* MetricRegistry::instance() {
+    if (!s_instance) {
+        s_instance = new MetricRegistry();
+    }
+    return s_instance;
+}
+
+void MetricRegistry::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+MetricRegistry::MetricRegistry(QObject* parent)
+    : QObject(parent)
+{
+}
+
+MetricRegistry::~MetricRegistry() = default;
+
+void MetricRegistry::set(const QString& name, double value) {
+    auto it = m_metrics.find(name);
+    if (it == m_metrics.end()) {
+        it = m_metrics.insert(name, Metric());
+        it->ring.resize(m_historySize);
+    }
+
+    Metric& metric = *it;
+    bool added = !metric.hasValue;
+    metric.hasValue = true;
+    metric.value = value;
+    if (!metric.ring.isEmpty()) {
+        metric.ring[metric.head] = value;
+        metric.head = (metric.head + 1) % metric.ring.size();
+        metric.count = qMin(metric.count + 1, metric.ring.size());
+    }
+
+    // Callbacks may bind or set other names, which can rehash m_metrics;
+    // work from a copy and never touch the reference after the first call
+    metric.bindings.erase(std::remove_if(metric.bindings.begin(), metric.bindings.end(),
+                                         [](const Binding& b) { return !b.context; }),
+                          metric.bindings.end());
+    const QVector<Binding> bindings = metric.bindings;
+
+    if (added) {
+        emit metricAdded(name);
+    }
+    for (const Binding& binding : bindings) {
+        if (binding.context) binding.callback(value);
+    }
+    emit valueChanged(name, value);
+}
+
+double MetricRegistry::value(const QString& name, double fallback) const {
+    auto it = m_metrics.constFind(name);
+    return it != m_metrics.constEnd() && it->hasValue ? it->value : fallback;
+}
+
+bool MetricRegistry::contains(const QString& name) const {
+    auto it = m_metrics.constFind(name);
+    return it != m_metrics.constEnd() && it->hasValue;
+}
+
+QStringList MetricRegistry::names() const {
+    QStringList names;
+    for (auto it = m_metrics.constBegin(); it != m_metrics.constEnd(); ++it) {
+        if (it->hasValue) names << it.key();
+    }
+    names.sort();
+    return names;
+}
+
+QVector<double> MetricRegistry::history(const QString& name) const {
+    QVector<double> values;
+    auto it = m_metrics.constFind(name);
+    if (it == m_metrics.constEnd() || it->count == 0) {
+        return values;
+    }
+    const Metric& metric = *it;
+    int size = metric.ring.size();
+    values.reserve(metric.count);
+    for (int i = metric.count; i > 0; --i) {
+        values.append(metric.ring[(metric.head - i + size) % size]);
+    }
+    return values;
+}
+
+void MetricRegistry::setHistorySize(int samples) {
+    m_historySize = qMax(0, samples);
+}
+
+void MetricRegistry::bind(const QString& name, QObject* context, std::function<void(double)> callback) {
+    if (!context || !callback) {
+        return;
+    }
+    auto it = m_metrics.find(name);
+    if (it == m_metrics.end()) {
+        // Bound before the first value: create the entry without a value
+        it = m_metrics.insert(name, Metric());
+        it->ring.resize(m_historySize);
+    }
+    it->bindings.append({context, callback});
+    if (it->hasValue) {
+        callback(it->value);
+    }
+}
+
+MetricRegistry* metricRegistry() {
+    return MetricRegistry::instance();
+}
+
+} // namespace Milk
@@ -0,0 +1,332 @@
+/**
+ * MilkWidgetCore - Metrics Exporter Implementation
+ *
+ * Minimal HTTP/1.0-style responder: one GET per connection, then close.
+ * That is all a Prometheus scrape or a curl needs.
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <cmath>
+#include <cstdio>
+
+namespace Milk {
+
+static const int MaxRequestBytes = 8192;
+static const char* ContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+// ============================================================================
+// FORMATTING
+// ============================================================================
+
+static void appendNumber(QByteArray& out, double value) {
+    // OpenMetrics spells these out; printf's nan/inf would fail a strict parser
+    if (std::isnan(value)) { out.append("NaN"); return; }
+    if (std::isinf(value)) { out.append(value > 0 ? "+Inf" : "-Inf"); return; }
+
+    // Formatted on the stack; QByteArray::number would allocate per sample
+    char digits[32];
+    int length = std::snprintf(digits, sizeof digits, "%.17g", value);
+    out.append(digits, length);
+}
+
+static void appendFamily(QByteArray& out, const char* name, const char* type, const char* help) {
+    out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+    out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+}
+
+static void appendLabelValue(QByteArray& out, const QString& value) {
+    for (char c : value.toUtf8()) {
+        if (c == '\\') out.append("\\\\");
+        else if (c == '"') out.append("\\\"");
+        else if (c == '\n') out.append("\\n");
+        else out.append(c);
+    }
+}
+
+static void appendSample(QByteArray& out, const char* name, double value) {
+    out.append(name).append(' ');
+    appendNumber(out, value);
+    out.append('\n');
+}
+
+static void appendSample(QByteArray& out, const char* name, const char* label, const QString& labelValue,
+                         double value) {
+    out.append(name).append('{').append(label).append("=\"");
+    appendLabelValue(out, labelValue);
+    out.append("\"} ");
+    appendNumber(out, value);
+    out.append('\n');
+}
+
+// ============================================================================
+// EXPORTER
+// ============================================================================
+
+MetricsExporter* MetricsExporter::s_instance = nullptr;
+
+MetricsExporter* MetricsExporter::instance() {
+    if (!s_instance) {
+        s_instance = new MetricsExporter();
+    }
+    return s_instance;
+}
+
+void MetricsExporter::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+MetricsExporter::MetricsExporter(QObject* parent)
+    : QObject(parent)
+{
+    m_buffer.reserve(16 * 1024);
+}
+
+MetricsExporter::~MetricsExporter() {
+    close();
+}
+
+bool MetricsExporter::listen(quint16 port) {
+    if (!m_tcp) {
+        m_tcp = new QTcpServer(this);
+        connect(m_tcp, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket* socket = m_tcp->nextPendingConnection()) accept(socket);
+        });
+    }
+    // Loopback only: this is a local agent, not a network service
+    if (!m_tcp->listen(QHostAddress::LocalHost, port)) {
+        QString message = QString("Metrics: cannot listen on 127.0.0.1:%1: %2").arg(port).arg(m_tcp->errorString());
+        log()->warning(message);
+        emit error(message);
+        return false;
+    }
+    SystemMonitor::instance();  // Make sure something is publishing snapshots
+    log()->info(QString("Metrics: serving http://127.0.0.1:%1/metrics").arg(m_tcp->serverPort()));
+    return true;
+}
+
+bool MetricsExporter::listenLocal(const QString& path) {
+    if (!m_local) {
+        m_local = new QLocalServer(this);
+        m_local->setSocketOptions(QLocalServer::UserAccessOption);
+        connect(m_local, &QLocalServer::newConnection, this, [this]() {
+            while (QLocalSocket* socket = m_local->nextPendingConnection()) accept(socket);
+        });
+    }
+    m_local->close();
+
+    // A stale socket file from a crashed run would make listen() fail, but
+    // only a stale one may be removed: a live exporter keeps its socket
+    QLocalSocket probe;
+    probe.connectToServer(path);
+    if (probe.waitForConnected(200)) {
+        QString message = QString("Metrics: another instance is listening on %1").arg(path);
+        log()->warning(message);
+        emit error(message);
+        return false;
+    }
+    QLocalServer::removeServer(path);
+    if (!m_local->listen(path)) {
+        QString message = QString("Metrics: cannot listen on %1: %2").arg(path, m_local->errorString());
+        log()->warning(message);
+        emit error(message);
+        return false;
+    }
+    SystemMonitor::instance();
+    log()->info(QString("Metrics: serving on %1").arg(m_local->fullServerName()));
+    return true;
+}
+
+void MetricsExporter::close() {
+    if (m_tcp) m_tcp->close();
+    if (m_local) m_local->close();
+}
+
+bool MetricsExporter::isListening() const {
+    return (m_tcp && m_tcp->isListening()) || (m_local && m_local->isListening());
+}
+
+quint16 MetricsExporter::port() const {
+    return m_tcp && m_tcp->isListening() ? m_tcp->serverPort() : 0;
+}
+
+void MetricsExporter::accept(QIODevice* socket) {
+    connect(socket, &QIODevice::readyRead, this, [this, socket]() { respond(socket); });
+    // Both socket types report closure as disconnected(); the old-style
+    // connect covers them without a cast per type
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    if (socket->bytesAvailable() > 0) respond(socket);
+}
+
+void MetricsExporter::respond(QIODevice* socket) {
+    if (socket->property("milk_answered").toBool()) {
+        socket->readAll();
+        return;
+    }
+
+    // Wait for the end of the headers; the body of a GET is empty
+    QByteArray request = socket->property("milk_request").toByteArray() + socket->readAll();
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+        if (request.size() > MaxRequestBytes) socket->close();
+        else socket->setProperty("milk_request", request);
+        return;
+    }
+    socket->setProperty("milk_answered", true);
+
+    QList<QByteArray> line = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray method = line.value(0);
+    QByteArray path = line.value(1);
+    int query = path.indexOf('?');
+    if (query >= 0) path.truncate(query);
+
+    QByteArray status = "200 OK";
+    QByteArray type = ContentType;
+    QByteArray body;
+    if (method != "GET" && method != "HEAD") {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+        body = "Only GET is supported\n";
+    } else if (path != "/metrics" && path != "/") {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "Metrics are at /metrics\n";
+    } else {
+        body = render();
+    }
+
+    QByteArray head = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+                      "\r\nContent-Length: " + QByteArray::number(body.size()) +
+                      "\r\nConnection: close\r\n\r\n";
+    socket->write(head);
+    if (method != "HEAD") socket->write(body);
+
+    if (auto* tcp = qobject_cast<QTcpSocket*>(socket)) tcp->disconnectFromHost();
+    else if (auto* local = qobject_cast<QLocalSocket*>(socket)) local->disconnectFromServer();
+}
+
+QByteArray MetricsExporter::render() {
+    std::shared_ptr<const SystemMonitor::Snapshot> snap = SystemMonitor::instance()->snapshot();
+    const SystemMonitor::Snapshot& s = *snap;
+
+    // resize(0) keeps the reserved capacity; clear() would free it
+    m_buffer.resize(0);
+    QByteArray& out = m_buffer;
+
+    appendFamily(out, "milk_cpu_usage_ratio", "gauge", "Share of CPU time not idle since the previous sample.");
+    appendSample(out, "milk_cpu_usage_ratio", s.cpuUsage / 100.0);
+
+    if (!s.cpuGroups.isEmpty()) {
+        appendFamily(out, "milk_cpu_group_usage_ratio", "gauge", "CPU usage by package, NUMA node and core type.");
+        for (const auto& group : s.cpuGroups) {
+            appendSample(out, "milk_cpu_group_usage_ratio", "group", group.name, group.usage / 100.0);
+        }
+        appendFamily(out, "milk_cpu_group_frequency_hertz", "gauge", "Mean current CPU frequency by group.");
+        for (const auto& group : s.cpuGroups) {
+            if (group.frequency > 0) appendSample(out, "milk_cpu_group_frequency_hertz", "group", group.name, group.frequency * 1e6);
+        }
+    }
+
+    appendFamily(out, "milk_load", "gauge", "Load average.");
+    appendSample(out, "milk_load", "period", "1m", s.load[0]);
+    appendSample(out, "milk_load", "period", "5m", s.load[1]);
+    appendSample(out, "milk_load", "period", "15m", s.load[2]);
+
+    appendFamily(out, "milk_memory_total_bytes", "gauge", "Physical memory.");
+    appendSample(out, "milk_memory_total_bytes", double(s.memoryTotal));
+    appendFamily(out, "milk_memory_available_bytes", "gauge", "Memory available without swapping.");
+    appendSample(out, "milk_memory_available_bytes", double(s.memoryAvailable));
+    appendFamily(out, "milk_swap_total_bytes", "gauge", "Swap space.");
+    appendSample(out, "milk_swap_total_bytes", double(s.swapTotal));
+    appendFamily(out, "milk_swap_free_bytes", "gauge", "Unused swap space.");
+    appendSample(out, "milk_swap_free_bytes", double(s.swapFree));
+
+    using Memory = SystemMonitor::Snapshot::Memory;
+    static const struct { const char* kind; qint64 Memory::*field; } breakdown[] = {
+        {"buffers", &Memory::buffers}, {"cached", &Memory::cached}, {"shmem", &Memory::shmem},
+        {"slab", &Memory::slab}, {"dirty", &Memory::dirty}, {"writeback", &Memory::writeback},
+        {"anon", &Memory::anonPages}, {"committed", &Memory::committedAs},
+    };
+    appendFamily(out, "milk_memory_bytes", "gauge", "Memory by /proc/meminfo category.");
+    for (const auto& entry : breakdown) {
+        appendSample(out, "milk_memory_bytes", "kind", entry.kind, double(s.memory.*entry.field));
+    }
+    if (!s.memoryNodes.isEmpty()) {
+        appendFamily(out, "milk_numa_memory_total_bytes", "gauge", "Physical memory per NUMA node.");
+        for (int node = 0; node < s.memoryNodes.size(); ++node) {
+            appendSample(out, "milk_numa_memory_total_bytes", "node", QString::number(node), double(s.memoryNodes[node].total));
+        }
+        appendFamily(out, "milk_numa_memory_available_bytes", "gauge", "Estimated available memory per NUMA node.");
+        for (int node = 0; node < s.memoryNodes.size(); ++node) {
+            appendSample(out, "milk_numa_memory_available_bytes", "node", QString::number(node), double(s.memoryNodes[node].available));
+        }
+    }
+
+    appendFamily(out, "milk_filesystem_size_bytes", "gauge", "Filesystem size.");
+    for (const auto& fs : s.filesystems) {
+        appendSample(out, "milk_filesystem_size_bytes", "mountpoint", fs.mountPoint, double(fs.total));
+    }
+    appendFamily(out, "milk_filesystem_free_bytes", "gauge", "Filesystem space available to users.");
+    for (const auto& fs : s.filesystems) {
+        appendSample(out, "milk_filesystem_free_bytes", "mountpoint", fs.mountPoint, double(fs.free));
+    }
+
+    appendFamily(out, "milk_network_receive_bytes", "counter", "Bytes received per interface.");
+    for (const auto& iface : s.interfaces) {
+        appendSample(out, "milk_network_receive_bytes_total", "interface", iface.name, double(iface.rxBytes));
+    }
+    appendFamily(out, "milk_network_transmit_bytes", "counter", "Bytes sent per interface.");
+    for (const auto& iface : s.interfaces) {
+        appendSample(out, "milk_network_transmit_bytes_total", "interface", iface.name, double(iface.txBytes));
+    }
+
+    if (!s.temperatures.isEmpty()) {
+        appendFamily(out, "milk_temperature_celsius", "gauge", "Sensor temperature.");
+        for (auto it = s.temperatures.constBegin(); it != s.temperatures.constEnd(); ++it) {
+            appendSample(out, "milk_temperature_celsius", "sensor", it.key(), it.value());
+        }
+    }
+
+    if (!s.gpus.isEmpty()) {
+        appendFamily(out, "milk_gpu_busy_ratio", "gauge", "Share of time the GPU was busy.");
+        for (const auto& gpu : s.gpus) {
+            if (gpu.busy >= 0) appendSample(out, "milk_gpu_busy_ratio", "card", gpu.card, gpu.busy / 100.0);
+        }
+        appendFamily(out, "milk_gpu_memory_used_bytes", "gauge", "Video memory in use.");
+        for (const auto& gpu : s.gpus) {
+            if (gpu.vramUsed >= 0) appendSample(out, "milk_gpu_memory_used_bytes", "card", gpu.card, double(gpu.vramUsed));
+        }
+        appendFamily(out, "milk_gpu_memory_total_bytes", "gauge", "Video memory.");
+        for (const auto& gpu : s.gpus) {
+            if (gpu.vramTotal >= 0) appendSample(out, "milk_gpu_memory_total_bytes", "card", gpu.card, double(gpu.vramTotal));
+        }
+    }
+
+    if (s.batteryPercent >= 0) {
+        appendFamily(out, "milk_battery_ratio", "gauge", "Battery charge.");
+        appendSample(out, "milk_battery_ratio", s.batteryPercent / 100.0);
+        appendFamily(out, "milk_battery_charging", "gauge", "1 while the battery is charging.");
+        appendSample(out, "milk_battery_charging", s.batteryCharging ? 1 : 0);
+    }
+
+    appendFamily(out, "milk_processes", "gauge", "Running processes.");
+    appendSample(out, "milk_processes", s.processes);
+    appendFamily(out, "milk_uptime_seconds", "gauge", "Time since boot.");
+    appendSample(out, "milk_uptime_seconds", s.uptime);
+    appendFamily(out, "milk_snapshot_timestamp_seconds", "gauge", "When the exported values were sampled.");
+    appendSample(out, "milk_snapshot_timestamp_seconds", s.timestamp / 1000.0);
+
+    out.append("# EOF\n");
+    return out;
+}
+
+MetricsExporter* metrics() {
+    return MetricsExporter::instance();
+}
+
+} // namespace Milk
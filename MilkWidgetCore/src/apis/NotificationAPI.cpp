@@ -0,0 +1,269 @@
+/**
+ * MilkWidgetCore - Notification API Implementation
+ *
+ * Talks to org.freedesktop.Notifications over the session bus connection
+ * Qt already holds open. notify-send is only used when there is no bus or
+ * no notification server on it, or when the server rejects a message.
+ * Whether there is a server is asked asynchronously and then followed
+ * with a service watcher, so nothing here blocks the GUI thread on the bus.
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QProcess>
+
+#ifdef MILK_HAS_DBUS
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#endif
+
+namespace Milk {
+
+static const char* NotifyService = "org.freedesktop.Notifications";
+static const char* NotifyPath = "/org/freedesktop/Notifications";
+static const char* NotifyInterface = "org.freedesktop.Notifications";
+static const int MaxDelayWindows = 4;  // Cap on how long a burst is held back
+
+NotificationAPI* NotificationAPI::s_instance = nullptr;
+
+NotificationAPI* NotificationAPI::instance() {
+    if (!s_instance) {
+        s_instance = new NotificationAPI();
+    }
+    return s_instance;
+}
+
+void NotificationAPI::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+NotificationAPI::NotificationAPI(QObject* parent)
+    : QObject(parent)
+    , m_flushTimer(new QTimer(this))
+{
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &NotificationAPI::flush);
+
+#ifdef MILK_HAS_DBUS
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    bus.connect(NotifyService, NotifyPath, NotifyInterface, "NotificationClosed",
+                this, SLOT(onNotificationClosed(uint,uint)));
+    bus.connect(NotifyService, NotifyPath, NotifyInterface, "ActionInvoked",
+                this, SLOT(onActionInvoked(uint,QString)));
+
+    // A server starting or stopping later is seen without asking again
+    auto* watcher = new QDBusServiceWatcher(NotifyService, bus, QDBusServiceWatcher::WatchForOwnerChange, this);
+    connect(watcher, &QDBusServiceWatcher::serviceOwnerChanged, this,
+            [this](const QString&, const QString&, const QString& owner) {
+        // Gone may still be activatable: probe again when next needed
+        if (!m_probing) m_serverState = owner.isEmpty() ? -1 : 1;
+    });
+#endif
+    // Usually answered long before the first notification
+    probeServer();
+}
+
+NotificationAPI::~NotificationAPI() {
+    // Anything still inside the coalesce window is sent, not dropped; a
+    // probe can no longer answer, so an unknown server means notify-send
+    if (m_pending.isEmpty()) return;
+    if (m_serverState < 0) m_serverState = 0;
+    flush();
+}
+
+// ============================================================================
+// SENDING
+// ============================================================================
+
+void NotificationAPI::notify(const QString& title, const QString& message) {
+    notify(title, message, m_defaultIcon, m_defaultTimeout, QString());
+}
+
+void NotificationAPI::notify(const QString& title, const QString& message, const QString& icon) {
+    notify(title, message, icon, m_defaultTimeout, QString());
+}
+
+void NotificationAPI::notify(const QString& title, const QString& message, int timeout) {
+    notify(title, message, m_defaultIcon, timeout, QString());
+}
+
+void NotificationAPI::notify(const QString& title, const QString& message, const QString& icon,
+                             int timeout, const QString& tag) {
+    m_history.append(Notification{title, message, icon, QDateTime::currentDateTime()});
+    if (m_history.size() > 100) m_history.removeFirst();
+
+    QString key = tag.isEmpty() ? title + '\n' + message : '#' + tag;
+    Pending& pending = m_pending[key];
+    if (pending.count == 0) m_pendingOrder.append(key);
+    pending.title = title;
+    pending.message = message;
+    pending.icon = icon;
+    pending.timeout = timeout;
+    pending.count++;
+
+    // Restarted by every notification, but never past the cap
+    if (!m_flushTimer->isActive()) m_burst.start();
+    qint64 left = qint64(m_coalesceWindow) * MaxDelayWindows - m_burst.elapsed();
+    m_flushTimer->start(int(qBound<qint64>(0, left, m_coalesceWindow)));
+}
+
+void NotificationAPI::flush() {
+    if (m_serverState < 0) {
+        probeServer();
+        if (m_serverState < 0) return;  // setServerState() flushes
+    }
+
+    QStringList order;
+    order.swap(m_pendingOrder);
+    QHash<QString, Pending> pending;
+    pending.swap(m_pending);
+
+    for (const QString& key : order) deliver(key, pending.value(key));
+}
+
+void NotificationAPI::probeServer() {
+#ifdef MILK_HAS_DBUS
+    if (m_probing) return;
+    QDBusConnectionInterface* bus = QDBusConnection::sessionBus().interface();
+    if (!QDBusConnection::sessionBus().isConnected() || !bus) {
+        m_serverState = 0;
+        return;
+    }
+
+    m_probing = true;
+    auto* owner = new QDBusPendingCallWatcher(bus->asyncCall("NameHasOwner", QString(NotifyService)), this);
+    connect(owner, &QDBusPendingCallWatcher::finished, this, [this, bus](QDBusPendingCallWatcher* w) {
+        QDBusPendingReply<bool> reply = *w;
+        w->deleteLater();
+        if (!reply.isError() && reply.value()) {
+            setServerState(1);
+            return;
+        }
+        // Activatable servers are not registered until first use
+        auto* activatable = new QDBusPendingCallWatcher(bus->asyncCall("ListActivatableNames"), this);
+        connect(activatable, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher* w) {
+            QDBusPendingReply<QStringList> reply = *w;
+            w->deleteLater();
+            setServerState(!reply.isError() && reply.value().contains(NotifyService) ? 1 : 0);
+        });
+    });
+#else
+    m_serverState = 0;
+#endif
+}
+
+void NotificationAPI::setServerState(int state) {
+    m_probing = false;
+    m_serverState = state;
+    // A burst held back for the answer goes out now, unless a newer one is still collecting
+    if (!m_pending.isEmpty() && !m_flushTimer->isActive()) flush();
+}
+
+static void notifySend(const QString& appName, const QString& icon, int timeout,
+                       const QString& title, const QString& body) {
+    QProcess::startDetached("notify-send", {
+        "-a", appName,
+        "-t", QString::number(timeout),
+        "-i", icon,
+        title, body
+    });
+}
+
+void NotificationAPI::deliver(const QString& key, const Pending& pending) {
+    QString body = pending.message;
+    if (pending.count > 1) body += QString(" (×%1)").arg(pending.count);
+
+    if (m_serverState != 1) {
+        notifySend(m_appName, pending.icon, pending.timeout, pending.title, body);
+        return;
+    }
+
+#ifdef MILK_HAS_DBUS
+    // Tagged notifications replace the bubble they showed last time
+    uint replaces = key.startsWith('#') ? m_serverIds.value(key, 0) : 0;
+
+    QDBusMessage call = QDBusMessage::createMethodCall(NotifyService, NotifyPath, NotifyInterface, "Notify");
+    call << m_appName << replaces << pending.icon << pending.title << body
+         << QStringList() << QVariantMap() << pending.timeout;
+
+    auto* watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [this, key, pending, body](QDBusPendingCallWatcher* w) {
+        QDBusPendingReply<uint> reply = *w;
+        w->deleteLater();
+        if (reply.isError()) {
+            // This message still goes out; the next one re-probes, since
+            // the server may have gone away
+            log()->warning(QString("Notification failed, using notify-send: %1").arg(reply.error().message()));
+            notifySend(m_appName, pending.icon, pending.timeout, pending.title, body);
+            m_serverIds.remove(key);
+            m_serverState = -1;
+            return;
+        }
+        m_ownIds.insert(reply.value());
+        if (key.startsWith('#')) m_serverIds.insert(key, reply.value());
+    });
+#else
+    Q_UNUSED(key)
+#endif
+}
+
+void NotificationAPI::close(const QString& tag) {
+    QString key = '#' + tag;
+    if (m_pending.remove(key)) m_pendingOrder.removeAll(key);
+
+    uint id = m_serverIds.take(key);
+    if (!id) return;
+#ifdef MILK_HAS_DBUS
+    QDBusMessage call = QDBusMessage::createMethodCall(NotifyService, NotifyPath, NotifyInterface, "CloseNotification");
+    call << id;
+    QDBusConnection::sessionBus().asyncCall(call);
+#endif
+}
+
+// ============================================================================
+// SERVER SIGNALS
+// ============================================================================
+
+void NotificationAPI::onNotificationClosed(uint id, uint reason) {
+    Q_UNUSED(reason)
+    // The signal is broadcast for every client's notifications
+    if (!m_ownIds.remove(id)) return;
+    for (auto it = m_serverIds.begin(); it != m_serverIds.end(); ++it) {
+        if (it.value() == id) {
+            // A closed bubble cannot be replaced; the next one starts fresh
+            m_serverIds.erase(it);
+            break;
+        }
+    }
+    emit notificationClosed(int(id));
+}
+
+void NotificationAPI::onActionInvoked(uint id, const QString& action) {
+    Q_UNUSED(action)
+    if (m_ownIds.contains(id)) emit notificationClicked(int(id));
+}
+
+// ============================================================================
+// OPTIONS
+// ============================================================================
+
+void NotificationAPI::setDefaultTimeout(int ms) { m_defaultTimeout = ms; }
+void NotificationAPI::setDefaultIcon(const QString& icon) { m_defaultIcon = icon; }
+void NotificationAPI::setAppName(const QString& name) { m_appName = name; }
+void NotificationAPI::setCoalesceWindow(int ms) { m_coalesceWindow = qMax(0, ms); }
+
+QList<NotificationAPI::Notification> NotificationAPI::history() { return m_history; }
+void NotificationAPI::clearHistory() { m_history.clear(); }
+
+NotificationAPI* notify() {
+    return NotificationAPI::instance();
+}
+
+} // namespace Milk
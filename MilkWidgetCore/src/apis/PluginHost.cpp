@@ -0,0 +1,286 @@
+/**
+ * MilkWidgetCore - Plugin Host Implementation
+ *
+ * Loading, describing and unloading happen on the GUI thread, where
+ * plugins may allocate. A sampling round takes the list of enabled
+ * plugins under m_mutex, then runs each one without any lock held,
+ * into its window of a round buffer, and times the call. The results
+ * and timings are committed to the slab under m_mutex again, copied into
+ * the published buffer and drained by the GUI thread.
+ */
+
+#include "milk/APIs.h"
+#include "milk/MetricPlugin.h"
+#include "milk/Utils.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QLibrary>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Milk {
+
+static const uint32_t MaxMetricsPerPlugin = 4096;
+static const int MaxStrikes = 3;          // Consecutive overruns before a plugin is disabled
+static const int HardOverrunFactor = 10;  // One round this far over the budget is enough
+
+static const double NoValue = std::numeric_limits<double>::quiet_NaN();
+
+struct PluginHost::Loaded {
+    std::unique_ptr<QLibrary> library;
+    const MilkPlugin* api = nullptr;
+    void* state = nullptr;
+
+    QString name;
+    QString path;
+    QStringList metrics;
+    int offset = 0;  // First slab slot
+    int count = 0;
+
+    // Sampler thread, under m_mutex
+    qint64 lastRunNs = 0;
+    int overruns = 0;
+    int strikes = 0;
+    bool disabled = false;
+    QString reason;
+};
+
+// ============================================================================
+// PLUGIN HOST
+// ============================================================================
+
+PluginHost* PluginHost::s_instance = nullptr;
+
+PluginHost* PluginHost::instance() {
+    if (!s_instance) {
+        s_instance = new PluginHost();
+        s_instance->attach();
+    }
+    return s_instance;
+}
+
+void PluginHost::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+PluginHost::PluginHost(QObject* parent)
+    : QObject(parent)
+{
+}
+
+PluginHost::~PluginHost() {
+    // Waits out a round the sampler may be running right now
+    if (SystemMonitor* monitor = m_attached ? SystemMonitor::s_instance : nullptr) {
+        QMutexLocker locker(&monitor->m_hookMutex);
+        monitor->m_plugins = nullptr;
+    }
+    QMutexLocker round(&m_roundMutex);
+    for (const auto& plugin : m_plugins) {
+        if (plugin->api->shutdown) plugin->api->shutdown(plugin->state);
+        plugin->library->unload();
+    }
+}
+
+void PluginHost::attach() {
+    SystemMonitor* monitor = SystemMonitor::instance();
+    QMutexLocker locker(&monitor->m_hookMutex);
+    monitor->m_plugins = this;
+    m_attached = true;
+}
+
+QString PluginHost::defaultDirectory() {
+    return File::join(File::dataDir(), "plugins");
+}
+
+bool PluginHost::load(const QString& path, QString* error) {
+    std::unique_ptr<QLibrary> library(new QLibrary(path));
+    auto fail = [&](const QString& message) {
+        log()->warning(QString("Plugin %1: %2").arg(path, message));
+        if (error) *error = message;
+        if (library->isLoaded()) library->unload();
+        return false;
+    };
+
+    if (!library->load()) {
+        return fail(library->errorString());
+    }
+    auto entry = reinterpret_cast<MilkPluginEntry>(library->resolve(MILK_PLUGIN_ENTRY));
+    if (!entry) {
+        return fail(QString("no %1() exported").arg(MILK_PLUGIN_ENTRY));
+    }
+    const MilkPlugin* api = entry();
+    if (!api || api->abi_version != MILK_PLUGIN_ABI_VERSION) {
+        return fail(QString("built for plugin ABI %1, this host speaks %2")
+                        .arg(api ? api->abi_version : 0).arg(MILK_PLUGIN_ABI_VERSION));
+    }
+    if (!api->name || !*api->name || !api->describe || !api->sample) {
+        return fail("name, describe() and sample() are required");
+    }
+
+    QString name = QString::fromUtf8(api->name);
+    for (const PluginInfo& existing : plugins()) {
+        if (existing.name == name) return fail(QString("a plugin named %1 is already loaded").arg(name));
+    }
+
+    void* state = nullptr;
+    if (api->init) {
+        const char* message = nullptr;
+        state = api->init(&message);
+        if (message) return fail(QString::fromUtf8(message));
+    }
+    uint32_t count = 0;
+    const MilkMetric* metrics = api->describe(state, &count);
+    if ((!metrics && count > 0) || count > MaxMetricsPerPlugin) {
+        if (api->shutdown) api->shutdown(state);
+        return fail(QString("describe() returned %1 metrics").arg(count));
+    }
+
+    std::unique_ptr<Loaded> loaded(new Loaded);
+    loaded->api = api;
+    loaded->state = state;
+    loaded->name = name;
+    loaded->path = path;
+    loaded->count = int(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        loaded->metrics << name + '.' + QString::fromUtf8(metrics[i].name);
+    }
+    QStringList names = loaded->metrics;
+    loaded->library = std::move(library);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        loaded->offset = int(m_slab.size());
+        m_slab.resize(m_slab.size() + count, NoValue);
+        QMutexLocker publish(&m_publishMutex);
+        m_published.resize(m_slab.size(), NoValue);
+        m_plugins.push_back(std::move(loaded));
+    }
+    m_names += names;
+
+    log()->info(QString("Plugin %1: %2 metrics from %3").arg(name).arg(count).arg(path));
+    return true;
+}
+
+int PluginHost::loadDirectory(const QString& directory) {
+    QDir dir(directory.isEmpty() ? defaultDirectory() : directory);
+    int loaded = 0;
+    for (const QString& file : dir.entryList(QDir::Files, QDir::Name)) {
+        QString path = dir.filePath(file);
+        if (QLibrary::isLibrary(path) && load(path)) ++loaded;
+    }
+    return loaded;
+}
+
+void PluginHost::setBudget(int microseconds) {
+    m_budgetNs = qint64(qMax(1, microseconds)) * 1000;
+}
+
+QVector<PluginHost::PluginInfo> PluginHost::plugins() const {
+    QMutexLocker locker(&m_mutex);
+    QVector<PluginInfo> infos;
+    for (const auto& plugin : m_plugins) {
+        PluginInfo info;
+        info.name = plugin->name;
+        info.path = plugin->path;
+        info.metrics = plugin->metrics;
+        for (int i = 0; i < plugin->count; ++i) info.values << m_slab[size_t(plugin->offset + i)];
+        info.lastRunNs = plugin->lastRunNs;
+        info.overruns = plugin->overruns;
+        info.disabled = plugin->disabled;
+        info.reason = plugin->reason;
+        infos << info;
+    }
+    return infos;
+}
+
+void PluginHost::sample() {
+    // One round at a time. load() and plugins() only wait for the short
+    // sections under m_mutex, never for a plugin.
+    QMutexLocker round(&m_roundMutex);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_running.clear();
+        for (const auto& plugin : m_plugins) {
+            if (!plugin->disabled) m_running.push_back(plugin.get());
+        }
+        m_round.resize(m_slab.size());
+    }
+    if (m_running.empty()) {
+        return;
+    }
+
+    // The list and capacities only grow, so after the first rounds this allocates nothing
+    m_runNs.resize(m_running.size());
+    QElapsedTimer timer;
+    for (size_t i = 0; i < m_running.size(); ++i) {
+        const Loaded* plugin = m_running[i];
+        double* values = m_round.data() + plugin->offset;
+        std::fill(values, values + plugin->count, NoValue);
+        timer.start();
+        int status = plugin->api->sample(plugin->state, values, uint32_t(plugin->count));
+        m_runNs[i] = timer.nsecsElapsed();
+        if (status != 0) {
+            std::fill(values, values + plugin->count, NoValue);
+        }
+    }
+
+    const qint64 budget = m_budgetNs;
+    QMutexLocker locker(&m_mutex);
+    for (size_t i = 0; i < m_running.size(); ++i) {
+        Loaded* plugin = m_running[i];
+        double* values = m_round.data() + plugin->offset;
+        plugin->lastRunNs = m_runNs[i];
+        if (plugin->lastRunNs <= budget) {
+            plugin->strikes = 0;
+        } else {
+            ++plugin->overruns;
+            if (++plugin->strikes >= MaxStrikes || plugin->lastRunNs >= budget * HardOverrunFactor) {
+                // Building these strings allocates, but only once per plugin
+                plugin->disabled = true;
+                plugin->reason = QString("took %1 us, budget is %2 us").arg(plugin->lastRunNs / 1000).arg(budget / 1000);
+                std::fill(values, values + plugin->count, NoValue);
+                QString name = plugin->name;
+                QString reason = plugin->reason;
+                QMetaObject::invokeMethod(this, [this, name, reason]() {
+                    log()->warning(QString("Plugin %1 disabled: %2").arg(name, reason));
+                    emit pluginDisabled(name, reason);
+                }, Qt::QueuedConnection);
+            }
+        }
+        std::copy(values, values + plugin->count, m_slab.begin() + plugin->offset);
+    }
+
+    {
+        QMutexLocker publish(&m_publishMutex);
+        std::copy(m_slab.begin(), m_slab.end(), m_published.begin());
+    }
+    locker.unlock();
+    // One delivery in flight at a time; a slow GUI thread just sees the latest round
+    if (!m_deliveryPending.exchange(true)) {
+        QMetaObject::invokeMethod(this, [this]() { deliver(); }, Qt::QueuedConnection);
+    }
+}
+
+void PluginHost::deliver() {
+    m_deliveryPending = false;
+    {
+        QMutexLocker publish(&m_publishMutex);
+        m_delivering = m_published;
+    }
+    MetricRegistry* registry = MetricRegistry::instance();
+    int count = qMin(int(m_delivering.size()), m_names.size());
+    for (int i = 0; i < count; ++i) {
+        double value = m_delivering[size_t(i)];
+        if (!std::isnan(value)) registry->set(m_names[i], value);
+    }
+}
+
+PluginHost* plugins() {
+    return PluginHost::instance();
+}
+
+} // namespace Milk
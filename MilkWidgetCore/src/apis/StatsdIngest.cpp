@@ -0,0 +1,556 @@
+/**
+ * MilkWidgetCore - StatsD Ingest Implementation
+ *
+ * One writer, one reader. The receiver thread owns inserts and updates;
+ * the GUI thread only reads published slots and drains the accumulators
+ * with exchanges. Nothing on either side takes a lock or allocates per
+ * message.
+ *
+ * The socket side uses recvmmsg() and pipe2(), so it is Linux only;
+ * elsewhere listen() reports that and fails, and nothing else runs.
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QFile>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QStandardPaths>
+#include <QThread>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Milk {
+
+static const int ReceiveBatch = 64;            // Datagrams per recvmmsg()
+static const int MaxDatagramBytes = 8192;      // Larger ones are truncated
+static const int ReceiveBufferBytes = 4 << 20; // Absorbs bursts while the thread is descheduled
+
+// ============================================================================
+// TABLE
+// ============================================================================
+
+static quint64 toBits(double value) {
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+static double fromBits(quint64 bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+/**
+ * Open-addressed table with a fixed capacity. The receiver fills in a
+ * slot and then publishes it by appending its index to the insertion
+ * order and bumping size with release semantics; the GUI thread only
+ * walks the first size() entries of that order.
+ */
+class StatsdTable {
+public:
+    static const int Capacity = 4096;                  // Power of two
+    static const int MaxNames = Capacity * 3 / 4;      // Keeps probe chains short
+    static const int MaxNameLength = 63;
+
+    enum Type : quint8 { Gauge, Counter, Timer };
+
+    struct Slot {
+        quint32 hash = 0;  // 0 = empty; receiver thread only
+        Type type = Gauge;
+        quint8 length = 0;
+        char name[MaxNameLength + 1] = {};
+        std::atomic<quint64> gauge{0};     // Latest value, as bits
+        std::atomic<quint64> sum{0};       // Counters: since the last drain; timers: total. As bits
+        std::atomic<quint32> count{0};     // Timers: samples in total
+        std::atomic<quint32> sequence{0};  // Bumped on every update; odd while a timer is written
+    };
+
+    /** Receiver thread: the slot for @p name, inserted on first sight */
+    Slot* find(const char* name, int length, Type type) {
+        quint32 hash = 2166136261u;
+        for (int i = 0; i < length; ++i) {
+            hash = (hash ^ quint8(name[i])) * 16777619u;
+        }
+        if (hash == 0) hash = 1;
+
+        for (quint32 index = hash & (Capacity - 1);; index = (index + 1) & (Capacity - 1)) {
+            Slot& slot = m_slots[index];
+            if (slot.hash == hash && slot.length == length && std::memcmp(slot.name, name, length) == 0) {
+                return &slot;
+            }
+            if (slot.hash == 0) {
+                int size = m_size.load(std::memory_order_relaxed);
+                if (size >= MaxNames) {
+                    return nullptr;
+                }
+                slot.hash = hash;
+                slot.type = type;
+                slot.length = quint8(length);
+                std::memcpy(slot.name, name, length);
+                slot.name[length] = '\0';
+                m_order[size] = int(index);
+                m_size.store(size + 1, std::memory_order_release);
+                return &slot;
+            }
+        }
+    }
+
+    int size() const { return m_size.load(std::memory_order_acquire); }
+    Slot& at(int order) { return m_slots[m_order[order]]; }
+
+    std::atomic<quint64> datagrams{0};
+    std::atomic<quint64> lines{0};
+    std::atomic<quint64> malformed{0};
+    std::atomic<quint64> dropped{0};
+
+private:
+    Slot m_slots[Capacity];
+    int m_order[MaxNames] = {};
+    std::atomic<int> m_size{0};
+};
+
+// ============================================================================
+// PARSING (receiver thread)
+// ============================================================================
+
+/**
+ * Decimal number with optional sign, fraction and exponent. strtod() is
+ * not used because it follows the C locale Qt installs, where the decimal
+ * separator may be a comma.
+ */
+static bool parseNumber(const char* p, const char* end, double* out) {
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        ++p;
+    }
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + quint64(*p - '0');
+        else ++exponent;
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + quint64(*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '+' || *p == '-')) {
+            negativeExponent = *p == '-';
+            ++p;
+        }
+        int value = 0;
+        if (p == end || *p < '0' || *p > '9') {
+            return false;
+        }
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            value = qMin(value * 10 + (*p - '0'), 1000);
+        }
+        exponent += negativeExponent ? -value : value;
+    }
+    if (p != end) {
+        return false;
+    }
+
+    double result = double(mantissa);
+    double scale = 10;
+    for (int e = exponent < 0 ? -exponent : exponent; e > 0; e >>= 1, scale *= scale) {
+        if (e & 1) result = exponent < 0 ? result / scale : result * scale;
+    }
+    *out = negative ? -result : result;
+    return true;
+}
+
+static void addTo(std::atomic<quint64>& target, double value) {
+    // The GUI thread may exchange the sum concurrently, so this cannot be a
+    // plain load and store even with a single writer
+    quint64 expected = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(expected, toBits(fromBits(expected) + value),
+                                         std::memory_order_relaxed)) {
+    }
+}
+
+/** One "name:value|type[|@rate][|#tags]" line */
+static void ingestLine(StatsdTable& table, const char* p, const char* end) {
+    table.lines.fetch_add(1, std::memory_order_relaxed);
+
+    const char* colon = static_cast<const char*>(std::memchr(p, ':', end - p));
+    const char* bar = colon ? static_cast<const char*>(std::memchr(colon, '|', end - colon)) : nullptr;
+    int nameLength = colon ? int(colon - p) : 0;
+    if (!bar || nameLength == 0 || nameLength > StatsdTable::MaxNameLength) {
+        table.malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const char* type = bar + 1;
+    const char* typeEnd = static_cast<const char*>(std::memchr(type, '|', end - type));
+    if (!typeEnd) typeEnd = end;
+    int typeLength = int(typeEnd - type);
+
+    StatsdTable::Type kind;
+    if (typeLength == 1 && *type == 'g') kind = StatsdTable::Gauge;
+    else if (typeLength == 1 && *type == 'c') kind = StatsdTable::Counter;
+    else if ((typeLength == 2 && type[0] == 'm' && type[1] == 's') || (typeLength == 1 && *type == 'h')) {
+        kind = StatsdTable::Timer;
+    } else {
+        table.malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    double value = 0;
+    if (!parseNumber(colon + 1, bar, &value)) {
+        table.malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    double sampleRate = 1;
+    if (typeEnd + 2 < end && typeEnd[1] == '@') {
+        const char* rateEnd = static_cast<const char*>(std::memchr(typeEnd + 2, '|', end - typeEnd - 2));
+        if (!parseNumber(typeEnd + 2, rateEnd ? rateEnd : end, &sampleRate) || sampleRate <= 0) {
+            sampleRate = 1;
+        }
+    }
+
+    StatsdTable::Slot* slot = table.find(p, nameLength, kind);
+    if (!slot) {
+        table.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // A name keeps the type it was first seen with
+    switch (slot->type) {
+    case StatsdTable::Gauge: {
+        bool delta = colon[1] == '+' || colon[1] == '-';
+        double current = fromBits(slot->gauge.load(std::memory_order_relaxed));
+        slot->gauge.store(toBits(delta ? current + value : value), std::memory_order_relaxed);
+        break;
+    }
+    case StatsdTable::Counter:
+        addTo(slot->sum, value / sampleRate);
+        break;
+    case StatsdTable::Timer: {
+        // Sum and count are one value to the reader: written under an odd
+        // sequence and never reset, so the GUI thread can take both or retry
+        quint32 sequence = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->sum.store(toBits(fromBits(slot->sum.load(std::memory_order_relaxed)) + value), std::memory_order_relaxed);
+        slot->count.store(slot->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        slot->sequence.store(sequence + 2, std::memory_order_release);
+        return;
+    }
+    }
+    slot->sequence.fetch_add(1, std::memory_order_release);
+}
+
+static void ingestDatagram(StatsdTable& table, const char* data, int size, bool truncated) {
+    table.datagrams.fetch_add(1, std::memory_order_relaxed);
+    const char* end = data + size;
+    if (truncated) {
+        // The cut-off tail is not a line
+        while (end > data && end[-1] != '\n') --end;
+        table.malformed.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (const char* p = data; p < end;) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = eol ? eol : end;
+        const char* trimmed = lineEnd;
+        if (trimmed > p && trimmed[-1] == '\r') --trimmed;
+        if (trimmed > p) ingestLine(table, p, trimmed);
+        p = lineEnd + 1;
+    }
+}
+
+// ============================================================================
+// INGEST
+// ============================================================================
+
+StatsdIngest* StatsdIngest::s_instance = nullptr;
+
+StatsdIngest* StatsdIngest::instance() {
+    if (!s_instance) {
+        s_instance = new StatsdIngest();
+    }
+    return s_instance;
+}
+
+void StatsdIngest::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+StatsdIngest::StatsdIngest(QObject* parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &StatsdIngest::deliver);
+
+    // Some virtual and headless screens report 0 Hz
+    int hz = 60;
+    if (QScreen* screen = QGuiApplication::primaryScreen()) {
+        if (screen->refreshRate() >= 1) hz = qRound(screen->refreshRate());
+    }
+    setDeliveryRate(hz);
+}
+
+StatsdIngest::~StatsdIngest() {
+    close();
+}
+
+QString StatsdIngest::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + "/milkwidget-statsd.sock";
+}
+
+void StatsdIngest::setPrefix(const QString& prefix) {
+    m_prefix = prefix;
+    m_names.clear();  // Rebuilt with the new prefix on the next delivery
+}
+
+void StatsdIngest::setDeliveryRate(int hz) {
+    m_timer->setInterval(1000 / qBound(1, hz, 240));
+}
+
+bool StatsdIngest::listen(const QString& path) {
+    close();
+    QString target = path.isEmpty() ? defaultPath() : path;
+    QByteArray encoded = QFile::encodeName(target);
+
+    auto fail = [this](const QString& message) {
+        log()->warning(message);
+        emit error(message);
+        return false;
+    };
+
+#ifdef Q_OS_LINUX
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (encoded.size() >= int(sizeof address.sun_path)) {
+        return fail(QString("StatsD: socket path too long: %1").arg(target));
+    }
+    std::memcpy(address.sun_path, encoded.constData(), encoded.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return fail(QString("StatsD: cannot create socket: %1").arg(std::strerror(errno)));
+    }
+
+    // A datagram socket nobody reads refuses connections; one that accepts
+    // belongs to a live instance and must not be unlinked
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0) {
+        ::close(fd);
+        return fail(QString("StatsD: another instance is listening on %1").arg(target));
+    }
+    ::close(fd);
+    ::unlink(encoded.constData());
+
+    fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0) {
+        QString reason = std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return fail(QString("StatsD: cannot listen on %1: %2").arg(target, reason));
+    }
+    ::chmod(encoded.constData(), S_IRUSR | S_IWUSR);
+    int bufferSize = ReceiveBufferBytes;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof bufferSize);
+
+    if (::pipe2(m_wake, O_CLOEXEC) != 0) {
+        ::close(fd);
+        return fail(QString("StatsD: cannot create wake pipe: %1").arg(std::strerror(errno)));
+    }
+
+    m_socket = fd;
+    m_path = target;
+    m_table = std::make_unique<StatsdTable>();
+    m_names.clear();
+    m_delivered.clear();
+    m_counts.clear();
+    m_timerSums.clear();
+    m_timerCounts.clear();
+    m_window.start();
+
+    m_thread = QThread::create([this]() { receive(); });
+    m_thread->setObjectName("milk-statsd");
+    m_thread->start();
+    m_timer->start();
+
+    log()->info(QString("StatsD: listening on %1").arg(target));
+    return true;
+#else
+    Q_UNUSED(encoded)
+    return fail(QString("StatsD: not supported on this platform, not listening on %1").arg(target));
+#endif
+}
+
+void StatsdIngest::close() {
+    if (!m_thread) {
+        return;
+    }
+#ifdef Q_OS_LINUX
+    m_timer->stop();
+    char byte = 0;
+    (void)::write(m_wake[1], &byte, 1);
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+
+    ::close(m_wake[0]);
+    ::close(m_wake[1]);
+    m_wake[0] = m_wake[1] = -1;
+    ::close(m_socket);
+    m_socket = -1;
+    ::unlink(QFile::encodeName(m_path).constData());
+    // The table stays so stats() still answers after close()
+#endif
+}
+
+void StatsdIngest::receive() {
+#ifdef Q_OS_LINUX
+    std::vector<char> buffers(size_t(ReceiveBatch) * MaxDatagramBytes);
+    mmsghdr messages[ReceiveBatch];
+    iovec vectors[ReceiveBatch];
+    for (int i = 0; i < ReceiveBatch; ++i) {
+        vectors[i].iov_base = buffers.data() + size_t(i) * MaxDatagramBytes;
+        vectors[i].iov_len = MaxDatagramBytes;
+    }
+
+    StatsdTable& table = *m_table;
+    pollfd fds[2] = {{m_socket, POLLIN, 0}, {m_wake[0], POLLIN, 0}};
+
+    for (;;) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+
+        // Drain everything queued before sleeping again: at high rates the
+        // cost per datagram is one slot in a recvmmsg() batch
+        for (;;) {
+            std::memset(messages, 0, sizeof messages);
+            for (int i = 0; i < ReceiveBatch; ++i) {
+                messages[i].msg_hdr.msg_iov = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int received = ::recvmmsg(m_socket, messages, ReceiveBatch, MSG_DONTWAIT, nullptr);
+            if (received <= 0) {
+                break;
+            }
+            for (int i = 0; i < received; ++i) {
+                ingestDatagram(table, static_cast<const char*>(vectors[i].iov_base), int(messages[i].msg_len),
+                               messages[i].msg_hdr.msg_flags & MSG_TRUNC);
+            }
+            if (received < ReceiveBatch) {
+                break;
+            }
+        }
+    }
+#endif
+}
+
+void StatsdIngest::deliver() {
+    StatsdTable& table = *m_table;
+    int size = table.size();
+
+    if (m_names.size() != size) {
+        int first = m_names.size();
+        m_names.resize(size);
+        m_delivered.resize(size);
+        m_counts.resize(size);
+        m_timerSums.resize(size);
+        m_timerCounts.resize(size);
+        for (int i = first; i < size; ++i) {
+            StatsdTable::Slot& slot = table.at(i);
+            m_names[i] = m_prefix + QString::fromUtf8(slot.name, slot.length);
+        }
+    }
+
+    // Counters are reported as a rate over a whole second; a per-frame
+    // rate of a few increments is mostly noise
+    qint64 window = m_window.elapsed();
+    bool closeWindow = window >= 1000;
+
+    MetricRegistry* registry = MetricRegistry::instance();
+    for (int i = 0; i < size; ++i) {
+        StatsdTable::Slot& slot = table.at(i);
+        quint32 sequence = slot.sequence.load(std::memory_order_acquire);
+        bool changed = sequence != m_delivered[i];
+
+        switch (slot.type) {
+        case StatsdTable::Gauge:
+            if (changed) registry->set(m_names[i], fromBits(slot.gauge.load(std::memory_order_relaxed)));
+            break;
+        case StatsdTable::Counter:
+            if (changed) m_counts[i] += fromBits(slot.sum.exchange(0, std::memory_order_relaxed));
+            if (closeWindow) {
+                registry->set(m_names[i], m_counts[i] * 1000.0 / window);
+                m_counts[i] = 0;
+            }
+            break;
+        case StatsdTable::Timer:
+            if (changed) {
+                // Both totals between two equal, even sequences; a pair torn
+                // by the receiver is taken on the next frame instead
+                double sum = fromBits(slot.sum.load(std::memory_order_relaxed));
+                quint32 count = slot.count.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if ((sequence & 1) || slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+                quint32 samples = count - m_timerCounts[i];
+                if (samples > 0) registry->set(m_names[i], (sum - m_timerSums[i]) / samples);
+                m_timerSums[i] = sum;
+                m_timerCounts[i] = count;
+            }
+            break;
+        }
+        m_delivered[i] = sequence;
+    }
+
+    if (closeWindow) {
+        m_window.restart();
+    }
+}
+
+StatsdIngest::Stats StatsdIngest::stats() const {
+    Stats stats;
+    if (m_table) {
+        stats.datagrams = m_table->datagrams.load(std::memory_order_relaxed);
+        stats.lines = m_table->lines.load(std::memory_order_relaxed);
+        stats.malformed = m_table->malformed.load(std::memory_order_relaxed);
+        stats.dropped = m_table->dropped.load(std::memory_order_relaxed);
+        stats.names = m_table->size();
+    }
+    return stats;
+}
+
+StatsdIngest* statsd() {
+    return StatsdIngest::instance();
+}
+
+} // namespace Milk
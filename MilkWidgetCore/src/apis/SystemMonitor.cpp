@@ -4,12 +4,18 @@
 
 #include "milk/APIs.h"
 #include "milk/Utils.h"
+#include "apis/CpuTopology.h"
+#include "apis/GpuCollector.h"
+#include "apis/MemInfo.h"
 
 #include <QFile>
 #include <QTextStream>
 #include <QDir>
+#include <QDateTime>
 #include <QProcess>
 #include <QStorageInfo>
+#include <QSet>
+#include <algorithm>
 
 #ifdef Q_OS_LINUX
 #include <unistd.h>
@@ -37,14 +43,9 @@ void SystemMonitor::cleanup() {
 SystemMonitor::SystemMonitor(QObject* parent)
     : QObject(parent)
 {
-    m_timer = new QTimer(this);
-    connect(m_timer, &QTimer::timeout, this, &SystemMonitor::updateSystemInfo);
-    m_timer->start(m_updateInterval);
-    
     // Get static info
 #ifdef Q_OS_LINUX
     m_cpuCores = sysconf(_SC_NPROCESSORS_ONLN);
-    m_lastCoreStats.resize(m_cpuCores);
     
     // Hostname
     char hostname[256];
@@ -102,42 +103,114 @@ SystemMonitor::SystemMonitor(QObject* parent)
     }
 #endif
     
-    // Initial update
+    m_deadbands[Cpu] = {1.0, 0, 10000};
+    m_deadbands[Memory] = {0.5, 0, 30000};
+    m_deadbands[Temperature] = {0.5, 0, 30000};
+    m_deadbands[Gpu] = {1.0, 0, 10000};
+    
+    m_topology.reset(new CpuTopology());
+    m_memInfo.reset(new MemInfoReader());
+    m_gpu.reset(new GpuCollector());
+    m_clock.start();
+    
+    // Initial update, so there is a snapshot before the first tick
     updateSystemInfo();
+    
+    // Later rounds run on their own thread: statfs on a slow mount or a
+    // large /proc never stalls painting
+    m_thread = new QThread(this);
+    m_thread->setObjectName("milk-sampler");
+    m_timer = new QTimer();
+    m_timer->setInterval(m_updateInterval);
+    m_timer->moveToThread(m_thread);
+    connect(m_timer, &QTimer::timeout, m_timer, [this]() { updateSystemInfo(); });
+    connect(m_thread, &QThread::started, m_timer, QOverload<>::of(&QTimer::start));
+    m_thread->start();
 }
 
 SystemMonitor::~SystemMonitor() {
-    if (m_timer) {
-        m_timer->stop();
-        delete m_timer;
-    }
+    // The timer belongs to the sampler thread; stop it there first
+    QMetaObject::invokeMethod(m_timer, &QTimer::stop, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_timer;
 }
 
 void SystemMonitor::setUpdateInterval(int ms) {
     m_updateInterval = ms;
-    m_timer->setInterval(ms);
+    QTimer* timer = m_timer;
+    QMetaObject::invokeMethod(timer, [timer, ms]() { timer->setInterval(ms); });
 }
 
-void SystemMonitor::updateSystemInfo() {
+void SystemMonitor::setHistoryEnabled(bool enabled) {
+    m_historyEnabled = enabled;
+}
+
+void SystemMonitor::setDeadband(Metric metric, const Deadband& deadband) {
+    if (metric < 0 || metric >= MetricCount) return;
     QMutexLocker locker(&m_mutex);
+    m_deadbands[metric] = deadband;
+}
+
+SystemMonitor::Deadband SystemMonitor::deadband(Metric metric) {
+    if (metric < 0 || metric >= MetricCount) return Deadband();
+    QMutexLocker locker(&m_mutex);
+    return m_deadbands[metric];
+}
+
+void SystemMonitor::updateSystemInfo() {
+    // Sampled without m_mutex: the getters only ever wait for the copy below
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->timestamp = QDateTime::currentMSecsSinceEpoch();
+    readCpuInfo(*snapshot);
+    readMemInfo(*snapshot);
+    readDiskInfo(*snapshot);
+    readTempInfo(*snapshot);
+    readProcessInfo(*snapshot);
+    readNetInfo(*snapshot);
+    readBatteryInfo(*snapshot);
+    readGpuInfo(*snapshot);
     
-    readCpuInfo();
-    readMemInfo();
-    readDiskInfo();
-    readTempInfo();
-    readProcessInfo();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_info = m_sampled;
+    }
+    
+    // Swapped in whole; readers holding the previous one keep it alive
+    std::shared_ptr<const Snapshot> published(std::move(snapshot));
+    std::atomic_store(&m_snapshot, published);
+    {
+        // Detaching takes this lock too, so neither hook goes away mid-round
+        QMutexLocker hooks(&m_hookMutex);
+        if (m_alerts) {
+            m_alerts->evaluate(*published);
+        }
+        if (m_plugins) {
+            m_plugins->sample();
+        }
+    }
+    reportChanges(*published);
+    reportNetRates(*published);
+    
+    if (m_historyEnabled) {
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        TimeSeries::open("sys.cpu")->append(now, m_sampled.cpuUsage);
+        TimeSeries::open("sys.memory")->append(now, m_sampled.memoryUsage);
+        if (m_sampled.temperature > 0) TimeSeries::open("sys.temperature")->append(now, m_sampled.temperature);
+    }
     
     emit updated();
 }
 
-void SystemMonitor::readCpuInfo() {
+void SystemMonitor::readCpuInfo(Snapshot& snapshot) {
 #ifdef Q_OS_LINUX
     QFile stat("/proc/stat");
     if (!stat.open(QIODevice::ReadOnly)) return;
     
-    QTextStream stream(&stat);
-    QString line = stream.readLine();
-    QStringList values = line.split(' ', Qt::SkipEmptyParts);
+    // One read for the aggregate line and the per-CPU lines below it
+    QByteArray data = stat.readAll();
+    stat.close();
+    QList<QByteArray> values = data.left(data.indexOf('\n')).simplified().split(' ');
     
     if (values.size() >= 8 && values[0] == "cpu") {
         quint64 user = values[1].toULongLong();
@@ -154,73 +227,65 @@ void SystemMonitor::readCpuInfo() {
             quint64 totalDiff = total - m_lastCpuTotal;
             quint64 idleDiff = idle - m_lastCpuIdle;
             
-            if (totalDiff > 0) {
-                m_info.cpuUsage = 100.0 * (totalDiff - idleDiff) / totalDiff;
+            // Unsigned: a counter that stepped back would wrap to 2^64
+            if (total > m_lastCpuTotal && idle >= m_lastCpuIdle && idleDiff <= totalDiff) {
+                m_sampled.cpuUsage = 100.0 * (totalDiff - idleDiff) / totalDiff;
             }
         }
+        snapshot.cpuUsage = m_sampled.cpuUsage;
         
         m_lastCpuTotal = total;
         m_lastCpuIdle = idle;
     }
     
-    stat.close();
+    m_topology->sample(data, snapshot);
 #endif
 }
 
-void SystemMonitor::readMemInfo() {
-#ifdef Q_OS_LINUX
-    QFile mem("/proc/meminfo");
-    if (!mem.open(QIODevice::ReadOnly)) return;
-    
-    qint64 memTotal = 0;
-    qint64 memFree = 0;
-    qint64 memAvailable = 0;
-    qint64 buffers = 0;
-    qint64 cached = 0;
-    
-    QTextStream stream(&mem);
-    while (!stream.atEnd()) {
-        QString line = stream.readLine();
-        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
-        
-        if (parts.size() >= 2) {
-            QString key = parts[0].remove(':');
-            qint64 value = parts[1].toLongLong() * 1024;  // kB to bytes
-            
-            if (key == "MemTotal") memTotal = value;
-            else if (key == "MemFree") memFree = value;
-            else if (key == "MemAvailable") memAvailable = value;
-            else if (key == "Buffers") buffers = value;
-            else if (key == "Cached") cached = value;
-        }
-    }
-    mem.close();
+void SystemMonitor::readMemInfo(Snapshot& snapshot) {
+    if (!m_memInfo->read(snapshot)) return;
     
-    if (memAvailable == 0) {
-        memAvailable = memFree + buffers + cached;
+    Snapshot::Memory& mem = snapshot.memory;
+    if (mem.available == 0) {
+        // Kernels before 3.14 have no MemAvailable
+        mem.available = mem.free + mem.buffers + mem.cached;
     }
     
-    qint64 memUsed = memTotal - memAvailable;
-    
-    if (memTotal > 0) {
-        m_info.memoryUsage = 100.0 * memUsed / memTotal;
+    if (mem.total > 0) {
+        m_sampled.memoryUsage = 100.0 * (mem.total - mem.available) / mem.total;
     }
-#endif
-}
-
-void SystemMonitor::readDiskInfo() {
-    QStorageInfo storage("/");
-    if (storage.isValid()) {
-        qint64 total = storage.bytesTotal();
-        qint64 free = storage.bytesFree();
+    snapshot.memoryTotal = mem.total;
+    snapshot.memoryAvailable = mem.available;
+    snapshot.swapTotal = mem.swapTotal;
+    snapshot.swapFree = mem.swapFree;
+}
+
+void SystemMonitor::readDiskInfo(Snapshot& snapshot) {
+    // Pseudo and in-memory filesystems would only add noise to the export
+    static const QSet<QByteArray> virtualTypes = {
+        "tmpfs", "devtmpfs", "proc", "sysfs", "cgroup", "cgroup2", "overlay", "squashfs",
+        "devpts", "securityfs", "pstore", "debugfs", "tracefs", "configfs", "fusectl",
+        "mqueue", "hugetlbfs", "autofs", "bpf", "efivarfs", "ramfs", "nsfs"
+    };
+    
+    for (const QStorageInfo& storage : QStorageInfo::mountedVolumes()) {
+        if (!storage.isValid() || !storage.isReady() || virtualTypes.contains(storage.fileSystemType())) continue;
         
-        if (total > 0) {
-            m_info.diskUsage = 100.0 * (total - free) / total;
+        Snapshot::Filesystem fs;
+        fs.mountPoint = storage.rootPath();
+        fs.device = QString::fromLocal8Bit(storage.device());
+        fs.type = QString::fromLatin1(storage.fileSystemType());
+        fs.total = storage.bytesTotal();
+        fs.free = storage.bytesFree();
+        snapshot.filesystems.append(fs);
+        
+        if (fs.mountPoint == "/" && fs.total > 0) {
+            m_sampled.diskUsage = 100.0 * (fs.total - fs.free) / fs.total;
         }
     }
 }
 
-void SystemMonitor::readTempInfo() {
+void SystemMonitor::readTempInfo(Snapshot& snapshot) {
 #ifdef Q_OS_LINUX
     // Try various temperature sources
     QStringList tempPaths = {
@@ -241,7 +306,8 @@ void SystemMonitor::readTempInfo() {
                 tempVal /= 1000.0;
             }
             
-            m_info.temperature = tempVal;
+            m_sampled.temperature = tempVal;
+            snapshot.temperatures.insert("cpu", tempVal);
             temp.close();
             break;
         }
@@ -249,7 +315,7 @@ void SystemMonitor::readTempInfo() {
 #endif
 }
 
-void SystemMonitor::readProcessInfo() {
+void SystemMonitor::readProcessInfo(Snapshot& snapshot) {
 #ifdef Q_OS_LINUX
     QDir procDir("/proc");
     int count = 0;
@@ -260,7 +326,13 @@ void SystemMonitor::readProcessInfo() {
         if (ok) count++;
     }
     
-    m_info.processCount = count;
+    m_sampled.processCount = count;
+    snapshot.processes = count;
+    
+    struct sysinfo sys;
+    if (sysinfo(&sys) == 0) {
+        for (int i = 0; i < 3; ++i) snapshot.load[i] = sys.loads[i] / double(1 << SI_LOAD_SHIFT);
+    }
     
     // Uptime
     QFile uptime("/proc/uptime");
@@ -269,16 +341,17 @@ void SystemMonitor::readProcessInfo() {
         QStringList parts = line.split(' ');
         if (!parts.isEmpty()) {
             double seconds = parts[0].toDouble();
+            snapshot.uptime = seconds;
             int days = static_cast<int>(seconds / 86400);
             int hours = static_cast<int>((seconds - days * 86400) / 3600);
             int minutes = static_cast<int>((seconds - days * 86400 - hours * 3600) / 60);
             
             if (days > 0) {
-                m_info.uptime = QString("%1d %2h %3m").arg(days).arg(hours).arg(minutes);
+                m_sampled.uptime = QString("%1d %2h %3m").arg(days).arg(hours).arg(minutes);
             } else if (hours > 0) {
-                m_info.uptime = QString("%1h %2m").arg(hours).arg(minutes);
+                m_sampled.uptime = QString("%1h %2m").arg(hours).arg(minutes);
             } else {
-                m_info.uptime = QString("%1m").arg(minutes);
+                m_sampled.uptime = QString("%1m").arg(minutes);
             }
         }
         uptime.close();
@@ -286,69 +359,270 @@ void SystemMonitor::readProcessInfo() {
 #endif
 }
 
+void SystemMonitor::readNetInfo(Snapshot& snapshot) {
+#ifdef Q_OS_LINUX
+    QFile dev("/proc/net/dev");
+    if (!dev.open(QIODevice::ReadOnly)) return;
+    
+    dev.readLine();  // Two header lines
+    dev.readLine();
+    while (!dev.atEnd()) {
+        QByteArray line = dev.readLine();
+        int colon = line.indexOf(':');
+        if (colon < 0) continue;
+        
+        QByteArray name = line.left(colon).trimmed();
+        if (name == "lo") continue;
+        QList<QByteArray> fields = line.mid(colon + 1).simplified().split(' ');
+        if (fields.size() < 9) continue;
+        
+        Snapshot::Interface iface;
+        iface.name = QString::fromLatin1(name);
+        iface.rxBytes = fields[0].toULongLong();
+        iface.txBytes = fields[8].toULongLong();
+        snapshot.interfaces.append(iface);
+    }
+#else
+    Q_UNUSED(snapshot)
+#endif
+}
+
+void SystemMonitor::readBatteryInfo(Snapshot& snapshot) {
+#ifdef Q_OS_LINUX
+    if (m_batteryPath.isNull()) {
+        m_batteryPath = "";  // Looked once; empty means none
+        QDir supplies("/sys/class/power_supply");
+        for (const QString& name : supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            QFile type(supplies.filePath(name + "/type"));
+            if (type.open(QIODevice::ReadOnly) && type.readAll().trimmed() == "Battery") {
+                m_batteryPath = supplies.filePath(name);
+                break;
+            }
+        }
+    }
+    if (m_batteryPath.isEmpty()) return;
+    
+    QFile capacity(m_batteryPath + "/capacity");
+    if (capacity.open(QIODevice::ReadOnly)) snapshot.batteryPercent = capacity.readAll().trimmed().toInt();
+    QFile status(m_batteryPath + "/status");
+    if (status.open(QIODevice::ReadOnly)) snapshot.batteryCharging = status.readAll().trimmed() == "Charging";
+#else
+    Q_UNUSED(snapshot)
+#endif
+}
+
+void SystemMonitor::readGpuInfo(Snapshot& snapshot) {
+    m_gpu->sample(snapshot, m_clock.nsecsElapsed());
+    for (int i = 0; i < snapshot.gpus.size(); ++i) {
+        if (snapshot.gpus[i].temperature > 0) {
+            snapshot.temperatures.insert(i == 0 ? QString("gpu") : QString("gpu%1").arg(i), snapshot.gpus[i].temperature);
+        }
+    }
+}
+
+bool SystemMonitor::Deadband::due(double value, double last, qint64 nowMs, qint64 lastAtMs) const {
+    if (lastAtMs == 0) return true;
+    double delta = qAbs(value - last);
+    double threshold = qMax(absolute, relative * qAbs(last));
+    bool moved = threshold > 0 ? delta >= threshold : delta > 0;
+    bool stale = maxStaleMs > 0 && nowMs - lastAtMs >= maxStaleMs;
+    return moved || stale;
+}
+
+void SystemMonitor::reportChanges(const Snapshot& snapshot) {
+    static const char* const names[MetricCount] = {"sys.cpu", "sys.memory", "sys.temperature", "sys.gpu"};
+    
+    double values[MetricCount];
+    bool available[MetricCount];
+    values[Cpu] = snapshot.cpuUsage;
+    available[Cpu] = true;
+    values[Memory] = snapshot.memoryTotal > 0
+        ? 100.0 * (snapshot.memoryTotal - snapshot.memoryAvailable) / snapshot.memoryTotal : 0;
+    available[Memory] = snapshot.memoryTotal > 0;
+    values[Temperature] = snapshot.temperatures.value("cpu", 0);
+    available[Temperature] = snapshot.temperatures.contains("cpu");
+    values[Gpu] = snapshot.gpus.isEmpty() ? 0 : snapshot.gpus.first().busy;
+    available[Gpu] = values[Gpu] >= 0 && !snapshot.gpus.isEmpty();
+    
+    Deadband bands[MetricCount];
+    {
+        QMutexLocker locker(&m_mutex);
+        std::copy(m_deadbands, m_deadbands + MetricCount, bands);
+    }
+    
+    // Monotonic: a wall clock stepped back would hold staleness off for as
+    // long as the step, and one stepped forward would fire it at once
+    const qint64 now = qMax<qint64>(1, m_clock.elapsed());
+    int changed = 0;  // Bit per metric
+    for (int m = 0; m < MetricCount; ++m) {
+        if (!available[m]) continue;
+        if (bands[m].due(values[m], m_reported[m], now, m_reportedAt[m])) {
+            m_reported[m] = values[m];
+            m_reportedAt[m] = now;
+            changed |= 1 << m;
+        }
+    }
+    if (!changed) return;
+    
+    // Queued to receivers on the GUI thread like updated()
+    if (changed & (1 << Cpu)) emit cpuChanged(values[Cpu]);
+    if (changed & (1 << Memory)) emit memoryChanged(values[Memory]);
+    if (changed & (1 << Temperature)) emit temperatureChanged(values[Temperature]);
+    if (changed & (1 << Gpu)) emit gpuChanged(values[Gpu]);
+    
+    // MetricRegistry is GUI-thread only
+    QVector<QPair<const char*, double>> reports;
+    for (int m = 0; m < MetricCount; ++m) {
+        if (changed & (1 << m)) reports.append({names[m], values[m]});
+    }
+    QMetaObject::invokeMethod(this, [reports]() {
+        MetricRegistry* registry = MetricRegistry::instance();
+        for (const auto& report : reports) registry->set(QString::fromLatin1(report.first), report.second);
+    }, Qt::QueuedConnection);
+}
+
+void SystemMonitor::reportNetRates(const Snapshot& snapshot) {
+    const qint64 now = m_clock.elapsed();
+    const double seconds = m_netAt > 0 ? (now - m_netAt) / 1000.0 : 0;
+    
+    // Idle interfaces don't repaint what is bound to them every round
+    QVector<QPair<QString, double>> reports;
+    auto report = [&](const QString& name, double rate) {
+        auto last = m_netReported.constFind(name);
+        if (last != m_netReported.constEnd() && *last == rate) return;
+        m_netReported.insert(name, rate);
+        reports.append({name, rate});
+    };
+    
+    QHash<QString, QPair<quint64, quint64>> bytes;
+    double rxTotal = 0;
+    double txTotal = 0;
+    for (const auto& iface : snapshot.interfaces) {
+        bytes.insert(iface.name, {iface.rxBytes, iface.txBytes});
+        auto last = m_netBytes.constFind(iface.name);
+        if (last == m_netBytes.constEnd() || seconds <= 0) continue;  // No rate before a second reading
+        // Counters start over when the driver is reloaded
+        double rx = iface.rxBytes >= last->first ? (iface.rxBytes - last->first) / seconds : 0;
+        double tx = iface.txBytes >= last->second ? (iface.txBytes - last->second) / seconds : 0;
+        report("net." + iface.name + ".rx", rx);
+        report("net." + iface.name + ".tx", tx);
+        rxTotal += rx;
+        txTotal += tx;
+    }
+    // Unplugged interfaces read as idle, not as their last rate
+    for (auto it = m_netBytes.constBegin(); it != m_netBytes.constEnd(); ++it) {
+        if (bytes.contains(it.key())) continue;
+        report("net." + it.key() + ".rx", 0);
+        report("net." + it.key() + ".tx", 0);
+    }
+    if (seconds > 0) {
+        report("net.rx", rxTotal);
+        report("net.tx", txTotal);
+    }
+    m_netBytes.swap(bytes);
+    m_netAt = now;
+    if (reports.isEmpty()) return;
+    
+    // MetricRegistry is GUI-thread only
+    QMetaObject::invokeMethod(this, [reports]() {
+        MetricRegistry* registry = MetricRegistry::instance();
+        for (const auto& rate : reports) registry->set(rate.first, rate.second);
+    }, Qt::QueuedConnection);
+}
+
 // ============================================================================
 // GETTERS
 // ============================================================================
 
+std::shared_ptr<const SystemMonitor::Snapshot> SystemMonitor::snapshot() const {
+    auto current = std::atomic_load(&m_snapshot);
+    return current ? current : std::make_shared<const Snapshot>();
+}
+
 double SystemMonitor::cpu() {
     QMutexLocker locker(&m_mutex);
     return m_info.cpuUsage;
 }
 
 double SystemMonitor::cpuCore(int core) {
-    QMutexLocker locker(&m_mutex);
-    Q_UNUSED(core)
-    // Per-core implementation would go here
-    return m_info.cpuUsage;
+    auto current = snapshot();
+    return core >= 0 && core < current->coreUsage.size() ? current->coreUsage[core] : 0;
 }
 
 int SystemMonitor::cpuCores() {
     return m_cpuCores;
 }
 
+int SystemMonitor::cpuPhysicalCores() {
+    return m_topology->physicalCores();
+}
+
+int SystemMonitor::cpuPackages() {
+    return m_topology->packages();
+}
+
+int SystemMonitor::cpuNodes() {
+    return m_topology->nodes();
+}
+
+static double cpuGroupUsage(const SystemMonitor::Snapshot& snapshot, const QString& name) {
+    for (const auto& group : snapshot.cpuGroups) {
+        if (group.name == name) return group.usage;
+    }
+    return 0;
+}
+
+double SystemMonitor::cpuPackage(int package) {
+    return cpuGroupUsage(*snapshot(), QString("package%1").arg(package));
+}
+
+double SystemMonitor::cpuNode(int node) {
+    // Single-node hosts get no node groups; the whole machine is node 0
+    if (m_topology->nodes() == 1) return node == 0 ? cpu() : 0;
+    return cpuGroupUsage(*snapshot(), QString("node%1").arg(node));
+}
+
 QString SystemMonitor::cpuModel() {
     return m_cpuModel;
 }
 
 double SystemMonitor::cpuFrequency() {
-#ifdef Q_OS_LINUX
-    QFile freq("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq");
-    if (freq.open(QIODevice::ReadOnly)) {
-        QString value = QString::fromLocal8Bit(freq.readAll()).trimmed();
-        freq.close();
-        return value.toDouble() / 1000.0;  // kHz to MHz
+    auto current = snapshot();
+    double sum = 0;
+    int count = 0;
+    for (double mhz : current->coreFrequency) {
+        if (mhz > 0) {
+            sum += mhz;
+            ++count;
+        }
     }
-#endif
-    return 0;
+    return count > 0 ? sum / count : 0;
+}
+
+double SystemMonitor::cpuCoreFrequency(int core) {
+    auto current = snapshot();
+    return core >= 0 && core < current->coreFrequency.size() ? current->coreFrequency[core] : 0;
 }
 
+// Every memory getter reads the same sample, so they always add up
+
 double SystemMonitor::memory() {
-    QMutexLocker locker(&m_mutex);
-    return m_info.memoryUsage;
+    auto current = snapshot();
+    if (current->memoryTotal <= 0) return 0;
+    return 100.0 * (current->memoryTotal - current->memoryAvailable) / current->memoryTotal;
 }
 
 qint64 SystemMonitor::memoryUsed() {
-#ifdef Q_OS_LINUX
-    struct sysinfo info;
-    if (sysinfo(&info) == 0) {
-        return (info.totalram - info.freeram) * info.mem_unit;
-    }
-#endif
-    return 0;
+    auto current = snapshot();
+    return current->memoryTotal - current->memoryAvailable;
 }
 
 qint64 SystemMonitor::memoryTotal() {
-#ifdef Q_OS_LINUX
-    struct sysinfo info;
-    if (sysinfo(&info) == 0) {
-        return info.totalram * info.mem_unit;
-    }
-#endif
-    return 0;
+    return snapshot()->memoryTotal;
 }
 
 qint64 SystemMonitor::memoryAvailable() {
-    return memoryTotal() - memoryUsed();
+    return snapshot()->memoryAvailable;
 }
 
 QString SystemMonitor::memoryUsedStr() {
@@ -360,33 +634,17 @@ QString SystemMonitor::memoryTotalStr() {
 }
 
 double SystemMonitor::swap() {
-#ifdef Q_OS_LINUX
-    struct sysinfo info;
-    if (sysinfo(&info) == 0 && info.totalswap > 0) {
-        return 100.0 * (info.totalswap - info.freeswap) / info.totalswap;
-    }
-#endif
-    return 0;
+    auto current = snapshot();
+    return current->swapTotal > 0 ? 100.0 * (current->swapTotal - current->swapFree) / current->swapTotal : 0;
 }
 
 qint64 SystemMonitor::swapUsed() {
-#ifdef Q_OS_LINUX
-    struct sysinfo info;
-    if (sysinfo(&info) == 0) {
-        return (info.totalswap - info.freeswap) * info.mem_unit;
-    }
-#endif
-    return 0;
+    auto current = snapshot();
+    return current->swapTotal - current->swapFree;
 }
 
 qint64 SystemMonitor::swapTotal() {
-#ifdef Q_OS_LINUX
-    struct sysinfo info;
-    if (sysinfo(&info) == 0) {
-        return info.totalswap * info.mem_unit;
-    }
-#endif
-    return 0;
+    return snapshot()->swapTotal;
 }
 
 double SystemMonitor::disk(const QString& path) {
@@ -432,8 +690,8 @@ double SystemMonitor::cpuTemperature() {
 }
 
 double SystemMonitor::gpuTemperature() {
-    // Would need NVIDIA/AMD specific implementation
-    return 0;
+    auto current = snapshot();
+    return current->gpus.isEmpty() ? 0 : current->gpus.first().temperature;
 }
 
 QMap<QString, double> SystemMonitor::temperatures() {
@@ -490,16 +748,20 @@ QString SystemMonitor::kernelVersion() {
 }
 
 double SystemMonitor::gpuUsage() {
-    // Would need NVIDIA/AMD specific implementation
-    return 0;
+    auto current = snapshot();
+    return current->gpus.isEmpty() ? 0 : qMax(0.0, current->gpus.first().busy);
 }
 
 double SystemMonitor::gpuMemory() {
-    return 0;
+    auto current = snapshot();
+    if (current->gpus.isEmpty()) return 0;
+    const Snapshot::Gpu& gpu = current->gpus.first();
+    return gpu.vramTotal > 0 && gpu.vramUsed >= 0 ? 100.0 * gpu.vramUsed / gpu.vramTotal : 0;
 }
 
 QString SystemMonitor::gpuModel() {
-    return QString();
+    auto current = snapshot();
+    return current->gpus.isEmpty() ? QString() : current->gpus.first().model;
 }
 
 SystemInfo SystemMonitor::info() {
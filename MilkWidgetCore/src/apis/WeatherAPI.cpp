@@ -0,0 +1,343 @@
+/**
+ * MilkWidgetCore - Weather API Implementation
+ *
+ * Responses are cached on disk per endpoint+location+units. Fresh data is
+ * served without touching the network; stale data stays on screen while a
+ * conditional request (ETag / Last-Modified) revalidates it.
+ */
+
+#include "milk/APIs.h"
+#include "milk/Utils.h"
+
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QUrlQuery>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+namespace Milk {
+
+static const int MinBackoff = 30;
+static const int MaxBackoff = 30 * 60;
+
+WeatherAPI* WeatherAPI::s_instance = nullptr;
+
+WeatherAPI* WeatherAPI::instance() {
+    if (!s_instance) {
+        s_instance = new WeatherAPI();
+    }
+    return s_instance;
+}
+
+void WeatherAPI::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+WeatherAPI::WeatherAPI(QObject* parent)
+    : QObject(parent)
+    , m_network(new QNetworkAccessManager(this))
+    , m_timer(new QTimer(this))
+    , m_retryTimer(new QTimer(this))
+    , m_endpoint("https://api.openweathermap.org/data/2.5/weather")
+{
+    connect(m_timer, &QTimer::timeout, this, &WeatherAPI::refresh);
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &WeatherAPI::fetchWeather);
+}
+
+WeatherAPI::~WeatherAPI() {
+    if (m_reply) { m_reply->disconnect(this); m_reply->abort(); m_reply->deleteLater(); }
+}
+
+// ============================================================================
+// SETUP
+// ============================================================================
+
+void WeatherAPI::setApiKey(const QString& key) { m_apiKey = key; }
+
+void WeatherAPI::setCity(const QString& city) {
+    m_city = city;
+    m_useCoords = false;
+    locationChanged();
+}
+
+void WeatherAPI::setCoordinates(double lat, double lon) {
+    m_lat = lat;
+    m_lon = lon;
+    m_useCoords = true;
+    locationChanged();
+}
+
+void WeatherAPI::setUnits(const QString& units) {
+    m_units = units;
+    locationChanged();
+}
+
+void WeatherAPI::setUpdateInterval(int minutes) {
+    if (minutes > 0) m_timer->start(minutes * 60 * 1000);
+    else m_timer->stop();
+}
+
+void WeatherAPI::setEndpoint(const QUrl& url) {
+    m_endpoint = url;
+    locationChanged();
+}
+
+void WeatherAPI::setCacheTtl(int seconds) { m_cacheTtl = qMax(0, seconds); }
+void WeatherAPI::setMaxStale(int seconds) { m_maxStale = qMax(0, seconds); }
+
+bool WeatherAPI::isStale() {
+    return !m_valid || m_lastUpdate.secsTo(QDateTime::currentDateTime()) >= m_cacheTtl;
+}
+
+void WeatherAPI::locationChanged() {
+    // Whatever is in flight belongs to the old location
+    if (m_reply) { m_reply->disconnect(this); m_reply->abort(); m_reply->deleteLater(); m_reply = nullptr; }
+    m_retryTimer->stop();
+    m_backoff = 0;
+    m_valid = false;
+    m_rawData = QJsonObject();
+    m_info = WeatherInfo();
+    m_etag.clear();
+    m_lastModified.clear();
+    loadCache();
+}
+
+// ============================================================================
+// CACHE
+// ============================================================================
+
+QString WeatherAPI::cacheFile() const {
+    QString location = m_useCoords ? QString("%1,%2").arg(m_lat, 0, 'f', 4).arg(m_lon, 0, 'f', 4) : m_city.toLower();
+    QByteArray key = (m_endpoint.toString() + '|' + location + '|' + m_units).toUtf8();
+    QString name = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex().left(16);
+    return File::cacheDir() + "/weather/" + name + ".json";
+}
+
+void WeatherAPI::loadCache() {
+    if (!m_useCoords && m_city.isEmpty()) return;
+
+    QFile file(cacheFile());
+    if (!file.open(QIODevice::ReadOnly)) return;
+    QJsonObject entry = QJsonDocument::fromJson(file.readAll()).object();
+
+    QDateTime fetched = QDateTime::fromMSecsSinceEpoch(qint64(entry["fetched"].toDouble()));
+    if (!fetched.isValid() || fetched.secsTo(QDateTime::currentDateTime()) > m_maxStale) return;
+
+    m_lastUpdate = fetched;
+    m_etag = entry["etag"].toString().toUtf8();
+    m_lastModified = entry["lastModified"].toString().toUtf8();
+    parseWeatherData(entry["body"].toObject());
+}
+
+void WeatherAPI::storeCache() {
+    QString path = cacheFile();
+    File::mkdirs(QFileInfo(path).absolutePath());
+
+    QJsonObject entry;
+    entry["fetched"] = double(m_lastUpdate.toMSecsSinceEpoch());
+    entry["etag"] = QString::fromUtf8(m_etag);
+    entry["lastModified"] = QString::fromUtf8(m_lastModified);
+    entry["body"] = m_rawData;
+
+    // Written atomically so a concurrent reader never sees half a file
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        log()->warning(QString("Cannot write weather cache: %1").arg(path));
+        return;
+    }
+    file.write(QJsonDocument(entry).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+// ============================================================================
+// NETWORK
+// ============================================================================
+
+void WeatherAPI::refresh() {
+    if (!isStale()) return;          // Fresh: served from cache
+    if (m_reply) return;             // Coalesce with the request already in flight
+    if (m_retryTimer->isActive()) return;  // Backing off after an error
+    fetchWeather();
+}
+
+void WeatherAPI::fetchWeather() {
+    if (m_reply) return;
+    if (m_apiKey.isEmpty()) { emit error("API key not set"); return; }
+    if (!m_useCoords && m_city.isEmpty()) { emit error("Location not set"); return; }
+
+    QUrlQuery query;
+    query.addQueryItem("appid", m_apiKey);
+    query.addQueryItem("units", m_units);
+    if (m_useCoords) {
+        query.addQueryItem("lat", QString::number(m_lat));
+        query.addQueryItem("lon", QString::number(m_lon));
+    } else {
+        query.addQueryItem("q", m_city);
+    }
+    QUrl url = m_endpoint;
+    url.setQuery(query);
+
+    QNetworkRequest request(url);
+    if (m_valid) {
+        // Revalidate what is on screen; a 304 costs no body and no parse
+        if (!m_etag.isEmpty()) request.setRawHeader("If-None-Match", m_etag);
+        if (!m_lastModified.isEmpty()) request.setRawHeader("If-Modified-Since", m_lastModified);
+    }
+    request.setTransferTimeout(15000);
+
+    m_reply = m_network->get(request);
+    connect(m_reply, &QNetworkReply::finished, this, &WeatherAPI::onWeatherReply);
+}
+
+void WeatherAPI::onWeatherReply() {
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    reply->deleteLater();
+    if (reply != m_reply) return;  // Superseded by a location change
+    m_reply = nullptr;
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    auto retryLater = [this](const QString& message) {
+        m_backoff = m_backoff ? qMin(m_backoff * 2, MaxBackoff) : MinBackoff;
+        m_retryTimer->start(m_backoff * 1000);
+        emit error(QString("%1 (retrying in %2s)").arg(message).arg(m_backoff));
+    };
+
+    if (reply->error() != QNetworkReply::NoError || (status != 200 && status != 304)) {
+        retryLater(reply->errorString());
+        return;
+    }
+
+    if (status == 304 && !m_valid) {
+        // Nothing on screen to revalidate: forget the validators and ask for the body
+        bool conditional = reply->request().hasRawHeader("If-None-Match") ||
+                           reply->request().hasRawHeader("If-Modified-Since");
+        m_etag.clear();
+        m_lastModified.clear();
+        if (conditional) fetchWeather();
+        else retryLater("Not Modified without cached data");
+        return;
+    }
+
+    QJsonObject body;
+    if (status == 200) {
+        QJsonParseError parseError;
+        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+            // What is on screen stays as stale as it was
+            retryLater(QString("Invalid weather response: %1").arg(parseError.errorString()));
+            return;
+        }
+        body = doc.object();
+    }
+
+    // Only a usable answer makes the data fresh
+    m_backoff = 0;
+    m_lastUpdate = QDateTime::currentDateTime();
+    if (reply->hasRawHeader("ETag")) m_etag = reply->rawHeader("ETag");
+    if (reply->hasRawHeader("Last-Modified")) m_lastModified = reply->rawHeader("Last-Modified");
+
+    if (status == 304) {
+        m_info.lastUpdate = m_lastUpdate;
+    } else {
+        parseWeatherData(body);
+    }
+    storeCache();
+}
+
+void WeatherAPI::parseWeatherData(const QJsonObject& data) {
+    m_rawData = data;
+
+    QJsonObject main = data["main"].toObject();
+    m_info.temperature = main["temp"].toDouble();
+    m_info.feelsLike = main["feels_like"].toDouble();
+    m_info.humidity = main["humidity"].toInt();
+
+    QJsonArray weather = data["weather"].toArray();
+    if (!weather.isEmpty()) {
+        QJsonObject w = weather[0].toObject();
+        m_info.condition = w["main"].toString();
+        m_info.description = w["description"].toString();
+        m_info.icon = w["icon"].toString();
+    }
+
+    QJsonObject wind = data["wind"].toObject();
+    m_info.windSpeed = wind["speed"].toDouble();
+    m_info.windDirection = windDirection();
+    m_info.city = data["name"].toString();
+    m_info.lastUpdate = m_lastUpdate;
+
+    m_valid = true;
+    emit updated();
+}
+
+// ============================================================================
+// ACCESSORS
+// ============================================================================
+
+static QString unitSymbol(const QString& units) {
+    if (units == "imperial") return QString::fromUtf8("°F");
+    if (units == "standard") return "K";
+    return QString::fromUtf8("°C");
+}
+
+QString WeatherAPI::temperature() { return QString::number(qRound(m_info.temperature)) + unitSymbol(m_units); }
+int WeatherAPI::temperatureInt() { return qRound(m_info.temperature); }
+double WeatherAPI::temperatureDouble() { return m_info.temperature; }
+QString WeatherAPI::feelsLike() { return QString::number(qRound(m_info.feelsLike)) + unitSymbol(m_units); }
+QString WeatherAPI::condition() { return m_info.condition; }
+QString WeatherAPI::description() { return m_info.description; }
+QString WeatherAPI::icon() { return m_info.icon; }
+QString WeatherAPI::iconUrl() {
+    return m_info.icon.isEmpty() ? QString() : QString("https://openweathermap.org/img/wn/%1@2x.png").arg(m_info.icon);
+}
+int WeatherAPI::humidity() { return m_info.humidity; }
+QString WeatherAPI::windSpeed() {
+    return QString::number(m_info.windSpeed, 'f', 1) + (m_units == "imperial" ? " mph" : " m/s");
+}
+QString WeatherAPI::windDirection() {
+    static const char* names[] = {"N", "NE", "E", "SE", "S", "SW", "W", "NW"};
+    int deg = m_rawData["wind"].toObject()["deg"].toInt();
+    return names[((deg % 360 + 360) % 360 + 22) / 45 % 8];
+}
+double WeatherAPI::pressure() { return m_rawData["main"].toObject()["pressure"].toDouble(); }
+int WeatherAPI::visibility() { return m_rawData["visibility"].toInt(); }
+int WeatherAPI::cloudiness() { return m_rawData["clouds"].toObject()["all"].toInt(); }
+
+QDateTime WeatherAPI::sunrise() {
+    return QDateTime::fromSecsSinceEpoch(qint64(m_rawData["sys"].toObject()["sunrise"].toDouble()));
+}
+QDateTime WeatherAPI::sunset() {
+    return QDateTime::fromSecsSinceEpoch(qint64(m_rawData["sys"].toObject()["sunset"].toDouble()));
+}
+bool WeatherAPI::isDaytime() {
+    QDateTime now = QDateTime::currentDateTime();
+    return now >= sunrise() && now < sunset();
+}
+
+bool WeatherAPI::isRaining() { return m_info.condition == "Rain" || m_info.condition == "Drizzle"; }
+bool WeatherAPI::isSnowing() { return m_info.condition == "Snow"; }
+bool WeatherAPI::isCloudy() { return m_info.condition == "Clouds"; }
+bool WeatherAPI::isSunny() { return m_info.condition == "Clear"; }
+bool WeatherAPI::isStormy() { return m_info.condition == "Thunderstorm"; }
+
+QString WeatherAPI::city() { return m_info.city; }
+QString WeatherAPI::country() { return m_rawData["sys"].toObject()["country"].toString(); }
+
+QDateTime WeatherAPI::lastUpdate() { return m_lastUpdate; }
+bool WeatherAPI::isValid() { return m_valid; }
+WeatherInfo WeatherAPI::info() { return m_info; }
+
+WeatherAPI* weather() {
+    return WeatherAPI::instance();
+}
+
+} // namespace Milk
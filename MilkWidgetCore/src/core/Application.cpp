@@ -10,6 +10,7 @@
 
 #include <QScreen>
 #include <QDir>
+#include <QFileInfo>
 #include <QStandardPaths>
 
 namespace Milk {
@@ -36,13 +37,48 @@ Application::Application(int& argc, char** argv)
     // Initialize subsystems
     initializeSubsystems();
     
+    bool budgetOk = false;
+    qint64 budgetMB = qEnvironmentVariable("MILK_MEMORY_BUDGET_MB").toLongLong(&budgetOk);
+    if (budgetOk && budgetMB > 0) {
+        setMemoryBudget(budgetMB * 1024 * 1024);
+    }
+    
+    // Opt-in metrics endpoint: a port on 127.0.0.1, or a Unix socket path
+    QString metricsAddress = qEnvironmentVariable("MILK_METRICS");
+    if (metricsAddress.startsWith("unix:")) {
+        MetricsExporter::instance()->listenLocal(metricsAddress.mid(5));
+    } else if (metricsAddress.toUShort() > 0) {
+        MetricsExporter::instance()->listen(metricsAddress.toUShort());
+    }
+    
+    // Opt-in StatsD ingest: "1" for the default socket, or a socket path
+    QString statsdAddress = qEnvironmentVariable("MILK_STATSD");
+    if (!statsdAddress.isEmpty()) {
+        StatsdIngest::instance()->listen(statsdAddress == "1" ? QString() : statsdAddress);
+    }
+    
+    // Opt-in collector plugins: "1" for the default directory, or a list of
+    // plugin files and directories
+    QString pluginPaths = qEnvironmentVariable("MILK_PLUGINS");
+    if (pluginPaths == "1") {
+        PluginHost::instance()->loadDirectory();
+    } else if (!pluginPaths.isEmpty()) {
+        for (const QString& path : pluginPaths.split(':', Qt::SkipEmptyParts)) {
+            if (QFileInfo(path).isDir()) PluginHost::instance()->loadDirectory(path);
+            else PluginHost::instance()->load(path);
+        }
+    }
+    
     // Connect quit signal
     connect(this, &QApplication::aboutToQuit, this, &Application::onAboutToQuit);
 }
 
 Application::~Application() {
+    m_controlServer.reset();
     cleanupWidgets();
     cleanupAPIs();
+    RenderCache::cleanup();
+    TimeSeries::closeAll();
     s_instance = nullptr;
 }
 
@@ -68,18 +104,66 @@ void Application::initializeSubsystems() {
 // ============================================================================
 
 QList<Widget*> Application::loadWidgets(const QString& xmlPath) {
+    QString path = QFileInfo(xmlPath).absoluteFilePath();
     XMLParser parser;
-    QList<Widget*> widgets = parser.parseFile(xmlPath);
+    QList<Widget*> widgets = parser.parseFile(path);
     
     for (Widget* w : widgets) {
+        // Remembered so the file can be reloaded on its own
+        w->setProperty("milk_source", path);
         registerWidget(w);
     }
+    if (!m_loadedFiles.contains(path)) {
+        m_loadedFiles.append(path);
+    }
     
     // Watch for changes
     if (m_autoReload) {
-        m_configWatcher->watch(xmlPath);
+        m_configWatcher->watch(path);
+    }
+    
+    return widgets;
+}
+
+QList<Widget*> Application::reloadWidgets(const QString& xmlPath) {
+    QString path = QFileInfo(xmlPath).absoluteFilePath();
+    
+    QList<Widget*> old;
+    bool wasVisible = false;
+    for (Widget* w : m_widgets) {
+        if (w->property("milk_source").toString() == path) {
+            old.append(w);
+            wasVisible = wasVisible || w->isVisible();
+        }
+    }
+    
+    // Parse before tearing anything down: a half-saved file must not
+    // leave the desktop empty
+    XMLParser parser;
+    QList<Widget*> widgets = parser.parseFile(path);
+    if (widgets.isEmpty() && parser.hasError()) {
+        log()->warning(QString("Reload of %1 failed, keeping current widgets: %2").arg(path, parser.lastError()));
+        return old;
+    }
+    
+    for (Widget* w : old) {
+        unregisterWidget(w);
+        w->hide();
+        w->deleteLater();
+    }
+    for (Widget* w : widgets) {
+        w->setProperty("milk_source", path);
+        registerWidget(w);
+        if (wasVisible || old.isEmpty()) {
+            w->show();
+        }
+    }
+    if (!m_loadedFiles.contains(path)) {
+        m_loadedFiles.append(path);
     }
     
+    log()->info(QString("Reloaded %1 widgets from %2").arg(widgets.size()).arg(path));
+    emit configReloaded();
     return widgets;
 }
 
@@ -120,6 +204,23 @@ void Application::unregisterWidget(Widget* widget) {
     }
 }
 
+QWidget* Application::findWidget(const QString& id) const {
+    if (id.isEmpty()) {
+        return nullptr;
+    }
+    for (Widget* w : m_widgets) {
+        if (w->objectName() == id) {
+            return w;
+        }
+    }
+    for (Widget* w : m_widgets) {
+        if (QWidget* child = w->findChild<QWidget*>(id)) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
 void Application::showAll() {
     for (Widget* w : m_widgets) {
         w->show();
@@ -256,17 +357,35 @@ void Application::setGlobalUpdateInterval(int ms) {
     }
 }
 
+void Application::setMemoryBudget(qint64 bytes) {
+    renderCache()->setBudget(bytes);
+}
+
+qint64 Application::memoryBudget() const {
+    return renderCache()->budget();
+}
+
+bool Application::startControlServer(const QString& path) {
+    if (!m_controlServer) {
+        m_controlServer = std::make_unique<ControlServer>(this);
+    }
+    return m_controlServer->isListening() || m_controlServer->listen(path);
+}
+
 void Application::onConfigChanged(const QString& path) {
     log()->info(QString("Config file changed: %1").arg(path));
     
-    // Reload widgets from changed file
-    // This is a simple implementation - could be smarter
-    emit configReloaded();
+    if (m_autoReload) {
+        reloadWidgets(path);
+    }
 }
 
 void Application::onAboutToQuit() {
+    m_controlServer.reset();
     cleanupWidgets();
     cleanupAPIs();
+    RenderCache::cleanup();
+    TimeSeries::closeAll();
 }
 
 // ============================================================================
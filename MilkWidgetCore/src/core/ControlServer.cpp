@@ -0,0 +1,465 @@
+/**
+ * MilkWidgetCore - Control Socket Implementation
+ *
+ * Length-prefixed frames over a Unix socket. Commands are parsed straight
+ * from the frame bytes and applied on the GUI thread, so a batch of pushes
+ * costs one wakeup and one repaint per touched element.
+ */
+
+#include "milk/Application.h"
+#include "milk/Widget.h"
+#include "milk/Widgets.h"
+#include "milk/Utils.h"
+#include "milk/APIs.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMetaProperty>
+#include <QStandardPaths>
+#include <QtEndian>
+
+namespace Milk {
+
+// ============================================================================
+// FRAMING
+// ============================================================================
+
+static void writeFrame(QIODevice* device, const QByteArray& payload) {
+    char header[4];
+    qToBigEndian<quint32>(quint32(payload.size()), header);
+    device->write(header, sizeof header);
+    device->write(payload);
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/** Next space-separated token of line starting at pos; advances pos */
+static QByteArray token(const QByteArray& line, int& pos) {
+    while (pos < line.size() && isSpace(line[pos])) ++pos;
+    int start = pos;
+    while (pos < line.size() && !isSpace(line[pos])) ++pos;
+    return line.mid(start, pos - start);
+}
+
+/** Everything after pos, for values that may contain spaces */
+static QByteArray remainder(const QByteArray& line, int pos) {
+    return line.mid(pos).trimmed();
+}
+
+// ============================================================================
+// ELEMENT ACCESS
+// ============================================================================
+
+static bool toNumber(const QByteArray& text, double* value, QString* error) {
+    bool ok = false;
+    *value = text.toDouble(&ok);
+    if (!ok) {
+        *error = QString("not a number: %1").arg(QString::fromUtf8(text));
+    }
+    return ok;
+}
+
+static bool toBool(const QByteArray& text) {
+    return text == "1" || text == "true" || text == "yes" || text == "on";
+}
+
+static bool pushValue(QWidget* target, const QByteArray& value, QString* error) {
+    double number = 0;
+    if (auto* graph = qobject_cast<Graph*>(target)) {
+        if (!toNumber(value, &number, error)) return false;
+        graph->addValue(number);
+    } else if (auto* bar = qobject_cast<ProgressBar*>(target)) {
+        if (!toNumber(value, &number, error)) return false;
+        bar->setValue(number);
+    } else if (auto* gauge = qobject_cast<Gauge*>(target)) {
+        if (!toNumber(value, &number, error)) return false;
+        gauge->setValue(number);
+    } else if (auto* text = qobject_cast<Text*>(target)) {
+        text->setText(QString::fromUtf8(value));
+    } else if (auto* image = qobject_cast<Image*>(target)) {
+        image->setSource(QString::fromUtf8(value));
+    } else {
+        *error = QString("%1 does not take values").arg(target->objectName());
+        return false;
+    }
+    return true;
+}
+
+static bool setElementProperty(QWidget* target, const QByteArray& name, const QByteArray& value, QString* error) {
+    QString text = QString::fromUtf8(value);
+    double number = 0;
+
+    if (name == "visible") {
+        target->setVisible(toBool(value));
+        return true;
+    }
+    if (name == "tooltip") {
+        target->setToolTip(text);
+        return true;
+    }
+
+    if (auto* label = qobject_cast<Text*>(target)) {
+        if (name == "text") { label->setText(text); return true; }
+        if (name == "html") { label->setHtml(text); return true; }
+        if (name == "color") { label->setColor(text); return true; }
+        if (name == "align") { label->setAlign(text); return true; }
+        if (name == "size") {
+            if (!toNumber(value, &number, error)) return false;
+            label->setFontSize(int(number));
+            return true;
+        }
+    } else if (auto* bar = qobject_cast<ProgressBar*>(target)) {
+        if (name == "fill") { bar->setFillColor(Color::parse(text)); return true; }
+        if (name == "value" || name == "min" || name == "max") {
+            if (!toNumber(value, &number, error)) return false;
+            if (name == "value") bar->setValue(number);
+            else if (name == "min") bar->setMinValue(number);
+            else bar->setMaxValue(number);
+            return true;
+        }
+    } else if (auto* gauge = qobject_cast<Gauge*>(target)) {
+        if (name == "label") { gauge->setLabel(text); return true; }
+        if (name == "unit") { gauge->setUnit(text); return true; }
+        if (name == "value") {
+            if (!toNumber(value, &number, error)) return false;
+            gauge->setValue(number);
+            return true;
+        }
+    } else if (auto* graph = qobject_cast<Graph*>(target)) {
+        if (name == "color") { graph->setLineColor(Color::parse(text)); return true; }
+        if (name == "fill") { graph->setFillColor(Color::parse(text)); return true; }
+        if (name == "min" || name == "max" || name == "points") {
+            if (!toNumber(value, &number, error)) return false;
+            if (name == "min") graph->setMinValue(number);
+            else if (name == "max") graph->setMaxValue(number);
+            else graph->setMaxPoints(int(number));
+            return true;
+        }
+    } else if (auto* image = qobject_cast<Image*>(target)) {
+        if (name == "source") { image->setSource(text); return true; }
+        if (name == "opacity") {
+            if (!toNumber(value, &number, error)) return false;
+            image->setOpacity(number);
+            return true;
+        }
+    } else if (auto* widget = qobject_cast<Widget*>(target)) {
+        if (name == "background") { widget->setBackground(text); return true; }
+    }
+
+    // Anything else Qt knows about: geometry, opacity, enabled, ...
+    int index = target->metaObject()->indexOfProperty(name.constData());
+    if (index < 0) {
+        *error = QString("unknown property: %1").arg(QString::fromUtf8(name));
+        return false;
+    }
+    if (!target->metaObject()->property(index).write(target, text)) {
+        *error = QString("cannot set %1 to %2").arg(QString::fromUtf8(name), text);
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// SERVER
+// ============================================================================
+
+ControlServer::ControlServer(Application* app)
+    : QObject(app)
+    , m_app(app)
+{
+    // Lookups are cached for push loops; any change to the widget set
+    // can make a cached id point at the wrong element
+    auto invalidate = [this]() { m_lookup.clear(); };
+    connect(app, &Application::widgetAdded, this, invalidate);
+    connect(app, &Application::widgetRemoved, this, invalidate);
+    connect(app, &Application::configReloaded, this, invalidate);
+}
+
+ControlServer::~ControlServer() {
+    close();
+    delete m_server;
+    m_server = nullptr;
+}
+
+QString ControlServer::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + "/milkwidget.sock";
+}
+
+bool ControlServer::listen(const QString& path) {
+    QString target = path.isEmpty() ? defaultPath() : path;
+    close();
+
+    // Only a stale file left by a crash may be removed; a live instance
+    // keeps its socket
+    QLocalSocket probe;
+    probe.connectToServer(target);
+    if (probe.waitForConnected(200)) {
+        QString message = QString("Control: another instance is listening on %1").arg(target);
+        log()->warning(message);
+        emit error(message);
+        return false;
+    }
+    QLocalServer::removeServer(target);
+
+    if (!m_server) {
+        m_server = new QLocalServer(this);
+        m_server->setSocketOptions(QLocalServer::UserAccessOption);
+        connect(m_server, &QLocalServer::newConnection, this, [this]() {
+            while (QLocalSocket* socket = m_server->nextPendingConnection()) accept(socket);
+        });
+    }
+    if (!m_server->listen(target)) {
+        QString message = QString("Control: cannot listen on %1: %2").arg(target, m_server->errorString());
+        log()->warning(message);
+        emit error(message);
+        return false;
+    }
+    log()->info(QString("Control: listening on %1").arg(m_server->fullServerName()));
+    return true;
+}
+
+void ControlServer::close() {
+    if (m_server) m_server->close();
+}
+
+bool ControlServer::isListening() const {
+    return m_server && m_server->isListening();
+}
+
+QString ControlServer::path() const {
+    return m_server ? m_server->fullServerName() : QString();
+}
+
+void ControlServer::accept(QLocalSocket* socket) {
+    ++m_stats.clients;
+    m_pending.insert(socket, QByteArray());
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readFrames(socket); });
+    connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+        if (m_pending.remove(socket) > 0) --m_stats.clients;
+        socket->deleteLater();
+    });
+    if (socket->bytesAvailable() > 0) readFrames(socket);
+}
+
+void ControlServer::readFrames(QLocalSocket* socket) {
+    auto it = m_pending.find(socket);
+    if (it == m_pending.end()) {
+        return;
+    }
+    QByteArray& buffer = it.value();
+    buffer.append(socket->readAll());
+
+    int offset = 0;
+    while (buffer.size() - offset >= 4) {
+        quint32 length = qFromBigEndian<quint32>(buffer.constData() + offset);
+        if (length > quint32(MaxFrameBytes)) {
+            log()->warning(QString("Control: dropping client that sent a %1 byte frame").arg(length));
+            m_pending.erase(it);
+            --m_stats.clients;
+            socket->abort();
+            socket->deleteLater();
+            return;
+        }
+        if (quint32(buffer.size() - offset - 4) < length) {
+            break;
+        }
+        QByteArray batch = QByteArray::fromRawData(buffer.constData() + offset + 4, int(length));
+        writeFrame(socket, execute(batch));
+        offset += 4 + int(length);
+    }
+    buffer.remove(0, offset);
+}
+
+QByteArray ControlServer::execute(const QByteArray& batch) {
+    ++m_stats.frames;
+    QByteArray reply;
+    reply.reserve(batch.count('\n') * 3 + 16);
+
+    int start = 0;
+    while (start < batch.size()) {
+        int end = batch.indexOf('\n', start);
+        if (end < 0) end = batch.size();
+        QByteArray line = batch.mid(start, end - start).trimmed();
+        start = end + 1;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        run(line, reply);
+    }
+    return reply;
+}
+
+QWidget* ControlServer::lookup(const QString& id) {
+    auto it = m_lookup.constFind(id);
+    if (it != m_lookup.constEnd() && it.value()) {
+        return it.value();
+    }
+    QWidget* widget = m_app->findWidget(id);
+    if (widget) {
+        m_lookup.insert(id, widget);
+    }
+    return widget;
+}
+
+void ControlServer::run(const QByteArray& line, QByteArray& reply) {
+    ++m_stats.commands;
+
+    int pos = 0;
+    QByteArray command = token(line, pos);
+    QString result;
+    QString failure;
+
+    auto target = [&](const QByteArray& id) -> QWidget* {
+        QWidget* widget = lookup(QString::fromUtf8(id));
+        if (!widget) failure = QString("no element with id %1").arg(QString::fromUtf8(id));
+        return widget;
+    };
+
+    if (command == "show" || command == "hide" || command == "toggle") {
+        QByteArray id = token(line, pos);
+        if (id.isEmpty()) {
+            if (command == "show") m_app->showAll();
+            else if (command == "hide") m_app->hideAll();
+            else m_app->toggleAll();
+        } else if (QWidget* widget = target(id)) {
+            bool visible = command == "show" || (command == "toggle" && widget->isHidden());
+            widget->setVisible(visible);
+        }
+    } else if (command == "reload") {
+        QByteArray file = remainder(line, pos);
+        QStringList files = file.isEmpty() ? m_app->loadedFiles() : QStringList{QString::fromUtf8(file)};
+        int count = 0;
+        for (const QString& path : files) {
+            count += m_app->reloadWidgets(path).size();
+        }
+        result = QString::number(count);
+    } else if (command == "set") {
+        QByteArray id = token(line, pos);
+        QByteArray name = token(line, pos);
+        if (name.isEmpty()) {
+            failure = "usage: set <id> <property> <value>";
+        } else if (QWidget* widget = target(id)) {
+            setElementProperty(widget, name, remainder(line, pos), &failure);
+        }
+    } else if (command == "push" || command == "graph" || command == "bar" || command == "gauge" ||
+               command == "text") {
+        QByteArray id = token(line, pos);
+        QWidget* widget = id.isEmpty() ? nullptr : target(id);
+        if (id.isEmpty()) {
+            failure = QString("usage: %1 <id> <value>").arg(QString::fromUtf8(command));
+        } else if (widget) {
+            bool typeOk = command == "push" ||
+                          (command == "graph" && qobject_cast<Graph*>(widget)) ||
+                          (command == "bar" && qobject_cast<ProgressBar*>(widget)) ||
+                          (command == "gauge" && qobject_cast<Gauge*>(widget)) ||
+                          (command == "text" && qobject_cast<Text*>(widget));
+            if (!typeOk) {
+                failure = QString("%1 is not a %2").arg(QString::fromUtf8(id), QString::fromUtf8(command));
+            } else {
+                pushValue(widget, remainder(line, pos), &failure);
+            }
+        }
+    } else if (command == "metric") {
+        QByteArray name = token(line, pos);
+        double number = 0;
+        if (name.isEmpty()) {
+            failure = "usage: metric <name> <value>";
+        } else if (toNumber(remainder(line, pos), &number, &failure)) {
+            MetricRegistry::instance()->set(QString::fromUtf8(name), number);
+        }
+    } else if (command == "list") {
+        QStringList ids;
+        for (Widget* w : m_app->widgets()) {
+            if (!w->objectName().isEmpty()) ids << w->objectName();
+            for (QWidget* child : w->findChildren<QWidget*>()) {
+                QString name = child->objectName();
+                if (!name.isEmpty() && !name.startsWith("qt_")) ids << name;
+            }
+        }
+        result = ids.join(' ');
+    } else if (command == "stats") {
+        int visible = 0;
+        for (Widget* w : m_app->widgets()) {
+            if (w->isVisible()) ++visible;
+        }
+        RenderCache::Stats cache = renderCache()->stats();
+        result = QString("widgets=%1 visible=%2 files=%3 clients=%4 frames=%5 commands=%6 errors=%7 "
+                         "cache_bytes=%8 cache_budget=%9")
+                     .arg(m_app->widgets().size())
+                     .arg(visible)
+                     .arg(m_app->loadedFiles().size())
+                     .arg(m_stats.clients)
+                     .arg(m_stats.frames)
+                     .arg(m_stats.commands)
+                     .arg(m_stats.errors)
+                     .arg(cache.bytes)
+                     .arg(cache.budget);
+    } else {
+        failure = QString("unknown command: %1").arg(QString::fromUtf8(command));
+    }
+
+    if (!failure.isEmpty()) {
+        ++m_stats.errors;
+        reply.append("err ").append(failure.toUtf8()).append('\n');
+    } else if (!result.isEmpty()) {
+        reply.append("ok ").append(result.toUtf8()).append('\n');
+    } else {
+        reply.append("ok\n");
+    }
+}
+
+// ============================================================================
+// CLIENT
+// ============================================================================
+
+ControlClient::ControlClient()
+    : m_socket(std::make_unique<QLocalSocket>())
+{
+}
+
+ControlClient::~ControlClient() = default;
+
+bool ControlClient::connectToServer(const QString& path, int timeoutMs) {
+    QString target = path.isEmpty() ? ControlServer::defaultPath() : path;
+    m_socket->connectToServer(target);
+    if (!m_socket->waitForConnected(timeoutMs)) {
+        m_error = QString("Cannot connect to %1: %2").arg(target, m_socket->errorString());
+        return false;
+    }
+    return true;
+}
+
+bool ControlClient::isConnected() const {
+    return m_socket->state() == QLocalSocket::ConnectedState;
+}
+
+bool ControlClient::request(const QByteArray& batch, QByteArray* reply, int timeoutMs) {
+    if (!isConnected()) {
+        m_error = "Not connected";
+        return false;
+    }
+    writeFrame(m_socket.get(), batch);
+    m_socket->flush();
+
+    // The server answers every frame with exactly one frame, so nothing
+    // past it can be buffered here
+    QByteArray buffer;
+    for (;;) {
+        if (buffer.size() >= 4) {
+            quint32 length = qFromBigEndian<quint32>(buffer.constData());
+            if (quint32(buffer.size() - 4) >= length) {
+                *reply = buffer.mid(4, int(length));
+                return true;
+            }
+        }
+        if (!m_socket->waitForReadyRead(timeoutMs)) {
+            m_error = QString("No reply: %1").arg(m_socket->errorString());
+            return false;
+        }
+        buffer.append(m_socket->readAll());
+    }
+}
+
+} // namespace Milk
@@ -8,6 +8,7 @@
 
 #include <QPainter>
 #include <QPainterPath>
+#include <QPaintEvent>
 #include <QScreen>
 #include <QGuiApplication>
 #include <QGraphicsDropShadowEffect>
@@ -15,6 +16,7 @@
 #include <QGraphicsOpacityEffect>
 #include <QTimer>
 #include <QFile>
+#include <QWindow>
 
 #ifdef Q_OS_LINUX
 #include <unistd.h>
@@ -137,9 +139,8 @@ void Widget::setMaxSize(int w, int h) {
     setMaximumSize(w, h);
 }
 
-void Widget::updateMask() {
+QPainterPath Widget::shapePath(const QRectF& rect) const {
     QPainterPath path;
-    QRectF rect = this->rect();
     
     switch (m_shape) {
         case Shape::Rectangle:
@@ -166,6 +167,11 @@ void Widget::updateMask() {
             break;
     }
     
+    return path;
+}
+
+void Widget::updateMask() {
+    QPainterPath path = shapePath(rect());
     QRegion region = QRegion(path.toFillPolygon().toPolygon());
     setMask(region);
 }
@@ -980,39 +986,42 @@ void Widget::toggle() {
 // ============================================================================
 
 void Widget::paintEvent(QPaintEvent* event) {
-    Q_UNUSED(event)
-    
+    // Chrome (background, image, border) only changes with style or size, so
+    // it is rendered once per device pixel ratio and blitted afterwards.
+    qreal dpr = devicePixelRatioF();
+    QPixmap chrome = renderCache()->fetch(chromeHash(), size(), dpr,
+        [this](QPainter& p, const QSize& s) { paintChrome(p, QRectF(QPointF(0, 0), s)); });
+    
+    // Copy back only the damaged parts. ProgressBar and Gauge report tight
+    // rects for a value change; a Graph sample scrolls the whole plot, and
+    // Text (QLabel) and Image repaint their own rect
     QPainter painter(this);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    qint64 pixels = 0;
+    for (const QRect& r : event->region()) {
+        QRectF source(QPointF(r.topLeft()) * dpr, QSizeF(r.size()) * dpr);
+        painter.drawPixmap(QRectF(r), chrome, source);
+        pixels += qint64(source.width()) * qint64(source.height());
+    }
+    
+    m_repaintStats.lastFramePixels = pixels;
+    m_repaintStats.totalPixels += pixels;
+    m_repaintStats.frames++;
+}
+
+quint64 Widget::chromeHash() const {
+    ContentHash h;
+    h << int(m_shape) << m_cornerRadius << m_bgColor
+      << m_bgGradient.start << m_bgGradient.end << m_bgImage
+      << m_border.color << m_border.width;
+    return h.value();
+}
+
+void Widget::paintChrome(QPainter& painter, const QRectF& rect) {
     painter.setRenderHint(QPainter::Antialiasing, true);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
     
-    QPainterPath path;
-    QRectF rect = this->rect();
-    
-    switch (m_shape) {
-        case Shape::Rectangle:
-            path.addRect(rect);
-            break;
-        case Shape::RoundedRect:
-            path.addRoundedRect(rect, m_cornerRadius, m_cornerRadius);
-            break;
-        case Shape::Circle: {
-            qreal diameter = qMin(rect.width(), rect.height());
-            qreal radius = diameter / 2.0;
-            QPointF center = rect.center();
-            path.addEllipse(center.x() - radius, center.y() - radius, diameter, diameter);
-            break;
-        }
-        case Shape::Ellipse:
-            path.addEllipse(rect);
-            break;
-        case Shape::Square:
-            path.addRect(rect);
-            break;
-        case Shape::Custom:
-            path.addRect(rect);
-            break;
-    }
+    QPainterPath path = shapePath(rect);
     
     // Background
     if (m_bgGradient.isValid()) {
@@ -1028,7 +1037,8 @@ void Widget::paintEvent(QPaintEvent* event) {
     
     // Background image
     if (!m_bgImage.isEmpty()) {
-        QPixmap pixmap(m_bgImage);
+        qreal dpr = painter.device()->devicePixelRatioF();
+        QPixmap pixmap = renderCache()->decode(m_bgImage, (rect.size() * dpr).toSize());
         if (!pixmap.isNull()) {
             painter.setClipPath(path);
             painter.drawPixmap(rect.toRect(), pixmap);
@@ -1097,6 +1107,16 @@ void Widget::resizeEvent(QResizeEvent* event) {
 void Widget::showEvent(QShowEvent* event) {
     QWidget::showEvent(event);
     m_initialized = true;
+    
+    // Moving to a monitor with another scale factor changes devicePixelRatioF(),
+    // which selects a different cache key on the next paint.
+    if (!m_screenTracked && windowHandle()) {
+        connect(windowHandle(), &QWindow::screenChanged, this, [this]() {
+            updateMask();
+            update();
+        });
+        m_screenTracked = true;
+    }
 }
 
 void Widget::hideEvent(QHideEvent* event) {
@@ -6,8 +6,10 @@
 
 #include <milk/MilkWidget.h>
 #include <QCommandLineParser>
+#include <QCoreApplication>
 #include <QFileInfo>
 #include <iostream>
+#include <string>
 
 using namespace Milk;
 
@@ -17,18 +19,108 @@ void printUsage() {
               << "Options:\n"
               << "  -h, --help           Show this help\n"
               << "  -v, --version        Show version\n"
-              << "  -d, --daemon         Run as daemon (background)\n"
+              << "  -d, --daemon         Keep running without widgets, serving the control socket\n"
               << "  -t, --theme <name>   Load theme\n"
               << "  -c, --config <dir>   Config directory\n"
               << "  --list-themes        List available themes\n"
+              << "  --memory-budget <mb> Image/render cache budget\n"
+              << "  --socket <path>      Control socket (default $XDG_RUNTIME_DIR/milkwidget.sock)\n"
+              << "  --send <commands>    Send commands to a running instance; - reads stdin\n"
+              << "  --plugin <path>      Load a collector plugin, or every plugin in a directory\n"
               << "\nExamples:\n"
               << "  milkwidget system_monitor.xml\n"
               << "  milkwidget -t dark ~/.config/milkwidget/*.xml\n"
-              << "  milkwidget --daemon\n";
+              << "  milkwidget --daemon\n"
+              << "  milkwidget --send 'graph cpu 42.0'\n"
+              << "  sensors-loop | milkwidget --send -\n";
+}
+
+/**
+ * Client mode: forward commands to a running instance and print what comes
+ * back. Runs without a GUI application so it never creates widgets, the
+ * tray or listeners of its own.
+ */
+static int runClient(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    QCommandLineOption sendOpt("send", "Commands to send", "commands");
+    parser.addOption(sendOpt);
+    QCommandLineOption socketOpt("socket", "Control socket", "path");
+    parser.addOption(socketOpt);
+    // Runner options may be present too; they mean nothing here
+    parser.parse(app.arguments());
+    
+    ControlClient client;
+    if (!client.connectToServer(parser.value(socketOpt))) {
+        std::cerr << client.errorString().toStdString() << "\n";
+        return 1;
+    }
+    
+    int failures = 0;
+    auto submit = [&](const QByteArray& batch) {
+        QByteArray reply;
+        if (!client.request(batch, &reply)) {
+            std::cerr << client.errorString().toStdString() << "\n";
+            return false;
+        }
+        for (const QByteArray& line : reply.split('\n')) {
+            if (line.startsWith("err ")) {
+                ++failures;
+                std::cerr << line.constData() << "\n";
+            } else if (line.startsWith("ok ")) {
+                std::cout << line.constData() + 3 << "\n";
+            }
+        }
+        std::cout.flush();
+        return true;
+    };
+    
+    QByteArray batch;
+    bool fromStdin = false;
+    for (const QString& commands : parser.values(sendOpt)) {
+        if (commands == "-") {
+            fromStdin = true;
+        } else {
+            batch.append(commands.toUtf8()).append('\n');
+        }
+    }
+    if (!batch.isEmpty() && !submit(batch)) {
+        return 1;
+    }
+    
+    if (fromStdin) {
+        // Lines are batched while more input is already buffered, so a fast
+        // producer gets few large frames and a slow one gets no added latency
+        std::ios::sync_with_stdio(false);
+        const int MaxBatchLines = 512;
+        std::string line;
+        batch.clear();
+        int lines = 0;
+        while (std::getline(std::cin, line)) {
+            batch.append(line.data(), int(line.size())).append('\n');
+            if (++lines >= MaxBatchLines || std::cin.rdbuf()->in_avail() <= 0) {
+                if (!submit(batch)) return 1;
+                batch.clear();
+                lines = 0;
+            }
+        }
+        if (!batch.isEmpty() && !submit(batch)) {
+            return 1;
+        }
+    }
+    
+    return failures > 0 ? 1 : 0;
 }
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--send") == 0 || qstrncmp(argv[i], "--send=", 7) == 0) {
+            return runClient(argc, argv);
+        }
+    }
+    
     Application app(argc, argv);
     app.setApplicationName("MilkWidget");
     app.setApplicationVersion(MILK_VERSION_STRING);
@@ -38,7 +130,7 @@ int main(int argc, char *argv[])
     parser.addHelpOption();
     parser.addVersionOption();
     
-    QCommandLineOption daemonOpt({"d", "daemon"}, "Run as daemon");
+    QCommandLineOption daemonOpt({"d", "daemon"}, "Keep running without widgets, serving the control socket");
     parser.addOption(daemonOpt);
     
     QCommandLineOption themeOpt({"t", "theme"}, "Load theme", "name");
@@ -50,6 +142,18 @@ int main(int argc, char *argv[])
     QCommandLineOption listThemesOpt("list-themes", "List available themes");
     parser.addOption(listThemesOpt);
     
+    QCommandLineOption memoryOpt("memory-budget", "Image/render cache budget in MB", "mb");
+    parser.addOption(memoryOpt);
+    
+    QCommandLineOption socketOpt("socket", "Control socket path", "path");
+    parser.addOption(socketOpt);
+    
+    QCommandLineOption sendOpt("send", "Send commands to a running instance; - reads stdin", "commands");
+    parser.addOption(sendOpt);
+    
+    QCommandLineOption pluginOpt("plugin", "Load a collector plugin, or every plugin in a directory", "path");
+    parser.addOption(pluginOpt);
+    
     parser.addPositionalArgument("files", "Widget XML files to load", "[files...]");
     
     parser.process(app);
@@ -63,6 +167,19 @@ int main(int argc, char *argv[])
         return 0;
     }
     
+    // Memory budget
+    if (parser.isSet(memoryOpt)) {
+        bool ok = false;
+        qint64 mb = parser.value(memoryOpt).toLongLong(&ok);
+        // Up to a terabyte, so the byte count cannot overflow
+        if (!ok || mb <= 0 || mb > 1024 * 1024) {
+            log()->error(QString("--memory-budget: expected megabytes from 1 to 1048576, got \"%1\"")
+                         .arg(parser.value(memoryOpt)));
+            return 1;
+        }
+        app.setMemoryBudget(mb * 1024 * 1024);
+    }
+    
     // Set config directory
     if (parser.isSet(configOpt)) {
         app.setConfigDir(parser.value(configOpt));
@@ -73,6 +190,17 @@ int main(int argc, char *argv[])
         app.loadTheme(parser.value(themeOpt));
     }
     
+    // Collector plugins
+    for (const QString& path : parser.values(pluginOpt)) {
+        if (QFileInfo(path).isDir()) {
+            plugins()->loadDirectory(path);
+        } else {
+            plugins()->load(path);
+        }
+    }
+    
+    bool daemon = parser.isSet(daemonOpt);
+    
     // Load widget files
     QStringList files = parser.positionalArguments();
     
@@ -88,7 +216,7 @@ int main(int argc, char *argv[])
         }
     }
     
-    if (files.isEmpty()) {
+    if (files.isEmpty() && !daemon) {
         log()->info("No widget files specified. Use --help for usage.");
         printUsage();
         return 1;
@@ -106,13 +234,22 @@ int main(int argc, char *argv[])
         }
     }
     
-    if (loaded == 0) {
+    if (loaded == 0 && !daemon) {
         log()->error("No widgets loaded.");
         return 1;
     }
     
     log()->info(QString("Total %1 widgets loaded.").arg(loaded));
     
+    // A daemon is only reachable through its socket, so failing to get it
+    // is fatal there; a plain run keeps going without one
+    if (!app.startControlServer(parser.value(socketOpt)) && daemon) {
+        return 1;
+    }
+    if (daemon) {
+        app.setQuitOnLastWindowClosed(false);
+    }
+    
     // Enable system tray
     app.enableTrayIcon(true);
     app.setTrayTooltip(QString("MilkWidget (%1 widgets)").arg(loaded));
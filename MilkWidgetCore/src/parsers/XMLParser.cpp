@@ -6,13 +6,441 @@
 #include "milk/Widget.h"
 #include "milk/Widgets.h"
 #include "milk/Utils.h"
+#include "milk/APIs.h"
 
 #include <QFile>
 #include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
 #include <QTextStream>
+#include <memory>
+#include <utility>
 
 namespace Milk {
 
+/**
+ * Attributes holding {expressions}, e.g. color="{cpu > 90 ? '#f44' : '#4f4'}"
+ * or text="{fmtBytes(net.rx)}/s". Each is compiled once and re-run only
+ * when one of the metrics it reads changes; the widget is touched only
+ * when the result does.
+ */
+static void bindExpressions(QWidget* target, const QDomElement& elem) {
+    static const char* const attributes[] = {"text", "color", "fill", "value", "visible"};
+    
+    for (const char* attribute : attributes) {
+        QString source = elem.attribute(attribute);
+        if (!Expression::isTemplate(source)) {
+            continue;
+        }
+        
+        QString name = QString::fromLatin1(attribute);
+        std::function<void(const Expression&)> apply;
+        if (name == "text") {
+            if (auto* text = qobject_cast<Text*>(target)) {
+                apply = [text](const Expression& e) { text->setText(e.toString()); };
+            } else if (auto* button = qobject_cast<Button*>(target)) {
+                apply = [button](const Expression& e) { button->setText(e.toString()); };
+            }
+        } else if (name == "color" || name == "fill") {
+            if (auto* text = qobject_cast<Text*>(target)) {
+                apply = [text](const Expression& e) { text->setColor(Color::parse(e.toString())); };
+            } else if (auto* bar = qobject_cast<ProgressBar*>(target)) {
+                apply = [bar](const Expression& e) { bar->setFillColor(Color::parse(e.toString())); };
+            } else if (auto* graph = qobject_cast<Graph*>(target)) {
+                apply = [graph](const Expression& e) { graph->setLineColor(Color::parse(e.toString())); };
+            } else if (auto* button = qobject_cast<Button*>(target)) {
+                apply = [button](const Expression& e) { button->setTextColor(Color::parse(e.toString())); };
+            }
+        } else if (name == "value") {
+            if (auto* bar = qobject_cast<ProgressBar*>(target)) {
+                apply = [bar](const Expression& e) { bar->setValue(e.number()); };
+            } else if (auto* gauge = qobject_cast<Gauge*>(target)) {
+                apply = [gauge](const Expression& e) { gauge->setValue(e.number()); };
+            }
+        } else if (name == "visible") {
+            apply = [target](const Expression& e) { target->setVisible(e.number() != 0); };
+        }
+        if (!apply) {
+            log()->warning(QString("<%1 %2>: expressions are not supported here").arg(elem.tagName(), name));
+            continue;
+        }
+        
+        QString error;
+        std::shared_ptr<Expression> expression = Expression::compileTemplate(source, &error);
+        if (!expression) {
+            log()->warning(QString("<%1 %2=\"%3\">: %4").arg(elem.tagName(), name, source, error));
+            continue;
+        }
+        
+        // Start from the values the registry already has, then follow them
+        MetricRegistry* registry = MetricRegistry::instance();
+        const QStringList& inputs = expression->inputs();
+        for (int slot = 0; slot < inputs.size(); ++slot) {
+            expression->setInput(slot, registry->value(inputs[slot], 0));
+        }
+        expression->evaluate();
+        apply(*expression);
+        for (int slot = 0; slot < inputs.size(); ++slot) {
+            registry->bind(inputs[slot], target, [expression, slot, apply](double value) {
+                if (expression->setInput(slot, value) && expression->evaluate()) {
+                    apply(*expression);
+                }
+            });
+        }
+    }
+}
+
+/**
+ * Attributes every child element understands: id, {expressions}, and
+ * metric="name" to follow a MetricRegistry value. Text elements use their
+ * content as the format, with %1 standing for the value.
+ */
+static void parseCommonAttributes(QWidget* target, const QDomElement& elem) {
+    if (elem.hasAttribute("id")) {
+        // Ids make elements addressable from the control socket
+        target->setObjectName(elem.attribute("id"));
+    }
+    bindExpressions(target, elem);
+    if (!elem.hasAttribute("metric")) {
+        return;
+    }
+    
+    QString metric = elem.attribute("metric");
+    MetricRegistry* registry = MetricRegistry::instance();
+    if (auto* graph = qobject_cast<Graph*>(target)) {
+        // Start from what the registry already has instead of an empty plot
+        for (double value : registry->history(metric)) graph->addValue(value);
+        registry->bind(metric, graph, [graph](double value) { graph->addValue(value); });
+        return;
+    }
+    if (auto* bar = qobject_cast<ProgressBar*>(target)) {
+        registry->bind(metric, bar, [bar](double value) { bar->setValue(value); });
+    } else if (auto* gauge = qobject_cast<Gauge*>(target)) {
+        registry->bind(metric, gauge, [gauge](double value) { gauge->setValue(value); });
+    } else if (auto* text = qobject_cast<Text*>(target)) {
+        QString format = elem.text().contains("%1") ? elem.text() : QString("%1");
+        int precision = elem.attribute("precision", "1").toInt();
+        registry->bind(metric, text, [text, format, precision](double value) {
+            text->setText(format.arg(value, 0, 'f', precision));
+        });
+    }
+}
+
+/** "10s", "500ms", "2m" or plain seconds */
+static int parseDuration(const QString& value) {
+    QString v = value.trimmed().toLower();
+    if (v.endsWith("ms")) return v.chopped(2).toInt();
+    if (v.endsWith('m')) return int(v.chopped(1).toDouble() * 60000);
+    if (v.endsWith('s')) v.chop(1);
+    return int(v.toDouble() * 1000);
+}
+
+/**
+ * <alert name="hot" when="sys.temperature > 85" for="10s"
+ *        clear="sys.temperature < 80" every="5m" notify="CPU is hot"/>
+ * sits beside the <widget> elements; widgets follow it as alert.hot.
+ */
+static AlertRules::Rule parseAlert(const QDomElement& elem) {
+    AlertRules::Rule rule;
+    rule.name = elem.attribute("name");
+    rule.condition = elem.attribute("when");
+    rule.clear = elem.attribute("clear");
+    rule.holdMs = parseDuration(elem.attribute("for", "0"));
+    rule.clearHoldMs = parseDuration(elem.attribute("clear-for", "0"));
+    rule.minIntervalMs = parseDuration(elem.attribute("every", "0"));
+    rule.message = elem.attribute("notify");
+    return rule;
+}
+
+/**
+ * Style attributes of an item element. Elements with the same attributes
+ * share one ItemStyle, so a grid of identical cells costs a single style.
+ */
+static int parseItemStyle(ItemView* view, const QDomElement& elem, QHash<QString, int>& styles) {
+    static const char* const keys[] = {"color", "background", "track", "font", "bold", "radius", "bar-height", "align"};
+    QString key;
+    bool any = false;
+    for (const char* name : keys) {
+        QString value = elem.attribute(name);
+        any = any || !value.isEmpty();
+        key += value + QChar(0x1f);
+    }
+    if (!any) {
+        return 0;
+    }
+    auto it = styles.constFind(key);
+    if (it != styles.constEnd()) {
+        return it.value();
+    }
+    
+    ItemStyle style = view->style(0);
+    if (elem.hasAttribute("color")) style.color = Color::parse(elem.attribute("color"));
+    if (elem.hasAttribute("background")) style.background = Color::parse(elem.attribute("background"));
+    if (elem.hasAttribute("track")) style.track = Color::parse(elem.attribute("track"));
+    if (elem.hasAttribute("font")) {
+        QStringList parts = elem.attribute("font").split(' ');
+        style.font.setFamily(parts[0]);
+        if (parts.size() >= 2) style.font.setPointSize(parts[1].remove("px").toInt());
+    }
+    if (elem.hasAttribute("bold")) style.font.setBold(elem.attribute("bold") == "true");
+    if (elem.hasAttribute("radius")) style.radius = elem.attribute("radius").toInt();
+    if (elem.hasAttribute("bar-height")) style.barHeight = elem.attribute("bar-height").toInt();
+    if (elem.hasAttribute("align")) {
+        QString align = elem.attribute("align").toLower();
+        if (align == "center") style.align = Qt::AlignCenter;
+        else if (align == "right") style.align = Qt::AlignRight | Qt::AlignVCenter;
+        else style.align = Qt::AlignLeft | Qt::AlignVCenter;
+    }
+    
+    int index = view->addStyle(style);
+    styles.insert(key, index);
+    return index;
+}
+
+static ItemView::Direction parseItemDirection(const QString& value) {
+    QString v = value.toLower();
+    if (v == "row" || v == "horizontal") return ItemView::Row;
+    if (v == "stack") return ItemView::Stack;
+    return ItemView::Column;
+}
+
+static void parseItems(ItemView* view, int parent, const QDomElement& elem, QHash<QString, int>& styles) {
+    for (QDomElement child = elem.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        QString tag = child.tagName().toLower();
+        int style = parseItemStyle(view, child, styles);
+        QString metric = child.attribute("metric");
+        int item = -1;
+        
+        if (tag == "row" || tag == "column" || tag == "stack") {
+            item = view->addBox(parent, parseItemDirection(tag), child.attribute("gap", "0").toInt(),
+                                child.attribute("padding", "0").toInt(), style);
+            parseItems(view, item, child, styles);
+        } else if (tag == "label" || tag == "text") {
+            QString format = child.text().contains("%1") ? child.text() : QString("%1");
+            item = view->addLabel(parent, metric.isEmpty() ? child.text() : QString(), style);
+            if (!metric.isEmpty()) {
+                int precision = child.attribute("precision", "1").toInt();
+                MetricRegistry::instance()->bind(metric, view, [view, item, format, precision](double value) {
+                    view->setText(item, format.arg(value, 0, 'f', precision));
+                });
+            }
+        } else if (tag == "bar") {
+            item = view->addBar(parent, child.attribute("value", "0").toDouble(),
+                                child.attribute("max", "100").toDouble(), style);
+            if (!metric.isEmpty()) {
+                MetricRegistry::instance()->bind(metric, view, [view, item](double value) {
+                    view->setValue(item, value);
+                });
+            }
+        } else if (tag == "space" || tag == "spacer") {
+            item = view->addSpace(parent, child.attribute("size", "-1").toInt());
+        }
+        if (item < 0) {
+            continue;
+        }
+        
+        if (child.hasAttribute("grow")) view->setGrow(item, child.attribute("grow").toDouble());
+        if (child.hasAttribute("size") && tag != "space" && tag != "spacer") {
+            view->setSize(item, child.attribute("size").toInt());
+        }
+        if (child.hasAttribute("id")) view->setName(item, child.attribute("id"));
+    }
+}
+
+// ============================================================================
+// TEMPLATES
+// ============================================================================
+
+/** Values usable in ${...} anywhere in a template, e.g. ${sys.cpuCores} */
+static bool resolveVariable(const QString& name, QString* value) {
+    if (name == "sys.cpuCores") {
+        *value = QString::number(SystemMonitor::instance()->cpuCores());
+        return true;
+    }
+    return false;
+}
+
+/** Loop variables a <repeat> or <for-each> binds in its body; none for other elements */
+static QStringList loopVariables(const QDomElement& elem) {
+    QString tag = elem.tagName().toLower();
+    if (tag == "repeat") return {elem.attribute("var", "i")};
+    if (tag == "for-each" || tag == "foreach") return {elem.attribute("index", "i"), elem.attribute("var", "item")};
+    return {};
+}
+
+/**
+ * The body of a <repeat> or <for-each>, resolved once: a private copy of
+ * its DOM and a list of the attributes and text that mention the loop
+ * variables, each split into literal and variable pieces. A copy is made
+ * by rewriting just those places and building the body's elements; the
+ * file is not read again and nothing else is re-resolved.
+ */
+class RepeatPrototype {
+public:
+    RepeatPrototype(const QDomElement& elem, const QString& indexVar, const QString& entryVar)
+        : m_indexVar(indexVar)
+        , m_entryVar(entryVar)
+    {
+        m_root = m_doc.importNode(elem, true).toElement();
+        m_doc.appendChild(m_root);
+        for (QDomNode child = m_root.firstChild(); !child.isNull(); child = child.nextSibling()) {
+            collect(child, m_indexVar, m_entryVar);
+        }
+    }
+    
+    /** Body elements with the variables of copy @p index written in */
+    QList<QDomElement> instantiate(int index, const QString& entry) {
+        for (const Slot& slot : std::as_const(m_slots)) {
+            QString value;
+            for (const Segment& segment : slot.segments) {
+                if (segment.var == Index) value += QString::number(index + segment.offset);
+                else if (segment.var == Entry) value += entry;
+                else value += segment.text;
+            }
+            // A copy of the handle: the node itself is shared, not const
+            QDomNode node = slot.node;
+            if (slot.attribute.isEmpty()) node.setNodeValue(value);
+            else node.toElement().setAttribute(slot.attribute, value);
+        }
+        QList<QDomElement> body;
+        for (QDomElement child = m_root.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+            body << child;
+        }
+        return body;
+    }
+    
+    /** ${...} in a single value with no loop variables, such as count */
+    static QString resolve(const QString& value) {
+        bool dynamic = false;
+        return join(compile(value, QString(), QString(), &dynamic));
+    }
+    
+private:
+    enum Var { Literal, Index, Entry };
+    
+    struct Segment {
+        QString text;
+        Var var = Literal;
+        int offset = 0;  // ${i+1}
+    };
+    
+    struct Slot {
+        QDomNode node;
+        QString attribute;  // Empty for a text node
+        QVector<Segment> segments;
+    };
+    
+    /** @p indexVar and @p entryVar are empty where a nested loop rebinds them */
+    void collect(const QDomNode& node, QString indexVar, QString entryVar) {
+        bool dynamic = false;
+        if (node.isText()) {
+            QVector<Segment> segments = compile(node.nodeValue(), indexVar, entryVar, &dynamic);
+            if (dynamic) m_slots.append({node, QString(), segments});
+            else if (node.nodeValue().contains("${")) node.toText().setData(join(segments));
+            return;
+        }
+        if (!node.isElement()) return;
+        
+        QDomElement elem = node.toElement();
+        QDomNamedNodeMap attributes = elem.attributes();
+        for (int i = 0; i < attributes.count(); ++i) {
+            QDomAttr attr = attributes.item(i).toAttr();
+            if (!attr.value().contains("${")) continue;
+            QVector<Segment> segments = compile(attr.value(), indexVar, entryVar, &dynamic);
+            if (dynamic) m_slots.append({elem, attr.name(), segments});
+            else attr.setValue(join(segments));
+            dynamic = false;
+        }
+        
+        // A nested loop's own attributes (count="${i}") are ours, but in its
+        // body its variables are its own: left as text for its prototype
+        const QStringList shadowed = loopVariables(elem);
+        if (shadowed.contains(indexVar)) indexVar.clear();
+        if (shadowed.contains(entryVar)) entryVar.clear();
+        for (QDomNode child = node.firstChild(); !child.isNull(); child = child.nextSibling()) {
+            collect(child, indexVar, entryVar);
+        }
+    }
+    
+    static QVector<Segment> compile(const QString& value, const QString& indexVar, const QString& entryVar,
+                                    bool* dynamic) {
+        static const QRegularExpression pattern("^([A-Za-z_][\\w.]*)\\s*(?:([+-])\\s*(\\d+))?$");
+        QVector<Segment> segments;
+        int pos = 0;
+        while (pos < value.size()) {
+            int open = value.indexOf("${", pos);
+            int close = open >= 0 ? value.indexOf('}', open) : -1;
+            if (open < 0 || close < 0) {
+                segments.append({value.mid(pos), Literal, 0});
+                break;
+            }
+            if (open > pos) segments.append({value.mid(pos, open - pos), Literal, 0});
+            
+            QString expression = value.mid(open + 2, close - open - 2).trimmed();
+            QRegularExpressionMatch match = pattern.match(expression);
+            QString name = match.captured(1);
+            int offset = match.captured(3).toInt() * (match.captured(2) == "-" ? -1 : 1);
+            QString resolved;
+            if (match.hasMatch() && !indexVar.isEmpty() && name == indexVar) {
+                segments.append({QString(), Index, offset});
+                *dynamic = true;
+            } else if (match.hasMatch() && !entryVar.isEmpty() && name == entryVar) {
+                segments.append({QString(), Entry, 0});
+                *dynamic = true;
+            } else if (match.hasMatch() && resolveVariable(name, &resolved)) {
+                if (offset != 0) resolved = QString::number(resolved.toInt() + offset);
+                segments.append({resolved, Literal, 0});
+            } else {
+                // Unknown here, maybe a variable of a nested template: keep it
+                segments.append({value.mid(open, close - open + 1), Literal, 0});
+            }
+            pos = close + 1;
+        }
+        return segments;
+    }
+    
+    static QString join(const QVector<Segment>& segments) {
+        QString text;
+        for (const Segment& segment : segments) text += segment.text;
+        return text;
+    }
+    
+    QDomDocument m_doc;
+    QDomElement m_root;
+    QString m_indexVar;
+    QString m_entryVar;
+    QVector<Slot> m_slots;
+};
+
+/** Lists a <for-each in="..."> can walk; all but cores follow the monitor's samples */
+static Repeater::Source collectionSource(const QString& name) {
+    if (name == "cores") {
+        return []() {
+            QStringList cores;
+            for (int i = 0; i < SystemMonitor::instance()->cpuCores(); ++i) cores << QString::number(i);
+            return cores;
+        };
+    }
+    if (name == "interfaces") {
+        return []() {
+            QStringList names;
+            for (const auto& iface : SystemMonitor::instance()->snapshot()->interfaces) names << iface.name;
+            return names;
+        };
+    }
+    if (name == "mounts") {
+        return []() {
+            QStringList mounts;
+            for (const auto& fs : SystemMonitor::instance()->snapshot()->filesystems) mounts << fs.mountPoint;
+            return mounts;
+        };
+    }
+    if (name == "sensors") {
+        return []() { return SystemMonitor::instance()->snapshot()->temperatures.keys(); };
+    }
+    return Repeater::Source();
+}
+
 XMLParser::XMLParser(QObject* parent)
     : QObject(parent)
 {
@@ -46,6 +474,7 @@ QList<Widget*> XMLParser::parseFile(const QString& path) {
     file.close();
     
     QDomElement root = doc.documentElement();
+    QList<AlertRules::Rule> alerts;
     
     // Handle root element
     if (root.tagName() == "widgets" || root.tagName() == "milk") {
@@ -60,6 +489,8 @@ QList<Widget*> XMLParser::parseFile(const QString& path) {
                         widgets.append(w);
                         emit widgetCreated(w);
                     }
+                } else if (elem.tagName() == "alert") {
+                    alerts.append(parseAlert(elem));
                 }
             }
             child = child.nextSibling();
@@ -73,6 +504,16 @@ QList<Widget*> XMLParser::parseFile(const QString& path) {
         }
     }
     
+    // Reloading a file drops the alerts it no longer defines; files that
+    // never had any don't start the alert engine
+    static QSet<QString> alertFiles;
+    const QString source = QFileInfo(path).absoluteFilePath();
+    if (!alerts.isEmpty() || alertFiles.contains(source)) {
+        AlertRules::instance()->replaceRules(source, alerts);
+        if (alerts.isEmpty()) alertFiles.remove(source);
+        else alertFiles.insert(source);
+    }
+    
     return widgets;
 }
 
@@ -101,6 +542,8 @@ QList<Widget*> XMLParser::parseString(const QString& xml) {
                 if (elem.tagName() == "widget") {
                     Widget* w = parseWidget(elem);
                     if (w) widgets.append(w);
+                } else if (elem.tagName() == "alert") {
+                    AlertRules::instance()->addRule(parseAlert(elem));
                 }
             }
             child = child.nextSibling();
@@ -120,6 +563,11 @@ Widget* XMLParser::parseWidget(const QDomElement& elem) {
     
     Widget* widget = Widget::create(width, height);
     
+    // Ids make widgets addressable from the control socket
+    if (elem.hasAttribute("id")) {
+        widget->setObjectName(elem.attribute("id"));
+    }
+    
     // Parse properties
     parseWidgetProperties(widget, elem);
     
@@ -246,7 +694,7 @@ void XMLParser::parseChildren(Widget* parent, const QDomElement& elem) {
     while (!child.isNull()) {
         if (child.isElement()) {
             QDomElement childElem = child.toElement();
-            QWidget* childWidget = parseChildElement(childElem, parent);
+            QWidget* childWidget = parseElement(childElem, parent);
             if (childWidget) {
                 parent->addWidget(childWidget);
             }
@@ -255,6 +703,14 @@ void XMLParser::parseChildren(Widget* parent, const QDomElement& elem) {
     }
 }
 
+QWidget* XMLParser::parseElement(const QDomElement& elem, Widget* parent) {
+    QWidget* widget = parseChildElement(elem, parent);
+    if (widget) {
+        parseCommonAttributes(widget, elem);
+    }
+    return widget;
+}
+
 QWidget* XMLParser::parseChildElement(const QDomElement& elem, Widget* parent) {
     QString tag = elem.tagName().toLower();
     
@@ -379,6 +835,13 @@ QWidget* XMLParser::parseChildElement(const QDomElement& elem, Widget* parent) {
         if (elem.hasAttribute("grid")) {
             graph->setShowGrid(elem.attribute("grid") == "true");
         }
+        if (elem.hasAttribute("renderer")) {
+            graph->setRenderBackend(parseRenderBackend(elem.attribute("renderer")));
+        }
+        if (elem.hasAttribute("history")) {
+            // max-points is applied above, so the history is bucketed to fit
+            graph->loadHistory(elem.attribute("history"), elem.attribute("history-span", "86400").toInt());
+        }
         
         return graph;
     }
@@ -412,6 +875,9 @@ QWidget* XMLParser::parseChildElement(const QDomElement& elem, Widget* parent) {
         if (elem.hasAttribute("unit")) {
             gauge->setUnit(elem.attribute("unit"));
         }
+        if (elem.hasAttribute("renderer")) {
+            gauge->setRenderBackend(parseRenderBackend(elem.attribute("renderer")));
+        }
         
         return gauge;
     }
@@ -451,6 +917,62 @@ QWidget* XMLParser::parseChildElement(const QDomElement& elem, Widget* parent) {
         return button;
     }
     
+    // Templates: the body is resolved once and copied per entry
+    if (tag == "repeat" || tag == "for-each" || tag == "foreach") {
+        bool forEach = tag != "repeat";
+        Container::Layout layout = Container::Vertical;
+        if (elem.attribute("layout") == "horizontal") layout = Container::Horizontal;
+        else if (elem.attribute("layout") == "grid" || elem.hasAttribute("columns")) layout = Container::Grid;
+        
+        Repeater* repeater = Repeater::create(layout, parent);
+        if (elem.hasAttribute("columns")) {
+            repeater->setColumns(elem.attribute("columns").toInt());
+        }
+        if (elem.hasAttribute("spacing")) {
+            repeater->setSpacing(elem.attribute("spacing").toInt());
+        }
+        
+        QString indexVar = forEach ? elem.attribute("index", "i") : elem.attribute("var", "i");
+        QString entryVar = forEach ? elem.attribute("var", "item") : QString();
+        auto prototype = std::make_shared<RepeatPrototype>(elem, indexVar, entryVar);
+        
+        // Copies are built after this parser is gone: by a parser of their own
+        auto builder = std::make_shared<XMLParser>();
+        builder->m_basePath = m_basePath;
+        repeater->setFactory([prototype, builder, parent](int index, const QString& entry) {
+            QList<QWidget*> copies;
+            for (const QDomElement& body : prototype->instantiate(index, entry)) {
+                if (QWidget* copy = builder->parseElement(body, parent)) copies << copy;
+            }
+            return copies;
+        });
+        
+        if (!forEach) {
+            repeater->setCount(RepeatPrototype::resolve(elem.attribute("count", "0")).toInt());
+        } else if (Repeater::Source source = collectionSource(elem.attribute("in").toLower())) {
+            repeater->setSource(source);
+            if (elem.attribute("in").toLower() != "cores") {
+                // Hotplugged interfaces, new mounts and sensors appear with the next sample
+                connect(SystemMonitor::instance(), &SystemMonitor::updated, repeater, &Repeater::refresh);
+            }
+        } else {
+            log()->warning(QString("for-each: unknown collection \"%1\"").arg(elem.attribute("in")));
+        }
+        repeater->refresh();
+        return repeater;
+    }
+    
+    // Item view: one widget painting a whole tree of lightweight items
+    if (tag == "items") {
+        ItemView* view = ItemView::create(parseItemDirection(elem.attribute("direction")), parent);
+        QHash<QString, int> styles;
+        view->setItemStyle(view->root(), parseItemStyle(view, elem, styles));
+        view->setGap(view->root(), elem.attribute("gap", "0").toInt());
+        view->setPadding(view->root(), elem.attribute("padding", "0").toInt());
+        parseItems(view, view->root(), elem, styles);
+        return view;
+    }
+    
     // Spacer
     if (tag == "spacer" || tag == "space") {
         int size = elem.attribute("size", "10").toInt();
@@ -513,7 +1035,7 @@ QWidget* XMLParser::parseChildElement(const QDomElement& elem, Widget* parent) {
         QDomNode child = elem.firstChild();
         while (!child.isNull()) {
             if (child.isElement()) {
-                QWidget* childWidget = parseChildElement(child.toElement(), parent);
+                QWidget* childWidget = parseElement(child.toElement(), parent);
                 if (childWidget) {
                     container->addWidget(childWidget);
                 }
@@ -575,6 +1097,15 @@ Alignment XMLParser::parseAlignment(const QString& value) {
     return Alignment::Left;
 }
 
+RenderBackend XMLParser::parseRenderBackend(const QString& value) {
+    QString v = value.toLower();
+    
+    if (v == "auto") return RenderBackend::Auto;
+    if (v == "opengl" || v == "gl") return RenderBackend::OpenGL;
+    
+    return RenderBackend::Raster;
+}
+
 QString XMLParser::toXml(Widget* widget) {
     return widget ? widget->toXml() : QString();
 }
@@ -0,0 +1,713 @@
+/**
+ * MilkWidgetCore - Expression Compiler
+ *
+ * Source is parsed into a small AST, folded bottom-up while it is built
+ * (a node whose operands are all constants is run once and replaced by
+ * its result), then flattened into bytecode for a stack machine with one
+ * stack per type. Types are known at compile time, so no instruction
+ * ever checks what it is looking at.
+ */
+
+#include "milk/Utils.h"
+
+#include <cmath>
+
+namespace Milk {
+
+// ============================================================================
+// BUILT-IN FUNCTIONS
+// ============================================================================
+
+enum FunctionId { Min, Max, Abs, Round, Floor, Ceil, Clamp, Fmt, FmtBytes, FmtPercent, FmtDuration };
+
+struct Function {
+    const char* name;
+    int minArgs;
+    int maxArgs;
+    Expression::Type result;
+};
+
+// Indexed by FunctionId
+static const Function Functions[] = {
+    {"min", 2, 2, Expression::Number},
+    {"max", 2, 2, Expression::Number},
+    {"abs", 1, 1, Expression::Number},
+    {"round", 1, 2, Expression::Number},  // round(x, decimals)
+    {"floor", 1, 1, Expression::Number},
+    {"ceil", 1, 1, Expression::Number},
+    {"clamp", 3, 3, Expression::Number},
+    {"fmt", 1, 2, Expression::String},  // fmt(x, decimals)
+    {"fmtBytes", 1, 1, Expression::String},
+    {"fmtPercent", 1, 2, Expression::String},
+    {"fmtDuration", 1, 1, Expression::String},
+};
+
+static double callNumber(int function, const double* a, int argc) {
+    switch (function) {
+    case Min: return std::fmin(a[0], a[1]);
+    case Max: return std::fmax(a[0], a[1]);
+    case Abs: return std::fabs(a[0]);
+    case Round: {
+        double scale = argc > 1 ? std::pow(10.0, a[1]) : 1.0;
+        return std::round(a[0] * scale) / scale;
+    }
+    case Floor: return std::floor(a[0]);
+    case Ceil: return std::ceil(a[0]);
+    case Clamp: return std::fmin(std::fmax(a[0], a[1]), a[2]);
+    }
+    return 0;
+}
+
+static QString formatNumber(double value) {
+    return QString::number(value, 'g', 15);
+}
+
+static QString callString(int function, const double* a, int argc) {
+    switch (function) {
+    case Fmt: return argc > 1 ? QString::number(a[0], 'f', int(a[1])) : formatNumber(a[0]);
+    case FmtBytes: return String::formatBytes(qint64(a[0]));
+    case FmtPercent: return String::formatPercent(a[0], argc > 1 ? int(a[1]) : 0);
+    case FmtDuration: return String::formatDuration(int(a[0]));
+    }
+    return QString();
+}
+
+// ============================================================================
+// COMPILER
+// ============================================================================
+
+struct ExpressionNode {
+    enum Kind { Constant, Input, Unary, Binary, Conditional, Call };
+
+    Kind kind = Constant;
+    Expression::Type type = Expression::Number;
+    double number = 0;
+    QString text;
+    int operand = 0;  // Input slot, opcode or FunctionId
+    std::vector<std::unique_ptr<ExpressionNode>> args;
+};
+
+using NodePtr = std::unique_ptr<ExpressionNode>;
+
+class ExpressionCompiler {
+public:
+    explicit ExpressionCompiler(Expression& target) : m_target(target) {}
+
+    NodePtr parse(const QString& source, int offset);
+    NodePtr parseTemplate(const QString& text);
+    void finish(const ExpressionNode& root);
+
+    QString error() const { return m_error; }
+
+private:
+    using Op = Expression::Op;
+
+    struct Token {
+        enum Kind { End, Number, String, Name, Symbol } kind = End;
+        QString text;
+        double number = 0;
+        int pos = 0;
+    };
+
+    // Parsing, lowest precedence first
+    NodePtr conditional();
+    NodePtr binaryLevel(int level);
+    NodePtr unary();
+    NodePtr primary();
+
+    NodePtr constant(double value);
+    NodePtr constant(const QString& text);
+    NodePtr unaryNode(Op op, Expression::Type type, NodePtr operand);
+    NodePtr binaryNode(const QString& symbol, NodePtr lhs, NodePtr rhs, int pos);
+    NodePtr toString(NodePtr node);
+    NodePtr fold(NodePtr node);
+
+    bool tokenize(const QString& source, int offset);
+    const Token& peek() const { return m_tokens[m_pos]; }
+    bool accept(const char* symbol);
+    bool fail(const QString& message, int pos);
+
+    // Code generation
+    void generate(const ExpressionNode& node);
+    int emitOp(Op op, int operand = 0, int argc = 0);
+
+    Expression& m_target;
+    QString m_error;
+    QVector<Token> m_tokens;
+    int m_pos = 0;
+
+    int m_numberDepth = 0;
+    int m_stringDepth = 0;
+    int m_maxNumberDepth = 0;
+    int m_maxStringDepth = 0;
+};
+
+bool ExpressionCompiler::fail(const QString& message, int pos) {
+    if (m_error.isEmpty()) {
+        m_error = QString("%1 at column %2").arg(message).arg(pos + 1);
+    }
+    return false;
+}
+
+bool ExpressionCompiler::tokenize(const QString& source, int offset) {
+    static const char* const symbols[] = {"&&", "||", "==", "!=", "<=", ">=", "<", ">", "+", "-",
+                                          "*",  "/",  "%",  "!",  "?",  ":",  "(", ")", ","};
+    m_tokens.clear();
+    m_pos = 0;
+    int i = 0;
+    while (i < source.size()) {
+        QChar c = source[i];
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+
+        Token token;
+        token.pos = offset + i;
+        if (c.isDigit() || (c == '.' && i + 1 < source.size() && source[i + 1].isDigit())) {
+            int start = i;
+            while (i < source.size() && (source[i].isDigit() || source[i] == '.')) ++i;
+            if (i < source.size() && (source[i] == 'e' || source[i] == 'E')) {
+                ++i;
+                if (i < source.size() && (source[i] == '+' || source[i] == '-')) ++i;
+                while (i < source.size() && source[i].isDigit()) ++i;
+            }
+            bool ok = false;
+            token.kind = Token::Number;
+            token.number = source.mid(start, i - start).toDouble(&ok);  // Always the C locale
+            if (!ok) return fail("bad number", token.pos);
+        } else if (c == '\'' || c == '"') {
+            int end = source.indexOf(c, i + 1);
+            if (end < 0) return fail("unterminated string", token.pos);
+            token.kind = Token::String;
+            token.text = source.mid(i + 1, end - i - 1);
+            i = end + 1;
+        } else if (c.isLetter() || c == '_') {
+            int start = i;
+            while (i < source.size() && (source[i].isLetterOrNumber() || source[i] == '_' || source[i] == '.')) ++i;
+            token.kind = Token::Name;
+            token.text = source.mid(start, i - start);
+        } else {
+            for (const char* symbol : symbols) {
+                int length = int(qstrlen(symbol));
+                if (source.mid(i, length) == QLatin1String(symbol)) {
+                    token.kind = Token::Symbol;
+                    token.text = QString::fromLatin1(symbol);
+                    i += length;
+                    break;
+                }
+            }
+            if (token.kind != Token::Symbol) return fail(QString("unexpected '%1'").arg(c), token.pos);
+        }
+        m_tokens.append(token);
+    }
+
+    Token end;
+    end.pos = offset + source.size();
+    m_tokens.append(end);
+    return true;
+}
+
+bool ExpressionCompiler::accept(const char* symbol) {
+    if (peek().kind == Token::Symbol && peek().text == QLatin1String(symbol)) {
+        ++m_pos;
+        return true;
+    }
+    return false;
+}
+
+NodePtr ExpressionCompiler::parse(const QString& source, int offset) {
+    if (!tokenize(source, offset)) return nullptr;
+    if (peek().kind == Token::End) {
+        fail("empty expression", peek().pos);
+        return nullptr;
+    }
+    NodePtr root = conditional();
+    if (root && peek().kind != Token::End) {
+        fail(QString("unexpected '%1'").arg(peek().text), peek().pos);
+        return nullptr;
+    }
+    return root;
+}
+
+NodePtr ExpressionCompiler::parseTemplate(const QString& text) {
+    NodePtr result;
+    QString literal;
+    auto append = [this, &result](NodePtr piece) {
+        if (!result) result = std::move(piece);
+        else result = binaryNode("+", toString(std::move(result)), toString(std::move(piece)), 0);
+    };
+
+    int pos = 0;
+    while (pos < text.size()) {
+        if (text[pos] != '{' || (pos > 0 && text[pos - 1] == '$')) {
+            literal += text[pos++];
+            continue;
+        }
+        // The closing brace, skipping any inside quoted strings
+        int end = pos + 1;
+        QChar quote;
+        for (; end < text.size(); ++end) {
+            QChar c = text[end];
+            if (!quote.isNull()) {
+                if (c == quote) quote = QChar();
+            } else if (c == '\'' || c == '"') {
+                quote = c;
+            } else if (c == '}') {
+                break;
+            }
+        }
+        if (end >= text.size()) {
+            fail("unclosed '{'", pos);
+            return nullptr;
+        }
+
+        if (!literal.isEmpty()) {
+            append(constant(literal));
+            literal.clear();
+        }
+        NodePtr piece = parse(text.mid(pos + 1, end - pos - 1), pos + 1);
+        if (!piece) return nullptr;
+        append(std::move(piece));
+        pos = end + 1;
+    }
+    if (!literal.isEmpty() || !result) {
+        append(constant(literal));
+    }
+    return result;
+}
+
+NodePtr ExpressionCompiler::conditional() {
+    NodePtr condition = binaryLevel(0);
+    if (!condition || !accept("?")) return condition;
+    int pos = m_tokens[m_pos - 1].pos;
+
+    NodePtr then = conditional();
+    if (!then) return nullptr;
+    if (!accept(":")) {
+        fail("expected ':'", peek().pos);
+        return nullptr;
+    }
+    NodePtr otherwise = conditional();
+    if (!otherwise) return nullptr;
+    if (condition->type != Expression::Number) {
+        fail("condition must be a number", pos);
+        return nullptr;
+    }
+
+    // Branches of different types meet as strings
+    if (then->type != otherwise->type) {
+        then = toString(std::move(then));
+        otherwise = toString(std::move(otherwise));
+    }
+    if (condition->kind == ExpressionNode::Constant) {
+        return condition->number != 0 ? std::move(then) : std::move(otherwise);
+    }
+
+    NodePtr node(new ExpressionNode);
+    node->kind = ExpressionNode::Conditional;
+    node->type = then->type;
+    node->args.push_back(std::move(condition));
+    node->args.push_back(std::move(then));
+    node->args.push_back(std::move(otherwise));
+    return node;
+}
+
+NodePtr ExpressionCompiler::binaryLevel(int level) {
+    static const char* const levels[][4] = {
+        {"||"}, {"&&"}, {"==", "!="}, {"<", "<=", ">", ">="}, {"+", "-"}, {"*", "/", "%"},
+    };
+    static const int levelCount = int(sizeof(levels) / sizeof(levels[0]));
+    if (level == levelCount) return unary();
+
+    NodePtr lhs = binaryLevel(level + 1);
+    while (lhs) {
+        const char* matched = nullptr;
+        for (const char* symbol : levels[level]) {
+            if (symbol && accept(symbol)) {
+                matched = symbol;
+                break;
+            }
+        }
+        if (!matched) break;
+        int pos = m_tokens[m_pos - 1].pos;
+        NodePtr rhs = binaryLevel(level + 1);
+        if (!rhs) return nullptr;
+        lhs = binaryNode(QString::fromLatin1(matched), std::move(lhs), std::move(rhs), pos);
+    }
+    return lhs;
+}
+
+NodePtr ExpressionCompiler::unary() {
+    int pos = peek().pos;
+    bool negate = accept("-");
+    if (negate || accept("!")) {
+        NodePtr operand = unary();
+        if (!operand) return nullptr;
+        if (operand->type != Expression::Number) {
+            fail(negate ? "cannot negate a string" : "cannot apply ! to a string", pos);
+            return nullptr;
+        }
+        return unaryNode(negate ? Expression::Negate : Expression::Not, Expression::Number, std::move(operand));
+    }
+    return primary();
+}
+
+NodePtr ExpressionCompiler::primary() {
+    Token token = peek();
+    if (token.kind != Token::End) ++m_pos;
+    switch (token.kind) {
+    case Token::Number:
+        return constant(token.number);
+    case Token::String:
+        return constant(token.text);
+    case Token::Symbol:
+        if (token.text == "(") {
+            NodePtr inner = conditional();
+            if (inner && !accept(")")) {
+                fail("expected ')'", peek().pos);
+                return nullptr;
+            }
+            return inner;
+        }
+        fail(QString("unexpected '%1'").arg(token.text), token.pos);
+        return nullptr;
+    case Token::End:
+        fail("unexpected end", token.pos);
+        return nullptr;
+    case Token::Name:
+        break;
+    }
+
+    if (token.text == "true") return constant(1.0);
+    if (token.text == "false") return constant(0.0);
+
+    if (!accept("(")) {
+        // A metric: one input slot per distinct name
+        int slot = m_target.m_inputs.indexOf(token.text);
+        if (slot < 0) {
+            slot = m_target.m_inputs.size();
+            m_target.m_inputs.append(token.text);
+        }
+        NodePtr node(new ExpressionNode);
+        node->kind = ExpressionNode::Input;
+        node->operand = slot;
+        return node;
+    }
+
+    int function = -1;
+    for (int i = 0; i < int(sizeof(Functions) / sizeof(Functions[0])); ++i) {
+        if (token.text == QLatin1String(Functions[i].name)) function = i;
+    }
+    if (function < 0) {
+        fail(QString("unknown function %1()").arg(token.text), token.pos);
+        return nullptr;
+    }
+
+    NodePtr node(new ExpressionNode);
+    node->kind = ExpressionNode::Call;
+    node->type = Functions[function].result;
+    node->operand = function;
+    if (!accept(")")) {
+        do {
+            NodePtr arg = conditional();
+            if (!arg) return nullptr;
+            if (arg->type != Expression::Number) {
+                fail(QString("%1() takes numbers").arg(token.text), token.pos);
+                return nullptr;
+            }
+            node->args.push_back(std::move(arg));
+        } while (accept(","));
+        if (!accept(")")) {
+            fail("expected ')'", peek().pos);
+            return nullptr;
+        }
+    }
+    int argc = int(node->args.size());
+    if (argc < Functions[function].minArgs || argc > Functions[function].maxArgs) {
+        fail(QString("wrong number of arguments to %1()").arg(token.text), token.pos);
+        return nullptr;
+    }
+    return fold(std::move(node));
+}
+
+NodePtr ExpressionCompiler::constant(double value) {
+    NodePtr node(new ExpressionNode);
+    node->number = value;
+    return node;
+}
+
+NodePtr ExpressionCompiler::constant(const QString& text) {
+    NodePtr node(new ExpressionNode);
+    node->type = Expression::String;
+    node->text = text;
+    return node;
+}
+
+NodePtr ExpressionCompiler::unaryNode(Op op, Expression::Type type, NodePtr operand) {
+    NodePtr node(new ExpressionNode);
+    node->kind = ExpressionNode::Unary;
+    node->type = type;
+    node->operand = op;
+    node->args.push_back(std::move(operand));
+    return fold(std::move(node));
+}
+
+NodePtr ExpressionCompiler::toString(NodePtr node) {
+    if (node->type == Expression::String) return node;
+    return unaryNode(Expression::ToString, Expression::String, std::move(node));
+}
+
+NodePtr ExpressionCompiler::binaryNode(const QString& symbol, NodePtr lhs, NodePtr rhs, int pos) {
+    static const struct {
+        const char* symbol;
+        Op op;
+    } numeric[] = {
+        {"+", Expression::Add},       {"-", Expression::Subtract},      {"*", Expression::Multiply},
+        {"/", Expression::Divide},    {"%", Expression::Modulo},        {"<", Expression::Less},
+        {"<=", Expression::LessEqual}, {">", Expression::Greater},      {">=", Expression::GreaterEqual},
+        {"==", Expression::Equal},    {"!=", Expression::NotEqual},     {"&&", Expression::And},
+        {"||", Expression::Or},
+    };
+
+    bool strings = lhs->type == Expression::String || rhs->type == Expression::String;
+    Op op = Expression::Add;
+    Expression::Type type = Expression::Number;
+    if (strings && symbol == "+") {
+        lhs = toString(std::move(lhs));
+        rhs = toString(std::move(rhs));
+        op = Expression::Concat;
+        type = Expression::String;
+    } else if (strings && (symbol == "==" || symbol == "!=")) {
+        if (lhs->type != rhs->type) {
+            fail("cannot compare a string with a number", pos);
+            return nullptr;
+        }
+        op = symbol == "==" ? Expression::StringEqual : Expression::StringNotEqual;
+    } else if (strings) {
+        fail(QString("cannot apply %1 to a string").arg(symbol), pos);
+        return nullptr;
+    } else {
+        for (const auto& entry : numeric) {
+            if (symbol == QLatin1String(entry.symbol)) op = entry.op;
+        }
+    }
+
+    NodePtr node(new ExpressionNode);
+    node->kind = ExpressionNode::Binary;
+    node->type = type;
+    node->operand = op;
+    node->args.push_back(std::move(lhs));
+    node->args.push_back(std::move(rhs));
+    return fold(std::move(node));
+}
+
+NodePtr ExpressionCompiler::fold(NodePtr node) {
+    for (const NodePtr& arg : node->args) {
+        if (arg->kind != ExpressionNode::Constant) return node;
+    }
+
+    // Run the node on its own and keep the result instead
+    Expression scratch;
+    ExpressionCompiler compiler(scratch);
+    compiler.finish(*node);
+    scratch.evaluate();
+    return node->type == Expression::String ? constant(scratch.m_text) : constant(scratch.m_number);
+}
+
+void ExpressionCompiler::finish(const ExpressionNode& root) {
+    generate(root);
+    m_target.m_type = root.type;
+    m_target.m_slots.fill(0, m_target.m_inputs.size());
+    m_target.m_numberStack.resize(size_t(qMax(1, m_maxNumberDepth)));
+    m_target.m_stringStack.resize(size_t(qMax(1, m_maxStringDepth)));
+}
+
+void ExpressionCompiler::generate(const ExpressionNode& node) {
+    switch (node.kind) {
+    case ExpressionNode::Constant:
+        if (node.type == Expression::Number) {
+            emitOp(Expression::PushNumber, m_target.m_constants.size());
+            m_target.m_constants.append(node.number);
+        } else {
+            emitOp(Expression::PushString, m_target.m_strings.size());
+            m_target.m_strings.append(node.text);
+        }
+        break;
+    case ExpressionNode::Input:
+        emitOp(Expression::PushInput, node.operand);
+        break;
+    case ExpressionNode::Unary:
+    case ExpressionNode::Binary:
+        for (const NodePtr& arg : node.args) generate(*arg);
+        emitOp(Op(node.operand));
+        break;
+    case ExpressionNode::Call:
+        for (const NodePtr& arg : node.args) generate(*arg);
+        emitOp(node.type == Expression::String ? Expression::CallString : Expression::CallNumber, node.operand,
+               int(node.args.size()));
+        break;
+    case ExpressionNode::Conditional: {
+        generate(*node.args[0]);
+        int toElse = emitOp(Expression::JumpIfFalse);
+        int numbers = m_numberDepth;
+        int strings = m_stringDepth;
+        generate(*node.args[1]);
+        int toEnd = emitOp(Expression::Jump);
+        m_target.m_code[toElse].operand = m_target.m_code.size();
+        // Only one branch runs: the second starts from the same depth
+        m_numberDepth = numbers;
+        m_stringDepth = strings;
+        generate(*node.args[2]);
+        m_target.m_code[toEnd].operand = m_target.m_code.size();
+        break;
+    }
+    }
+}
+
+int ExpressionCompiler::emitOp(Op op, int operand, int argc) {
+    switch (op) {
+    case Expression::PushNumber:
+    case Expression::PushInput:
+        m_numberDepth += 1;
+        break;
+    case Expression::PushString:
+        m_stringDepth += 1;
+        break;
+    case Expression::ToString:
+        m_numberDepth -= 1;
+        m_stringDepth += 1;
+        break;
+    case Expression::Negate:
+    case Expression::Not:
+    case Expression::Jump:
+        break;
+    case Expression::Concat:
+        m_stringDepth -= 1;
+        break;
+    case Expression::StringEqual:
+    case Expression::StringNotEqual:
+        m_stringDepth -= 2;
+        m_numberDepth += 1;
+        break;
+    case Expression::CallNumber:
+        m_numberDepth += 1 - argc;
+        break;
+    case Expression::CallString:
+        m_numberDepth -= argc;
+        m_stringDepth += 1;
+        break;
+    default:  // Binary numeric operators and JumpIfFalse pop one number
+        m_numberDepth -= 1;
+        break;
+    }
+    m_maxNumberDepth = qMax(m_maxNumberDepth, m_numberDepth);
+    m_maxStringDepth = qMax(m_maxStringDepth, m_stringDepth);
+
+    m_target.m_code.append({op, quint8(argc), operand});
+    return m_target.m_code.size() - 1;
+}
+
+// ============================================================================
+// EXPRESSION
+// ============================================================================
+
+std::shared_ptr<Expression> Expression::compile(const QString& source, QString* error) {
+    std::shared_ptr<Expression> expression(new Expression());
+    ExpressionCompiler compiler(*expression);
+    NodePtr root = compiler.parse(source, 0);
+    if (!root) {
+        if (error) *error = compiler.error();
+        return nullptr;
+    }
+    compiler.finish(*root);
+    return expression;
+}
+
+std::shared_ptr<Expression> Expression::compileTemplate(const QString& text, QString* error) {
+    std::shared_ptr<Expression> expression(new Expression());
+    ExpressionCompiler compiler(*expression);
+    NodePtr root = compiler.parseTemplate(text);
+    if (!root) {
+        if (error) *error = compiler.error();
+        return nullptr;
+    }
+    compiler.finish(*root);
+    return expression;
+}
+
+bool Expression::isTemplate(const QString& text) {
+    for (int i = text.indexOf('{'); i >= 0; i = text.indexOf('{', i + 1)) {
+        if ((i == 0 || text[i - 1] != '$') && text.indexOf('}', i) > i) return true;
+    }
+    return false;
+}
+
+bool Expression::setInput(int slot, double value) {
+    if (slot < 0 || slot >= m_slots.size() || m_slots[slot] == value) {
+        return false;
+    }
+    m_slots[slot] = value;
+    return true;
+}
+
+bool Expression::evaluate() {
+    double* num = m_numberStack.data();
+    QString* str = m_stringStack.data();
+    const double* constants = m_constants.constData();
+    const double* inputs = m_slots.constData();
+    const Instruction* code = m_code.constData();
+    const int size = m_code.size();
+    int n = 0;
+    int s = 0;
+
+    for (int pc = 0; pc < size; ++pc) {
+        const Instruction& in = code[pc];
+        switch (in.op) {
+        case PushNumber: num[n++] = constants[in.operand]; break;
+        case PushInput: num[n++] = inputs[in.operand]; break;
+        case PushString: str[s++] = m_strings.at(in.operand); break;
+        case ToString: str[s++] = formatNumber(num[--n]); break;
+        case Negate: num[n - 1] = -num[n - 1]; break;
+        case Not: num[n - 1] = num[n - 1] == 0 ? 1 : 0; break;
+        case Add: --n; num[n - 1] += num[n]; break;
+        case Subtract: --n; num[n - 1] -= num[n]; break;
+        case Multiply: --n; num[n - 1] *= num[n]; break;
+        case Divide: --n; num[n - 1] /= num[n]; break;
+        case Modulo: --n; num[n - 1] = std::fmod(num[n - 1], num[n]); break;
+        case Less: --n; num[n - 1] = num[n - 1] < num[n]; break;
+        case LessEqual: --n; num[n - 1] = num[n - 1] <= num[n]; break;
+        case Greater: --n; num[n - 1] = num[n - 1] > num[n]; break;
+        case GreaterEqual: --n; num[n - 1] = num[n - 1] >= num[n]; break;
+        case Equal: --n; num[n - 1] = num[n - 1] == num[n]; break;
+        case NotEqual: --n; num[n - 1] = num[n - 1] != num[n]; break;
+        case And: --n; num[n - 1] = num[n - 1] != 0 && num[n] != 0; break;
+        case Or: --n; num[n - 1] = num[n - 1] != 0 || num[n] != 0; break;
+        case Concat: --s; str[s - 1] += str[s]; break;
+        case StringEqual: s -= 2; num[n++] = str[s] == str[s + 1]; break;
+        case StringNotEqual: s -= 2; num[n++] = str[s] != str[s + 1]; break;
+        case Jump: pc = in.operand - 1; break;
+        case JumpIfFalse: if (num[--n] == 0) pc = in.operand - 1; break;
+        case CallNumber: n -= in.argc; num[n] = callNumber(in.operand, num + n, in.argc); ++n; break;
+        case CallString: n -= in.argc; str[s++] = callString(in.operand, num + n, in.argc); break;
+        }
+    }
+
+    bool first = !m_evaluated;
+    m_evaluated = true;
+    if (m_type == Number) {
+        double result = num[0];
+        bool same = result == m_number || (std::isnan(result) && std::isnan(m_number));
+        m_number = result;
+        return first || !same;
+    }
+    bool same = str[0] == m_text;
+    if (!same) m_text = str[0];
+    return first || !same;
+}
+
+QString Expression::toString() const {
+    return m_type == String ? m_text : formatNumber(m_number);
+}
+
+} // namespace Milk
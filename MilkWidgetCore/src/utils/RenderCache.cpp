@@ -0,0 +1,231 @@
+/**
+ * MilkWidgetCore - Render Cache Implementation
+ */
+
+#include "milk/Utils.h"
+
+#include <QPainter>
+#include <QPixmapCache>
+#include <QImageReader>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QScreen>
+#include <QGuiApplication>
+#include <QtMath>
+
+namespace Milk {
+
+RenderCache* RenderCache::s_instance = nullptr;
+
+RenderCache* RenderCache::instance() {
+    if (!s_instance) {
+        s_instance = new RenderCache();
+    }
+    return s_instance;
+}
+
+void RenderCache::cleanup() {
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+RenderCache::RenderCache() : QObject(nullptr) {
+    QPixmapCache::setCacheLimit(int(m_pixmapCacheLimit / 1024));
+    
+    if (auto* app = qobject_cast<QGuiApplication*>(QCoreApplication::instance())) {
+        for (QScreen* screen : QGuiApplication::screens()) {
+            watchScreen(screen);
+        }
+        connect(app, &QGuiApplication::screenAdded, this, &RenderCache::watchScreen);
+        connect(app, &QGuiApplication::screenRemoved, this, [this](QScreen* screen) {
+            m_screenRatios.remove(screen);
+        });
+    }
+}
+
+// ============================================================================
+// LOOKUP
+// ============================================================================
+
+RenderCache::Key RenderCache::makeKey(quint64 contentHash, const QSize& size, qreal dpr) {
+    return Key{contentHash, size.width(), size.height(), qRound(dpr * 1000.0)};
+}
+
+qint64 RenderCache::pixmapBytes(const QPixmap& pixmap) {
+    return qint64(pixmap.width()) * pixmap.height() * qMax(1, pixmap.depth() / 8);
+}
+
+QPixmap RenderCache::find(quint64 contentHash, const QSize& size, qreal dpr) {
+    auto it = m_index.find(makeKey(contentHash, size, dpr));
+    if (it == m_index.end()) {
+        m_misses++;
+        return QPixmap();
+    }
+
+    m_hits++;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->pixmap;
+}
+
+void RenderCache::insert(quint64 contentHash, const QSize& size, qreal dpr, const QPixmap& pixmap,
+                         Category category) {
+    if (pixmap.isNull()) return;
+
+    Key key = makeKey(contentHash, size, dpr);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        erase(it->second);
+    }
+
+    qint64 bytes = pixmapBytes(pixmap);
+    if (bytes > m_budget - m_pixmapCacheLimit) return;  // Would evict everything else for one entry
+
+    m_lru.push_front(Entry{key, pixmap, bytes, category});
+    m_index.emplace(key, m_lru.begin());
+    m_bytes += bytes;
+    m_categoryBytes[category] += bytes;
+    trim();
+}
+
+QPixmap RenderCache::fetch(quint64 contentHash, const QSize& size, qreal dpr, const Painter& paint,
+                           Category category) {
+    if (size.isEmpty()) return QPixmap();
+
+    QPixmap cached = find(contentHash, size, dpr);
+    if (!cached.isNull()) return cached;
+
+    QPixmap pixmap(QSize(qCeil(size.width() * dpr), qCeil(size.height() * dpr)));
+    pixmap.setDevicePixelRatio(dpr);
+    pixmap.fill(Qt::transparent);
+    {
+        QPainter painter(&pixmap);
+        paint(painter, size);
+    }
+
+    insert(contentHash, size, dpr, pixmap, category);
+    return pixmap;
+}
+
+QPixmap RenderCache::decode(const QString& path, const QSize& pixelSize) {
+    if (path.isEmpty() || pixelSize.isEmpty()) return QPixmap();
+
+    // DPR 0 marks raw decoded pixels, which are independent of any screen
+    // Size too: a rewrite within the filesystem's mtime granularity still differs
+    QFileInfo info(path);
+    ContentHash h; h << path << quint64(info.lastModified().toMSecsSinceEpoch()) << quint64(info.size());
+    QPixmap cached = find(h.value(), pixelSize, 0);
+    if (!cached.isNull()) return cached;
+
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    if (reader.size().isValid() && reader.size() != pixelSize) {
+        // JPEG and friends can decode at reduced scale directly
+        reader.setScaledSize(pixelSize);
+    }
+    QImage image = reader.read();
+    if (image.isNull()) return QPixmap();
+
+    QPixmap pixmap = QPixmap::fromImage(std::move(image));
+    insert(h.value(), pixelSize, 0, pixmap, Decoded);
+    return pixmap;
+}
+
+// ============================================================================
+// EVICTION
+// ============================================================================
+
+void RenderCache::setBudget(qint64 bytes) {
+    m_budget = qMax<qint64>(0, bytes);
+    m_pixmapCacheLimit = m_budget / 8;
+    QPixmapCache::setCacheLimit(int(m_pixmapCacheLimit / 1024));
+    trim();
+}
+
+void RenderCache::erase(std::list<Entry>::iterator it) {
+    m_bytes -= it->bytes;
+    m_categoryBytes[it->category] -= it->bytes;
+    m_index.erase(it->key);
+    m_lru.erase(it);
+}
+
+void RenderCache::trim() {
+    while (m_bytes > m_budget - m_pixmapCacheLimit && !m_lru.empty()) {
+        erase(std::prev(m_lru.end()));
+        m_evictions++;
+    }
+}
+
+void RenderCache::evictRatio(qreal dpr) {
+    int milli = qRound(dpr * 1000.0);
+    for (auto it = m_lru.begin(); it != m_lru.end();) {
+        auto next = std::next(it);
+        if (it->key.dprMilli == milli) {
+            erase(it);
+            m_evictions++;
+        }
+        it = next;
+    }
+    emit evicted(dpr);
+}
+
+void RenderCache::clear() {
+    m_lru.clear();
+    m_index.clear();
+    m_bytes = 0;
+    for (qint64& bytes : m_categoryBytes) bytes = 0;
+}
+
+// ============================================================================
+// SCREEN TRACKING
+// ============================================================================
+
+void RenderCache::watchScreen(QScreen* screen) {
+    m_screenRatios[screen] = qRound(screen->devicePixelRatio() * 1000.0);
+    connect(screen, &QScreen::logicalDotsPerInchChanged, this, [this, screen]() {
+        onScreenRatioChanged(screen);
+    });
+}
+
+void RenderCache::onScreenRatioChanged(QScreen* screen) {
+    int oldMilli = m_screenRatios.value(screen, 0);
+    int newMilli = qRound(screen->devicePixelRatio() * 1000.0);
+    m_screenRatios[screen] = newMilli;
+
+    if (oldMilli == 0 || oldMilli == newMilli) return;
+
+    // Layers at the old ratio are still valid for other screens using it
+    for (auto it = m_screenRatios.constBegin(); it != m_screenRatios.constEnd(); ++it) {
+        if (it.value() == oldMilli) return;
+    }
+
+    evictRatio(oldMilli / 1000.0);
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+RenderCache::Stats RenderCache::stats() const {
+    Stats s;
+    s.hits = m_hits;
+    s.misses = m_misses;
+    s.evictions = m_evictions;
+    s.bytes = m_bytes;
+    s.budget = m_budget;
+    for (int i = 0; i < CategoryCount; i++) s.categoryBytes[i] = m_categoryBytes[i];
+    s.pixmapCacheLimit = m_pixmapCacheLimit;
+    s.entries = int(m_index.size());
+    return s;
+}
+
+void RenderCache::resetStats() {
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
+RenderCache* renderCache() {
+    return RenderCache::instance();
+}
+
+} // namespace Milk
@@ -0,0 +1,535 @@
+/**
+ * MilkWidgetCore - Time Series Store
+ *
+ * File layout (native byte order; these files never leave the machine):
+ *   page 0        FileHeader
+ *   page 1..N     blocks: BlockHeader, then a bitstream of points
+ *
+ * A block's first point lives in its header. Every later point is a
+ * delta-of-delta timestamp followed by the XOR of its value with the
+ * previous one, as in Facebook's Gorilla. The header also caches the
+ * encoder state; open() rebuilds it from the points of the block being
+ * appended to, so an append cut short by a crash is simply not there.
+ */
+
+#include "milk/Utils.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace Milk {
+
+static const int BlockSize = 4096;
+static const quint32 FileMagic = 0x4d545346;   // "MTSF"
+static const quint32 BlockMagic = 0x4d545342;  // "MTSB"
+static const quint32 FormatVersion = 1;
+
+static const qint64 TierStepMs[] = {1000, 60 * 1000, 60 * 60 * 1000};
+static const int TierBlocks[] = {256, 64, 32};  // 1 MiB + 256 KiB + 128 KiB per metric
+static const char* TierSuffix[] = {"1s", "1m", "1h"};
+
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 blockSize;
+    quint32 blockCount;
+    quint64 nextSequence;
+    qint32 current;  // Block being appended to
+    quint32 reserved;
+};
+
+struct BlockHeader {
+    quint32 magic;
+    quint32 count;
+    quint64 sequence;  // Ring order
+    qint64 firstTime;
+    quint64 firstValue;
+    // Encoder state after the last point
+    qint64 lastTime;
+    qint64 lastDelta;
+    quint64 lastValue;
+    quint32 bits;
+    quint8 leading;  // 0xff: no XOR window yet
+    quint8 trailing;
+    quint16 reserved;
+};
+
+static const int PayloadBits = int(BlockSize - sizeof(BlockHeader)) * 8;
+// Worst case per point: '1111' + 32 timestamp bits, '11' + 5 + 6 + 64 value bits
+static const int MaxPointBits = 4 + 32 + 2 + 5 + 6 + 64;
+
+static quint64 toBits(double value) { quint64 bits; memcpy(&bits, &value, sizeof bits); return bits; }
+static double fromBits(quint64 bits) { double value; memcpy(&value, &bits, sizeof value); return value; }
+
+// ============================================================================
+// BIT STREAM
+// ============================================================================
+
+namespace {
+
+class BitWriter {
+public:
+    BitWriter(uchar* data, quint32 pos) : m_data(data), m_pos(pos) {}
+
+    /** Payloads start zeroed, so writing only ever sets bits */
+    void write(quint64 value, int count) {
+        while (count > 0) {
+            int room = 8 - int(m_pos & 7);
+            int take = qMin(room, count);
+            quint8 chunk = quint8((value >> (count - take)) & ((1u << take) - 1));
+            m_data[m_pos >> 3] |= quint8(chunk << (room - take));
+            m_pos += quint32(take);
+            count -= take;
+        }
+    }
+    quint32 pos() const { return m_pos; }
+
+private:
+    uchar* m_data;
+    quint32 m_pos;
+};
+
+class BitReader {
+public:
+    explicit BitReader(const uchar* data) : m_data(data) {}
+
+    quint64 read(int count) {
+        quint64 value = 0;
+        while (count > 0) {
+            int room = 8 - int(m_pos & 7);
+            int take = qMin(room, count);
+            quint8 chunk = quint8((m_data[m_pos >> 3] >> (room - take)) & ((1u << take) - 1));
+            value = (value << take) | chunk;
+            m_pos += quint32(take);
+            count -= take;
+        }
+        return value;
+    }
+    bool bit() { return read(1) != 0; }
+    quint32 pos() const { return m_pos; }
+
+private:
+    const uchar* m_data;
+    quint32 m_pos = 0;
+};
+
+/** Walks a block's points, holding the encoder state after the current one */
+class PointReader {
+public:
+    PointReader(const BlockHeader* block, const uchar* payload) : m_in(payload) {
+        time = block->firstTime;
+        bits = block->firstValue;
+    }
+
+    void next() {
+        qint64 dod = 0;
+        if (m_in.bit()) {
+            if (!m_in.bit()) dod = qint64(m_in.read(7)) - 63;
+            else if (!m_in.bit()) dod = qint64(m_in.read(9)) - 255;
+            else if (!m_in.bit()) dod = qint64(m_in.read(12)) - 2047;
+            else dod = qint32(quint32(m_in.read(32)));
+        }
+        delta += dod;
+        time += delta;
+
+        if (m_in.bit()) {
+            if (m_in.bit()) {
+                leading = int(m_in.read(5));
+                int length = int(m_in.read(6));
+                if (length == 0) length = 64;
+                trailing = 64 - leading - length;
+            }
+            bits ^= m_in.read(64 - leading - trailing) << trailing;
+        }
+    }
+    quint32 pos() const { return m_in.pos(); }
+
+    qint64 time = 0;
+    qint64 delta = 0;
+    quint64 bits = 0;
+    int leading = 0xff;  // No XOR window yet
+    int trailing = 0;
+
+private:
+    BitReader m_in;
+};
+
+} // namespace
+
+// ============================================================================
+// TIER FILE
+// ============================================================================
+
+struct TimeSeries::TierFile {
+    QFile file;
+    uchar* map = nullptr;
+    int blocks = 0;
+
+    FileHeader* header() { return reinterpret_cast<FileHeader*>(map); }
+    BlockHeader* block(int i) { return reinterpret_cast<BlockHeader*>(map + qint64(BlockSize) * (i + 1)); }
+    const BlockHeader* block(int i) const { return reinterpret_cast<const BlockHeader*>(map + qint64(BlockSize) * (i + 1)); }
+    uchar* payload(int i) { return map + qint64(BlockSize) * (i + 1) + sizeof(BlockHeader); }
+    const uchar* payload(int i) const { return map + qint64(BlockSize) * (i + 1) + sizeof(BlockHeader); }
+
+    bool open(const QString& path, int blockCount);
+    void resume();
+    bool append(qint64 time, double value);
+    bool encode(BlockHeader* block, uchar* payload, qint64 time, quint64 bits);
+    void decode(int index, qint64 fromMs, qint64 toMs, QVector<Point>& out) const;
+    QVector<int> ordered() const;
+};
+
+bool TimeSeries::TierFile::open(const QString& path, int blockCount) {
+    blocks = blockCount;
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        log()->warning(QString("TimeSeries: cannot open %1: %2").arg(path, file.errorString()));
+        return false;
+    }
+
+    const qint64 size = qint64(BlockSize) * (blockCount + 1);
+    FileHeader existing = {};
+    bool valid = file.size() == size && file.read(reinterpret_cast<char*>(&existing), sizeof existing) == sizeof existing &&
+                 existing.magic == FileMagic && existing.version == FormatVersion &&
+                 existing.blockSize == quint32(BlockSize) && existing.blockCount == quint32(blockCount) &&
+                 existing.current >= 0 && existing.current < blockCount;
+    if (!valid) {
+        // Unknown, damaged or resized: history is a cache of the past, start over
+        if (!file.resize(0) || !file.resize(size)) return false;
+    }
+
+    map = file.map(0, size);
+    if (!map) {
+        log()->warning(QString("TimeSeries: cannot map %1").arg(path));
+        return false;
+    }
+    if (!valid) {
+        FileHeader* h = header();
+        h->magic = FileMagic;
+        h->version = FormatVersion;
+        h->blockSize = BlockSize;
+        h->blockCount = quint32(blockCount);
+        h->nextSequence = 1;
+        h->current = 0;
+    }
+    resume();
+    return true;
+}
+
+/** Encoder state of the current block, from its published points only */
+void TimeSeries::TierFile::resume() {
+    const int index = header()->current;
+    BlockHeader* b = block(index);
+    if (b->magic != BlockMagic || b->count == 0) return;
+
+    // Every point was written with room for the largest one after it
+    PointReader reader(b, payload(index));
+    quint32 count = 1;
+    while (count < b->count && reader.pos() + MaxPointBits <= quint32(PayloadBits)) {
+        reader.next();
+        count++;
+    }
+    b->count = count;
+    b->bits = reader.pos();
+    b->lastTime = reader.time;
+    b->lastDelta = reader.delta;
+    b->lastValue = reader.bits;
+    b->leading = quint8(reader.leading);
+    b->trailing = quint8(reader.trailing);
+
+    // Bits of a point whose append never finished: writing only sets bits
+    uchar* data = payload(index);
+    quint32 byte = b->bits >> 3;
+    if (b->bits & 7) data[byte++] &= quint8(0xff << (8 - (b->bits & 7)));
+    memset(data + byte, 0, PayloadBits / 8 - byte);
+}
+
+/** False if the point was not stored, so nothing is rolled up from it */
+bool TimeSeries::TierFile::append(qint64 time, double value) {
+    if (!map) return false;
+    FileHeader* h = header();
+    BlockHeader* current = block(h->current);
+    const quint64 bits = toBits(value);
+
+    if (current->magic == BlockMagic && current->count > 0) {
+        // Time only moves forward within a series; a clock step back is dropped
+        if (time <= current->lastTime) return false;
+        if (encode(current, payload(h->current), time, bits)) return true;
+        h->current = (h->current + 1) % blocks;  // Full: overwrite the oldest block
+    }
+
+    BlockHeader* fresh = block(h->current);
+    memset(fresh, 0, BlockSize);
+    fresh->sequence = h->nextSequence++;
+    fresh->firstTime = fresh->lastTime = time;
+    fresh->firstValue = fresh->lastValue = bits;
+    fresh->leading = 0xff;
+    std::atomic_thread_fence(std::memory_order_release);
+    fresh->count = 1;
+    fresh->magic = BlockMagic;
+    return true;
+}
+
+bool TimeSeries::TierFile::encode(BlockHeader* b, uchar* payload, qint64 time, quint64 bits) {
+    if (b->bits + MaxPointBits > quint32(PayloadBits)) return false;
+
+    const qint64 delta = time - b->lastTime;
+    const qint64 dod = delta - b->lastDelta;
+    if (dod < INT32_MIN || dod > INT32_MAX) return false;  // Long gap: a new block starts clean
+
+    BitWriter out(payload, b->bits);
+
+    // Regular sampling makes almost every delta-of-delta zero: one bit
+    if (dod == 0) {
+        out.write(0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        out.write(0x2, 2);
+        out.write(quint64(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        out.write(0x6, 3);
+        out.write(quint64(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        out.write(0xe, 4);
+        out.write(quint64(dod + 2047), 12);
+    } else {
+        out.write(0xf, 4);
+        out.write(quint32(qint32(dod)), 32);
+    }
+
+    const quint64 x = bits ^ b->lastValue;
+    if (x == 0) {
+        out.write(0, 1);
+    } else {
+        int leading = qMin(31, int(qCountLeadingZeroBits(x)));
+        int trailing = int(qCountTrailingZeroBits(x));
+        out.write(1, 1);
+        if (b->leading != 0xff && leading >= b->leading && trailing >= b->trailing) {
+            // Fits the previous window: reuse it
+            out.write(0, 1);
+            out.write(x >> b->trailing, 64 - b->leading - b->trailing);
+        } else {
+            int length = 64 - leading - trailing;
+            out.write(1, 1);
+            out.write(quint64(leading), 5);
+            out.write(quint64(length & 63), 6);  // 64 wraps to 0
+            out.write(x >> trailing, length);
+            b->leading = quint8(leading);
+            b->trailing = quint8(trailing);
+        }
+    }
+
+    b->bits = out.pos();
+    b->lastTime = time;
+    b->lastDelta = delta;
+    b->lastValue = bits;
+    // Published after the data: a process killed mid-append leaves the
+    // point unseen, and resume() drops it. This does not cover power loss,
+    // where the kernel may write the pages back in any order.
+    std::atomic_thread_fence(std::memory_order_release);
+    b->count++;
+    return true;
+}
+
+void TimeSeries::TierFile::decode(int index, qint64 fromMs, qint64 toMs, QVector<Point>& out) const {
+    const BlockHeader* b = block(index);
+    PointReader reader(b, payload(index));
+    for (quint32 i = 0; i < b->count; ++i) {
+        if (i > 0) reader.next();
+        if (reader.time > toMs) return;
+        if (reader.time >= fromMs) out.append(Point{reader.time, fromBits(reader.bits)});
+    }
+}
+
+QVector<int> TimeSeries::TierFile::ordered() const {
+    QVector<int> used;
+    if (!map) return used;
+    for (int i = 0; i < blocks; ++i) {
+        if (block(i)->magic == BlockMagic && block(i)->count > 0) used.append(i);
+    }
+    std::sort(used.begin(), used.end(), [this](int a, int b) {
+        return block(a)->sequence < block(b)->sequence;
+    });
+    return used;
+}
+
+// ============================================================================
+// TIME SERIES
+// ============================================================================
+
+QHash<QString, TimeSeries*> TimeSeries::s_series;
+QMutex TimeSeries::s_seriesMutex;
+
+static QString historyDir() {
+    return File::dataDir() + "/history";
+}
+
+static QString tierPath(const QString& metric, int tier) {
+    QString name = metric;
+    for (QChar& c : name) {
+        if (!c.isLetterOrNumber() && c != '.' && c != '-' && c != '_') c = '_';
+    }
+    return QString("%1/%2.%3.mts").arg(historyDir(), name, TierSuffix[tier]);
+}
+
+TimeSeries* TimeSeries::open(const QString& metric) {
+    QMutexLocker locker(&s_seriesMutex);
+    TimeSeries* series = s_series.value(metric);
+    if (!series) {
+        series = new TimeSeries(metric);
+        s_series.insert(metric, series);
+    }
+    return series;
+}
+
+TimeSeries* TimeSeries::find(const QString& metric) {
+    QMutexLocker locker(&s_seriesMutex);
+    TimeSeries* series = s_series.value(metric);
+    if (!series && QFile::exists(tierPath(metric, Seconds))) {
+        series = new TimeSeries(metric);
+        s_series.insert(metric, series);
+    }
+    return series;
+}
+
+void TimeSeries::closeAll() {
+    QMutexLocker locker(&s_seriesMutex);
+    qDeleteAll(s_series);
+    s_series.clear();
+}
+
+TimeSeries::TimeSeries(const QString& metric)
+    : m_metric(metric)
+{
+    QDir().mkpath(historyDir());
+    for (int tier = 0; tier < TierCount; ++tier) {
+        m_tiers[tier].reset(new TierFile());
+        m_tiers[tier]->open(tierPath(metric, tier), TierBlocks[tier]);
+    }
+    recoverRollups();
+}
+
+TimeSeries::~TimeSeries() = default;
+
+void TimeSeries::recoverRollups() {
+    // The partial minute and hour are rebuilt from the finer tier on disk
+    for (int tier = Minutes; tier < TierCount; ++tier) {
+        TierFile* source = m_tiers[tier - 1].get();
+        if (!source->map) continue;
+        const BlockHeader* last = source->block(source->header()->current);
+        if (last->magic != BlockMagic || last->count == 0) continue;
+
+        const qint64 step = TierStepMs[tier];
+        const qint64 bucket = last->lastTime / step;
+        Rollup& rollup = m_rollups[tier];
+        rollup.bucket = bucket;
+        for (const Point& p : readLocked(tier - 1, bucket * step, last->lastTime)) {
+            rollup.sum += p.value;
+            rollup.count++;
+        }
+    }
+}
+
+void TimeSeries::append(double value) {
+    append(QDateTime::currentMSecsSinceEpoch(), value);
+}
+
+void TimeSeries::append(qint64 timeMs, double value) {
+    QMutexLocker locker(&m_mutex);
+    if (m_tiers[Seconds]->append(timeMs, value)) rollUp(Minutes, timeMs, value);
+}
+
+void TimeSeries::rollUp(int tier, qint64 timeMs, double value) {
+    Rollup& rollup = m_rollups[tier];
+    const qint64 bucket = timeMs / TierStepMs[tier];
+
+    if (bucket != rollup.bucket) {
+        if (rollup.count > 0) {
+            // The bucket is complete: its mean is stamped with its start time
+            const qint64 start = rollup.bucket * TierStepMs[tier];
+            const double mean = rollup.sum / rollup.count;
+            if (m_tiers[tier]->append(start, mean) && tier + 1 < TierCount) rollUp(tier + 1, start, mean);
+        }
+        rollup.bucket = bucket;
+        rollup.sum = 0;
+        rollup.count = 0;
+    }
+    rollup.sum += value;
+    rollup.count++;
+}
+
+QVector<TimeSeries::Point> TimeSeries::read(Tier tier, qint64 fromMs, qint64 toMs) const {
+    QMutexLocker locker(&m_mutex);
+    return readLocked(tier, fromMs, toMs);
+}
+
+QVector<TimeSeries::Point> TimeSeries::readLocked(int tier, qint64 fromMs, qint64 toMs) const {
+    QVector<Point> points;
+    const TierFile* file = m_tiers[tier].get();
+    for (int index : file->ordered()) {
+        const BlockHeader* b = file->block(index);
+        // Block headers carry their time span, so untouched blocks are never decoded
+        if (b->lastTime < fromMs || b->firstTime > toMs) continue;
+        file->decode(index, fromMs, toMs, points);
+    }
+    return points;
+}
+
+QVector<TimeSeries::Point> TimeSeries::history(qint64 fromMs, qint64 toMs, int maxPoints) const {
+    QMutexLocker locker(&m_mutex);
+    maxPoints = qMax(1, maxPoints);
+    const qint64 span = qMax<qint64>(1, toMs - fromMs);
+
+    // Coarsest tier that still gives every output point at least one sample
+    int tier = Seconds;
+    while (tier + 1 < TierCount && TierStepMs[tier + 1] <= span / maxPoints) tier++;
+
+    QVector<Point> points = readLocked(tier, fromMs, toMs);
+
+    // Older than this tier keeps: fill in from coarser tiers
+    for (int coarser = tier + 1; coarser < TierCount; ++coarser) {
+        qint64 covered = points.isEmpty() ? toMs + 1 : points.first().time;
+        if (covered <= fromMs + TierStepMs[tier]) break;
+        QVector<Point> older = readLocked(coarser, fromMs, covered - 1);
+        if (!older.isEmpty()) points = older + points;
+    }
+    // Newer than this tier's last rollup: fill in from finer tiers
+    for (int finer = tier - 1; finer >= Seconds; --finer) {
+        qint64 covered = points.isEmpty() ? fromMs - 1 : points.last().time;
+        points += readLocked(finer, covered + 1, toMs);
+    }
+
+    if (points.size() <= maxPoints) return points;
+
+    // Average into maxPoints equal time buckets
+    QVector<Point> result;
+    result.reserve(maxPoints);
+    int bucket = -1;
+    double sum = 0;
+    qint64 timeSum = 0;
+    int count = 0;
+    for (const Point& p : std::as_const(points)) {
+        int b = int(qBound<qint64>(0, (p.time - fromMs) * maxPoints / (span + 1), maxPoints - 1));
+        if (b != bucket && count > 0) {
+            result.append(Point{timeSum / count, sum / count});
+            sum = 0;
+            timeSum = 0;
+            count = 0;
+        }
+        bucket = b;
+        sum += p.value;
+        timeSum += p.time - fromMs;
+        count++;
+    }
+    if (count > 0) result.append(Point{timeSum / count, sum / count});
+    for (Point& p : result) p.time += fromMs;
+    return result;
+}
+
+} // namespace Milk
@@ -0,0 +1,437 @@
+/**
+ * MilkWidgetCore - OpenGL Render Surfaces
+ */
+
+#include "widgets/GLSurface.h"
+
+#ifdef MILK_HAS_OPENGL
+
+#include "milk/Utils.h"
+
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QPainter>
+#include <QVector2D>
+#include <QtMath>
+
+namespace Milk {
+
+// Shaders carry no #version so they compile as GLSL 1.10 on desktop and
+// GLSL ES 1.00 on GLES; QOpenGLShaderProgram supplies the precision macros.
+// Output is premultiplied to match the widget's composited framebuffer.
+
+static const char* FlatVertexShader = R"(
+attribute highp vec2 a_pos;
+uniform highp vec2 u_size;
+void main() {
+    gl_Position = vec4(a_pos.x / u_size.x * 2.0 - 1.0, 1.0 - a_pos.y / u_size.y * 2.0, 0.0, 1.0);
+}
+)";
+
+static const char* FlatFragmentShader = R"(
+uniform lowp vec4 u_color;
+void main() {
+    gl_FragColor = vec4(u_color.rgb * u_color.a, u_color.a);
+}
+)";
+
+// Samples are addressed by a static index attribute: pair = index / 2 gives
+// the ring slot, odd indices are the area baseline when u_fill is set.
+static const char* SeriesVertexShader = R"(
+attribute highp float a_value;
+attribute highp float a_index;
+uniform highp float u_first;
+uniform highp float u_xStep;
+uniform highp float u_min;
+uniform highp float u_range;
+uniform highp float u_fill;
+varying highp float v_y;
+void main() {
+    highp float slot = floor(a_index * 0.5) - u_first;
+    highp float y = (a_value - u_min) / u_range;
+    y *= 1.0 - mod(a_index, 2.0) * u_fill;
+    v_y = y;
+    gl_Position = vec4(slot * u_xStep - 1.0, y * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char* SeriesFragmentShader = R"(
+uniform lowp vec4 u_top;
+uniform lowp vec4 u_bottom;
+varying highp float v_y;
+void main() {
+    lowp vec4 c = mix(u_bottom, u_top, clamp(v_y, 0.0, 1.0));
+    gl_FragColor = vec4(c.rgb * c.a, c.a);
+}
+)";
+
+// ============================================================================
+// SURFACE BASE
+// ============================================================================
+
+GLSurface::GLSurface(QWidget* parent) : QOpenGLWidget(parent) {
+    // Lets the surface blend over the translucent top-level instead of
+    // punching an opaque hole into it
+    setAttribute(Qt::WA_AlwaysStackOnTop);
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+
+    QSurfaceFormat fmt = format();
+    fmt.setAlphaBufferSize(8);
+    fmt.setSamples(4);
+    setFormat(fmt);
+}
+
+bool GLSurface::isAvailable() {
+    static int available = -1;
+    if (available < 0) {
+        if (qEnvironmentVariable("MILK_RENDERER").toLower() == "raster") {
+            available = 0;
+        } else {
+            // Mesa llvmpipe (LIBGL_ALWAYS_SOFTWARE=1) passes this probe, which
+            // is how the GL path runs on machines without a GPU
+            QOpenGLContext ctx;
+            QOffscreenSurface surface;
+            surface.create();
+            available = (ctx.create() && ctx.makeCurrent(&surface)) ? 1 : 0;
+            if (available) ctx.doneCurrent();
+            else log()->info("OpenGL unavailable, widgets use the raster renderer");
+        }
+    }
+    return available == 1;
+}
+
+RenderBackend GLSurface::resolve(RenderBackend requested) {
+    if (requested == RenderBackend::Raster) return RenderBackend::Raster;
+    return isAvailable() ? RenderBackend::OpenGL : RenderBackend::Raster;
+}
+
+void GLSurface::initializeGL() {
+    if (!context() || !context()->isValid()) { fail("invalid OpenGL context"); return; }
+    initializeOpenGLFunctions();
+    if (!buildFlatProgram() || !setupGL()) return;
+}
+
+bool GLSurface::buildFlatProgram() {
+    if (!m_flat.addShaderFromSourceCode(QOpenGLShader::Vertex, FlatVertexShader) ||
+        !m_flat.addShaderFromSourceCode(QOpenGLShader::Fragment, FlatFragmentShader) ||
+        !m_flat.link()) {
+        fail(m_flat.log());
+        return false;
+    }
+    return true;
+}
+
+void GLSurface::drawFlat(QOpenGLBuffer& buffer, GLenum mode, int first, int count, const QColor& color) {
+    if (count <= 0) return;
+    m_flat.bind();
+    m_flat.setUniformValue("u_size", QVector2D(float(width()), float(height())));
+    m_flat.setUniformValue("u_color", color);
+    buffer.bind();
+    int pos = m_flat.attributeLocation("a_pos");
+    m_flat.enableAttributeArray(pos);
+    m_flat.setAttributeBuffer(pos, GL_FLOAT, 0, 2);
+    glDrawArrays(mode, first, count);
+    m_flat.disableAttributeArray(pos);
+    buffer.release();
+    m_flat.release();
+}
+
+void GLSurface::fail(const QString& reason) {
+    if (m_failed) return;
+    m_failed = true;
+    log()->warning(QString("OpenGL renderer disabled: %1").arg(reason.trimmed()));
+    QMetaObject::invokeMethod(this, [this, reason]() { emit failed(reason); }, Qt::QueuedConnection);
+}
+
+// ============================================================================
+// GRAPH SURFACE
+// ============================================================================
+
+GLGraphSurface::GLGraphSurface(QWidget* parent) : GLSurface(parent) {
+    m_ring.resize(m_capacity * 4);
+}
+
+GLGraphSurface::~GLGraphSurface() {
+    if (!context()) return;
+    makeCurrent();
+    m_values.destroy(); m_indices.destroy(); m_grid.destroy();
+    doneCurrent();
+}
+
+void GLGraphSurface::setCapacity(int maxPoints) {
+    maxPoints = qMax(2, maxPoints);
+    if (maxPoints == m_capacity) return;
+
+    // Keep the newest samples that still fit
+    QList<double> kept;
+    for (int i = qMax(0, m_count - maxPoints); i < m_count; i++) {
+        kept.append(m_ring[((m_first + i) % m_capacity) * 2]);
+    }
+    m_capacity = maxPoints;
+    setSamples(kept);
+}
+
+void GLGraphSurface::setSamples(const QList<double>& values) {
+    m_ring.fill(0.0f, m_capacity * 4);
+    m_first = 0;
+    m_count = 0;
+    int start = qMax(0, int(values.size()) - m_capacity);
+    for (int i = start; i < values.size(); i++) {
+        writeSlot(m_count++, float(values[i]));
+    }
+    m_pending.clear();
+    m_reupload = true;
+    update();
+}
+
+void GLGraphSurface::pushSample(double value) {
+    int slot;
+    if (m_count < m_capacity) {
+        slot = (m_first + m_count++) % m_capacity;
+    } else {
+        slot = m_first;
+        m_first = (m_first + 1) % m_capacity;
+    }
+    writeSlot(slot, float(value));
+    if (!m_reupload) {
+        if (m_pending.size() >= m_capacity) m_reupload = true;
+        else m_pending.append(slot);
+    }
+    update();
+}
+
+void GLGraphSurface::writeSlot(int slot, float value) {
+    float* pair = m_ring.data() + slot * 2;
+    pair[0] = pair[1] = value;
+    float* mirror = m_ring.data() + (slot + m_capacity) * 2;
+    mirror[0] = mirror[1] = value;
+}
+
+void GLGraphSurface::setRange(double min, double max) {
+    if (min == m_min && max == m_max) return;
+    m_min = min; m_max = max;
+    update();
+}
+
+void GLGraphSurface::setStyle(GraphType type, const QColor& line, const QColor& fill, int lineWidth) {
+    m_type = type; m_lineColor = line; m_fillColor = fill; m_lineWidth = lineWidth;
+    update();
+}
+
+void GLGraphSurface::setGrid(bool show, const QColor& color) {
+    m_showGrid = show; m_gridColor = color;
+    update();
+}
+
+bool GLGraphSurface::setupGL() {
+    if (!m_series.addShaderFromSourceCode(QOpenGLShader::Vertex, SeriesVertexShader) ||
+        !m_series.addShaderFromSourceCode(QOpenGLShader::Fragment, SeriesFragmentShader) ||
+        !m_series.link()) {
+        fail(m_series.log());
+        return false;
+    }
+    if (!m_values.create() || !m_indices.create() || !m_grid.create()) {
+        fail("cannot create vertex buffers");
+        return false;
+    }
+    m_values.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_reupload = true;
+    m_gridDirty = true;
+    return true;
+}
+
+void GLGraphSurface::allocate() {
+    m_values.bind();
+    m_values.allocate(m_ring.constData(), int(m_ring.size() * sizeof(float)));
+    m_values.release();
+
+    QVector<float> indices(m_capacity * 4);
+    for (int i = 0; i < indices.size(); i++) indices[i] = float(i);
+    m_indices.bind();
+    m_indices.allocate(indices.constData(), int(indices.size() * sizeof(float)));
+    m_indices.release();
+}
+
+void GLGraphSurface::resizeGL(int, int) {
+    m_gridDirty = true;
+}
+
+void GLGraphSurface::paintGL() {
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (m_failed) return;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (m_showGrid) {
+        if (m_gridDirty) {
+            float w = width(), h = height(), lines[24];
+            for (int i = 1; i < 4; i++) {
+                float y = float(height() * i / 4) + 0.5f, x = float(width() * i / 4) + 0.5f;
+                float* hl = lines + (i - 1) * 4;
+                hl[0] = 0; hl[1] = y; hl[2] = w; hl[3] = y;
+                float* vl = lines + 12 + (i - 1) * 4;
+                vl[0] = x; vl[1] = 0; vl[2] = x; vl[3] = h;
+            }
+            m_grid.bind();
+            m_grid.allocate(lines, sizeof(lines));
+            m_grid.release();
+            m_gridDirty = false;
+        }
+        glLineWidth(1.0f);
+        drawFlat(m_grid, GL_LINES, 0, 12, m_gridColor);
+    }
+
+    // Upload only the slots written since the last frame
+    if (m_reupload) {
+        allocate();
+        m_reupload = false;
+        m_pending.clear();
+    } else if (!m_pending.isEmpty()) {
+        m_values.bind();
+        for (int slot : m_pending) {
+            m_values.write(slot * 2 * sizeof(float), m_ring.constData() + slot * 2, 2 * sizeof(float));
+            int mirror = slot + m_capacity;
+            m_values.write(mirror * 2 * sizeof(float), m_ring.constData() + mirror * 2, 2 * sizeof(float));
+        }
+        m_values.release();
+        m_pending.clear();
+    }
+
+    if (m_count < 2) return;
+
+    double range = m_max - m_min; if (range <= 0) range = 1;
+    m_series.bind();
+    m_series.setUniformValue("u_first", float(m_first));
+    m_series.setUniformValue("u_xStep", float(2.0 / (m_capacity - 1)));
+    m_series.setUniformValue("u_min", float(m_min));
+    m_series.setUniformValue("u_range", float(range));
+
+    int valueLoc = m_series.attributeLocation("a_value");
+    int indexLoc = m_series.attributeLocation("a_index");
+    m_series.enableAttributeArray(valueLoc);
+    m_series.enableAttributeArray(indexLoc);
+
+    auto bindSeries = [&](int stride) {
+        m_values.bind(); m_series.setAttributeBuffer(valueLoc, GL_FLOAT, 0, 1, stride);
+        m_indices.bind(); m_series.setAttributeBuffer(indexLoc, GL_FLOAT, 0, 1, stride);
+    };
+
+    if (m_type == GraphType::Area) {
+        QColor bottom = m_fillColor; bottom.setAlpha(20);
+        m_series.setUniformValue("u_fill", 1.0f);
+        m_series.setUniformValue("u_top", m_fillColor);
+        m_series.setUniformValue("u_bottom", bottom);
+        bindSeries(sizeof(float));
+        glDrawArrays(GL_TRIANGLE_STRIP, m_first * 2, m_count * 2);
+    }
+
+    // One vertex per pair for the polyline
+    m_series.setUniformValue("u_fill", 0.0f);
+    m_series.setUniformValue("u_top", m_lineColor);
+    m_series.setUniformValue("u_bottom", m_lineColor);
+    bindSeries(2 * sizeof(float));
+    glLineWidth(float(m_lineWidth * devicePixelRatioF()));
+    glDrawArrays(GL_LINE_STRIP, m_first, m_count);
+
+    m_series.disableAttributeArray(valueLoc);
+    m_series.disableAttributeArray(indexLoc);
+    m_indices.release();
+    m_series.release();
+}
+
+// ============================================================================
+// GAUGE SURFACE
+// ============================================================================
+
+GLGaugeSurface::GLGaugeSurface(QWidget* parent) : GLSurface(parent) { }
+
+GLGaugeSurface::~GLGaugeSurface() {
+    if (!context()) return;
+    makeCurrent();
+    m_arc.destroy();
+    doneCurrent();
+}
+
+void GLGaugeSurface::setArc(int startAngle, int endAngle, int thickness) {
+    if (startAngle == m_startAngle && endAngle == m_endAngle && thickness == m_thickness) return;
+    m_startAngle = startAngle; m_endAngle = endAngle; m_thickness = thickness;
+    m_arcDirty = true;
+    update();
+}
+
+void GLGaugeSurface::setColors(const QColor& background, const QColor& fill) {
+    m_bgColor = background; m_fillColor = fill;
+    update();
+}
+
+void GLGaugeSurface::setFraction(double fraction) {
+    fraction = qBound(0.0, fraction, 1.0);
+    if (fraction == m_fraction) return;
+    m_fraction = fraction;
+    update();
+}
+
+void GLGaugeSurface::setText(const QString& text, const QColor& color) {
+    if (text == m_text && color == m_textColor) return;
+    m_text = text; m_textColor = color;
+    update();
+}
+
+bool GLGaugeSurface::setupGL() {
+    if (!m_arc.create()) { fail("cannot create vertex buffer"); return false; }
+    m_arcDirty = true;
+    return true;
+}
+
+void GLGaugeSurface::resizeGL(int, int) {
+    m_arcDirty = true;
+}
+
+void GLGaugeSurface::tessellate() {
+    // Triangle strip along the full sweep; a value is drawn as a prefix of it
+    int side = qMin(width(), height());
+    double radius = (side - 2.0 * m_thickness) / 2.0;
+    double cx = width() / 2.0, cy = height() / 2.0;
+    double inner = radius - m_thickness / 2.0, outer = radius + m_thickness / 2.0;
+    double span = m_startAngle - m_endAngle;
+
+    QVector<float> strip; strip.reserve((Segments + 1) * 4);
+    for (int k = 0; k <= Segments; k++) {
+        double a = qDegreesToRadians(m_startAngle - span * k / Segments);
+        double c = qCos(a), s = qSin(a);
+        strip << float(cx + outer * c) << float(cy - outer * s)
+              << float(cx + inner * c) << float(cy - inner * s);
+    }
+    m_arc.bind();
+    m_arc.allocate(strip.constData(), int(strip.size() * sizeof(float)));
+    m_arc.release();
+    m_arcDirty = false;
+}
+
+void GLGaugeSurface::paintGL() {
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (m_failed) return;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (m_arcDirty) tessellate();
+    drawFlat(m_arc, GL_TRIANGLE_STRIP, 0, (Segments + 1) * 2, m_bgColor);
+    int k = qRound(m_fraction * Segments);
+    if (k > 0) drawFlat(m_arc, GL_TRIANGLE_STRIP, 0, (k + 1) * 2, m_fillColor);
+
+    if (!m_text.isEmpty()) {
+        int side = qMin(width(), height());
+        QPainter p(this); p.setRenderHint(QPainter::TextAntialiasing);
+        p.setPen(m_textColor);
+        QFont f = p.font(); f.setPointSize(qMax(1, side / 6)); f.setBold(true); p.setFont(f);
+        p.drawText(rect(), Qt::AlignCenter, m_text);
+    }
+}
+
+} // namespace Milk
+
+#endif // MILK_HAS_OPENGL
@@ -0,0 +1,148 @@
+/**
+ * MilkWidgetCore - OpenGL Render Surfaces (private)
+ *
+ * Child surfaces that Graph and Gauge stack over themselves when the
+ * OpenGL backend is active. Geometry lives in vertex buffers that are
+ * patched per sample instead of being re-tessellated every frame.
+ */
+
+#pragma once
+
+#ifdef MILK_HAS_OPENGL
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QColor>
+#include <QFont>
+#include <QVector>
+
+#include "milk/Types.h"
+
+namespace Milk {
+
+class GLSurface : public QOpenGLWidget, protected QOpenGLFunctions {
+    Q_OBJECT
+
+public:
+    explicit GLSurface(QWidget* parent);
+    virtual ~GLSurface() = default;
+
+    /** True when an OpenGL context can be created (probed once).
+     *  MILK_RENDERER=raster forces false. */
+    static bool isAvailable();
+
+    /** Resolve a requested backend against what this machine supports */
+    static RenderBackend resolve(RenderBackend requested);
+
+signals:
+    /** Emitted (queued) when the context or shaders fail; owner falls back to raster */
+    void failed(const QString& reason);
+
+protected:
+    void initializeGL() override;
+    virtual bool setupGL() = 0;
+
+    /** Solid-colour program over pixel-space vec2 positions */
+    bool buildFlatProgram();
+    void drawFlat(QOpenGLBuffer& buffer, GLenum mode, int first, int count, const QColor& color);
+
+    void fail(const QString& reason);
+
+    QOpenGLShaderProgram m_flat;
+    bool m_failed = false;
+};
+
+// ============================================================================
+// GRAPH SURFACE
+// ============================================================================
+class GLGraphSurface : public GLSurface {
+    Q_OBJECT
+
+public:
+    explicit GLGraphSurface(QWidget* parent);
+    ~GLGraphSurface() override;
+
+    void setCapacity(int maxPoints);
+    void setSamples(const QList<double>& values);
+    void pushSample(double value);
+    void setRange(double min, double max);
+    void setStyle(GraphType type, const QColor& line, const QColor& fill, int lineWidth);
+    void setGrid(bool show, const QColor& color);
+
+protected:
+    bool setupGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+
+private:
+    void allocate();
+    void writeSlot(int slot, float value);
+
+    QOpenGLShaderProgram m_series;
+    QOpenGLBuffer m_values{QOpenGLBuffer::VertexBuffer};
+    QOpenGLBuffer m_indices{QOpenGLBuffer::VertexBuffer};
+    QOpenGLBuffer m_grid{QOpenGLBuffer::VertexBuffer};
+
+    // Ring of samples; each stored as a (value, value) pair twice, at slot
+    // and slot + capacity, so the window [first, first + count) is contiguous
+    int m_capacity = 60;
+    int m_first = 0;
+    int m_count = 0;
+    QVector<float> m_ring;
+    QVector<int> m_pending;
+    bool m_reupload = true;
+    bool m_gridDirty = true;
+
+    double m_min = 0;
+    double m_max = 100;
+    GraphType m_type = GraphType::Line;
+    QColor m_lineColor;
+    QColor m_fillColor;
+    QColor m_gridColor;
+    int m_lineWidth = 2;
+    bool m_showGrid = true;
+};
+
+// ============================================================================
+// GAUGE SURFACE
+// ============================================================================
+class GLGaugeSurface : public GLSurface {
+    Q_OBJECT
+
+public:
+    explicit GLGaugeSurface(QWidget* parent);
+    ~GLGaugeSurface() override;
+
+    void setArc(int startAngle, int endAngle, int thickness);
+    void setColors(const QColor& background, const QColor& fill);
+    void setFraction(double fraction);
+    void setText(const QString& text, const QColor& color);
+
+protected:
+    bool setupGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+
+private:
+    void tessellate();
+
+    static constexpr int Segments = 128;
+
+    QOpenGLBuffer m_arc{QOpenGLBuffer::VertexBuffer};
+    bool m_arcDirty = true;
+
+    int m_startAngle = 225;
+    int m_endAngle = -45;
+    int m_thickness = 10;
+    QColor m_bgColor;
+    QColor m_fillColor;
+    double m_fraction = 0;
+    QString m_text;
+    QColor m_textColor;
+};
+
+} // namespace Milk
+
+#endif // MILK_HAS_OPENGL
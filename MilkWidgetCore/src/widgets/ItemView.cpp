@@ -0,0 +1,395 @@
+/**
+ * MilkWidgetCore - Item View Implementation
+ */
+
+#include "milk/Widgets.h"
+#include "milk/Widget.h"
+
+#include <QPaintEvent>
+#include <utility>
+#include <vector>
+
+namespace Milk {
+
+ItemView::ItemView(Direction direction, QWidget* parent) : QWidget(parent) {
+    static_assert(sizeof(Item) <= 64, "items are meant to stay a cache line or less");
+    setAttribute(Qt::WA_TranslucentBackground);
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+
+    ItemStyle base;
+    base.font = font();
+    m_styles.append(base);
+
+    Item root;
+    root.direction = quint8(direction);
+    m_items.append(root);
+}
+
+ItemView* ItemView::create(Direction direction, Widget* parent) { return new ItemView(direction, parent); }
+
+// ============================================================================
+// BUILDING
+// ============================================================================
+
+int ItemView::addStyle(const ItemStyle& style) {
+    m_styles.append(style);
+    return m_styles.size() - 1;
+}
+
+void ItemView::setStyle(int index, const ItemStyle& style) {
+    if (index < 0 || index >= m_styles.size()) return;
+    m_styles[index] = style;
+    m_layoutDirty = true;
+    updateGeometry();
+    update();
+}
+
+int ItemView::append(int parent, Kind kind, int style) {
+    if (parent < 0 || parent >= m_items.size() || m_items[parent].kind != Box) {
+        return -1;
+    }
+    Item item;
+    item.kind = kind;
+    item.parent = parent;
+    item.style = quint16(qBound(0, style, m_styles.size() - 1));
+
+    int index = m_items.size();
+    m_items.append(item);
+    Item& owner = m_items[parent];
+    if (owner.lastChild >= 0) m_items[owner.lastChild].next = index;
+    else owner.firstChild = index;
+    owner.lastChild = index;
+
+    m_layoutDirty = true;
+    updateGeometry();
+    update();
+    return index;
+}
+
+int ItemView::addBox(int parent, Direction direction, int gap, int padding, int style) {
+    int index = append(parent, Box, style);
+    if (index >= 0) {
+        m_items[index].direction = quint8(direction);
+        m_items[index].gap = qint16(gap);
+        m_items[index].padding = qint16(padding);
+    }
+    return index;
+}
+
+int ItemView::addLabel(int parent, const QString& text, int style) {
+    int index = append(parent, Label, style);
+    if (index >= 0) {
+        m_items[index].data = m_strings.size();
+        m_strings.append(text);
+    }
+    return index;
+}
+
+int ItemView::addBar(int parent, double value, double max, int style) {
+    int index = append(parent, Bar, style);
+    if (index >= 0) {
+        m_items[index].max = float(max);
+        m_items[index].value = float(qBound(0.0, value, max));
+    }
+    return index;
+}
+
+int ItemView::addSpace(int parent, int size) {
+    int index = append(parent, Space, 0);
+    if (index >= 0) {
+        m_items[index].size = qint16(size);
+        if (size < 0) m_items[index].grow = 1;
+    }
+    return index;
+}
+
+int ItemView::addCustom(int parent, Painter painter, int style) {
+    int index = append(parent, Custom, style);
+    if (index >= 0) {
+        m_items[index].data = m_painters.size();
+        m_painters.append(painter);
+    }
+    return index;
+}
+
+// ============================================================================
+// UPDATES
+// ============================================================================
+
+void ItemView::setText(int index, const QString& text) {
+    if (index < 0 || index >= m_items.size() || m_items[index].kind != Label) return;
+    QString& current = m_strings[m_items[index].data];
+    if (current == text) return;
+
+    bool sameWidth = !m_layoutDirty && index < m_natural.size() &&
+                     QFontMetrics(m_styles[m_items[index].style].font).horizontalAdvance(text) ==
+                         m_natural[index].width();
+    current = text;
+    if (sameWidth) update(m_items[index].rect);
+    else invalidate(index);
+}
+
+void ItemView::setValue(int index, double value) {
+    if (index < 0 || index >= m_items.size() || m_items[index].kind != Bar) return;
+    Item& item = m_items[index];
+    float clamped = float(qBound(0.0, value, double(item.max)));
+    if (clamped == item.value) return;
+    item.value = clamped;
+    update(item.rect);
+}
+
+void ItemView::setGrow(int index, double grow) {
+    if (index < 0 || index >= m_items.size()) return;
+    m_items[index].grow = float(qMax(0.0, grow));
+    m_layoutDirty = true;
+    update();
+}
+
+void ItemView::setSize(int index, int size) {
+    if (index < 0 || index >= m_items.size()) return;
+    m_items[index].size = qint16(size);
+    m_layoutDirty = true;
+    updateGeometry();
+    update();
+}
+
+void ItemView::setGap(int index, int gap) {
+    if (index < 0 || index >= m_items.size()) return;
+    m_items[index].gap = qint16(gap);
+    m_layoutDirty = true;
+    updateGeometry();
+    update();
+}
+
+void ItemView::setPadding(int index, int padding) {
+    if (index < 0 || index >= m_items.size()) return;
+    m_items[index].padding = qint16(padding);
+    m_layoutDirty = true;
+    updateGeometry();
+    update();
+}
+
+void ItemView::setItemStyle(int index, int style) {
+    if (index < 0 || index >= m_items.size()) return;
+    m_items[index].style = quint16(qBound(0, style, m_styles.size() - 1));
+    m_layoutDirty = true;
+    updateGeometry();
+    update();
+}
+
+void ItemView::setName(int index, const QString& name) {
+    if (index < 0 || index >= m_items.size()) return;
+    m_names.insert(name, index);
+}
+
+void ItemView::invalidate(int index) {
+    // A label's width only moves things when some row up the chain sizes
+    // this branch by its content; otherwise repainting the label is enough
+    for (int child = index, parent = m_items[index].parent; parent >= 0;
+         child = parent, parent = m_items[parent].parent) {
+        if (m_items[parent].direction == Row && m_items[child].size < 0) {
+            m_layoutDirty = true;
+            update();
+            return;
+        }
+    }
+    if (index < m_natural.size()) {
+        m_natural[index].setWidth(QFontMetrics(m_styles[m_items[index].style].font)
+                                      .horizontalAdvance(m_strings[m_items[index].data]));
+    }
+    update(m_items[index].rect);
+}
+
+// ============================================================================
+// LAYOUT
+// ============================================================================
+
+QRect ItemView::itemRect(int index) {
+    if (index < 0 || index >= m_items.size()) return QRect();
+    ensureLayout();
+    return m_items[index].rect;
+}
+
+int ItemView::itemAt(const QPoint& pos) {
+    ensureLayout();
+    // Later items are children or later siblings, so the last hit is on top
+    for (int i = m_items.size() - 1; i >= 0; --i) {
+        if (m_items[i].rect.contains(pos)) return i;
+    }
+    return -1;
+}
+
+QSize ItemView::sizeHint() const {
+    measure();
+    return m_natural[0].expandedTo(QSize(1, 1));
+}
+
+void ItemView::resizeEvent(QResizeEvent* event) {
+    m_layoutDirty = true;
+    QWidget::resizeEvent(event);
+}
+
+void ItemView::ensureLayout() {
+    if (!m_layoutDirty) return;
+    measure();
+    layout(0, rect());
+    m_layoutDirty = false;
+}
+
+void ItemView::measure() const {
+    // Children always follow their parent, so walking backwards sees every
+    // child's natural size before its box needs it
+    m_natural.resize(m_items.size());
+    std::vector<QFontMetrics> metrics;
+    metrics.reserve(size_t(m_styles.size()));
+    for (const ItemStyle& style : m_styles) metrics.emplace_back(style.font);
+
+    for (int i = m_items.size() - 1; i >= 0; --i) {
+        const Item& item = m_items[i];
+        QSize natural;
+        switch (item.kind) {
+        case Label: {
+            const QFontMetrics& fm = metrics[item.style];
+            natural = QSize(fm.horizontalAdvance(m_strings[item.data]), fm.height());
+            break;
+        }
+        case Bar:
+            natural = QSize(0, m_styles[item.style].barHeight);
+            break;
+        case Space:
+            natural = QSize(qMax(0, int(item.size)), qMax(0, int(item.size)));
+            break;
+        case Custom:
+            break;
+        case Box: {
+            bool row = item.direction == Row;
+            bool stack = item.direction == Stack;
+            int main = 0, cross = 0, count = 0;
+            for (int c = item.firstChild; c >= 0; c = m_items[c].next, ++count) {
+                QSize child = m_natural[c];
+                if (stack) {
+                    main = qMax(main, child.width());
+                    cross = qMax(cross, child.height());
+                } else if (row) {
+                    main += m_items[c].size >= 0 ? m_items[c].size : child.width();
+                    cross = qMax(cross, child.height());
+                } else {
+                    main += m_items[c].size >= 0 ? m_items[c].size : child.height();
+                    cross = qMax(cross, child.width());
+                }
+            }
+            if (!stack && count > 1) main += item.gap * (count - 1);
+            natural = (row || stack) ? QSize(main, cross) : QSize(cross, main);
+            natural += QSize(2 * item.padding, 2 * item.padding);
+            break;
+        }
+        }
+        m_natural[i] = natural;
+    }
+}
+
+void ItemView::layout(int index, const QRect& rect) {
+    Item& item = m_items[index];
+    item.rect = rect;
+    if (item.kind != Box) return;
+
+    QRect content = rect.adjusted(item.padding, item.padding, -item.padding, -item.padding);
+    if (item.direction == Stack) {
+        for (int c = item.firstChild; c >= 0; c = m_items[c].next) layout(c, content);
+        return;
+    }
+
+    bool row = item.direction == Row;
+    auto extentOf = [&](int c) {
+        const Item& child = m_items[c];
+        if (child.size >= 0) return int(child.size);
+        return row ? m_natural[c].width() : m_natural[c].height();
+    };
+
+    int used = 0, count = 0;
+    double grow = 0;
+    for (int c = item.firstChild; c >= 0; c = m_items[c].next, ++count) {
+        used += extentOf(c);
+        grow += m_items[c].grow;
+    }
+    if (count == 0) return;
+    used += item.gap * (count - 1);
+    int spare = qMax(0, (row ? content.width() : content.height()) - used);
+
+    // Spare room is handed out cumulatively so rounding never loses a pixel
+    int pos = row ? content.x() : content.y();
+    double granted = 0;
+    int given = 0;
+    for (int c = item.firstChild; c >= 0; c = m_items[c].next) {
+        int extent = extentOf(c);
+        if (grow > 0 && m_items[c].grow > 0) {
+            granted += m_items[c].grow;
+            int total = int(spare * granted / grow + 0.5);
+            extent += total - given;
+            given = total;
+        }
+        layout(c, row ? QRect(pos, content.y(), extent, content.height())
+                      : QRect(content.x(), pos, content.width(), extent));
+        pos += extent + item.gap;
+    }
+}
+
+// ============================================================================
+// PAINTING
+// ============================================================================
+
+void ItemView::paintEvent(QPaintEvent* event) {
+    ensureLayout();
+
+    QPainter p(this);
+    p.setRenderHint(QPainter::Antialiasing);
+    const QRect dirty = event->rect();
+    int fontStyle = -1;
+
+    for (const Item& item : std::as_const(m_items)) {
+        if (item.rect.isEmpty() || !item.rect.intersects(dirty)) continue;
+        const ItemStyle& style = m_styles[item.style];
+
+        switch (item.kind) {
+        case Box:
+            if (style.background.alpha() > 0) {
+                p.setPen(Qt::NoPen);
+                p.setBrush(style.background);
+                p.drawRoundedRect(QRectF(item.rect), style.radius, style.radius);
+            }
+            break;
+        case Label:
+            if (fontStyle != item.style) {
+                p.setFont(style.font);
+                fontStyle = item.style;
+            }
+            p.setPen(style.color);
+            p.drawText(item.rect, int(style.align) | Qt::TextSingleLine, m_strings[item.data]);
+            break;
+        case Bar: {
+            // Centered across the cell at the style's height, whatever the
+            // layout stretched the cell to
+            qreal height = qMin<qreal>(item.rect.height(), style.barHeight);
+            QRectF track(item.rect.x(), item.rect.y() + (item.rect.height() - height) / 2, item.rect.width(), height);
+            p.setPen(Qt::NoPen);
+            p.setBrush(style.track);
+            p.drawRoundedRect(track, style.radius, style.radius);
+            double ratio = item.max > 0 ? qBound(0.0, double(item.value) / item.max, 1.0) : 0.0;
+            if (ratio > 0) {
+                p.setBrush(style.color);
+                p.drawRoundedRect(QRectF(track.x(), track.y(), track.width() * ratio, height), style.radius, style.radius);
+            }
+            break;
+        }
+        case Custom:
+            p.save();
+            m_painters[item.data](p, item.rect);
+            p.restore();
+            break;
+        case Space:
+            break;
+        }
+    }
+}
+
+} // namespace Milk
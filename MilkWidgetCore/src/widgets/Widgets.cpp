@@ -6,6 +6,7 @@
 #include "milk/Widget.h"
 #include "milk/Utils.h"
 
+#include <QDateTime>
 #include <QPainter>
 #include <QPainterPath>
 #include <QGraphicsDropShadowEffect>
@@ -13,8 +14,14 @@
 #include <QHBoxLayout>
 #include <QGridLayout>
 #include <QFontDatabase>
+#include <QImageReader>
+#include <QFileInfo>
 #include <QtMath>
 
+#ifdef MILK_HAS_OPENGL
+#include "widgets/GLSurface.h"
+#endif
+
 namespace Milk {
 
 // ============================================================================
@@ -23,8 +30,9 @@ namespace Milk {
 
 Text::Text(const QString& text, QWidget* parent) : QLabel(text, parent) {
     setWordWrap(true);
+    // No style sheet: a per-label sheet makes QStyleSheetStyle polish every
+    // instance, and QLabel paints no background without one anyway
     setAttribute(Qt::WA_TranslucentBackground);
-    setStyleSheet("background: transparent;");
 }
 
 Text* Text::create(const QString& text, Widget* parent) { return new Text(text, parent); }
@@ -86,13 +94,24 @@ void Text::setSubtitle() { QFont f = font(); f.setPointSize(14); QLabel::setFont
 void Text::setBody() { QFont f = font(); f.setPointSize(12); QLabel::setFont(f); }
 void Text::setCaption() { QFont f = font(); f.setPointSize(10); QLabel::setFont(f); setColor(QColor(150,150,150)); }
 void Text::setMonospace() { QFont f = QFontDatabase::systemFont(QFontDatabase::FixedFont); f.setPointSize(font().pointSize()); QLabel::setFont(f); }
-void Text::setCode() { setMonospace(); setStyleSheet("background: rgba(0,0,0,50); padding: 4px; border-radius: 3px;"); }
+void Text::setCode() { setMonospace(); m_backdrop = QColor(0, 0, 0, 50); setContentsMargins(4, 4, 4, 4); update(); }
 void Text::setStyleClass(const QString& className) { m_styleClass = className; }
 void Text::setWrap(bool enabled) { setWordWrap(enabled); }
 void Text::setMaxWidth(int width) { setMaximumWidth(width); }
 void Text::setMaxLines(int lines) { m_maxLines = lines; }
 void Text::setEllipsis(bool enabled) { m_ellipsis = enabled; }
 
+void Text::paintEvent(QPaintEvent* event) {
+    if (m_backdrop.alpha() > 0) {
+        QPainter p(this);
+        p.setRenderHint(QPainter::Antialiasing);
+        p.setPen(Qt::NoPen);
+        p.setBrush(m_backdrop);
+        p.drawRoundedRect(QRectF(rect()), 3, 3);
+    }
+    QLabel::paintEvent(event);
+}
+
 // ============================================================================
 // PROGRESS BAR
 // ============================================================================
@@ -104,10 +123,16 @@ ProgressBar::ProgressBar(QWidget* parent) : QWidget(parent) {
 ProgressBar* ProgressBar::create(Widget* parent) { return new ProgressBar(parent); }
 
 void ProgressBar::setValue(double value) {
+    double oldDisplay = m_displayValue;
+    QString oldText = m_showText ? formattedText() : QString();
     m_value = qBound(m_minValue, value, m_maxValue);
     if (m_animated && m_animTimerId == 0) m_animTimerId = startTimer(16);
-    else if (!m_animated) m_displayValue = m_value;
-    emit valueChanged(m_value); update();
+    else if (!m_animated) { m_displayValue = m_value; update(fillDamage(oldDisplay, m_displayValue)); }
+    if (m_showText) {
+        QString txt = formattedText();
+        if (txt != oldText) update(textDamage(oldText).united(textDamage(txt)));
+    }
+    emit valueChanged(m_value);
 }
 void ProgressBar::setMinValue(double min) { m_minValue = min; update(); }
 void ProgressBar::setMaxValue(double max) { m_maxValue = max; update(); }
@@ -126,33 +151,60 @@ void ProgressBar::animateTo(double v, int) { setValue(v); }
 void ProgressBar::setIndeterminate(bool e) { m_indeterminate = e; if (e && m_animTimerId == 0) m_animTimerId = startTimer(16); update(); }
 void ProgressBar::setOrientation(Qt::Orientation o) { m_orientation = o; update(); }
 
+QString ProgressBar::formattedText() const {
+    QString txt = m_textFormat;
+    txt.replace("%v", QString::number(int(m_value)));
+    txt.replace("%m", QString::number(int(m_maxValue)));
+    return txt;
+}
+QRect ProgressBar::fillDamage(double from, double to) const {
+    double range = m_maxValue - m_minValue;
+    auto edge = [&](double v) { return width() * (range > 0 ? qBound(0.0, (v - m_minValue) / range, 1.0) : 0.0); };
+    double a = edge(from), b = edge(to);
+    if (a == b) return QRect();
+    // The fill is a fixed full-width layer, so only the span between the edges changes
+    return QRect(qFloor(qMin(a, b)) - 1, 0, qCeil(qAbs(a - b)) + 2, height()).intersected(rect());
+}
+QRect ProgressBar::textDamage(const QString& text) const {
+    if (text.isEmpty()) return QRect();
+    return fontMetrics().boundingRect(rect(), Qt::AlignCenter, text).adjusted(-1, -1, 1, 1);
+}
+
 void ProgressBar::paintEvent(QPaintEvent*) {
-    QPainter p(this); p.setRenderHint(QPainter::Antialiasing);
-    QRectF r = rect();
-    QPainterPath bgPath; bgPath.addRoundedRect(r, m_radius, m_radius); p.fillPath(bgPath, m_bgColor);
+    // Track and full-width fill are rendered once per size/style; a frame is
+    // then two blits, the fill clipped to the current value
+    qreal dpr = devicePixelRatioF();
+    ContentHash bh; bh << QStringLiteral("progress-track") << m_bgColor << m_radius;
+    QPixmap track = renderCache()->fetch(bh.value(), size(), dpr, [this](QPainter& lp, const QSize& s) {
+        QPainterPath path; path.addRoundedRect(QRectF(QPointF(0, 0), s), m_radius, m_radius);
+        lp.setRenderHint(QPainter::Antialiasing); lp.fillPath(path, m_bgColor);
+    });
+    ContentHash fh; fh << QStringLiteral("progress-fill") << m_fillColor << m_fillEndColor << m_radius;
+    QPixmap fill = renderCache()->fetch(fh.value(), size(), dpr, [this](QPainter& lp, const QSize& s) {
+        QRectF r(QPointF(0, 0), s);
+        QPainterPath path; path.addRoundedRect(r, m_radius, m_radius);
+        lp.setRenderHint(QPainter::Antialiasing);
+        if (m_fillEndColor.isValid()) {
+            QLinearGradient grad(r.topLeft(), r.topRight());
+            grad.setColorAt(0, m_fillColor); grad.setColorAt(1, m_fillEndColor);
+            lp.fillPath(path, grad);
+        } else lp.fillPath(path, m_fillColor);
+    });
+    
+    QPainter p(this);
+    p.drawPixmap(0, 0, track);
     double range = m_maxValue - m_minValue;
-    double pct = range > 0 ? (m_displayValue - m_minValue) / range : 0;
-    pct = qBound(0.0, pct, 1.0);
-    QRectF fillRect = r; fillRect.setWidth(r.width() * pct);
-    QPainterPath fillPath; fillPath.addRoundedRect(fillRect, m_radius, m_radius);
-    if (m_fillEndColor.isValid()) {
-        QLinearGradient grad(fillRect.topLeft(), fillRect.topRight());
-        grad.setColorAt(0, m_fillColor); grad.setColorAt(1, m_fillEndColor);
-        p.fillPath(fillPath, grad);
-    } else p.fillPath(fillPath, m_fillColor);
-    if (m_showText) {
-        QString txt = m_textFormat;
-        txt.replace("%v", QString::number(int(m_value)));
-        txt.replace("%m", QString::number(int(m_maxValue)));
-        p.setPen(m_textColor); p.drawText(r, Qt::AlignCenter, txt);
-    }
+    double pct = range > 0 ? qBound(0.0, (m_displayValue - m_minValue) / range, 1.0) : 0;
+    double fillW = width() * pct;
+    if (fillW > 0) p.drawPixmap(QRectF(0, 0, fillW, height()), fill, QRectF(0, 0, fillW * dpr, height() * dpr));
+    if (m_showText) { p.setPen(m_textColor); p.drawText(rect(), Qt::AlignCenter, formattedText()); }
 }
 void ProgressBar::timerEvent(QTimerEvent* e) {
     if (e->timerId() == m_animTimerId) {
-        double diff = m_value - m_displayValue;
+        double old = m_displayValue, diff = m_value - m_displayValue;
         if (qAbs(diff) < 0.1) { m_displayValue = m_value; killTimer(m_animTimerId); m_animTimerId = 0; }
         else m_displayValue += diff * 0.15;
-        update();
+        if (m_indeterminate) update(); else update(fillDamage(old, m_displayValue));
     }
 }
 
@@ -173,60 +225,143 @@ void Graph::addValue(double value) {
         m_maxValue = *std::max_element(m_values.begin(), m_values.end());
         if (qFuzzyCompare(m_minValue, m_maxValue)) m_maxValue = m_minValue + 1;
     }
+#ifdef MILK_HAS_OPENGL
+    if (m_surface) {
+        // One vertex pair patched on the GPU; this widget itself stays clean.
+        // A hidden surface is kept current for when it is shown again
+        m_surface->pushSample(value); m_surface->setRange(m_minValue, m_maxValue);
+        if (onSurface()) return;
+    }
+#endif
+    update();
+}
+void Graph::setValues(const QList<double>& v) {
+    m_values = v; while (m_values.size() > m_maxPoints) m_values.removeFirst();
+#ifdef MILK_HAS_OPENGL
+    if (m_surface) m_surface->setSamples(m_values);
+#endif
     update();
 }
-void Graph::setValues(const QList<double>& v) { m_values = v; while (m_values.size() > m_maxPoints) m_values.removeFirst(); update(); }
-void Graph::clear() { m_values.clear(); update(); }
-void Graph::setMinValue(double m) { m_minValue = m; update(); }
-void Graph::setMaxValue(double m) { m_maxValue = m; update(); }
+void Graph::clear() { setValues(QList<double>()); }
+void Graph::loadHistory(const QString& metric, int seconds) {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<double> values;
+    // find(): a graph of a metric nobody records must not create its files
+    if (TimeSeries* series = TimeSeries::find(metric)) {
+        for (const TimeSeries::Point& p : series->history(now - qint64(seconds) * 1000, now, m_maxPoints)) values.append(p.value);
+    }
+    setValues(values);
+}
+void Graph::setMinValue(double m) { m_minValue = m; syncSurface(); update(); }
+void Graph::setMaxValue(double m) { m_maxValue = m; syncSurface(); update(); }
 void Graph::setAutoScale(bool e) { m_autoScale = e; }
-void Graph::setMaxPoints(int c) { m_maxPoints = c; }
-void Graph::setGraphType(GraphType t) { m_type = t; update(); }
-void Graph::setLineColor(const QColor& c) { m_lineColor = c; update(); }
-void Graph::setFillColor(const QColor& c) { m_fillColor = c; update(); }
-void Graph::setLineWidth(int w) { m_lineWidth = w; update(); }
-void Graph::setShowGrid(bool s) { m_showGrid = s; update(); }
-void Graph::setGridColor(const QColor& c) { m_gridColor = c; update(); }
-void Graph::setShowLabels(bool s) { m_showLabels = s; update(); }
-void Graph::setSmooth(bool e) { m_smooth = e; update(); }
+void Graph::setMaxPoints(int c) { m_maxPoints = c; syncSurface(); }
+void Graph::setGraphType(GraphType t) { m_type = t; syncSurface(); update(); }
+void Graph::setLineColor(const QColor& c) { m_lineColor = c; syncSurface(); update(); }
+void Graph::setFillColor(const QColor& c) { m_fillColor = c; syncSurface(); update(); }
+void Graph::setLineWidth(int w) { m_lineWidth = w; syncSurface(); update(); }
+void Graph::setShowGrid(bool s) { m_showGrid = s; syncSurface(); update(); }
+void Graph::setGridColor(const QColor& c) { m_gridColor = c; syncSurface(); update(); }
+void Graph::setShowLabels(bool s) { m_showLabels = s; syncSurface(); update(); }
+void Graph::setSmooth(bool e) { m_smooth = e; syncSurface(); update(); }
 void Graph::setAntialiased(bool e) { m_antialiased = e; update(); }
 
+void Graph::setRenderBackend(RenderBackend backend) {
+    m_backend = backend;
+#ifdef MILK_HAS_OPENGL
+    if (GLSurface::resolve(backend) == RenderBackend::OpenGL) {
+        if (!m_surface) {
+            m_surface = new GLGraphSurface(this);
+            m_surface->setGeometry(rect());
+            connect(m_surface, &GLSurface::failed, this, [this]() { dropSurface(); });
+            syncSurface(); m_surface->setSamples(m_values);
+        }
+    } else dropSurface();
+#endif
+    update();
+}
+RenderBackend Graph::renderBackend() const { return onSurface() ? RenderBackend::OpenGL : RenderBackend::Raster; }
+bool Graph::onSurface() const {
+#ifdef MILK_HAS_OPENGL
+    return m_surface && !m_surface->isHidden();
+#else
+    return false;
+#endif
+}
+
+void Graph::syncSurface() {
+#ifdef MILK_HAS_OPENGL
+    if (!m_surface) return;
+    m_surface->setCapacity(m_maxPoints);
+    m_surface->setRange(m_minValue, m_maxValue);
+    m_surface->setStyle(m_type, m_lineColor, m_fillColor, m_lineWidth);
+    m_surface->setGrid(m_showGrid, m_gridColor);
+    // The surface draws straight polylines and nothing else; bars, curves
+    // and labels stay on the raster path
+    m_surface->setVisible(m_type != GraphType::Bar && !m_smooth && !m_showLabels);
+#endif
+}
+void Graph::dropSurface() {
+#ifdef MILK_HAS_OPENGL
+    if (!m_surface) return;
+    m_surface->hide(); m_surface->deleteLater(); m_surface = nullptr;
+    update();
+#endif
+}
+void Graph::resizeEvent(QResizeEvent* e) {
+    QWidget::resizeEvent(e);
+#ifdef MILK_HAS_OPENGL
+    if (m_surface) m_surface->setGeometry(rect());
+#endif
+}
+
 void Graph::paintEvent(QPaintEvent*) {
+    if (onSurface()) return;
+    QPixmap grid;
+    if (m_showGrid) {
+        ContentHash h; h << m_gridColor;
+        grid = renderCache()->fetch(h.value(), size(), devicePixelRatioF(),
+            [this](QPainter& gp, const QSize&) { drawGrid(gp); });
+    }
     QPainter p(this); p.setRenderHint(QPainter::Antialiasing, m_antialiased);
-    if (m_showGrid) drawGrid(p);
+    if (!grid.isNull()) p.drawPixmap(0, 0, grid);
     switch (m_type) {
         case GraphType::Line: case GraphType::Sparkline: drawLine(p); break;
         case GraphType::Area: drawArea(p); break;
         case GraphType::Bar: drawBar(p); break;
     }
+    if (m_showLabels) drawLabels(p);
 }
 void Graph::drawGrid(QPainter& p) {
     p.setPen(QPen(m_gridColor, 1));
     for (int i = 1; i < 4; i++) { int y = height() * i / 4; p.drawLine(0, y, width(), y); }
     for (int i = 1; i < 4; i++) { int x = width() * i / 4; p.drawLine(x, 0, x, height()); }
 }
-void Graph::drawLine(QPainter& p) {
-    if (m_values.size() < 2) return;
+QPainterPath Graph::seriesPath() const {
+    QPainterPath path;
     double range = m_maxValue - m_minValue; if (range <= 0) range = 1;
     double xStep = double(width()) / (m_maxPoints - 1);
-    QPainterPath path;
+    QPointF prev;
     for (int i = 0; i < m_values.size(); i++) {
-        double x = i * xStep, y = height() - (m_values[i] - m_minValue) / range * height();
-        if (i == 0) path.moveTo(x, y); else path.lineTo(x, y);
+        QPointF pt(i * xStep, height() - (m_values[i] - m_minValue) / range * height());
+        if (i == 0) path.moveTo(pt);
+        // Flat tangents at every sample: never overshoots the data
+        else if (m_smooth) { double mx = (prev.x() + pt.x()) / 2; path.cubicTo(mx, prev.y(), mx, pt.y(), pt.x(), pt.y()); }
+        else path.lineTo(pt);
+        prev = pt;
     }
+    return path;
+}
+void Graph::drawLine(QPainter& p) {
+    if (m_values.size() < 2) return;
     p.setPen(QPen(m_lineColor, m_lineWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-    p.drawPath(path);
+    p.drawPath(seriesPath());
 }
 void Graph::drawArea(QPainter& p) {
     if (m_values.size() < 2) return;
-    double range = m_maxValue - m_minValue; if (range <= 0) range = 1;
     double xStep = double(width()) / (m_maxPoints - 1);
-    QPainterPath path; path.moveTo(0, height());
-    for (int i = 0; i < m_values.size(); i++) {
-        double x = i * xStep, y = height() - (m_values[i] - m_minValue) / range * height();
-        path.lineTo(x, y);
-    }
-    path.lineTo((m_values.size() - 1) * xStep, height()); path.closeSubpath();
+    QPainterPath path = seriesPath();
+    path.lineTo((m_values.size() - 1) * xStep, height()); path.lineTo(0, height()); path.closeSubpath();
     QLinearGradient grad(0, 0, 0, height());
     grad.setColorAt(0, m_fillColor);
     grad.setColorAt(1, QColor(m_fillColor.red(), m_fillColor.green(), m_fillColor.blue(), 20));
@@ -241,6 +376,16 @@ void Graph::drawBar(QPainter& p) {
         p.fillRect(QRectF(x, height() - barH, barW, barH), m_lineColor);
     }
 }
+void Graph::drawLabels(QPainter& p) {
+    // Scale at the left edge, latest value at the right
+    QColor c = m_lineColor; c.setAlpha(200);
+    p.setPen(c);
+    QFont f = p.font(); f.setPointSize(qMax(6, qMin(9, height() / 6))); p.setFont(f);
+    QRect r = rect().adjusted(3, 1, -3, -1);
+    p.drawText(r, Qt::AlignLeft | Qt::AlignTop, QString::number(m_maxValue, 'g', 4));
+    p.drawText(r, Qt::AlignLeft | Qt::AlignBottom, QString::number(m_minValue, 'g', 4));
+    if (!m_values.isEmpty()) p.drawText(r, Qt::AlignRight | Qt::AlignTop, QString::number(m_values.last(), 'g', 4));
+}
 
 // ============================================================================
 // GAUGE
@@ -252,43 +397,150 @@ Gauge::Gauge(QWidget* parent) : QWidget(parent) {
 Gauge* Gauge::create(Widget* parent) { return new Gauge(parent); }
 
 void Gauge::setValue(double v) {
+    double oldDisplay = m_displayValue;
+    QString oldText = valueText();
     m_value = qBound(m_minValue, v, m_maxValue);
     m_displayValue = m_animated ? m_displayValue + (m_value - m_displayValue) * 0.3 : m_value;
-    emit valueChanged(m_value); update();
-}
-void Gauge::setRange(double min, double max) { m_minValue = min; m_maxValue = max; update(); }
+    emit valueChanged(m_value);
+    if (onSurface()) { syncSurface(); return; }
+    QRect damage = arcDamage(fraction(oldDisplay), fraction(m_displayValue));
+    QString txt = valueText();
+    if (txt != oldText) damage |= textDamage(oldText) | textDamage(txt);
+    update(damage);
+}
+void Gauge::setRange(double min, double max) { m_minValue = min; m_maxValue = max; syncSurface(); update(); }
 void Gauge::setStyle(GaugeStyle s) { m_style = s; update(); }
-void Gauge::setColors(const QColor& bg, const QColor& fill) { m_bgColor = bg; m_fillColor = fill; update(); }
-void Gauge::setGradient(const QColor& s, const QColor& e) { m_fillColor = s; m_fillEndColor = e; update(); }
-void Gauge::setThickness(int t) { m_thickness = t; update(); }
-void Gauge::setStartAngle(int d) { m_startAngle = d; update(); }
-void Gauge::setEndAngle(int d) { m_endAngle = d; update(); }
-void Gauge::setShowValue(bool s) { m_showValue = s; update(); }
-void Gauge::setValueFormat(const QString& f) { m_valueFormat = f; update(); }
+void Gauge::setColors(const QColor& bg, const QColor& fill) { m_bgColor = bg; m_fillColor = fill; syncSurface(); update(); }
+void Gauge::setGradient(const QColor& s, const QColor& e) { m_fillColor = s; m_fillEndColor = e; syncSurface(); update(); }
+void Gauge::setThickness(int t) { m_thickness = t; syncSurface(); update(); }
+void Gauge::setStartAngle(int d) { m_startAngle = d; syncSurface(); update(); }
+void Gauge::setEndAngle(int d) { m_endAngle = d; syncSurface(); update(); }
+void Gauge::setShowValue(bool s) { m_showValue = s; syncSurface(); update(); }
+void Gauge::setValueFormat(const QString& f) { m_valueFormat = f; syncSurface(); update(); }
 void Gauge::setLabel(const QString& l) { m_label = l; update(); }
-void Gauge::setUnit(const QString& u) { m_unit = u; update(); }
-void Gauge::setTextColor(const QColor& c) { m_textColor = c; update(); }
+void Gauge::setUnit(const QString& u) { m_unit = u; syncSurface(); update(); }
+void Gauge::setTextColor(const QColor& c) { m_textColor = c; syncSurface(); update(); }
 void Gauge::setAnimated(bool e) { m_animated = e; }
 void Gauge::animateTo(double v, int) { setValue(v); }
 
-void Gauge::paintEvent(QPaintEvent*) {
-    QPainter p(this); p.setRenderHint(QPainter::Antialiasing);
+QString Gauge::valueText() const {
+    if (!m_showValue) return QString();
+    QString txt = QString::asprintf(m_valueFormat.toUtf8().constData(), m_displayValue);
+    if (!m_unit.isEmpty()) txt += m_unit;
+    return txt;
+}
+
+QRectF Gauge::arcRect() const {
     int side = qMin(width(), height());
     QRectF r((width()-side)/2.0, (height()-side)/2.0, side, side);
-    r.adjust(m_thickness, m_thickness, -m_thickness, -m_thickness);
+    return r.adjusted(m_thickness, m_thickness, -m_thickness, -m_thickness);
+}
+double Gauge::fraction(double value) const {
     double range = m_maxValue - m_minValue; if (range <= 0) range = 1;
-    double pct = (m_displayValue - m_minValue) / range;
+    return (value - m_minValue) / range;
+}
+QRect Gauge::arcDamage(double from, double to) const {
+    // Track and gradient are fixed, so only the sweep between the two ends
+    // changes: its bounding box, padded by half the pen for the round caps
+    int spanAngle = m_startAngle - m_endAngle;
+    double a = m_startAngle - int(spanAngle * from), b = m_startAngle - int(spanAngle * to);
+    if (a == b) return QRect();
+    double lo = qMin(a, b), hi = qMax(a, b);
+    QVector<double> angles{lo, hi};
+    for (double k = qCeil(lo / 90.0) * 90.0; k < hi; k += 90) angles << k;  // Extremes of the circle
+
+    QRectF r = arcRect();
+    double radius = r.width() / 2, x0 = r.right(), y0 = r.bottom(), x1 = r.left(), y1 = r.top();
+    for (double degrees : angles) {
+        double x = r.center().x() + radius * qCos(qDegreesToRadians(degrees));
+        double y = r.center().y() - radius * qSin(qDegreesToRadians(degrees));
+        x0 = qMin(x0, x); x1 = qMax(x1, x); y0 = qMin(y0, y); y1 = qMax(y1, y);
+    }
+    double pad = m_thickness / 2.0 + 2;
+    return QRectF(QPointF(x0 - pad, y0 - pad), QPointF(x1 + pad, y1 + pad)).toAlignedRect().intersected(rect());
+}
+QRect Gauge::textDamage(const QString& text) const {
+    if (text.isEmpty()) return QRect();
+    QFont f = font(); f.setPointSize(qMin(width(), height())/6); f.setBold(true);
+    return QFontMetrics(f).boundingRect(arcRect().toAlignedRect(), Qt::AlignCenter, text).adjusted(-2, -2, 2, 2);
+}
+
+void Gauge::setRenderBackend(RenderBackend backend) {
+    m_backend = backend;
+#ifdef MILK_HAS_OPENGL
+    if (GLSurface::resolve(backend) == RenderBackend::OpenGL) {
+        if (!m_surface) {
+            m_surface = new GLGaugeSurface(this);
+            m_surface->setGeometry(rect());
+            connect(m_surface, &GLSurface::failed, this, [this]() { dropSurface(); });
+            syncSurface(); m_surface->show();
+        }
+    } else dropSurface();
+#endif
+    update();
+}
+RenderBackend Gauge::renderBackend() const { return onSurface() ? RenderBackend::OpenGL : RenderBackend::Raster; }
+bool Gauge::onSurface() const {
+#ifdef MILK_HAS_OPENGL
+    return m_surface && !m_surface->isHidden();
+#else
+    return false;
+#endif
+}
+
+void Gauge::syncSurface() {
+#ifdef MILK_HAS_OPENGL
+    if (!m_surface) return;
+    m_surface->setArc(m_startAngle, m_endAngle, m_thickness);
+    m_surface->setColors(m_bgColor, m_fillColor);
+    m_surface->setFraction(fraction(m_displayValue));
+    m_surface->setText(valueText(), m_textColor);
+    // The surface fills with one color; a gradient is drawn on the raster path
+    m_surface->setVisible(!m_fillEndColor.isValid());
+#endif
+}
+void Gauge::dropSurface() {
+#ifdef MILK_HAS_OPENGL
+    if (!m_surface) return;
+    m_surface->hide(); m_surface->deleteLater(); m_surface = nullptr;
+    update();
+#endif
+}
+void Gauge::resizeEvent(QResizeEvent* e) {
+    QWidget::resizeEvent(e);
+#ifdef MILK_HAS_OPENGL
+    if (m_surface) m_surface->setGeometry(rect());
+#endif
+}
+
+void Gauge::paintEvent(QPaintEvent*) {
+    if (onSurface()) return;
+    QPainter p(this); p.setRenderHint(QPainter::Antialiasing);
+    int side = qMin(width(), height());
+    QRectF r = arcRect();
+    double pct = fraction(m_displayValue);
     int spanAngle = m_startAngle - m_endAngle, valueAngle = int(spanAngle * pct);
-    p.setPen(QPen(m_bgColor, m_thickness, Qt::SolidLine, Qt::RoundCap));
-    p.drawArc(r, m_startAngle * 16, -spanAngle * 16);
-    p.setPen(QPen(m_fillColor, m_thickness, Qt::SolidLine, Qt::RoundCap));
+    ContentHash h; h << m_bgColor << m_thickness << m_startAngle << m_endAngle;
+    p.drawPixmap(0, 0, renderCache()->fetch(h.value(), size(), devicePixelRatioF(), [&](QPainter& tp, const QSize&) {
+        tp.setRenderHint(QPainter::Antialiasing);
+        tp.setPen(QPen(m_bgColor, m_thickness, Qt::SolidLine, Qt::RoundCap));
+        tp.drawArc(r, m_startAngle * 16, -spanAngle * 16);
+    }));
+    if (m_fillEndColor.isValid()) {
+        // Clockwise from the start angle; the conical gradient runs
+        // counter-clockwise, so it starts at the end of the sweep
+        QConicalGradient grad(r.center(), m_endAngle);
+        grad.setColorAt(0, m_fillEndColor);
+        grad.setColorAt(qBound(0.0, spanAngle / 360.0, 1.0), m_fillColor);
+        p.setPen(QPen(QBrush(grad), m_thickness, Qt::SolidLine, Qt::RoundCap));
+    } else {
+        p.setPen(QPen(m_fillColor, m_thickness, Qt::SolidLine, Qt::RoundCap));
+    }
     p.drawArc(r, m_startAngle * 16, -valueAngle * 16);
     if (m_showValue) {
         p.setPen(m_textColor);
         QFont f = p.font(); f.setPointSize(side/6); f.setBold(true); p.setFont(f);
-        QString txt = QString::asprintf(m_valueFormat.toUtf8().constData(), m_displayValue);
-        if (!m_unit.isEmpty()) txt += m_unit;
-        p.drawText(r, Qt::AlignCenter, txt);
+        p.drawText(r, Qt::AlignCenter, valueText());
     }
 }
 
@@ -299,9 +551,17 @@ void Gauge::paintEvent(QPaintEvent*) {
 Image::Image(QWidget* parent) : QWidget(parent) { setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding); }
 Image* Image::create(Widget* parent) { return new Image(parent); }
 Image* Image::create(const QString& path, Widget* parent) { Image* img = new Image(parent); img->setSource(path); return img; }
-void Image::setSource(const QString& path) { m_source = path; m_pixmap = QPixmap(path); update(); }
-void Image::setSource(const QImage& image) { m_pixmap = QPixmap::fromImage(image); update(); }
-void Image::setSource(const QPixmap& pixmap) { m_pixmap = pixmap; update(); }
+void Image::setSource(const QString& path) {
+    // Only the header is read here; pixels are decoded at display size in paintEvent
+    m_source = path; m_pixmap = QPixmap(); m_sourceSize = QImageReader(path).size();
+    // A file replaced under the same name must not hit the old scaled layer
+    QFileInfo info(path);
+    m_sourceModified = info.lastModified().toMSecsSinceEpoch(); m_sourceBytes = info.size();
+    if (m_sourceSize.isValid()) emit loaded(); else emit loadError(QString("Cannot read image: %1").arg(path));
+    update();
+}
+void Image::setSource(const QImage& image) { m_source.clear(); m_pixmap = QPixmap::fromImage(image); m_sourceSize = m_pixmap.size(); update(); }
+void Image::setSource(const QPixmap& pixmap) { m_source.clear(); m_pixmap = pixmap; m_sourceSize = m_pixmap.size(); update(); }
 void Image::setUrl(const QString&) { }
 void Image::setFillMode(Qt::AspectRatioMode m) { m_fillMode = m; update(); }
 void Image::setRounded(int r) { m_radius = r; update(); }
@@ -313,46 +573,101 @@ void Image::setTint(const QColor& c) { m_tint = c; update(); }
 void Image::setGif(const QString&) { }
 
 void Image::paintEvent(QPaintEvent*) {
-    if (m_pixmap.isNull()) return;
+    if (!m_sourceSize.isValid()) return;
+    // Scale and clip once per size/DPR. File sources are decoded straight at
+    // the displayed size, so no full-resolution copy stays resident.
+    ContentHash h; h << int(m_fillMode) << m_radius << m_circular;
+    if (m_source.isEmpty()) h << quint64(m_pixmap.cacheKey());
+    else h << m_source << quint64(m_sourceModified) << quint64(m_sourceBytes);
+    QPixmap layer = renderCache()->fetch(h.value(), size(), devicePixelRatioF(), [this](QPainter& lp, const QSize& s) {
+        qreal dpr = lp.device()->devicePixelRatioF();
+        QSize target = m_sourceSize.scaled(s * dpr, m_fillMode);
+        QPixmap scaled = m_source.isEmpty() ? m_pixmap.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                                            : renderCache()->decode(m_source, target);
+        if (scaled.isNull()) return;
+        scaled.setDevicePixelRatio(dpr);
+        QSizeF logical = scaled.size() / dpr;
+        QRectF r((s.width()-logical.width())/2.0, (s.height()-logical.height())/2.0, logical.width(), logical.height());
+        lp.setRenderHint(QPainter::Antialiasing);
+        if (m_circular || m_radius > 0) {
+            QPainterPath path;
+            if (m_circular) path.addEllipse(r); else path.addRoundedRect(r, m_radius, m_radius);
+            lp.setClipPath(path);
+        }
+        lp.drawPixmap(r.topLeft(), scaled);
+    }, RenderCache::Scaled);
     QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing);
-    p.setRenderHint(QPainter::SmoothPixmapTransform);
     p.setOpacity(m_opacity);
-    QPixmap scaled = m_pixmap.scaled(size(), m_fillMode, Qt::SmoothTransformation);
-    QRectF r((width()-scaled.width())/2.0, (height()-scaled.height())/2.0, scaled.width(), scaled.height());
-    if (m_circular || m_radius > 0) {
-        QPainterPath path;
-        if (m_circular) path.addEllipse(r); else path.addRoundedRect(r, m_radius, m_radius);
-        p.setClipPath(path);
-    }
-    p.drawPixmap(r.toRect(), scaled);
+    p.drawPixmap(0, 0, layer);
 }
 
 // ============================================================================
 // BUTTON
 // ============================================================================
 
-Button::Button(const QString& text, QWidget* parent) : QPushButton(text, parent) { setCursor(Qt::PointingHandCursor); updateStyle(); }
+static const int ButtonPaddingX = 16;
+static const int ButtonPaddingY = 8;
+static const int ButtonIconSpacing = 6;
+
+Button::Button(const QString& text, QWidget* parent) : QPushButton(text, parent) { setCursor(Qt::PointingHandCursor); }
 Button* Button::create(const QString& text, Widget* parent) { return new Button(text, parent); }
-void Button::setBackground(const QColor& c) { m_bgColor = c; updateStyle(); }
-void Button::setHoverBackground(const QColor& c) { m_hoverColor = c; updateStyle(); }
-void Button::setPressedBackground(const QColor& c) { m_pressedColor = c; updateStyle(); }
-void Button::setTextColor(const QColor& c) { m_textColor = c; updateStyle(); }
-void Button::setRounded(int r) { m_radius = r; updateStyle(); }
-void Button::setBorder(const QColor& c, int w) { m_borderColor = c; m_borderWidth = w; updateStyle(); }
+void Button::setBackground(const QColor& c) { m_bgColor = c; update(); }
+void Button::setHoverBackground(const QColor& c) { m_hoverColor = c; update(); }
+void Button::setPressedBackground(const QColor& c) { m_pressedColor = c; update(); }
+void Button::setTextColor(const QColor& c) { m_textColor = c; update(); }
+void Button::setRounded(int r) { m_radius = r; update(); }
+void Button::setBorder(const QColor& c, int w) { m_borderColor = c; m_borderWidth = w; updateGeometry(); update(); }
 void Button::setIcon(const QString& p) { QPushButton::setIcon(QIcon(p)); }
 void Button::setIconSize(int s) { QPushButton::setIconSize(QSize(s, s)); }
 void Button::onClick(ClickCallback cb) { m_onClick = cb; connect(this, &QPushButton::clicked, cb); }
-void Button::enterEvent(QEnterEvent*) { m_hovered = true; updateStyle(); }
-void Button::leaveEvent(QEvent*) { m_hovered = false; updateStyle(); }
-void Button::paintEvent(QPaintEvent* e) { QPushButton::paintEvent(e); }
-void Button::updateStyle() {
-    QColor bg = m_hovered ? m_hoverColor : m_bgColor;
-    QString ss = QString("QPushButton{background:%1;color:%2;border-radius:%3px;padding:8px 16px;border:%4px solid %5}"
-                        "QPushButton:pressed{background:%6}")
-        .arg(Color::toRgba(bg)).arg(Color::toRgba(m_textColor)).arg(m_radius)
-        .arg(m_borderWidth).arg(Color::toRgba(m_borderColor)).arg(Color::toRgba(m_pressedColor));
-    setStyleSheet(ss);
+
+// Hover only changes which cached color is painted; no re-polish
+void Button::enterEvent(QEnterEvent*) { m_hovered = true; update(); }
+void Button::leaveEvent(QEvent*) { m_hovered = false; update(); }
+
+QSize Button::sizeHint() const {
+    QFontMetrics fm = fontMetrics();
+    int w = text().isEmpty() ? 0 : fm.horizontalAdvance(text());
+    int h = fm.height();
+    if (!icon().isNull()) {
+        w += iconSize().width() + (text().isEmpty() ? 0 : ButtonIconSpacing);
+        h = qMax(h, iconSize().height());
+    }
+    return QSize(w + 2 * (ButtonPaddingX + m_borderWidth), h + 2 * (ButtonPaddingY + m_borderWidth));
+}
+QSize Button::minimumSizeHint() const { return sizeHint(); }
+
+void Button::paintEvent(QPaintEvent*) {
+    QPainter p(this);
+    p.setRenderHint(QPainter::Antialiasing);
+    
+    // Background and border; the stroke is inset so it stays inside the widget
+    const QColor& fill = (isDown() || isChecked()) ? m_pressedColor : m_hovered ? m_hoverColor : m_bgColor;
+    qreal inset = m_borderWidth / 2.0;
+    if (m_borderWidth > 0 && m_borderColor.alpha() > 0) p.setPen(QPen(m_borderColor, m_borderWidth));
+    else p.setPen(Qt::NoPen);
+    p.setBrush(fill);
+    p.drawRoundedRect(QRectF(rect()).adjusted(inset, inset, -inset, -inset), m_radius, m_radius);
+    
+    // Icon and text, centered together
+    QRect content = rect().adjusted(ButtonPaddingX, ButtonPaddingY, -ButtonPaddingX, -ButtonPaddingY);
+    QPixmap pixmap = icon().isNull() ? QPixmap() : icon().pixmap(iconSize(), isEnabled() ? QIcon::Normal : QIcon::Disabled);
+    int iconWidth = pixmap.isNull() ? 0 : iconSize().width();
+    int spacing = (iconWidth > 0 && !text().isEmpty()) ? ButtonIconSpacing : 0;
+    QString label = fontMetrics().elidedText(text(), Qt::ElideRight, qMax(0, content.width() - iconWidth - spacing));
+    int textWidth = label.isEmpty() ? 0 : fontMetrics().horizontalAdvance(label);
+    int x = content.x() + (content.width() - iconWidth - spacing - textWidth) / 2;
+    
+    if (iconWidth > 0) {
+        p.drawPixmap(x, content.center().y() - iconSize().height() / 2, pixmap);
+        x += iconWidth + spacing;
+    }
+    if (!label.isEmpty()) {
+        QColor color = m_textColor;
+        if (!isEnabled()) color.setAlphaF(color.alphaF() * 0.5);
+        p.setPen(color);
+        p.drawText(QRect(x, content.y(), textWidth, content.height()), Qt::AlignLeft | Qt::AlignVCenter, label);
+    }
 }
 
 // ============================================================================
@@ -401,6 +716,46 @@ void Container::setMargins(int m) { m_layoutPtr->setContentsMargins(m, m, m, m);
 void Container::setMargins(int t, int r, int b, int l) { m_layoutPtr->setContentsMargins(l, t, r, b); }
 void Container::paintEvent(QPaintEvent*) { if (m_bgColor.alpha() > 0) { QPainter p(this); p.fillRect(rect(), m_bgColor); } }
 
+// ============================================================================
+// REPEATER
+// ============================================================================
+
+Repeater::Repeater(Layout layout, QWidget* parent) : Container(layout, parent) {}
+Repeater* Repeater::create(Layout l, Widget* p) { return new Repeater(l, p); }
+void Repeater::setFactory(Factory factory) { m_factory = factory; }
+void Repeater::setSource(Source source) { m_source = source; }
+void Repeater::setCount(int count) {
+    m_source = [count]() {
+        QStringList entries;
+        for (int i = 0; i < count; ++i) entries << QString::number(i);
+        return entries;
+    };
+}
+void Repeater::setColumns(int columns) { m_columns = qMax(1, columns); }
+
+void Repeater::refresh() {
+    if (!m_source) return;
+    QStringList entries = m_source();
+    if (entries == m_entries) return;
+    m_entries = entries;
+    rebuild();
+}
+
+void Repeater::rebuild() {
+    qDeleteAll(m_copies);
+    m_copies.clear();
+    if (m_factory) {
+        for (int i = 0; i < m_entries.size(); ++i) {
+            for (QWidget* copy : m_factory(i, m_entries[i])) {
+                int n = m_copies.size();
+                addWidget(copy, n / m_columns, n % m_columns);
+                m_copies.append(copy);
+            }
+        }
+    }
+    emit expanded(m_entries.size());
+}
+
 // ============================================================================
 // CLOCK
 // ============================================================================
@@ -439,9 +794,14 @@ void Clock::drawDigital(QPainter& p) {
 }
 void Clock::drawAnalog(QPainter& p) {
     int side = qMin(width(), height());
+    ContentHash h; h << m_dialColor << m_textColor << m_showTicks;
+    p.drawPixmap(0, 0, renderCache()->fetch(h.value(), size(), devicePixelRatioF(), [&](QPainter& dp, const QSize&) {
+        dp.setRenderHint(QPainter::Antialiasing);
+        dp.translate(width()/2, height()/2); dp.scale(side/200.0, side/200.0);
+        dp.setPen(Qt::NoPen); dp.setBrush(m_dialColor); dp.drawEllipse(QPoint(0,0), 95, 95);
+        if (m_showTicks) { dp.setPen(QPen(m_textColor, 2)); for (int i = 0; i < 12; i++) { dp.drawLine(0, -88, 0, -78); dp.rotate(30); } }
+    }));
     p.translate(width()/2, height()/2); p.scale(side/200.0, side/200.0);
-    p.setPen(Qt::NoPen); p.setBrush(m_dialColor); p.drawEllipse(QPoint(0,0), 95, 95);
-    if (m_showTicks) { p.setPen(QPen(m_textColor, 2)); for (int i = 0; i < 12; i++) { p.drawLine(0, -88, 0, -78); p.rotate(30); } }
     QTime time = QTime::currentTime();
     p.save(); p.rotate(30.0 * (time.hour() + time.minute()/60.0));
     p.setPen(Qt::NoPen); p.setBrush(m_hourHandColor); p.drawConvexPolygon(QPolygon({{-4,0},{0,-50},{4,0}})); p.restore();
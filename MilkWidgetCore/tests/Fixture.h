@@ -0,0 +1,26 @@
+/**
+ * MilkWidgetCore - Test Fixtures
+ *
+ * Collectors take their /sys and /proc roots as parameters; tests point
+ * them at a tree built under a QTemporaryDir with these helpers.
+ */
+
+#pragma once
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+namespace MilkTest {
+
+/** Writes contents to root/path, creating directories; rewrites in place if it exists */
+inline bool writeFile(const QString& root, const QString& path, const QByteArray& contents) {
+    QString full = root + '/' + path;
+    QDir().mkpath(QFileInfo(full).absolutePath());
+    QFile file(full);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return file.write(contents) == contents.size();
+}
+
+} // namespace MilkTest
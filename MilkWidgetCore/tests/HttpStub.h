@@ -0,0 +1,100 @@
+/**
+ * MilkWidgetCore - Local HTTP Server for Tests
+ *
+ * Answers each request on 127.0.0.1 with the next queued response and
+ * records what was asked. A streamed response keeps its connection open
+ * so the test can write more of the body later through stream().
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+
+namespace MilkTest {
+
+class HttpStub {
+public:
+    struct Response {
+        int status = 200;
+        QByteArray body;
+        QByteArray headers;     // Extra "Name: value\r\n" lines
+        bool streamed = false;  // No Content-Length; the connection stays open
+    };
+
+    HttpStub() {
+        m_server.listen(QHostAddress::LocalHost);
+        QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this]() {
+            while (QTcpSocket* socket = m_server.nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { read(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+    }
+
+    bool isListening() const { return m_server.isListening(); }
+    QUrl url(const QString& path) const {
+        return QUrl(QString("http://127.0.0.1:%1%2").arg(m_server.serverPort()).arg(path));
+    }
+
+    void enqueue(int status, const QByteArray& body = QByteArray(), const QByteArray& headers = QByteArray()) {
+        m_responses.append(Response{status, body, headers, false});
+    }
+    void enqueueStream(const QByteArray& headers, const QByteArray& first = QByteArray()) {
+        m_responses.append(Response{200, first, headers, true});
+    }
+
+    /** Request heads in arrival order: request line and headers */
+    const QList<QByteArray>& requests() const { return m_requests; }
+    /** The connection of the latest streamed response, while it is open */
+    QTcpSocket* stream() const { return m_stream; }
+
+private:
+    void read(QTcpSocket* socket) {
+        QByteArray buffer = socket->property("request").toByteArray() + socket->readAll();
+        int end = buffer.indexOf("\r\n\r\n");
+        if (end < 0) {
+            socket->setProperty("request", buffer);
+            return;
+        }
+        socket->setProperty("request", QByteArray());
+        m_requests.append(buffer.left(end));
+
+        Response response = m_responses.isEmpty() ? Response{404, "no response queued", QByteArray(), false}
+                                                  : m_responses.takeFirst();
+        QByteArray head = "HTTP/1.1 " + QByteArray::number(response.status) + ' ' + reason(response.status) + "\r\n";
+        head += response.headers;
+        if (response.streamed) {
+            head += "Connection: close\r\n\r\n";
+            socket->write(head + response.body);
+            m_stream = socket;
+            return;
+        }
+        head += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+        head += "Connection: close\r\n\r\n";
+        socket->write(head + response.body);
+        socket->disconnectFromHost();  // After the queued bytes are written
+    }
+
+    static QByteArray reason(int status) {
+        switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        default: return "Status";
+        }
+    }
+
+    QTcpServer m_server;
+    QList<Response> m_responses;
+    QList<QByteArray> m_requests;
+    QPointer<QTcpSocket> m_stream;
+};
+
+} // namespace MilkTest
@@ -0,0 +1,76 @@
+/**
+ * MilkWidgetCore - Private Session Bus for Tests
+ *
+ * Starts a dbus-daemon of its own and points DBUS_SESSION_BUS_ADDRESS at
+ * it, so QDBusConnection::sessionBus() talks to it. Start it before
+ * anything touches the session bus. The daemon has no service
+ * directories: nothing is activatable, and a name is owned only while a
+ * test's own connection holds it.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QDBusConnection>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+
+#include "Fixture.h"
+
+namespace MilkTest {
+
+class SessionBus {
+public:
+    ~SessionBus() {
+        for (const QString& name : m_connections) QDBusConnection::disconnectFromBus(name);
+        if (m_daemon.state() != QProcess::NotRunning) {
+            m_daemon.terminate();
+            m_daemon.waitForFinished(2000);
+        }
+    }
+
+    static bool available() { return !QStandardPaths::findExecutable("dbus-daemon").isEmpty(); }
+
+    /** Runs the daemon with its socket and configuration under @p dir */
+    bool start(const QString& dir) {
+        static const char* config = R"(<!DOCTYPE busconfig PUBLIC "-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN"
+ "http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd">
+<busconfig>
+  <type>session</type>
+  <listen>unix:tmpdir=%1</listen>
+  <auth>EXTERNAL</auth>
+  <policy context="default">
+    <allow send_destination="*" eavesdrop="true"/>
+    <allow eavesdrop="true"/>
+    <allow own="*"/>
+  </policy>
+</busconfig>
+)";
+        if (!writeFile(dir, "bus.conf", QString(config).arg(dir).toUtf8())) return false;
+        m_daemon.start(QStandardPaths::findExecutable("dbus-daemon"),
+                       {"--config-file=" + dir + "/bus.conf", "--nofork", "--print-address=1"});
+        if (!m_daemon.waitForStarted()) return false;
+
+        QByteArray address;
+        while (!address.contains('\n') && m_daemon.waitForReadyRead(5000)) address += m_daemon.readAllStandardOutput();
+        m_address = QString::fromUtf8(address.trimmed());
+        if (m_address.isEmpty()) return false;
+        qputenv("DBUS_SESSION_BUS_ADDRESS", m_address.toUtf8());
+        return true;
+    }
+
+    /** A second connection to the bus, e.g. for a stub service; closed with the daemon */
+    QDBusConnection connect(const QString& name) {
+        m_connections.append(name);
+        return QDBusConnection::connectToBus(m_address, name);
+    }
+
+private:
+    QProcess m_daemon;
+    QString m_address;
+    QStringList m_connections;
+};
+
+} // namespace MilkTest
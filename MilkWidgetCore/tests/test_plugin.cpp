@@ -0,0 +1,61 @@
+/**
+ * MilkWidgetCore - Test Collector Plugin
+ *
+ * Built once per TEST_PLUGIN_NAME with a fixed delay and failure pattern
+ * for tst_pluginhost. Round n reports a = n and b = 2n; every
+ * TEST_PLUGIN_FAIL_EVERY-th round returns an error instead. Sleeping in
+ * sample() is exactly what a real plugin must not do.
+ */
+
+#include <milk/MetricPlugin.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const MilkMetric Metrics[] = {
+    {"a", nullptr},
+    {"b", "units"},
+};
+
+std::atomic<int> s_round{0};
+std::atomic<int> s_inSample{0};
+
+const MilkMetric* describe(void*, uint32_t* count) {
+    *count = sizeof(Metrics) / sizeof(Metrics[0]);
+    return Metrics;
+}
+
+int sample(void*, double* values, uint32_t count) {
+    s_inSample = 1;
+    int round = ++s_round;
+    std::this_thread::sleep_for(std::chrono::microseconds(TEST_PLUGIN_DELAY_US));
+    if (count >= 2) {
+        values[0] = round;
+        values[1] = 2.0 * round;
+    }
+    s_inSample = 0;
+    return TEST_PLUGIN_FAIL_EVERY > 0 && round % TEST_PLUGIN_FAIL_EVERY == 0 ? -1 : 0;
+}
+
+const MilkPlugin Plugin = {
+    MILK_PLUGIN_ABI_VERSION,
+    TEST_PLUGIN_NAME,
+    nullptr,
+    describe,
+    sample,
+    nullptr,
+};
+
+} // namespace
+
+extern "C" MILK_PLUGIN_EXPORT const MilkPlugin* milk_plugin_entry(void) {
+    return &Plugin;
+}
+
+/** Lets the test see that a round is inside sample() right now */
+extern "C" MILK_PLUGIN_EXPORT int milk_test_in_sample(void) {
+    return s_inSample;
+}
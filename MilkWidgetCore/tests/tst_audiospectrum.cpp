@@ -0,0 +1,185 @@
+/**
+ * MilkWidgetCore - AudioSpectrum Tests
+ *
+ * Known sines through the FFT plan, a WAV file and a FIFO: the strongest
+ * bin and band must be where the frequency is, and RMS and peak must match
+ * the amplitude.
+ */
+
+#include "apis/AudioWorker.h"
+#include "Fixture.h"
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+using namespace Milk;
+
+static const int Rate = 48000;
+
+/** Mono sine as 16-bit PCM in a WAV container */
+static QByteArray wavSine(double hz, double amplitude, double seconds) {
+    const int frames = int(Rate * seconds);
+    QByteArray data(frames * 2, Qt::Uninitialized);
+    for (int i = 0; i < frames; ++i) {
+        qint16 sample = qint16(std::lround(32767 * amplitude * std::sin(2 * M_PI * hz * i / Rate)));
+        qToLittleEndian<qint16>(sample, data.data() + 2 * i);
+    }
+
+    QByteArray wav(44, '\0');
+    char* h = wav.data();
+    memcpy(h, "RIFF", 4);
+    qToLittleEndian<quint32>(36 + data.size(), h + 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, h + 16);
+    qToLittleEndian<quint16>(1, h + 20);         // PCM
+    qToLittleEndian<quint16>(1, h + 22);         // Mono
+    qToLittleEndian<quint32>(Rate, h + 24);
+    qToLittleEndian<quint32>(Rate * 2, h + 28);  // Bytes per second
+    qToLittleEndian<quint16>(2, h + 32);         // Bytes per frame
+    qToLittleEndian<quint16>(16, h + 34);
+    memcpy(h + 36, "data", 4);
+    qToLittleEndian<quint32>(data.size(), h + 40);
+    return wav + data;
+}
+
+/** Mono sine as raw float32, the FIFO format */
+static QByteArray rawSine(double hz, double amplitude, double seconds) {
+    const int frames = int(Rate * seconds);
+    QByteArray data(frames * 4, Qt::Uninitialized);
+    for (int i = 0; i < frames; ++i) {
+        float sample = float(amplitude * std::sin(2 * M_PI * hz * i / Rate));
+        quint32 bits;
+        memcpy(&bits, &sample, sizeof(bits));
+        qToLittleEndian<quint32>(bits, data.data() + 4 * i);
+    }
+    return data;
+}
+
+static int strongestBand(const SpectrumFrame& frame) {
+    int best = 0;
+    for (int b = 1; b < frame.bands.size(); ++b) {
+        if (frame.bands[b] > frame.bands[best]) best = b;
+    }
+    return best;
+}
+
+class TestAudioSpectrum : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void fftPeakBin();
+    void wavFile();
+    void fifo();
+
+private:
+    /** 16 log bands over 50 Hz - 12.8 kHz: 1 kHz lands in band 8, 2 kHz in band 10 */
+    AudioSpectrum* configure(const QString& source);
+
+    QTemporaryDir m_dir;
+};
+
+void TestAudioSpectrum::init() {
+    QVERIFY(m_dir.isValid());
+}
+
+void TestAudioSpectrum::cleanup() {
+    AudioSpectrum::cleanup();
+}
+
+AudioSpectrum* TestAudioSpectrum::configure(const QString& source) {
+    AudioSpectrum* spectrum = AudioSpectrum::instance();
+    spectrum->setSource(source);
+    spectrum->setSampleRate(Rate);
+    spectrum->setFftSize(2048);
+    spectrum->setBands(16);
+    spectrum->setFrequencyRange(50, 12800);
+    spectrum->setFrameRate(60);
+    spectrum->setSmoothing(0);
+    return spectrum;
+}
+
+void TestAudioSpectrum::fftPeakBin() {
+    const int n = 1024;
+    FftPlan plan;
+    plan.prepare(n);
+    std::vector<float> input(n), power(n / 2 + 1);
+
+    for (int bin : {1, 64, 100, 511}) {
+        for (int i = 0; i < n; ++i) input[i] = float(std::sin(2 * M_PI * bin * i / n));
+        plan.powerSpectrum(input.data(), power.data());
+
+        int peak = int(std::max_element(power.begin(), power.end()) - power.begin());
+        QCOMPARE(peak, bin);
+        // An unwindowed unit sine on a bin centre: (N / 2)^2, nothing elsewhere
+        QVERIFY(std::fabs(power[bin] / (0.25f * n * n) - 1.0f) < 1e-3f);
+        for (int k = 0; k <= n / 2; ++k) {
+            if (k != bin) QVERIFY2(power[k] < 1e-3f * power[bin], qPrintable(QString("bin %1 for %2").arg(k).arg(bin)));
+        }
+    }
+}
+
+void TestAudioSpectrum::wavFile() {
+    QVERIFY(MilkTest::writeFile(m_dir.path(), "sine.wav", wavSine(1000, 0.5, 1.0)));
+    AudioSpectrum* spectrum = configure(m_dir.filePath("sine.wav"));
+    QSignalSpy finished(spectrum, &AudioSpectrum::finished);
+    QSignalSpy errors(spectrum, &AudioSpectrum::error);
+
+    QElapsedTimer clock;
+    clock.start();
+    spectrum->start();
+    QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+    QCOMPARE(errors.count(), 0);
+
+    // Read at playback speed: a one-second file takes a second, not 960 ms
+    QVERIFY2(clock.elapsed() >= 990, qPrintable(QString("played in %1 ms").arg(clock.elapsed())));
+
+    SpectrumFrame frame = spectrum->frame();
+    QCOMPARE(int(frame.bands.size()), 16);
+    QCOMPARE(strongestBand(frame), 8);
+    QVERIFY2(frame.bands[8] > 0.8f, qPrintable(QString::number(frame.bands[8])));
+    for (int b : {0, 1, 2, 3, 4, 12, 13, 14, 15}) QVERIFY(frame.bands[b] < 0.3f);
+    QVERIFY(std::fabs(frame.rms - 0.5f / std::sqrt(2.0f)) < 0.01f);
+    QVERIFY(std::fabs(frame.peak - 0.5f) < 0.01f);
+    QVERIFY(frame.sequence > 50);  // About one frame per 1/60 s of audio
+}
+
+void TestAudioSpectrum::fifo() {
+#ifdef Q_OS_UNIX
+    QString path = m_dir.filePath("audio.fifo");
+    QCOMPARE(::mkfifo(QFile::encodeName(path).constData(), 0600), 0);
+    AudioSpectrum* spectrum = configure(path);
+    QSignalSpy finished(spectrum, &AudioSpectrum::finished);
+    spectrum->start();
+
+    // Blocks until the worker has the read end open; it runs on its own thread
+    QFile writer(path);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    QByteArray audio = rawSine(2000, 0.25, 0.25);
+    QCOMPARE(writer.write(audio), qint64(audio.size()));
+    writer.close();
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+    SpectrumFrame frame = spectrum->frame();
+    QCOMPARE(strongestBand(frame), 10);
+    QVERIFY2(frame.bands[10] > 0.7f, qPrintable(QString::number(frame.bands[10])));
+    QVERIFY(std::fabs(frame.rms - 0.25f / std::sqrt(2.0f)) < 0.01f);
+    QVERIFY(std::fabs(frame.peak - 0.25f) < 0.01f);
+#else
+    QSKIP("FIFO sources are Unix only");
+#endif
+}
+
+QTEST_GUILESS_MAIN(TestAudioSpectrum)
+#include "tst_audiospectrum.moc"
@@ -0,0 +1,154 @@
+/**
+ * MilkWidgetCore - CpuTopology Tests
+ *
+ * Four CPUs on two packages and two NUMA nodes, hybrid, with SMT siblings
+ * on the first package and no cpufreq on the last CPU.
+ */
+
+#include "apis/CpuTopology.h"
+#include "Fixture.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Milk;
+using MilkTest::writeFile;
+
+class TestCpuTopology : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void discovery();
+    void usageAndGroups();
+    void offlineCpuIgnored();
+    void idleSteppingBackIsSkipped();
+
+private:
+    const SystemMonitor::Snapshot::CpuGroup* group(const SystemMonitor::Snapshot& s, const QString& name);
+
+    QTemporaryDir m_root;
+};
+
+void TestCpuTopology::initTestCase() {
+    QVERIFY(m_root.isValid());
+    const QString root = m_root.path();
+    const QString cpu = "devices/system/cpu/cpu%1/";
+    const int package[] = {0, 0, 1, 1};
+    const int core[] = {0, 0, 0, 1};
+    const char* khz[] = {"2000000\n", "3000000\n", "1000000\n", nullptr};
+
+    QVERIFY(writeFile(root, "devices/system/cpu/online", "0-3\n"));
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(writeFile(root, cpu.arg(i) + "topology/physical_package_id", QByteArray::number(package[i])));
+        QVERIFY(writeFile(root, cpu.arg(i) + "topology/core_id", QByteArray::number(core[i])));
+        if (khz[i]) QVERIFY(writeFile(root, cpu.arg(i) + "cpufreq/scaling_cur_freq", khz[i]));
+    }
+    QVERIFY(writeFile(root, "devices/system/node/node0/cpulist", "0-1\n"));
+    QVERIFY(writeFile(root, "devices/system/node/node1/cpulist", "2-3\n"));
+    QVERIFY(writeFile(root, "devices/cpu_core/cpus", "0-1\n"));
+    QVERIFY(writeFile(root, "devices/cpu_atom/cpus", "2-3\n"));
+}
+
+const SystemMonitor::Snapshot::CpuGroup* TestCpuTopology::group(const SystemMonitor::Snapshot& s,
+                                                                const QString& name) {
+    for (const auto& g : s.cpuGroups) {
+        if (g.name == name) return &g;
+    }
+    return nullptr;
+}
+
+void TestCpuTopology::discovery() {
+    CpuTopology topology(m_root.path());
+    QCOMPARE(topology.size(), 4);
+    QCOMPARE(topology.physicalCores(), 3);  // cpu0 and cpu1 are siblings
+    QCOMPARE(topology.packages(), 2);
+    QCOMPARE(topology.nodes(), 2);
+    QVERIFY(topology.hybrid());
+}
+
+void TestCpuTopology::usageAndGroups() {
+    CpuTopology topology(m_root.path());
+    SystemMonitor::Snapshot snapshot;
+
+    // user nice system idle iowait irq softirq; the first round only primes
+    topology.sample("cpu  200 0 100 2900 0 0 0\n"
+                    "cpu0 100 0 100 800 0 0 0\n"
+                    "cpu1 100 0 0 100 0 0 0\n"
+                    "cpu2 0 0 0 1000 0 0 0\n"
+                    "cpu3 0 0 0 1000 0 0 0\n"
+                    "intr 12345\n", snapshot);
+    QCOMPARE(int(snapshot.coreUsage.size()), 4);
+    QCOMPARE(snapshot.coreUsage[0], 0.0);
+
+    topology.sample("cpu  1850 0 200 6050 0 0 0\n"
+                    "cpu0 600 0 100 1300 0 0 0\n"
+                    "cpu1 1100 0 0 100 0 0 0\n"
+                    "cpu2 0 0 0 2000 0 0 0\n"
+                    "cpu3 250 0 0 1750 0 0 0\n"
+                    "intr 23456\n", snapshot);
+    QCOMPARE(snapshot.coreUsage[0], 50.0);
+    QCOMPARE(snapshot.coreUsage[1], 100.0);
+    QCOMPARE(snapshot.coreUsage[2], 0.0);
+    QCOMPARE(snapshot.coreUsage[3], 25.0);
+    QCOMPARE(snapshot.coreFrequency[0], 2000.0);
+    QCOMPARE(snapshot.coreFrequency[3], 0.0);
+
+    QCOMPARE(int(snapshot.cpuGroups.size()), 6);
+    const auto* package0 = group(snapshot, "package0");
+    const auto* package1 = group(snapshot, "package1");
+    QVERIFY(package0 && package1);
+    QCOMPARE(package0->cpus, 2);
+    QCOMPARE(package0->usage, 75.0);
+    QCOMPARE(package0->frequency, 2500.0);
+    QCOMPARE(package1->usage, 12.5);
+    QCOMPARE(package1->frequency, 1000.0);  // cpu3 has no cpufreq and is left out
+    QCOMPARE(group(snapshot, "node1")->usage, 12.5);
+    QCOMPARE(group(snapshot, "performance")->usage, 75.0);
+    QCOMPARE(group(snapshot, "efficiency")->cpus, 2);
+}
+
+void TestCpuTopology::offlineCpuIgnored() {
+    QTemporaryDir dir;
+    const QString root = dir.path();
+    QVERIFY(writeFile(root, "devices/system/cpu/online", "0,2\n"));
+    QVERIFY(writeFile(root, "devices/system/cpu/cpu0/topology/physical_package_id", "0"));
+    QVERIFY(writeFile(root, "devices/system/cpu/cpu2/topology/physical_package_id", "0"));
+    QVERIFY(writeFile(root, "devices/system/cpu/cpu2/topology/core_id", "2"));
+
+    CpuTopology topology(root);
+    QCOMPARE(topology.size(), 2);
+    QCOMPARE(topology.nodes(), 1);
+    QVERIFY(!topology.hybrid());
+
+    SystemMonitor::Snapshot snapshot;
+    topology.sample("cpu0 0 0 0 100 0 0 0\ncpu1 0 0 0 100 0 0 0\ncpu2 0 0 0 100 0 0 0\n", snapshot);
+    topology.sample("cpu0 100 0 0 100 0 0 0\ncpu1 100 0 0 100 0 0 0\ncpu2 0 0 0 200 0 0 0\n", snapshot);
+    QCOMPARE(int(snapshot.coreUsage.size()), 3);  // Indexed by logical id
+    QCOMPARE(snapshot.coreUsage[0], 100.0);
+    QCOMPARE(snapshot.coreUsage[1], 0.0);
+    QCOMPARE(snapshot.coreUsage[2], 0.0);
+    QCOMPARE(int(snapshot.cpuGroups.size()), 1);
+    QCOMPARE(snapshot.cpuGroups[0].usage, 50.0);
+}
+
+void TestCpuTopology::idleSteppingBackIsSkipped() {
+    CpuTopology topology(m_root.path());
+    SystemMonitor::Snapshot snapshot;
+    topology.sample("cpu0 0 0 0 1000 0 0 0\n", snapshot);
+    topology.sample("cpu0 100 0 0 1100 0 0 0\n", snapshot);
+    QCOMPARE(snapshot.coreUsage[0], 50.0);
+
+    // Idle went back by 10 ticks: unsigned, that diff would be 2^64 - 10
+    topology.sample("cpu0 300 0 0 1090 0 0 0\n", snapshot);
+    QCOMPARE(snapshot.coreUsage[0], 50.0);
+
+    // The next consistent round counts from there
+    topology.sample("cpu0 400 0 0 1190 0 0 0\n", snapshot);
+    QCOMPARE(snapshot.coreUsage[0], 50.0);
+    topology.sample("cpu0 500 0 0 1190 0 0 0\n", snapshot);
+    QCOMPARE(snapshot.coreUsage[0], 100.0);
+}
+
+QTEST_GUILESS_MAIN(TestCpuTopology)
+#include "tst_cputopology.moc"
@@ -0,0 +1,143 @@
+/**
+ * MilkWidgetCore - DataSource Tests
+ *
+ * JSON-path polling and Server-Sent Events against a local HttpStub.
+ */
+
+#include "milk/APIs.h"
+#include "HttpStub.h"
+
+#include <QSignalSpy>
+#include <QtTest>
+
+using namespace Milk;
+using MilkTest::HttpStub;
+
+class TestDataSource : public QObject {
+    Q_OBJECT
+
+private slots:
+    void pollPaths();
+    void pollKeepsMissingPaths();
+    void eventStream();
+    void oversizedEventReconnects();
+};
+
+void TestDataSource::pollPaths() {
+    HttpStub server;
+    QVERIFY(server.isListening());
+    server.enqueue(200, R"({"cpu":{"load":0.5,"name":"x86"},"disks":[{"free":10},{"free":20}],"ok":true,"note":null})");
+
+    DataSource source(server.url("/stats"));
+    source.setInterval(50);
+    QVERIFY(source.bind("cpu.load"));
+    QVERIFY(source.bind("$.disks[1].free"));
+    QVERIFY(source.bind("ok"));
+    QVERIFY(source.bind("note"));
+    QVERIFY(!source.bind("disks[x]"));
+
+    QVariant loadSeen;
+    source.bind("cpu.load", [&loadSeen](const QVariant& v) { loadSeen = v; });  // Also starts polling
+    QSignalSpy updated(&source, &DataSource::updated);
+    QTRY_COMPARE(updated.count(), 1);
+
+    QVERIFY(server.requests().first().startsWith("GET /stats "));
+    QVERIFY(server.requests().first().contains("Accept: application/json"));
+    QCOMPARE(source.value("cpu.load").toDouble(), 0.5);
+    QCOMPARE(loadSeen.toDouble(), 0.5);
+    QCOMPARE(source.value("$.disks[1].free").toDouble(), 20.0);
+    QCOMPARE(source.value("ok").toBool(), true);
+    QVERIFY(source.value("note").isValid());  // JSON null is a value...
+    QVERIFY(source.value("note").isNull());   // ...that holds nothing
+    QVERIFY(!source.value("missing").isValid());
+
+    // The next poll changes one value: one valueChanged, one updated
+    QSignalSpy changed(&source, &DataSource::valueChanged);
+    server.enqueue(200, R"({"cpu":{"load":0.75},"disks":[{"free":10},{"free":20}],"ok":true,"note":null})");
+    QTRY_COMPARE(updated.count(), 2);
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(changed.first().at(0).toString(), QString("cpu.load"));
+    QCOMPARE(loadSeen.toDouble(), 0.75);
+    source.stop();
+}
+
+void TestDataSource::pollKeepsMissingPaths() {
+    HttpStub server;
+    server.enqueue(200, R"({"a":1,"b":2})");
+    server.enqueue(200, R"({"a":3})");
+    server.enqueue(200, R"({"a":)");
+
+    DataSource source(server.url("/"));
+    source.setInterval(50);
+    source.bind("a");
+    source.bind("b");
+    QSignalSpy errors(&source, &DataSource::error);
+    source.start();
+
+    QTRY_COMPARE(source.value("a").toInt(), 3);
+    QCOMPARE(source.value("b").toInt(), 2);  // Absent from the second answer: unchanged
+
+    QTRY_VERIFY(errors.count() >= 1);
+    QVERIFY2(errors.first().at(0).toString().startsWith("Malformed JSON"), qPrintable(errors.first().at(0).toString()));
+    QCOMPARE(source.value("a").toInt(), 3);
+    source.stop();
+}
+
+void TestDataSource::eventStream() {
+    HttpStub server;
+    server.enqueueStream("Content-Type: text/event-stream\r\n", "retry: 1000\n\ndata: {\"level\": 1}\n\n");
+
+    DataSource source(server.url("/events"));
+    source.setMode(DataSource::EventStream);
+    source.bind("level");
+    source.bind("state.name");
+    QSignalSpy updated(&source, &DataSource::updated);
+    source.start();
+
+    QTRY_COMPARE(source.value("level").toInt(), 1);
+    QVERIFY(server.requests().first().contains("Accept: text/event-stream"));
+    QVERIFY(server.stream());
+
+    // Split across writes and lines: one event per blank line, data lines joined
+    server.stream()->write("data: {\"level\": 2,\r\n");
+    QTest::qWait(20);
+    QCOMPARE(source.value("level").toInt(), 1);
+    server.stream()->write("data: \"state\": {\"name\": \"busy\"}}\r\n\r\n");
+    QTRY_COMPARE(source.value("level").toInt(), 2);
+    QCOMPARE(source.value("state.name").toString(), QString("busy"));
+
+    // Comments and other fields are not data
+    int before = updated.count();
+    server.stream()->write(": keep-alive\nevent: ping\n\n");
+    QTest::qWait(20);
+    QCOMPARE(updated.count(), before);
+    QCOMPARE(int(server.requests().size()), 1);  // Still the same connection
+    source.stop();
+}
+
+void TestDataSource::oversizedEventReconnects() {
+    HttpStub server;
+    server.enqueueStream("Content-Type: text/event-stream\r\n", "data: {\"n\": 1}\n\n");
+    server.enqueueStream("Content-Type: text/event-stream\r\n", "data: {\"n\": 2}\n\n");
+
+    DataSource source(server.url("/events"));
+    source.setMode(DataSource::EventStream);
+    source.bind("n");
+    QSignalSpy errors(&source, &DataSource::error);
+    source.start();
+    QTRY_COMPARE(source.value("n").toInt(), 1);
+
+    // A line that never ends: the source drops it and reconnects after backoff
+    QByteArray chunk(1024 * 1024, 'x');
+    server.stream()->write("data: \"");
+    for (int i = 0; i < 9; i++) server.stream()->write(chunk);
+    QTRY_COMPARE(errors.count(), 1);
+    QVERIFY2(errors.first().at(0).toString().contains("larger than"), qPrintable(errors.first().at(0).toString()));
+
+    QTRY_COMPARE(source.value("n").toInt(), 2);
+    QCOMPARE(int(server.requests().size()), 2);
+    source.stop();
+}
+
+QTEST_GUILESS_MAIN(TestDataSource)
+#include "tst_datasource.moc"
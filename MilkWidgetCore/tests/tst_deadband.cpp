@@ -0,0 +1,72 @@
+/**
+ * MilkWidgetCore - Deadband Tests
+ *
+ * The decision SystemMonitor::reportChanges makes for every metric each
+ * round; no monitor is created.
+ */
+
+#include "milk/APIs.h"
+
+#include <QtTest>
+
+using namespace Milk;
+using Deadband = SystemMonitor::Deadband;
+
+class TestDeadband : public QObject {
+    Q_OBJECT
+
+private slots:
+    void firstValueIsDue();
+    void absolute();
+    void relative();
+    void largerThresholdWins();
+    void anyChangeWithoutThresholds();
+    void staleness();
+};
+
+void TestDeadband::firstValueIsDue() {
+    Deadband band{5, 0, 0};
+    QVERIFY(band.due(0, 0, 1000, 0));  // Never reported, even if unchanged
+}
+
+void TestDeadband::absolute() {
+    Deadband band{1.0, 0, 0};
+    QVERIFY(!band.due(50.9, 50, 2000, 1000));
+    QVERIFY(band.due(51.0, 50, 2000, 1000));  // Inclusive
+    QVERIFY(band.due(49.0, 50, 2000, 1000));  // Either direction
+    QVERIFY(!band.due(49.5, 50, 2000, 1000));
+}
+
+void TestDeadband::relative() {
+    Deadband band{0, 0.1, 0};
+    QVERIFY(!band.due(109, 100, 2000, 1000));
+    QVERIFY(band.due(110, 100, 2000, 1000));
+    QVERIFY(!band.due(10.9, 10, 2000, 1000));  // Scales with the last value
+    QVERIFY(band.due(11, 10, 2000, 1000));
+    QVERIFY(band.due(0.001, 0, 2000, 1000));   // From zero any change counts
+}
+
+void TestDeadband::largerThresholdWins() {
+    Deadband band{2, 0.1, 0};
+    QVERIFY(!band.due(11.5, 10, 2000, 1000));   // 10% of 10 is 1, but 2 is larger
+    QVERIFY(band.due(12, 10, 2000, 1000));
+    QVERIFY(!band.due(105, 100, 2000, 1000));   // 10% of 100 is 10
+    QVERIFY(band.due(110, 100, 2000, 1000));
+}
+
+void TestDeadband::anyChangeWithoutThresholds() {
+    Deadband band;
+    QVERIFY(!band.due(42, 42, 2000, 1000));
+    QVERIFY(band.due(42.0001, 42, 2000, 1000));
+}
+
+void TestDeadband::staleness() {
+    Deadband band{1.0, 0, 10000};
+    QVERIFY(!band.due(50, 50, 10999, 1000));
+    QVERIFY(band.due(50, 50, 11000, 1000));   // Unchanged, but due for a refresh
+    Deadband never{1.0, 0, 0};
+    QVERIFY(!never.due(50, 50, 1000000, 1000));
+}
+
+QTEST_GUILESS_MAIN(TestDeadband)
+#include "tst_deadband.moc"
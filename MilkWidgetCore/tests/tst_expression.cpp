@@ -0,0 +1,123 @@
+/**
+ * MilkWidgetCore - Expression Tests
+ */
+
+#include "milk/Utils.h"
+
+#include <QtTest>
+
+using namespace Milk;
+
+class TestExpression : public QObject {
+    Q_OBJECT
+
+private slots:
+    void constantsFold();
+    void inputs();
+    void conditionalStrings();
+    void templates();
+    void errors_data();
+    void errors();
+};
+
+void TestExpression::constantsFold() {
+    auto e = Expression::compile("1 + 2 * 3 - (4 - 2) / 2");
+    QVERIFY(e);
+    QVERIFY(e->isConstant());
+    QVERIFY(e->evaluate());
+    QCOMPARE(e->number(), 6.0);
+
+    auto text = Expression::compile("fmt(1 / 3, 2) + ' s'");
+    QVERIFY(text && text->isConstant());
+    text->evaluate();
+    QCOMPARE(text->toString(), QString("0.33 s"));
+}
+
+void TestExpression::inputs() {
+    auto e = Expression::compile("min(sys.cpu, 100) / 2 + sys.cpu * 0 + net.eth0.rx");
+    QVERIFY(e);
+    QCOMPARE(e->inputs(), QStringList({"sys.cpu", "net.eth0.rx"}));  // One slot per distinct name
+    QCOMPARE(e->type(), Expression::Number);
+
+    QVERIFY(e->setInput(0, 150));
+    QVERIFY(!e->setInput(0, 150));
+    QVERIFY(!e->setInput(7, 1));  // No such slot
+    QVERIFY(e->evaluate());
+    QCOMPARE(e->number(), 50.0);
+    QVERIFY(!e->evaluate());      // Same result
+
+    e->setInput(1, 4);
+    QVERIFY(e->evaluate());
+    QCOMPARE(e->number(), 54.0);
+}
+
+void TestExpression::conditionalStrings() {
+    auto color = Expression::compile("sys.cpu > 90 ? '#f44' : \"#4f4\"");
+    QVERIFY(color);
+    QCOMPARE(color->type(), Expression::String);
+    color->setInput(0, 95);
+    color->evaluate();
+    QCOMPARE(color->toString(), QString("#f44"));
+    color->setInput(0, 10);
+    QVERIFY(color->evaluate());
+    QCOMPARE(color->toString(), QString("#4f4"));
+
+    // Branches of different types meet as strings
+    auto mixed = Expression::compile("x > 0 ? x : 'none'");
+    QVERIFY(mixed);
+    QCOMPARE(mixed->type(), Expression::String);
+    mixed->setInput(0, 3);
+    mixed->evaluate();
+    QCOMPARE(mixed->toString(), QString("3"));
+
+    auto compare = Expression::compile("'a' == 'a' && !(2 < 1)");
+    QVERIFY(compare && compare->isConstant());
+    compare->evaluate();
+    QCOMPARE(compare->number(), 1.0);
+}
+
+void TestExpression::templates() {
+    QVERIFY(Expression::isTemplate("{fmtBytes(net.rx)}/s"));
+    QVERIFY(!Expression::isTemplate("${literal}"));
+    QVERIFY(!Expression::isTemplate("plain"));
+
+    auto rate = Expression::compileTemplate("{fmtBytes(net.rx)}/s");
+    QVERIFY(rate);
+    QCOMPARE(rate->inputs(), QStringList({"net.rx"}));
+    rate->setInput(0, 1536);
+    rate->evaluate();
+    QCOMPARE(rate->toString(), QString("1.5 KB/s"));
+
+    auto label = Expression::compileTemplate("CPU {round(sys.cpu)}% {sys.cpu > 50 ? 'busy' : '}'}");
+    QVERIFY(label);
+    label->setInput(0, 72.4);
+    label->evaluate();
+    QCOMPARE(label->toString(), QString("CPU 72% busy"));
+    label->setInput(0, 12);
+    label->evaluate();
+    QCOMPARE(label->toString(), QString("CPU 12% }"));  // A brace inside quotes doesn't close
+}
+
+void TestExpression::errors_data() {
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QString>("message");
+    QTest::newRow("dangling operator") << "1 +" << "unexpected end";
+    QTest::newRow("unknown function") << "foo(1)" << "unknown function foo()";
+    QTest::newRow("argument count") << "min(1)" << "wrong number of arguments to min()";
+    QTest::newRow("string arithmetic") << "'a' * 2" << "cannot apply * to a string";
+    QTest::newRow("string compared with number") << "'a' == 1" << "cannot compare a string with a number";
+    QTest::newRow("unterminated string") << "'abc" << "unterminated string";
+    QTest::newRow("missing colon") << "x ? 1" << "expected ':'";
+    QTest::newRow("empty") << "  " << "empty expression";
+}
+
+void TestExpression::errors() {
+    QFETCH(QString, source);
+    QFETCH(QString, message);
+    QString error;
+    QVERIFY(!Expression::compile(source, &error));
+    QVERIFY2(error.startsWith(message), qPrintable(error));
+}
+
+QTEST_GUILESS_MAIN(TestExpression)
+#include "tst_expression.moc"
@@ -0,0 +1,212 @@
+/**
+ * MilkWidgetCore - GPU Collector Tests
+ *
+ * A fake /sys/class/drm and /proc/<pid>/{fd,fdinfo,comm} tree. fd entries
+ * are symlinks to /dev/dri/renderD128 that need not exist; fdinfo files
+ * are rewritten in place, so the descriptors the collector keeps open see
+ * the new counters the way they would on a real /proc.
+ */
+
+#include "apis/GpuCollector.h"
+#include "Fixture.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Milk;
+using MilkTest::writeFile;
+
+static const qint64 Second = 1000 * 1000 * 1000;
+static const qint64 Ms = 1000 * 1000;
+static const char IntelSlot[] = "0000:00:02.0";
+
+/** What the i915 driver writes, with the drm-* keys the collector reads */
+static QByteArray fdinfo(int clientId, qint64 renderNs, qint64 videoNs, const char* pdev = IntelSlot) {
+    return QByteArray("pos:\t0\nflags:\t02100002\nmnt_id:\t24\nino:\t1071\n"
+                      "drm-driver:\ti915\n")
+        + "drm-client-id:\t" + QByteArray::number(clientId) + "\n"
+        + "drm-pdev:\t" + pdev + "\n"
+        + "drm-engine-render:\t" + QByteArray::number(renderNs) + " ns\n"
+        + "drm-engine-video:\t" + QByteArray::number(videoNs) + " ns\n"
+        + "drm-engine-capacity-video:\t2\n";
+}
+
+class TestGpuCollector : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void cards();
+    void engineDifferencing();
+    void dupAndForkCountedOnce();
+    void descriptorReuse();
+
+private:
+    bool addIntelCard(const QString& name = "card0");
+    bool addClient(int pid, int fd, const QByteArray& info, const QByteArray& comm = "game");
+    bool updateClient(int pid, int fd, const QByteArray& info);
+    SystemMonitor::Snapshot sample();
+
+    std::unique_ptr<QTemporaryDir> m_dir;
+    std::unique_ptr<GpuCollector> m_collector;
+    QString m_sys;
+    QString m_proc;
+    int m_seconds = 0;
+};
+
+void TestGpuCollector::init() {
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+    m_sys = m_dir->path() + "/sys";
+    m_proc = m_dir->path() + "/proc";
+    m_collector.reset(new GpuCollector(m_sys, m_proc));
+    m_seconds = 0;
+}
+
+void TestGpuCollector::cleanup() {
+    m_collector.reset();
+    m_dir.reset();
+}
+
+bool TestGpuCollector::addIntelCard(const QString& name) {
+    return writeFile(m_sys, "class/drm/" + name + "/device/uevent",
+                     QByteArray("DRIVER=i915\nPCI_ID=8086:46A6\nPCI_SLOT_NAME=") + IntelSlot + "\n");
+}
+
+bool TestGpuCollector::addClient(int pid, int fd, const QByteArray& info, const QByteArray& comm) {
+    QString dir = QString("%1/%2").arg(m_proc).arg(pid);
+    QDir().mkpath(dir + "/fd");
+    return writeFile(dir, "comm", comm + "\n")
+        && writeFile(dir, "fdinfo/" + QString::number(fd), info)
+        && QFile::link("/dev/dri/renderD128", dir + "/fd/" + QString::number(fd));
+}
+
+bool TestGpuCollector::updateClient(int pid, int fd, const QByteArray& info) {
+    return writeFile(m_proc, QString("%1/fdinfo/%2").arg(pid).arg(fd), info);
+}
+
+/** One round, a second after the previous one */
+SystemMonitor::Snapshot TestGpuCollector::sample() {
+    SystemMonitor::Snapshot snapshot;
+    m_collector->sample(snapshot, ++m_seconds * Second);
+    return snapshot;
+}
+
+void TestGpuCollector::cards() {
+    // Sorted by number, not by name; connectors are not cards
+    const QString amd = "class/drm/card0/device/";
+    QVERIFY(writeFile(m_sys, amd + "uevent", "DRIVER=amdgpu\nPCI_ID=1002:7480\nPCI_SLOT_NAME=0000:03:00.0\n"));
+    QVERIFY(writeFile(m_sys, amd + "product_name", "AMD Radeon RX 7600\n"));
+    QVERIFY(writeFile(m_sys, amd + "gpu_busy_percent", "37\n"));
+    QVERIFY(writeFile(m_sys, amd + "mem_info_vram_used", "1073741824\n"));
+    QVERIFY(writeFile(m_sys, amd + "mem_info_vram_total", "8589934592\n"));
+    QVERIFY(writeFile(m_sys, amd + "hwmon/hwmon3/temp1_input", "54000\n"));
+    QVERIFY(writeFile(m_sys, "class/drm/card10/device/uevent", "DRIVER=nouveau\nPCI_ID=10DE:2684\n"));
+    QVERIFY(addIntelCard("card2"));
+    QVERIFY(QDir().mkpath(m_sys + "/class/drm/card0-DP-1"));
+
+    SystemMonitor::Snapshot snapshot = sample();
+    QCOMPARE(int(snapshot.gpus.size()), 3);
+    const SystemMonitor::Snapshot::Gpu& radeon = snapshot.gpus[0];
+    QCOMPARE(radeon.card, QString("card0"));
+    QCOMPARE(radeon.model, QString("AMD Radeon RX 7600"));
+    QCOMPARE(radeon.driver, QString("amdgpu"));
+    QCOMPARE(radeon.busy, 37.0);
+    QCOMPARE(radeon.vramUsed, 1073741824LL);
+    QCOMPARE(radeon.vramTotal, 8589934592LL);
+    QCOMPARE(radeon.temperature, 54.0);
+
+    QCOMPARE(snapshot.gpus[1].card, QString("card2"));
+    QCOMPARE(snapshot.gpus[1].model, QString("Intel GPU [8086:46A6]"));
+    QCOMPARE(snapshot.gpus[1].busy, -1.0);  // No counter and no clients yet
+    QCOMPARE(snapshot.gpus[1].vramUsed, -1LL);
+    QCOMPARE(snapshot.gpus[2].card, QString("card10"));
+    QCOMPARE(snapshot.gpus[2].model, QString("NVIDIA GPU [10DE:2684]"));
+
+    // Files stay open and are re-read every round
+    QVERIFY(writeFile(m_sys, amd + "gpu_busy_percent", "90\n"));
+    QCOMPARE(sample().gpus[0].busy, 90.0);
+}
+
+void TestGpuCollector::engineDifferencing() {
+    QVERIFY(addIntelCard());
+    QVERIFY(addClient(100, 3, fdinfo(7, 0, 0)));
+
+    SystemMonitor::Snapshot snapshot = sample();
+    QVERIFY(snapshot.gpuProcesses.isEmpty());  // Baseline only
+    QCOMPARE(snapshot.gpus[0].busy, -1.0);
+
+    // render 25%; video a full second, but over two instances: 50%
+    QVERIFY(updateClient(100, 3, fdinfo(7, 250 * Ms, 1000 * Ms)));
+    snapshot = sample();
+    QCOMPARE(int(snapshot.gpuProcesses.size()), 1);
+    QCOMPARE(snapshot.gpuProcesses[0].pid, 100);
+    QCOMPARE(snapshot.gpuProcesses[0].name, QString("game"));
+    QCOMPARE(snapshot.gpuProcesses[0].card, QString("card0"));
+    QCOMPARE(snapshot.gpuProcesses[0].busy, 50.0);  // The busiest engine
+    QCOMPARE(snapshot.gpus[0].busy, 50.0);           // No busy counter: derived from clients
+
+    // Only the time since the previous round counts
+    QVERIFY(updateClient(100, 3, fdinfo(7, 1000 * Ms, 1000 * Ms)));
+    snapshot = sample();
+    QCOMPARE(snapshot.gpuProcesses[0].busy, 75.0);
+    QCOMPARE(snapshot.gpus[0].busy, 75.0);
+
+    // Idle clients are left out of the process list
+    snapshot = sample();
+    QVERIFY(snapshot.gpuProcesses.isEmpty());
+    QCOMPARE(snapshot.gpus[0].busy, 0.0);
+}
+
+void TestGpuCollector::dupAndForkCountedOnce() {
+    QVERIFY(addIntelCard());
+    // 100 opened client 7 and dup()ed it to fd 4; 101 inherited it by fork()
+    // and also opened client 8 of its own
+    QVERIFY(addClient(100, 3, fdinfo(7, 0, 0)));
+    QVERIFY(addClient(100, 4, fdinfo(7, 0, 0)));
+    QVERIFY(addClient(101, 5, fdinfo(7, 0, 0), "worker"));
+    QVERIFY(addClient(101, 6, fdinfo(8, 0, 0), "worker"));
+    QVERIFY(QFile::link("socket:[4242]", m_proc + "/100/fd/9"));  // Not DRM, no fdinfo needed
+    sample();
+
+    // Every descriptor of a DRM file shows the same counters
+    for (int fd : {3, 4}) QVERIFY(updateClient(100, fd, fdinfo(7, 500 * Ms, 0)));
+    QVERIFY(updateClient(101, 5, fdinfo(7, 500 * Ms, 0)));
+    QVERIFY(updateClient(101, 6, fdinfo(8, 250 * Ms, 0)));
+    SystemMonitor::Snapshot snapshot = sample();
+
+    QCOMPARE(int(snapshot.gpuProcesses.size()), 2);
+    QCOMPARE(snapshot.gpuProcesses[0].pid, 100);
+    QCOMPARE(snapshot.gpuProcesses[0].busy, 50.0);  // Not 100: fd 4 is the same file
+    QCOMPARE(snapshot.gpuProcesses[1].pid, 101);
+    QCOMPARE(snapshot.gpuProcesses[1].name, QString("worker"));
+    QCOMPARE(snapshot.gpuProcesses[1].busy, 25.0);  // Its own client only
+    QCOMPARE(snapshot.gpus[0].busy, 75.0);
+}
+
+void TestGpuCollector::descriptorReuse() {
+    QVERIFY(addIntelCard());
+    QVERIFY(addClient(100, 3, fdinfo(7, 0, 0)));
+    sample();
+    QVERIFY(updateClient(100, 3, fdinfo(7, 500 * Ms, 0)));
+    QCOMPARE(sample().gpuProcesses[0].busy, 50.0);
+
+    // fd 3 closed and reopened as another DRM file; its counters are not
+    // differenced against client 7's
+    QVERIFY(updateClient(100, 3, fdinfo(12, 5000 * Ms, 0)));
+    SystemMonitor::Snapshot snapshot = sample();
+    QVERIFY(snapshot.gpuProcesses.isEmpty());
+    QCOMPARE(snapshot.gpus[0].busy, -1.0);  // No clients left to derive it from
+
+    // Picked up as a new client by the next walk of /proc
+    while (m_seconds < GpuCollector::DiscoveryRounds) QVERIFY(sample().gpuProcesses.isEmpty());
+    QVERIFY(sample().gpuProcesses.isEmpty());  // Discovery round: baseline
+    QVERIFY(updateClient(100, 3, fdinfo(12, 5250 * Ms, 0)));
+    snapshot = sample();
+    QCOMPARE(int(snapshot.gpuProcesses.size()), 1);
+    QCOMPARE(snapshot.gpuProcesses[0].busy, 25.0);
+}
+
+QTEST_GUILESS_MAIN(TestGpuCollector)
+#include "tst_gpucollector.moc"
@@ -0,0 +1,270 @@
+/**
+ * MilkWidgetCore - MediaPlayer Tests
+ *
+ * A stub org.mpris.MediaPlayer2.* player on a private session bus: the
+ * client must find it through ListNames or NameOwnerChanged, follow
+ * PropertiesChanged and Seeked, and let go when the name disappears.
+ */
+
+#include "milk/APIs.h"
+#include "HttpStub.h"
+#include "SessionBus.h"
+
+#include <QBuffer>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QImage>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Milk;
+using MilkTest::HttpStub;
+
+static const char* PlayerService = "org.mpris.MediaPlayer2.fake";
+static const char* PlayerPath = "/org/mpris/MediaPlayer2";
+static const char* PlayerInterface = "org.mpris.MediaPlayer2.Player";
+
+class FakePlayer : public QObject {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.mpris.MediaPlayer2.Player")
+    Q_PROPERTY(QString PlaybackStatus READ playbackStatus)
+    Q_PROPERTY(QVariantMap Metadata READ metadata)
+    Q_PROPERTY(double Rate READ rate)
+    Q_PROPERTY(qlonglong Position READ position)
+    Q_PROPERTY(double Volume READ volume)
+
+public:
+    QString status = "Paused";
+    QVariantMap meta;
+    qlonglong positionUs = 0;
+    double vol = 0.5;
+    QStringList calls;
+
+    QString playbackStatus() const { return status; }
+    QVariantMap metadata() const { return meta; }
+    double rate() const { return 1.0; }
+    qlonglong position() const { return positionUs; }
+    double volume() const { return vol; }
+
+public slots:
+    void Play() { calls << "Play"; }
+    void Pause() { calls << "Pause"; }
+    void PlayPause() { calls << "PlayPause"; }
+    void Stop() { calls << "Stop"; }
+    void Next() { calls << "Next"; }
+    void Previous() { calls << "Previous"; }
+    void SetPosition(const QDBusObjectPath& track, qlonglong position) {
+        calls << QString("SetPosition %1 %2").arg(track.path()).arg(position);
+    }
+};
+
+static QVariantMap track(const QString& id, const QString& title, const QString& artist, qlonglong lengthUs,
+                         const QString& art = QString()) {
+    QVariantMap metadata;
+    metadata["mpris:trackid"] = QVariant::fromValue(QDBusObjectPath(id));
+    metadata["xesam:title"] = title;
+    metadata["xesam:artist"] = QStringList{artist};
+    metadata["xesam:album"] = "Album";
+    metadata["mpris:length"] = lengthUs;
+    if (!art.isEmpty()) metadata["mpris:artUrl"] = art;
+    return metadata;
+}
+
+class TestMediaPlayer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+    void findsRunningPlayer();
+    void followsNameOwnerChanged();
+    void followsPropertiesChanged();
+    void controlsReachPlayer();
+    void albumArt();
+    void oversizedArtIsAbandoned();
+
+private:
+    void appear();
+    void vanish();
+    /** Broadcast PropertiesChanged from the stub, as a real player would */
+    void changed(const QVariantMap& properties);
+
+    QTemporaryDir m_dir;
+    MilkTest::SessionBus m_bus;
+    QDBusConnection m_player{QString()};
+    FakePlayer m_fake;
+    bool m_owned = false;
+};
+
+void TestMediaPlayer::initTestCase() {
+    if (!MilkTest::SessionBus::available()) QSKIP("dbus-daemon not installed");
+    QVERIFY(m_dir.isValid());
+    QVERIFY(m_bus.start(m_dir.path()));
+    m_player = m_bus.connect("player");
+    QVERIFY(m_player.isConnected());
+    QVERIFY(m_player.registerObject(PlayerPath, &m_fake,
+                                    QDBusConnection::ExportAllSlots | QDBusConnection::ExportAllProperties));
+}
+
+void TestMediaPlayer::cleanupTestCase() {
+    MediaPlayer::cleanup();
+}
+
+void TestMediaPlayer::init() {
+    m_fake.status = "Paused";
+    m_fake.meta = track("/track/1", "First", "Artist", 200000000);
+    m_fake.positionUs = 0;
+    m_fake.calls.clear();
+}
+
+void TestMediaPlayer::cleanup() {
+    MediaPlayer::cleanup();
+    vanish();
+}
+
+void TestMediaPlayer::appear() {
+    QVERIFY(m_player.registerService(PlayerService));
+    m_owned = true;
+}
+
+void TestMediaPlayer::vanish() {
+    if (m_owned) m_player.unregisterService(PlayerService);
+    m_owned = false;
+}
+
+void TestMediaPlayer::changed(const QVariantMap& properties) {
+    QDBusMessage signal = QDBusMessage::createSignal(PlayerPath, "org.freedesktop.DBus.Properties", "PropertiesChanged");
+    signal << QString(PlayerInterface) << properties << QStringList();
+    QVERIFY(m_player.send(signal));
+}
+
+void TestMediaPlayer::findsRunningPlayer() {
+    // Already on the bus before the client starts: found through ListNames
+    appear();
+    MediaPlayer* media = MediaPlayer::instance();
+    QTRY_COMPARE(media->title(), QString("First"));
+    QCOMPARE(media->playerName(), QString("fake"));
+    QCOMPARE(media->availablePlayers(), QStringList{"fake"});
+    QCOMPARE(media->artist(), QString("Artist"));
+    QCOMPARE(media->album(), QString("Album"));
+    QCOMPARE(media->duration(), 200);
+    QVERIFY(media->isPaused());
+    QCOMPARE(media->volume(), 0.5);
+}
+
+void TestMediaPlayer::followsNameOwnerChanged() {
+    MediaPlayer* media = MediaPlayer::instance();
+    QTest::qWait(50);  // ListNames answered: nothing there yet
+    QVERIFY(media->playerName().isEmpty());
+
+    QSignalSpy tracks(media, &MediaPlayer::trackChanged);
+    appear();
+    QTRY_COMPARE(media->title(), QString("First"));
+    QCOMPARE(media->playerName(), QString("fake"));
+    QCOMPARE(tracks.count(), 1);
+
+    // Gone: everything about the player is dropped
+    QSignalSpy playback(media, &MediaPlayer::playbackChanged);
+    vanish();
+    QTRY_VERIFY(media->playerName().isEmpty());
+    QVERIFY(media->availablePlayers().isEmpty());
+    QVERIFY(media->title().isEmpty());
+    QVERIFY(media->isStopped());
+    QCOMPARE(playback.count(), 1);
+
+    // Back again
+    appear();
+    QTRY_COMPARE(media->title(), QString("First"));
+}
+
+void TestMediaPlayer::followsPropertiesChanged() {
+    appear();
+    MediaPlayer* media = MediaPlayer::instance();
+    QTRY_COMPARE(media->title(), QString("First"));
+
+    QSignalSpy tracks(media, &MediaPlayer::trackChanged);
+    QSignalSpy playback(media, &MediaPlayer::playbackChanged);
+    changed({{"Metadata", track("/track/2", "Second", "Other", 100000000)}, {"PlaybackStatus", "Playing"}});
+    QTRY_COMPARE(media->title(), QString("Second"));
+    QCOMPARE(media->artist(), QString("Other"));
+    QCOMPARE(media->duration(), 100);
+    QCOMPARE(tracks.count(), 1);
+    QCOMPARE(tracks.first().at(0).toString(), QString("Second"));
+    QVERIFY(media->isPlaying());
+    QCOMPARE(playback.count(), 1);
+    QCOMPARE(playback.first().at(0).toBool(), true);
+
+    // Position is extrapolated while playing, from the Seeked value on
+    QDBusMessage seeked = QDBusMessage::createSignal(PlayerPath, PlayerInterface, "Seeked");
+    seeked << qlonglong(50000000);
+    QVERIFY(m_player.send(seeked));
+    QTRY_VERIFY(media->position() >= 50);
+    QVERIFY(media->position() <= 52);
+    QTRY_VERIFY(media->progress() > 0.5);
+
+    QSignalSpy volume(media, &MediaPlayer::volumeChanged);
+    changed({{"Volume", 0.25}, {"PlaybackStatus", "Paused"}});
+    QTRY_COMPARE(volume.count(), 1);
+    QCOMPARE(media->volume(), 0.25);
+    QVERIFY(media->isPaused());
+    int paused = media->position();
+    QTest::qWait(1100);
+    QCOMPARE(media->position(), paused);  // No longer advancing
+}
+
+void TestMediaPlayer::controlsReachPlayer() {
+    appear();
+    MediaPlayer* media = MediaPlayer::instance();
+    QTRY_COMPARE(media->title(), QString("First"));
+
+    media->pause();
+    media->next();
+    media->seek(30);
+    QTRY_COMPARE(int(m_fake.calls.size()), 3);
+    QCOMPARE(m_fake.calls, (QStringList{"Pause", "Next", "SetPosition /track/1 30000000"}));
+}
+
+void TestMediaPlayer::albumArt() {
+    HttpStub server;
+    QImage image(8, 8, QImage::Format_RGB32);
+    image.fill(Qt::red);
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(image.save(&buffer, "PNG"));
+    server.enqueue(200, png, "Content-Type: image/png\r\n");
+
+    m_fake.meta = track("/track/1", "First", "Artist", 200000000, server.url("/art.png").toString());
+    appear();
+    MediaPlayer* media = MediaPlayer::instance();
+    QTRY_VERIFY(!media->artImage().isNull());
+    QCOMPARE(media->artImage().size(), QSize(8, 8));
+}
+
+void TestMediaPlayer::oversizedArtIsAbandoned() {
+    // A valid image followed by padding: reading only the first bytes would
+    // still decode, so a non-null image here means the cap truncated
+    HttpStub server;
+    QImage image(8, 8, QImage::Format_RGB32);
+    image.fill(Qt::blue);
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(image.save(&buffer, "PNG"));
+    server.enqueue(200, png + QByteArray(9 * 1024 * 1024, '\0'), "Content-Type: image/png\r\n");
+
+    m_fake.meta = track("/track/1", "First", "Artist", 200000000, server.url("/big.png").toString());
+    appear();
+    MediaPlayer* media = MediaPlayer::instance();
+    QTRY_COMPARE(media->title(), QString("First"));
+    QTRY_COMPARE(int(server.requests().size()), 1);
+    QTest::qWait(500);
+    QVERIFY(media->artImage().isNull());
+}
+
+QTEST_GUILESS_MAIN(TestMediaPlayer)
+#include "tst_mediaplayer.moc"
@@ -0,0 +1,106 @@
+/**
+ * MilkWidgetCore - MemInfo Tests
+ */
+
+#include "apis/MemInfo.h"
+#include "Fixture.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Milk;
+using MilkTest::writeFile;
+using Memory = SystemMonitor::Snapshot::Memory;
+
+class TestMemInfo : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parseKnownKeys();
+    void parseSkipsUnknownKeys();
+    void parseNodeLines();
+    void readerFillsNodes();
+};
+
+void TestMemInfo::parseKnownKeys() {
+    Memory memory;
+    int found = parseMemInfo("MemTotal:       16384000 kB\n"
+                             "MemFree:         1024000 kB\n"
+                             "MemAvailable:    8192000 kB\n"
+                             "Committed_AS:    4096000 kB\n"
+                             "HugePages_Total:       8\n"
+                             "HugePages_Rsvd:        2\n"
+                             "Hugepagesize:       2048 kB\n", memory);
+    QCOMPARE(found, 7);
+    QCOMPARE(memory.total, 16384000LL * 1024);
+    QCOMPARE(memory.free, 1024000LL * 1024);
+    QCOMPARE(memory.available, 8192000LL * 1024);
+    QCOMPARE(memory.committedAs, 4096000LL * 1024);
+    QCOMPARE(memory.hugePagesTotal, 8LL);  // Counts have no unit and are not scaled
+    QCOMPARE(memory.hugePagesReserved, 2LL);
+    QCOMPARE(memory.hugePageSize, 2048LL * 1024);
+}
+
+void TestMemInfo::parseSkipsUnknownKeys() {
+    // Names that share a slot or a prefix with a known key must not match it
+    Memory memory;
+    memory.cached = 42;
+    int found = parseMemInfo("Mem:               1 kB\n"
+                             "MemTotalX:         2 kB\n"
+                             "DirectMap4k:       3 kB\n"
+                             "CmaTotal:          4 kB\n"
+                             "SwapCached:        5 kB\n"
+                             "no colon here\n"
+                             "\n", memory);
+    QCOMPARE(found, 1);
+    QCOMPARE(memory.swapCached, 5LL * 1024);
+    QCOMPARE(memory.total, 0LL);
+    QCOMPARE(memory.cached, 42LL);  // Missing fields are left alone
+}
+
+void TestMemInfo::parseNodeLines() {
+    Memory memory;
+    int found = parseMemInfo("Node 1 MemTotal:       8192 kB\n"
+                             "Node 1 MemFree:        4096 kB\n"
+                             "Node 1 FilePages:      1024 kB\n"
+                             "Node 1 HugePages_Free:    3", memory);  // No trailing newline
+    QCOMPARE(found, 4);
+    QCOMPARE(memory.total, 8192LL * 1024);
+    QCOMPARE(memory.free, 4096LL * 1024);
+    QCOMPARE(memory.filePages, 1024LL * 1024);
+    QCOMPARE(memory.hugePagesFree, 3LL);
+}
+
+void TestMemInfo::readerFillsNodes() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString sys = dir.path() + "/sys";
+    const QString proc = dir.path() + "/proc";
+    QVERIFY(writeFile(proc, "meminfo", "MemTotal: 4096 kB\nMemAvailable: 1024 kB\n"));
+    // node1 is missing: nodes are indexed by id, with a gap
+    QVERIFY(writeFile(sys, "devices/system/node/node0/meminfo",
+                      "Node 0 MemTotal: 2048 kB\nNode 0 MemFree: 512 kB\nNode 0 FilePages: 256 kB\n"
+                      "Node 0 Shmem: 128 kB\nNode 0 SReclaimable: 64 kB\n"));
+    QVERIFY(writeFile(sys, "devices/system/node/node2/meminfo",
+                      "Node 2 MemTotal: 2048 kB\nNode 2 MemFree: 2000 kB\nNode 2 FilePages: 1000 kB\n"));
+
+    MemInfoReader reader(sys, proc);
+    SystemMonitor::Snapshot snapshot;
+    QVERIFY(reader.read(snapshot));
+    QCOMPARE(snapshot.memory.total, 4096LL * 1024);
+    QCOMPARE(snapshot.memory.available, 1024LL * 1024);
+
+    QCOMPARE(int(snapshot.memoryNodes.size()), 3);
+    QCOMPARE(snapshot.memoryNodes[0].total, 2048LL * 1024);
+    QCOMPARE(snapshot.memoryNodes[0].available, (512LL + 256 - 128 + 64) * 1024);
+    QCOMPARE(snapshot.memoryNodes[1].total, 0LL);
+    QCOMPARE(snapshot.memoryNodes[2].available, 2048LL * 1024);  // Estimate capped at the node's total
+
+    // Files are kept open and re-read from the start every round
+    QVERIFY(writeFile(proc, "meminfo", "MemTotal: 4096 kB\nMemAvailable: 2048 kB\n"));
+    QVERIFY(reader.read(snapshot));
+    QCOMPARE(snapshot.memory.available, 2048LL * 1024);
+}
+
+QTEST_GUILESS_MAIN(TestMemInfo)
+#include "tst_meminfo.moc"
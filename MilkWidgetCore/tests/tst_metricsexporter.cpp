@@ -0,0 +1,139 @@
+/**
+ * MilkWidgetCore - MetricsExporter Tests
+ *
+ * Scrapes the exporter over loopback TCP the way Prometheus or curl would.
+ */
+
+#include "milk/APIs.h"
+
+#include <QLocalServer>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Milk;
+
+class TestMetricsExporter : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void scrape();
+    void head();
+    void notFound();
+    void methodNotAllowed();
+    void localSocketInUse();
+
+private:
+    /** Send @p request and return everything up to the server's close */
+    QByteArray fetch(const QByteArray& request);
+    static QByteArray header(const QByteArray& response, const QByteArray& name);
+    static QByteArray body(const QByteArray& response);
+};
+
+void TestMetricsExporter::initTestCase() {
+    QVERIFY(MetricsExporter::instance()->listen(0));
+    QVERIFY(MetricsExporter::instance()->port() != 0);
+}
+
+void TestMetricsExporter::cleanupTestCase() {
+    MetricsExporter::cleanup();
+    SystemMonitor::cleanup();
+}
+
+QByteArray TestMetricsExporter::fetch(const QByteArray& request) {
+    // Asynchronous: the exporter answers from this thread's event loop
+    QTcpSocket socket;
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, this, [&]() { response += socket.readAll(); });
+    socket.connectToHost(QHostAddress::LocalHost, MetricsExporter::instance()->port());
+    socket.write(request);
+    QTest::qWaitFor([&]() { return socket.state() == QAbstractSocket::UnconnectedState; }, 5000);
+    return response + socket.readAll();
+}
+
+QByteArray TestMetricsExporter::header(const QByteArray& response, const QByteArray& name) {
+    const QList<QByteArray> lines = response.left(response.indexOf("\r\n\r\n")).split('\n');
+    for (const QByteArray& line : lines) {
+        int colon = line.indexOf(':');
+        if (colon > 0 && line.left(colon).trimmed().toLower() == name.toLower()) return line.mid(colon + 1).trimmed();
+    }
+    return QByteArray();
+}
+
+QByteArray TestMetricsExporter::body(const QByteArray& response) {
+    int end = response.indexOf("\r\n\r\n");
+    return end < 0 ? QByteArray() : response.mid(end + 4);
+}
+
+void TestMetricsExporter::scrape() {
+    QByteArray response = fetch("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QVERIFY2(response.startsWith("HTTP/1.1 200 OK\r\n"), response.left(64).constData());
+    QCOMPARE(header(response, "Content-Type"), QByteArray("application/openmetrics-text; version=1.0.0; charset=utf-8"));
+
+    QByteArray text = body(response);
+    QCOMPARE(header(response, "Content-Length").toInt(), text.size());
+    QVERIFY(text.endsWith("\n# EOF\n"));
+    QCOMPARE(text.count("# EOF"), 1);
+    QVERIFY(text.contains("# TYPE milk_cpu_usage_ratio gauge\n"));
+    QVERIFY(text.contains("\nmilk_uptime_seconds "));
+
+    // Every sample is "name[{labels}] value" with a value OpenMetrics accepts
+    const QList<QByteArray> lines = text.split('\n');
+    for (const QByteArray& line : lines) {
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        QByteArray value = line.mid(line.lastIndexOf(' ') + 1);
+        bool ok = false;
+        value.toDouble(&ok);
+        QVERIFY2(ok || value == "NaN" || value == "+Inf" || value == "-Inf", line.constData());
+        QVERIFY2(value != "nan" && value != "inf" && value != "-inf", line.constData());
+    }
+
+    // A query string is ignored, and / is an alias
+    QVERIFY(fetch("GET /metrics?x=1 HTTP/1.1\r\n\r\n").startsWith("HTTP/1.1 200 OK"));
+    QVERIFY(fetch("GET / HTTP/1.0\r\n\r\n").startsWith("HTTP/1.1 200 OK"));
+}
+
+void TestMetricsExporter::head() {
+    QByteArray response = fetch("HEAD /metrics HTTP/1.1\r\n\r\n");
+    QVERIFY(response.startsWith("HTTP/1.1 200 OK\r\n"));
+    QVERIFY(header(response, "Content-Length").toInt() > 0);
+    QVERIFY(body(response).isEmpty());
+}
+
+void TestMetricsExporter::notFound() {
+    QByteArray response = fetch("GET /other HTTP/1.1\r\n\r\n");
+    QVERIFY2(response.startsWith("HTTP/1.1 404 Not Found\r\n"), response.left(64).constData());
+    QCOMPARE(header(response, "Content-Type"), QByteArray("text/plain"));
+    QVERIFY(!body(response).contains("# EOF"));
+}
+
+void TestMetricsExporter::methodNotAllowed() {
+    QByteArray response = fetch("POST /metrics HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+    QVERIFY2(response.startsWith("HTTP/1.1 405 Method Not Allowed\r\n"), response.left(64).constData());
+    QCOMPARE(header(response, "Content-Type"), QByteArray("text/plain"));
+}
+
+void TestMetricsExporter::localSocketInUse() {
+    // A live socket belongs to someone else and must survive listenLocal()
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("metrics.sock");
+    QLocalServer other;
+    QVERIFY(other.listen(path));
+
+    QSignalSpy errors(MetricsExporter::instance(), &MetricsExporter::error);
+    QVERIFY(!MetricsExporter::instance()->listenLocal(path));
+    QCOMPARE(errors.count(), 1);
+    QVERIFY(other.isListening());
+    QVERIFY(QFile::exists(path));
+
+    // Once the owner has gone the path can be used
+    other.close();
+    QVERIFY(MetricsExporter::instance()->listenLocal(path));
+}
+
+QTEST_GUILESS_MAIN(TestMetricsExporter)
+#include "tst_metricsexporter.moc"
@@ -0,0 +1,208 @@
+/**
+ * MilkWidgetCore - NotificationAPI Tests
+ *
+ * Runs a private session bus (SessionBus.h) with a stub
+ * org.freedesktop.Notifications server on its own connection. A fake
+ * notify-send on PATH appends its arguments to a log file, so the
+ * fallback can be checked without a desktop.
+ */
+
+#include "milk/APIs.h"
+#include "Fixture.h"
+#include "SessionBus.h"
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusContext>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace Milk;
+
+static const char* NotifyService = "org.freedesktop.Notifications";
+static const char* NotifyPath = "/org/freedesktop/Notifications";
+
+class FakeNotifications : public QObject, protected QDBusContext {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Notifications")
+
+public:
+    struct Call {
+        uint id;
+        uint replaces;
+        QString title;
+        QString body;
+        int timeout;
+    };
+    QList<Call> calls;
+    QList<uint> closed;
+    bool refuse = false;
+
+public slots:
+    uint Notify(const QString& app, uint replaces, const QString& icon, const QString& title,
+                const QString& body, const QStringList& actions, const QVariantMap& hints, int timeout) {
+        Q_UNUSED(app) Q_UNUSED(icon) Q_UNUSED(actions) Q_UNUSED(hints)
+        if (refuse) {
+            sendErrorReply(QDBusError::Failed, "refused by test");
+            return 0;
+        }
+        uint id = replaces ? replaces : m_nextId++;
+        calls.append(Call{id, replaces, title, body, timeout});
+        return id;
+    }
+    void CloseNotification(uint id) { closed.append(id); }
+    QStringList GetCapabilities() { return {"body"}; }
+
+private:
+    uint m_nextId = 1;
+};
+
+class TestNotification : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void replacesTaggedBubble();
+    void coalescesBursts();
+    void capsLongBursts();
+    void failedCallFallsBack();
+    void noServerUsesNotifySend();
+
+private:
+    QString notifySendLog() const;
+
+    QTemporaryDir m_dir;
+    MilkTest::SessionBus m_bus;
+    QDBusConnection m_server{QString()};
+    FakeNotifications m_fake;
+};
+
+void TestNotification::initTestCase() {
+    if (!MilkTest::SessionBus::available()) QSKIP("dbus-daemon not installed");
+    QVERIFY(m_dir.isValid());
+    QVERIFY(m_bus.start(m_dir.path()));
+
+    // The fake notify-send comes first on PATH
+    QString script = m_dir.filePath("notify-send");
+    QVERIFY(MilkTest::writeFile(m_dir.path(), "notify-send", "#!/bin/sh\nprintf '%s\\n' \"$*\" >> \"$MILK_NOTIFY_LOG\"\n"));
+    QFile::setPermissions(script, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    qputenv("MILK_NOTIFY_LOG", QFile::encodeName(m_dir.filePath("notify-send.log")));
+    qputenv("PATH", QFile::encodeName(m_dir.path()) + ':' + qgetenv("PATH"));
+
+    m_server = m_bus.connect("notification-server");
+    QVERIFY(m_server.isConnected());
+    QVERIFY(m_server.registerObject(NotifyPath, &m_fake, QDBusConnection::ExportAllSlots));
+    QVERIFY(m_server.registerService(NotifyService));
+}
+
+void TestNotification::cleanupTestCase() {
+    NotificationAPI::cleanup();
+}
+
+void TestNotification::init() {
+    // A fresh client per test; the server keeps running
+    NotificationAPI::cleanup();
+    NotificationAPI::instance()->setCoalesceWindow(50);
+    m_fake.calls.clear();
+    m_fake.closed.clear();
+    m_fake.refuse = false;
+    QFile::remove(m_dir.filePath("notify-send.log"));
+}
+
+QString TestNotification::notifySendLog() const {
+    QFile file(m_dir.filePath("notify-send.log"));
+    return file.open(QIODevice::ReadOnly) ? QString::fromUtf8(file.readAll()) : QString();
+}
+
+void TestNotification::replacesTaggedBubble() {
+    NotificationAPI* api = NotificationAPI::instance();
+    api->notify("CPU", "90%", QString(), 3000, "cpu");
+    QTRY_COMPARE(int(m_fake.calls.size()), 1);
+    QCOMPARE(m_fake.calls[0].replaces, 0u);
+    QCOMPARE(m_fake.calls[0].title, QString("CPU"));
+    QCOMPARE(m_fake.calls[0].timeout, 3000);
+    uint id = m_fake.calls[0].id;
+
+    // Same tag, after the window: updates the bubble in place
+    QTest::qWait(100);
+    api->notify("CPU", "95%", QString(), 3000, "cpu");
+    QTRY_COMPARE(int(m_fake.calls.size()), 2);
+    QCOMPARE(m_fake.calls[1].replaces, id);
+    QCOMPARE(m_fake.calls[1].body, QString("95%"));
+
+    // Untagged notifications never replace anything
+    api->notify("Disk", "full");
+    QTRY_COMPARE(int(m_fake.calls.size()), 3);
+    QCOMPARE(m_fake.calls[2].replaces, 0u);
+
+    api->close("cpu");
+    QTRY_COMPARE(int(m_fake.closed.size()), 1);
+    QCOMPARE(m_fake.closed[0], id);
+    QVERIFY(notifySendLog().isEmpty());
+}
+
+void TestNotification::coalescesBursts() {
+    NotificationAPI* api = NotificationAPI::instance();
+    for (int i = 0; i < 5; i++) api->notify("Battery", "low");
+    api->notify("Other", "once");
+
+    QTRY_COMPARE(int(m_fake.calls.size()), 2);
+    QTest::qWait(150);
+    QCOMPARE(int(m_fake.calls.size()), 2);  // One bubble per key, in arrival order
+    QCOMPARE(m_fake.calls[0].title, QString("Battery"));
+    QCOMPARE(m_fake.calls[0].body, QString::fromUtf8("low (×5)"));
+    QCOMPARE(m_fake.calls[1].body, QString("once"));
+    QCOMPARE(int(api->history().size()), 6);  // History keeps every notification
+}
+
+void TestNotification::capsLongBursts() {
+    // A burst that never pauses is still delivered about four windows in
+    NotificationAPI* api = NotificationAPI::instance();
+    api->notify("warm", "up");
+    QTRY_COMPARE(int(m_fake.calls.size()), 1);  // Server probed and answering
+    m_fake.calls.clear();
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 firstDelivery = -1;
+    while (clock.elapsed() < 600) {
+        api->notify("Net", "flapping", QString(), 1000, "net");
+        QTest::qWait(10);
+        if (firstDelivery < 0 && !m_fake.calls.isEmpty()) firstDelivery = clock.elapsed();
+    }
+    QVERIFY2(firstDelivery >= 0, "nothing delivered during the burst");
+    QVERIFY2(firstDelivery < 400, qPrintable(QString("first delivery after %1 ms").arg(firstDelivery)));
+    QVERIFY(m_fake.calls.first().body.startsWith("flapping (×"));
+}
+
+void TestNotification::failedCallFallsBack() {
+    NotificationAPI* api = NotificationAPI::instance();
+    m_fake.refuse = true;
+    api->notify("Refused", "goes to notify-send");
+    QTRY_VERIFY(notifySendLog().contains("Refused goes to notify-send"));
+    QVERIFY(notifySendLog().contains("-a MilkWidget"));
+
+    // The next message probes again and reaches the server
+    m_fake.refuse = false;
+    api->notify("Back", "on the bus");
+    QTRY_COMPARE(int(m_fake.calls.size()), 1);
+    QCOMPARE(m_fake.calls[0].title, QString("Back"));
+    QVERIFY(!notifySendLog().contains("Back"));
+}
+
+void TestNotification::noServerUsesNotifySend() {
+    QVERIFY(m_server.unregisterService(NotifyService));
+    QTRY_VERIFY(!QDBusConnection::sessionBus().interface()->isServiceRegistered(NotifyService));
+
+    NotificationAPI::instance()->notify("Nobody", "listening");
+    QTRY_VERIFY(notifySendLog().contains("Nobody listening"));
+    QVERIFY(m_fake.calls.isEmpty());
+
+    QVERIFY(m_server.registerService(NotifyService));
+}
+
+QTEST_GUILESS_MAIN(TestNotification)
+#include "tst_notification.moc"
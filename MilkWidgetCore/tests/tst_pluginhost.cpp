@@ -0,0 +1,137 @@
+/**
+ * MilkWidgetCore - PluginHost Tests
+ *
+ * Every test uses a host of its own, so SystemMonitor and its sampler
+ * thread are never started; the only rounds are the sample() calls below.
+ * FAST_PLUGIN and SLOW_PLUGIN are test_plugin.cpp builds; the slow one
+ * sleeps 50 ms per round.
+ */
+
+#include "milk/APIs.h"
+
+#include <QLibrary>
+#include <QSignalSpy>
+#include <QtTest>
+#include <cmath>
+#include <thread>
+
+using namespace Milk;
+
+class TestPluginHost : public QObject {
+    Q_OBJECT
+
+private slots:
+    void loadAndSample();
+    void loadErrors();
+    void overrunsDisable();
+    void hardOverrunDisables();
+    void pluginRunsWithoutHostLock();
+};
+
+void TestPluginHost::loadAndSample() {
+    PluginHost host;
+    QString error;
+    QVERIFY2(host.load(FAST_PLUGIN, &error), qPrintable(error));
+
+    QVector<PluginHost::PluginInfo> plugins = host.plugins();
+    QCOMPARE(int(plugins.size()), 1);
+    QCOMPARE(plugins[0].name, QString("fast"));
+    QCOMPARE(plugins[0].metrics, QStringList({"fast.a", "fast.b"}));
+    QVERIFY(std::isnan(plugins[0].values[0]));  // No round yet
+
+    // Rounds alternate between values and a failure, which reports none
+    host.sample();
+    PluginHost::PluginInfo first = host.plugins().first();
+    host.sample();
+    PluginHost::PluginInfo second = host.plugins().first();
+    QVERIFY(std::isnan(first.values[0]) != std::isnan(second.values[0]));
+    const PluginHost::PluginInfo& good = std::isnan(second.values[0]) ? first : second;
+    QVERIFY(good.values[0] >= 1);
+    QCOMPARE(good.values[1], 2 * good.values[0]);
+    QVERIFY(!second.disabled);
+
+    // Deliveries reach the registry on the event loop, with the latest round
+    if (std::isnan(second.values[0])) host.sample();
+    QCoreApplication::processEvents();
+    MetricRegistry* registry = MetricRegistry::instance();
+    QVERIFY(registry->contains("fast.a"));
+    QCOMPARE(registry->value("fast.b"), 2 * registry->value("fast.a"));
+    MetricRegistry::cleanup();
+}
+
+void TestPluginHost::loadErrors() {
+    PluginHost host;
+    QString error;
+    QVERIFY(!host.load("/nonexistent/libmilk_nothing.so", &error));
+    QVERIFY(!error.isEmpty());
+
+    QVERIFY(host.load(FAST_PLUGIN));
+    QVERIFY(!host.load(FAST_PLUGIN, &error));
+    QVERIFY2(error.contains("already loaded"), qPrintable(error));
+    QCOMPARE(int(host.plugins().size()), 1);
+}
+
+void TestPluginHost::overrunsDisable() {
+    PluginHost host;
+    host.setBudget(15000);  // Over budget every round, but not by ten times
+    QVERIFY(host.load(SLOW_PLUGIN));
+    QSignalSpy disabled(&host, &PluginHost::pluginDisabled);
+
+    host.sample();
+    host.sample();
+    QVERIFY(!host.plugins().first().disabled);
+    host.sample();
+    PluginHost::PluginInfo info = host.plugins().first();
+    QVERIFY(info.disabled);
+    QCOMPARE(info.overruns, 3);
+    QVERIFY(std::isnan(info.values[0]));
+
+    QCoreApplication::processEvents();
+    QCOMPARE(disabled.count(), 1);
+    QCOMPARE(disabled.first().at(0).toString(), QString("slow"));
+
+    // Skipped from then on
+    qint64 lastRun = info.lastRunNs;
+    host.sample();
+    QCOMPARE(host.plugins().first().lastRunNs, lastRun);
+    QCOMPARE(host.plugins().first().overruns, 3);
+}
+
+void TestPluginHost::hardOverrunDisables() {
+    PluginHost host;
+    host.setBudget(1000);
+    QVERIFY(host.load(SLOW_PLUGIN));
+    host.sample();
+    PluginHost::PluginInfo info = host.plugins().first();
+    QVERIFY(info.disabled);
+    QCOMPARE(info.overruns, 1);
+}
+
+void TestPluginHost::pluginRunsWithoutHostLock() {
+    PluginHost host;
+    host.setBudget(10 * 1000 * 1000);
+    QVERIFY(host.load(SLOW_PLUGIN));
+
+    QLibrary library(SLOW_PLUGIN);  // Same loaded module, same state
+    QVERIFY(library.load());
+    auto inSample = reinterpret_cast<int (*)()>(library.resolve("milk_test_in_sample"));
+    QVERIFY(inSample);
+
+    std::thread sampler([&host]() { host.sample(); });
+    QElapsedTimer waited;
+    waited.start();
+    while (!inSample() && waited.elapsed() < 5000) std::this_thread::yield();
+    bool entered = inSample() != 0;
+
+    // Answered while the plugin is still inside sample(), not after it
+    QVector<PluginHost::PluginInfo> plugins = host.plugins();
+    bool overlapped = inSample() != 0;
+    sampler.join();
+    QVERIFY(entered);
+    QVERIFY(overlapped);
+    QCOMPARE(int(plugins.size()), 1);
+    QVERIFY(!host.plugins().first().disabled);
+}
+
+QTEST_GUILESS_MAIN(TestPluginHost)
+#include "tst_pluginhost.moc"
@@ -0,0 +1,173 @@
+/**
+ * MilkWidgetCore - TimeSeries Tests
+ *
+ * History files go under XDG_DATA_HOME, which points into a temporary
+ * directory for the whole run.
+ */
+
+#include "milk/Utils.h"
+
+#include <QDirIterator>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <cstring>
+
+using namespace Milk;
+
+static const qint64 Hour = 60 * 60 * 1000;
+static const qint64 Minute = 60 * 1000;
+static const qint64 T0 = 472222 * Hour;  // On an hour boundary, late 2023
+
+class TestTimeSeries : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void secondsRoundTrip();
+    void minuteAndHourRollups();
+    void rollupSurvivesReopen();
+    void clockStepBackIsDropped();
+    void tornAppendIsDropped();
+    void findDoesNotCreate();
+
+private:
+    QTemporaryDir m_data;
+};
+
+void TestTimeSeries::initTestCase() {
+    QVERIFY(m_data.isValid());
+    qputenv("XDG_DATA_HOME", QFile::encodeName(m_data.path()));
+}
+
+void TestTimeSeries::cleanupTestCase() {
+    TimeSeries::closeAll();
+}
+
+void TestTimeSeries::secondsRoundTrip() {
+    TimeSeries* series = TimeSeries::open("roundtrip");
+    const double values[] = {0, 1.5, 1.5, -3.25, 1e9, 0.1};
+    for (int i = 0; i < 6; ++i) series->append(T0 + i * 1000 + (i == 4 ? 7 : 0), values[i]);
+
+    QVector<TimeSeries::Point> points = series->read(TimeSeries::Seconds, T0, T0 + Minute);
+    QCOMPARE(int(points.size()), 6);
+    for (int i = 0; i < 6; ++i) {
+        QCOMPARE(points[i].time, T0 + i * 1000 + (i == 4 ? 7 : 0));  // Irregular deltas survive
+        QCOMPARE(points[i].value, values[i]);
+    }
+    QCOMPARE(int(series->read(TimeSeries::Seconds, T0 + 1000, T0 + 3000).size()), 3);
+}
+
+void TestTimeSeries::minuteAndHourRollups() {
+    TimeSeries* series = TimeSeries::open("rollup");
+    // Minute m alternates m * 10 and m * 10 + 1: its mean is m * 10 + 0.5
+    for (int m = 0; m < 3; ++m) {
+        for (int s = 0; s < 60; ++s) series->append(T0 + m * Minute + s * 1000, m * 10 + s % 2);
+    }
+    series->append(T0 + 3 * Minute, 0);
+
+    QVector<TimeSeries::Point> minutes = series->read(TimeSeries::Minutes, T0, T0 + Hour);
+    QCOMPARE(int(minutes.size()), 3);  // The fourth minute is still open
+    for (int m = 0; m < 3; ++m) {
+        QCOMPARE(minutes[m].time, T0 + m * Minute);  // Stamped with the bucket's start
+        QCOMPARE(minutes[m].value, m * 10 + 0.5);
+    }
+    QVERIFY(series->read(TimeSeries::Hours, T0, T0 + Hour).isEmpty());
+
+    // The hour closes once a minute of the next hour is rolled up
+    series->append(T0 + Hour, 100);
+    series->append(T0 + Hour + Minute, 100);
+    QVector<TimeSeries::Point> hours = series->read(TimeSeries::Hours, T0, T0 + 2 * Hour);
+    QCOMPARE(int(hours.size()), 1);
+    QCOMPARE(hours[0].time, T0);
+    QCOMPARE(hours[0].value, (0.5 + 10.5 + 20.5 + 0) / 4);
+}
+
+void TestTimeSeries::rollupSurvivesReopen() {
+    TimeSeries* series = TimeSeries::open("reopen");
+    for (int s = 0; s < 30; ++s) series->append(T0 + s * 1000, 1);
+    TimeSeries::closeAll();
+
+    // The half-built minute is recovered from the seconds tier on disk
+    series = TimeSeries::open("reopen");
+    for (int s = 30; s < 60; ++s) series->append(T0 + s * 1000, 3);
+    series->append(T0 + Minute, 0);
+
+    QVector<TimeSeries::Point> minutes = series->read(TimeSeries::Minutes, T0, T0 + Hour);
+    QCOMPARE(int(minutes.size()), 1);
+    QCOMPARE(minutes[0].value, 2.0);
+}
+
+void TestTimeSeries::clockStepBackIsDropped() {
+    TimeSeries* series = TimeSeries::open("clockstep");
+    for (int s = 0; s < 60; ++s) series->append(T0 + s * 1000, 1);
+    series->append(T0 + 30 * 1000, 1000);    // Within the open minute
+    series->append(T0 + Minute, 0);
+    series->append(T0 + 10 * 1000, 500);     // Back into the closed one
+    series->append(T0 + Minute + 1000, 2);
+    series->append(T0 + 2 * Minute, 0);
+
+    QCOMPARE(int(series->read(TimeSeries::Seconds, T0, T0 + Hour).size()), 63);
+    QVector<TimeSeries::Point> minutes = series->read(TimeSeries::Minutes, T0, T0 + Hour);
+    QCOMPARE(int(minutes.size()), 2);
+    QCOMPARE(minutes[0].value, 1.0);  // Neither dropped point counted
+    QCOMPARE(minutes[1].time, T0 + Minute);
+    QCOMPARE(minutes[1].value, 1.0);
+}
+
+void TestTimeSeries::tornAppendIsDropped() {
+    TimeSeries* series = TimeSeries::open("torn");
+    for (int s = 0; s < 5; ++s) series->append(T0 + s * 1000, s + 1);
+    TimeSeries::closeAll();
+
+    // A process killed mid-append: the encoder state and some bits of a
+    // sixth point are written, the count is not. Offsets are those of
+    // BlockHeader in TimeSeries.cpp; block 0 is the second page.
+    QDirIterator files(m_data.path(), {"torn.1s.mts"}, QDir::Files, QDirIterator::Subdirectories);
+    QVERIFY(files.hasNext());
+    QFile file(files.next());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    const qint64 block = 4096, payload = block + 64;
+    auto field = [&](qint64 offset, auto value) {
+        char raw[sizeof value];
+        memcpy(raw, &value, sizeof value);
+        return file.seek(block + offset) && file.write(raw, sizeof raw) == qint64(sizeof raw);
+    };
+    QVERIFY(file.seek(block + 56));
+    quint32 bits = 0;
+    QCOMPARE(file.read(reinterpret_cast<char*>(&bits), sizeof bits), qint64(sizeof bits));
+    QVERIFY(field(32, qint64(T0 + 5000)));  // lastTime
+    QVERIFY(field(48, quint64(0x4058c00000000000ull)));  // lastValue: 99.0
+    QVERIFY(field(56, quint32(bits + 20)));
+    QVERIFY(file.seek(payload + bits / 8 + 1));
+    QVERIFY(file.write(QByteArray(2, char(0xff))) == 2);
+    file.close();
+
+    series = TimeSeries::open("torn");
+    series->append(T0 + 6000, 7);
+    series->append(T0 + 7000, 8);
+    QVector<TimeSeries::Point> points = series->read(TimeSeries::Seconds, T0, T0 + Minute);
+    QCOMPARE(int(points.size()), 7);
+    const double values[] = {1, 2, 3, 4, 5, 7, 8};
+    const qint64 times[] = {0, 1000, 2000, 3000, 4000, 6000, 7000};
+    for (int i = 0; i < 7; ++i) {
+        QCOMPARE(points[i].time, T0 + times[i]);
+        QCOMPARE(points[i].value, values[i]);
+    }
+}
+
+void TestTimeSeries::findDoesNotCreate() {
+    QVERIFY(!TimeSeries::find("unrecorded"));
+    QDirIterator files(m_data.path(), {"unrecorded*"}, QDir::Files, QDirIterator::Subdirectories);
+    QVERIFY(!files.hasNext());
+
+    TimeSeries::open("recorded")->append(T0, 4);
+    TimeSeries::closeAll();
+    TimeSeries* series = TimeSeries::find("recorded");  // On disk, not open
+    QVERIFY(series);
+    QCOMPARE(int(series->read(TimeSeries::Seconds, T0, T0).size()), 1);
+    QCOMPARE(TimeSeries::find("recorded"), series);
+}
+
+QTEST_GUILESS_MAIN(TestTimeSeries)
+#include "tst_timeseries.moc"
@@ -0,0 +1,178 @@
+/**
+ * MilkWidgetCore - WeatherAPI Tests
+ *
+ * The endpoint is a local HttpStub; the disk cache goes under a temporary
+ * XDG_CACHE_HOME. The stub lives for the whole run because the cache key
+ * includes the endpoint; each test that needs a clean slate uses its own city.
+ */
+
+#include "milk/APIs.h"
+#include "HttpStub.h"
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <memory>
+
+using namespace Milk;
+using MilkTest::HttpStub;
+
+static const QByteArray Oslo = R"({"main":{"temp":21.6,"feels_like":20.1,"humidity":40},)"
+                               R"("weather":[{"main":"Rain","description":"light rain","icon":"10d"}],)"
+                               R"("wind":{"speed":3.5,"deg":90},"name":"Oslo"})";
+
+class TestWeather : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void fetchAndCache();
+    void notModifiedRevalidates();
+    void serverErrorBacksOff();
+    void invalidJsonIsNotFresh();
+    void notModifiedWithoutCache();
+
+private:
+    WeatherAPI* start(const QString& city);
+
+    QTemporaryDir m_cache;
+    std::unique_ptr<HttpStub> m_server;
+    int m_sent = 0;  // Requests made before the current test
+};
+
+// Requests made by the current test
+#define SENT() (int(m_server->requests().size()) - m_sent)
+
+void TestWeather::initTestCase() {
+    QVERIFY(m_cache.isValid());
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(m_cache.path()));
+    m_server.reset(new HttpStub);
+    QVERIFY(m_server->isListening());
+}
+
+void TestWeather::cleanupTestCase() {
+    WeatherAPI::cleanup();
+}
+
+void TestWeather::init() {
+    // A fresh instance per test: no backoff or data left over
+    WeatherAPI::cleanup();
+    m_sent = m_server->requests().size();
+}
+
+WeatherAPI* TestWeather::start(const QString& city) {
+    WeatherAPI* weather = WeatherAPI::instance();
+    weather->setApiKey("key");
+    weather->setEndpoint(m_server->url("/weather"));
+    weather->setCity(city);
+    return weather;
+}
+
+void TestWeather::fetchAndCache() {
+    WeatherAPI* weather = start("Oslo");
+    QVERIFY(!weather->isValid());
+    QSignalSpy updated(weather, &WeatherAPI::updated);
+
+    m_server->enqueue(200, Oslo, "ETag: \"v1\"\r\nContent-Type: application/json\r\n");
+    weather->refresh();
+    QTRY_COMPARE(updated.count(), 1);
+    QCOMPARE(SENT(), 1);
+    const QByteArray& request = m_server->requests().last();
+    QVERIFY(request.startsWith("GET /weather?"));
+    QVERIFY(request.contains("q=Oslo"));
+    QVERIFY(request.contains("appid=key"));
+    QVERIFY(!request.contains("If-None-Match"));  // Nothing to revalidate yet
+
+    QVERIFY(weather->isValid());
+    QVERIFY(!weather->isStale());
+    QCOMPARE(weather->temperatureInt(), 22);
+    QCOMPARE(weather->city(), QString("Oslo"));
+    QCOMPARE(weather->windDirection(), QString("E"));
+    QVERIFY(weather->isRaining());
+
+    // Fresh data is served without a request
+    weather->refresh();
+    QTest::qWait(50);
+    QCOMPARE(SENT(), 1);
+
+    // A new instance shows the cached answer before any request
+    WeatherAPI::cleanup();
+    weather = start("Oslo");
+    QVERIFY(weather->isValid());
+    QCOMPARE(weather->temperatureInt(), 22);
+    QCOMPARE(SENT(), 1);
+}
+
+void TestWeather::notModifiedRevalidates() {
+    WeatherAPI* weather = start("Oslo");  // Cached by fetchAndCache
+    QVERIFY(weather->isValid());
+    weather->setCacheTtl(0);
+    QVERIFY(weather->isStale());
+    QDateTime before = weather->lastUpdate();
+    QSignalSpy updated(weather, &WeatherAPI::updated);
+
+    QTest::qWait(5);
+    m_server->enqueue(304);
+    weather->refresh();
+    QTRY_VERIFY(weather->lastUpdate() > before);
+    QCOMPARE(SENT(), 1);
+    QVERIFY(m_server->requests().last().contains("If-None-Match: \"v1\""));
+    QCOMPARE(updated.count(), 0);  // Nothing to re-parse or repaint
+    QCOMPARE(weather->temperatureInt(), 22);
+}
+
+void TestWeather::serverErrorBacksOff() {
+    WeatherAPI* weather = start("Bergen");
+    QSignalSpy errors(weather, &WeatherAPI::error);
+
+    m_server->enqueue(500, "oops");
+    weather->refresh();
+    QTRY_COMPARE(errors.count(), 1);
+    QVERIFY2(errors.first().at(0).toString().contains("retrying in 30s"), qPrintable(errors.first().at(0).toString()));
+    QVERIFY(!weather->isValid());
+
+    // Backing off: refresh() does not hammer the server
+    weather->refresh();
+    QTest::qWait(50);
+    QCOMPARE(SENT(), 1);
+}
+
+void TestWeather::invalidJsonIsNotFresh() {
+    WeatherAPI* weather = start("Tromso");
+    QSignalSpy errors(weather, &WeatherAPI::error);
+    QSignalSpy updated(weather, &WeatherAPI::updated);
+
+    m_server->enqueue(200, "{\"main\": {", "ETag: \"broken\"\r\n");
+    weather->refresh();
+    QTRY_COMPARE(errors.count(), 1);
+    QString message = errors.first().at(0).toString();
+    QVERIFY2(message.startsWith("Invalid weather response"), qPrintable(message));
+    QVERIFY2(message.contains("retrying in 30s"), qPrintable(message));
+    QCOMPARE(updated.count(), 0);
+    QVERIFY(!weather->isValid());
+    QVERIFY(weather->isStale());
+
+    weather->refresh();
+    QTest::qWait(50);
+    QCOMPARE(SENT(), 1);
+}
+
+void TestWeather::notModifiedWithoutCache() {
+    // A 304 to an unconditional request has nothing behind it
+    WeatherAPI* weather = start("Bodo");
+    QSignalSpy errors(weather, &WeatherAPI::error);
+    QSignalSpy updated(weather, &WeatherAPI::updated);
+
+    m_server->enqueue(304);
+    weather->refresh();
+    QTRY_COMPARE(errors.count(), 1);
+    QVERIFY(errors.first().at(0).toString().contains("retrying"));
+    QCOMPARE(updated.count(), 0);
+    QVERIFY(!weather->isValid());
+}
+
+QTEST_GUILESS_MAIN(TestWeather)
+#include "tst_weather.moc"